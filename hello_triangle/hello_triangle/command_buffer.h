@@ -0,0 +1,605 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "jobs.h"
+#include "gl_state.h"
+#include "pipeline_state.h"
+
+// Draw recording that does not need the GL context. Worker threads record
+// into their own command_buffer_t; every recorded item starts with a 64-bit
+// sort key followed by the packets that set up and issue one draw. The render
+// thread radix-sorts all items by key and replays them through gl_state, so
+// state shared by neighbouring items is set only once.
+//
+// Items with equal keys keep their order within one buffer, but not across
+// buffers: put everything the order depends on into the key.
+
+//
+// Sort key, most significant first:
+//
+//     63..56  pass
+//     55..44  program
+//     43..24  material
+//     23..0   depth
+//
+
+#define COMMAND_KEY_PASS_BITS 8
+#define COMMAND_KEY_PROGRAM_BITS 12
+#define COMMAND_KEY_MATERIAL_BITS 20
+#define COMMAND_KEY_DEPTH_BITS 24
+
+static_assert(PIPELINE_STATE_MAX <= (1u << COMMAND_KEY_PROGRAM_BITS), "pipeline handles have to fit the key's program bits");
+
+// depth is in [0, 1]; pass back_to_front for blended passes.
+inline uint64_t command_key(uint32_t pass, uint32_t program, uint32_t material, real32_t depth, bool back_to_front)
+{
+    assert(pass < (1u << COMMAND_KEY_PASS_BITS));
+    assert(program < (1u << COMMAND_KEY_PROGRAM_BITS));
+    assert(material < (1u << COMMAND_KEY_MATERIAL_BITS));
+
+    uint32_t depth_max = (1u << COMMAND_KEY_DEPTH_BITS) - 1;
+    depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+    uint32_t depth_bits = (uint32_t)(depth * (real32_t)depth_max);
+    if (back_to_front)
+    {
+        depth_bits = depth_max - depth_bits;
+    }
+
+    uint64_t key = pass;
+    key = (key << COMMAND_KEY_PROGRAM_BITS) | program;
+    key = (key << COMMAND_KEY_MATERIAL_BITS) | material;
+    key = (key << COMMAND_KEY_DEPTH_BITS) | depth_bits;
+    return key;
+}
+
+//
+// Packets
+//
+
+enum command_type_t
+{
+    COMMAND_USE_PROGRAM,
+    COMMAND_BIND_VERTEX_ARRAY,
+    COMMAND_BIND_BUFFER,
+    COMMAND_BIND_BUFFER_RANGE,
+    COMMAND_BIND_TEXTURE,
+    COMMAND_SET_RENDER_STATE,
+    COMMAND_SET_PIPELINE,
+    COMMAND_UNIFORM_4FV,
+    COMMAND_UNIFORM_MATRIX_4FV,
+    COMMAND_DRAW_ARRAYS,
+    COMMAND_DRAW_ELEMENTS,
+};
+
+// Every packet starts with a header; size includes the header and is a
+// multiple of 8.
+struct command_header_t
+{
+    uint32_t type;
+    uint32_t size;
+};
+
+struct command_object_t
+{
+    command_header_t header;
+    uint32_t object;
+    uint32_t pad;
+};
+
+struct command_bind_buffer_t
+{
+    command_header_t header;
+    uint32_t target;
+    uint32_t buffer;
+};
+
+struct command_bind_buffer_range_t
+{
+    command_header_t header;
+    uint32_t target;
+    uint32_t index;
+    uint32_t buffer;
+    uint32_t pad;
+    int64_t offset;
+    int64_t size;
+};
+
+struct command_bind_texture_t
+{
+    command_header_t header;
+    uint32_t unit;
+    uint32_t target;
+    uint32_t texture;
+    uint32_t pad;
+};
+
+struct command_render_state_t
+{
+    command_header_t header;
+    uint8_t blend;
+    uint8_t depth_test;
+    uint8_t depth_write;
+    uint8_t cull;
+    uint32_t blend_source;
+    uint32_t blend_destination;
+    uint32_t depth_function;
+};
+
+struct command_uniform_t
+{
+    command_header_t header;
+    int32_t location;
+    uint32_t pad;
+    real32_t value[16];
+};
+
+struct command_draw_arrays_t
+{
+    command_header_t header;
+    uint32_t mode;
+    int32_t first;
+    int32_t count;
+    int32_t instance_count;
+};
+
+struct command_draw_elements_t
+{
+    command_header_t header;
+    uint32_t mode;
+    int32_t count;
+    uint32_t index_type;
+    int32_t instance_count;
+    uint64_t offset;
+    int32_t base_vertex;
+    uint32_t pad;
+};
+
+struct command_render_state_desc_t
+{
+    bool blend;
+    bool depth_test;
+    bool depth_write;
+    bool cull;
+    uint32_t blend_source;
+    uint32_t blend_destination;
+    uint32_t depth_function;
+};
+
+//
+// Buffers
+//
+
+// Packets in [begin, end) of the buffer's memory.
+struct command_item_t
+{
+    uint64_t key;
+    uint32_t begin;
+    uint32_t end;
+};
+
+struct command_buffer_t
+{
+    uint8_t *memory;
+    uint32_t size;
+    uint32_t capacity;
+
+    command_item_t *items;
+    uint32_t item_count;
+    uint32_t item_capacity;
+};
+
+void command_buffer_reset(command_buffer_t *buffer)
+{
+    buffer->size = 0;
+    buffer->item_count = 0;
+}
+
+void command_buffer_free(command_buffer_t *buffer)
+{
+    free(buffer->memory);
+    free(buffer->items);
+    *buffer = {};
+}
+
+// Starts a new item; the packets recorded after it belong to it.
+void command_begin(command_buffer_t *buffer, uint64_t key)
+{
+    if (buffer->item_count)
+    {
+        buffer->items[buffer->item_count - 1].end = buffer->size;
+    }
+    if (buffer->item_count == buffer->item_capacity)
+    {
+        buffer->item_capacity = buffer->item_capacity ? buffer->item_capacity * 2 : 1024;
+        buffer->items = (command_item_t *)realloc(buffer->items, buffer->item_capacity * sizeof(command_item_t));
+        assert(buffer->items);
+    }
+    command_item_t *item = &buffer->items[buffer->item_count++];
+    item->key = key;
+    item->begin = buffer->size;
+    item->end = buffer->size;
+}
+
+// The returned packet is only valid until the next push.
+void *command_push(command_buffer_t *buffer, uint32_t type, uint32_t size)
+{
+    assert(buffer->item_count && "command_begin() has to come first");
+    assert(size % 8 == 0);
+
+    if (buffer->size + size > buffer->capacity)
+    {
+        uint32_t capacity = buffer->capacity ? buffer->capacity : 64 * 1024;
+        while (buffer->size + size > capacity)
+        {
+            capacity *= 2;
+        }
+        buffer->memory = (uint8_t *)realloc(buffer->memory, capacity);
+        assert(buffer->memory);
+        buffer->capacity = capacity;
+    }
+
+    command_header_t *header = (command_header_t *)(buffer->memory + buffer->size);
+    header->type = type;
+    header->size = size;
+    buffer->size += size;
+    return header;
+}
+
+void command_use_program(command_buffer_t *buffer, uint32_t program)
+{
+    command_object_t *command = (command_object_t *)command_push(buffer, COMMAND_USE_PROGRAM, sizeof(command_object_t));
+    command->object = program;
+}
+
+void command_bind_vertex_array(command_buffer_t *buffer, uint32_t vertex_array)
+{
+    command_object_t *command = (command_object_t *)command_push(buffer, COMMAND_BIND_VERTEX_ARRAY, sizeof(command_object_t));
+    command->object = vertex_array;
+}
+
+// Program, vertex array and fixed-function state in one packet. Pipeline
+// handles fit the key's program bits, so items sorted by pipeline can use the
+// handle there.
+void command_set_pipeline(command_buffer_t *buffer, uint32_t pipeline)
+{
+    command_object_t *command = (command_object_t *)command_push(buffer, COMMAND_SET_PIPELINE, sizeof(command_object_t));
+    command->object = pipeline;
+}
+
+void command_bind_buffer(command_buffer_t *buffer, uint32_t target, uint32_t gl_buffer)
+{
+    command_bind_buffer_t *command = (command_bind_buffer_t *)command_push(buffer, COMMAND_BIND_BUFFER, sizeof(command_bind_buffer_t));
+    command->target = target;
+    command->buffer = gl_buffer;
+}
+
+// size -1 binds the whole buffer.
+void command_bind_buffer_range(command_buffer_t *buffer, uint32_t target, uint32_t index, uint32_t gl_buffer, int64_t offset, int64_t size)
+{
+    command_bind_buffer_range_t *command = (command_bind_buffer_range_t *)command_push(buffer, COMMAND_BIND_BUFFER_RANGE, sizeof(command_bind_buffer_range_t));
+    command->target = target;
+    command->index = index;
+    command->buffer = gl_buffer;
+    command->offset = offset;
+    command->size = size;
+}
+
+void command_bind_texture(command_buffer_t *buffer, uint32_t unit, uint32_t target, uint32_t texture)
+{
+    command_bind_texture_t *command = (command_bind_texture_t *)command_push(buffer, COMMAND_BIND_TEXTURE, sizeof(command_bind_texture_t));
+    command->unit = unit;
+    command->target = target;
+    command->texture = texture;
+}
+
+void command_set_render_state(command_buffer_t *buffer, const command_render_state_desc_t *desc)
+{
+    command_render_state_t *command = (command_render_state_t *)command_push(buffer, COMMAND_SET_RENDER_STATE, sizeof(command_render_state_t));
+    command->blend = desc->blend;
+    command->depth_test = desc->depth_test;
+    command->depth_write = desc->depth_write;
+    command->cull = desc->cull;
+    command->blend_source = desc->blend_source;
+    command->blend_destination = desc->blend_destination;
+    command->depth_function = desc->depth_function;
+}
+
+// Uniform packets copy the value, so it can live on the recording stack. The
+// 4-float packet is cut short to keep it at 32 bytes.
+void command_uniform_4fv(command_buffer_t *buffer, int32_t location, const real32_t *value)
+{
+    uint32_t size = (uint32_t)(sizeof(command_uniform_t) - 12 * sizeof(real32_t));
+    command_uniform_t *command = (command_uniform_t *)command_push(buffer, COMMAND_UNIFORM_4FV, size);
+    command->location = location;
+    memcpy(command->value, value, 4 * sizeof(real32_t));
+}
+
+void command_uniform_matrix_4fv(command_buffer_t *buffer, int32_t location, const real32_t *value)
+{
+    command_uniform_t *command = (command_uniform_t *)command_push(buffer, COMMAND_UNIFORM_MATRIX_4FV, sizeof(command_uniform_t));
+    command->location = location;
+    memcpy(command->value, value, 16 * sizeof(real32_t));
+}
+
+void command_draw_arrays(command_buffer_t *buffer, uint32_t mode, int32_t first, int32_t count, int32_t instance_count)
+{
+    command_draw_arrays_t *command = (command_draw_arrays_t *)command_push(buffer, COMMAND_DRAW_ARRAYS, sizeof(command_draw_arrays_t));
+    command->mode = mode;
+    command->first = first;
+    command->count = count;
+    command->instance_count = instance_count;
+}
+
+// offset is in bytes into the bound element buffer.
+void command_draw_elements(command_buffer_t *buffer, uint32_t mode, int32_t count, uint32_t index_type, uint64_t offset, int32_t base_vertex, int32_t instance_count)
+{
+    command_draw_elements_t *command = (command_draw_elements_t *)command_push(buffer, COMMAND_DRAW_ELEMENTS, sizeof(command_draw_elements_t));
+    command->mode = mode;
+    command->count = count;
+    command->index_type = index_type;
+    command->instance_count = instance_count;
+    command->offset = offset;
+    command->base_vertex = base_vertex;
+}
+
+//
+// Queue
+//
+
+struct command_sort_entry_t
+{
+    uint64_t key;
+    uint32_t buffer;
+    uint32_t item;
+};
+
+struct command_queue_stats_t
+{
+    uint32_t items;
+    uint32_t packets;
+    uint32_t bytes;
+};
+
+// One buffer per pool worker.
+struct command_queue_t
+{
+    job_pool_t *pool;
+    command_buffer_t *buffers;
+    uint32_t buffer_count;
+
+    command_sort_entry_t *entries;
+    command_sort_entry_t *scratch;
+    uint32_t entry_capacity;
+
+    command_queue_stats_t stats;
+};
+
+command_queue_t *command_queue_create(job_pool_t *pool)
+{
+    command_queue_t *queue = (command_queue_t *)calloc(1, sizeof(command_queue_t));
+    assert(queue);
+    queue->pool = pool;
+    queue->buffer_count = job_pool_worker_count(pool);
+    queue->buffers = (command_buffer_t *)calloc(queue->buffer_count, sizeof(command_buffer_t));
+    assert(queue->buffers);
+    return queue;
+}
+
+void command_queue_destroy(command_queue_t *queue)
+{
+    for (uint32_t i = 0; i < queue->buffer_count; ++i)
+    {
+        command_buffer_free(&queue->buffers[i]);
+    }
+    free(queue->buffers);
+    free(queue->entries);
+    free(queue->scratch);
+    free(queue);
+}
+
+inline command_buffer_t *command_queue_buffer(command_queue_t *queue, uint32_t worker)
+{
+    assert(worker < queue->buffer_count);
+    return &queue->buffers[worker];
+}
+
+// Runs record(data, index, worker) for every index on the pool; record into
+// command_queue_buffer(queue, worker). Can be called several times per frame.
+void command_queue_record(command_queue_t *queue, uint32_t count, job_function_t *record, void *data)
+{
+    job_pool_run(queue->pool, count, record, data);
+}
+
+// LSD radix sort, one byte per pass. Passes where every key has the same
+// byte are skipped, which for typical keys removes most of them. Stable, so
+// equal keys stay in gather order.
+void command_radix_sort(command_sort_entry_t *entries, command_sort_entry_t *scratch, uint32_t count)
+{
+    uint32_t histograms[8][256] = {};
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint64_t key = entries[i].key;
+        for (uint32_t pass = 0; pass < 8; ++pass)
+        {
+            ++histograms[pass][(key >> (pass * 8)) & 0xff];
+        }
+    }
+
+    command_sort_entry_t *source = entries;
+    command_sort_entry_t *destination = scratch;
+    for (uint32_t pass = 0; pass < 8; ++pass)
+    {
+        uint32_t *histogram = histograms[pass];
+        if (histogram[(source[0].key >> (pass * 8)) & 0xff] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            destination[histogram[(source[i].key >> (pass * 8)) & 0xff]++] = source[i];
+        }
+
+        command_sort_entry_t *swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != entries)
+    {
+        memcpy(entries, source, count * sizeof(command_sort_entry_t));
+    }
+}
+
+void command_execute(const uint8_t *packets, uint32_t size, command_queue_stats_t *stats)
+{
+    for (uint32_t at = 0; at < size;)
+    {
+        const command_header_t *header = (const command_header_t *)(packets + at);
+        switch (header->type)
+        {
+        case COMMAND_USE_PROGRAM: {
+            gl_state_use_program(((const command_object_t *)header)->object);
+        } break;
+
+        case COMMAND_BIND_VERTEX_ARRAY: {
+            gl_state_bind_vertex_array(((const command_object_t *)header)->object);
+        } break;
+
+        case COMMAND_BIND_BUFFER: {
+            const command_bind_buffer_t *command = (const command_bind_buffer_t *)header;
+            gl_state_bind_buffer(command->target, command->buffer);
+        } break;
+
+        case COMMAND_BIND_BUFFER_RANGE: {
+            const command_bind_buffer_range_t *command = (const command_bind_buffer_range_t *)header;
+            gl_state_bind_buffer_range(command->target, command->index, command->buffer, command->offset, command->size);
+        } break;
+
+        case COMMAND_BIND_TEXTURE: {
+            const command_bind_texture_t *command = (const command_bind_texture_t *)header;
+            gl_state_bind_texture(command->unit, command->target, command->texture);
+        } break;
+
+        case COMMAND_SET_RENDER_STATE: {
+            const command_render_state_t *command = (const command_render_state_t *)header;
+            gl_state_set_blend(command->blend != 0);
+            if (command->blend)
+            {
+                gl_state_set_blend_function(command->blend_source, command->blend_destination, command->blend_source, command->blend_destination);
+            }
+            gl_state_set_depth_test(command->depth_test != 0);
+            gl_state_set_depth_write(command->depth_write != 0);
+            if (command->depth_test)
+            {
+                gl_state_set_depth_function(command->depth_function);
+            }
+            gl_state_set_cull(command->cull != 0);
+            pipeline_state_invalidate();
+        } break;
+
+        case COMMAND_SET_PIPELINE: {
+            pipeline_state_apply(((const command_object_t *)header)->object);
+        } break;
+
+        case COMMAND_UNIFORM_4FV: {
+            const command_uniform_t *command = (const command_uniform_t *)header;
+            gl_state_uniform_4fv(command->location, 1, command->value);
+        } break;
+
+        case COMMAND_UNIFORM_MATRIX_4FV: {
+            const command_uniform_t *command = (const command_uniform_t *)header;
+            gl_state_uniform_matrix_4fv(command->location, 1, false, command->value);
+        } break;
+
+        case COMMAND_DRAW_ARRAYS: {
+            const command_draw_arrays_t *command = (const command_draw_arrays_t *)header;
+            glDrawArraysInstanced(command->mode, command->first, command->count, command->instance_count);
+        } break;
+
+        case COMMAND_DRAW_ELEMENTS: {
+            const command_draw_elements_t *command = (const command_draw_elements_t *)header;
+            glDrawElementsInstancedBaseVertex(command->mode, command->count, command->index_type, (const void *)(uintptr_t)command->offset, command->instance_count, command->base_vertex);
+        } break;
+
+        default: {
+            assert(!"unknown command");
+        } break;
+        }
+
+        assert(header->size);
+        at += header->size;
+        ++stats->packets;
+    }
+}
+
+// Sorts everything recorded since the last submit and replays it on the
+// calling thread, which has to own the GL context. Clears the buffers.
+void command_queue_submit(command_queue_t *queue)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < queue->buffer_count; ++i)
+    {
+        command_buffer_t *buffer = &queue->buffers[i];
+        if (buffer->item_count)
+        {
+            buffer->items[buffer->item_count - 1].end = buffer->size;
+        }
+        count += buffer->item_count;
+    }
+
+    queue->stats = {};
+    queue->stats.items = count;
+    if (!count)
+    {
+        return;
+    }
+
+    if (count > queue->entry_capacity)
+    {
+        free(queue->entries);
+        free(queue->scratch);
+        queue->entry_capacity = count + count / 2;
+        queue->entries = (command_sort_entry_t *)malloc(queue->entry_capacity * sizeof(command_sort_entry_t));
+        queue->scratch = (command_sort_entry_t *)malloc(queue->entry_capacity * sizeof(command_sort_entry_t));
+        assert(queue->entries && queue->scratch);
+    }
+
+    command_sort_entry_t *entry = queue->entries;
+    for (uint32_t i = 0; i < queue->buffer_count; ++i)
+    {
+        command_buffer_t *buffer = &queue->buffers[i];
+        for (uint32_t item = 0; item < buffer->item_count; ++item)
+        {
+            entry->key = buffer->items[item].key;
+            entry->buffer = i;
+            entry->item = item;
+            ++entry;
+        }
+    }
+
+    command_radix_sort(queue->entries, queue->scratch, count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        command_buffer_t *buffer = &queue->buffers[queue->entries[i].buffer];
+        command_item_t *item = &buffer->items[queue->entries[i].item];
+        command_execute(buffer->memory + item->begin, item->end - item->begin, &queue->stats);
+        queue->stats.bytes += item->end - item->begin;
+    }
+
+    for (uint32_t i = 0; i < queue->buffer_count; ++i)
+    {
+        command_buffer_reset(&queue->buffers[i]);
+    }
+}
@@ -0,0 +1,2358 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "simd.h"
+#include "texture.h"
+
+// Compiler for a GLSL 4.00 subset and the virtual machine that runs it on the CPU.
+//
+// Supported: float/int/bool, vec2-4, ivec2-4, bvec2-4, mat2-4, sampler2D,
+// uniforms, in/out with layout(location = N), const and global arrays with
+// initializers, gl_VertexID, gl_InstanceID, gl_Position, gl_FragCoord,
+// arithmetic, comparisons, logic, ?:, swizzles (read and write), constant and
+// dynamic indexing (read and write, one dynamic index per l-value), constructors, the common built-in functions, texture(),
+// if/else, for and while. Only main() may be defined; break, continue,
+// return and discard are not supported.
+//
+// Every vector component is scalarized into its own register at compile time,
+// so swizzles cost nothing and each instruction is a plain operation on one
+// register of 8 or 16 lanes. Divergent control flow runs both sides under an
+// execution mask, exactly like a GPU does.
+
+#define CPU_SHADER_MAX_INSTRUCTIONS 4096
+#define CPU_SHADER_MAX_REGISTERS 2048
+#define CPU_SHADER_MAX_CONSTANTS 512
+#define CPU_SHADER_MAX_SYMBOLS 256
+#define CPU_SHADER_MAX_VARIABLES 16
+#define CPU_SHADER_MAX_UNIFORM_FLOATS 1024
+#define CPU_SHADER_MAX_MASK_DEPTH 16
+#define CPU_SHADER_NAME_LENGTH 32
+
+// Register operands with this bit set refer to the constant pool until the
+// final pass assigns them real registers.
+#define CPU_SHADER_CONSTANT_BIT 0x8000
+
+enum cpu_shader_stage_t
+{
+    CPU_SHADER_VERTEX,
+    CPU_SHADER_FRAGMENT,
+};
+
+enum cpu_shader_opcode_t
+{
+    CPU_OP_MOV,             // dst = a, only for lanes in the execution mask
+    CPU_OP_ADD,
+    CPU_OP_SUB,
+    CPU_OP_MUL,
+    CPU_OP_DIV,
+    CPU_OP_MAD,             // dst = a * b + c
+    CPU_OP_MIN,
+    CPU_OP_MAX,
+    CPU_OP_ABS,
+    CPU_OP_FLOOR,
+    CPU_OP_TRUNC,
+    CPU_OP_SQRT,
+    CPU_OP_SIN,
+    CPU_OP_COS,
+    CPU_OP_EXP2,
+    CPU_OP_LOG2,
+    CPU_OP_CMP_LT,
+    CPU_OP_CMP_LE,
+    CPU_OP_CMP_EQ,
+    CPU_OP_CMP_NE,
+    CPU_OP_AND,
+    CPU_OP_OR,
+    CPU_OP_NOT,
+    CPU_OP_SELECT,          // dst = a ? b : c
+    CPU_OP_INDEX,           // dst = register[a + index(b) * d] with c elements
+    CPU_OP_STORE_INDEX,     // register[dst + index(b) * d] = a with c elements, masked
+    CPU_OP_TEXTURE,         // dst..dst+3 = texture(sampler c, vec2(a, b))
+    CPU_OP_MASK_PUSH,       // push the execution mask, then mask &= a
+    CPU_OP_MASK_AND,        // mask &= a
+    CPU_OP_MASK_ELSE,       // mask = pushed mask & ~a
+    CPU_OP_MASK_POP,
+    CPU_OP_JUMP,            // jump to a
+    CPU_OP_JUMP_IF_NONE,    // jump to a when no lane is active
+    CPU_OP_END,
+};
+
+struct cpu_shader_instruction_t
+{
+    uint16_t op;
+    uint16_t dst;
+    uint16_t a, b, c, d;
+};
+
+enum cpu_shader_base_type_t
+{
+    CPU_TYPE_VOID,
+    CPU_TYPE_FLOAT,
+    CPU_TYPE_INT,
+    CPU_TYPE_BOOL,
+    CPU_TYPE_SAMPLER,
+};
+
+struct cpu_shader_type_t
+{
+    uint8_t base;
+    uint8_t rows;           // components per column, 1 for scalars
+    uint8_t columns;        // 1 unless a matrix
+    uint16_t array_length;  // 0 unless an array
+};
+
+// A uniform, input, output or sampler visible through the API.
+struct cpu_shader_variable_t
+{
+    char name[CPU_SHADER_NAME_LENGTH];
+    cpu_shader_type_t type;
+    uint16_t first_register;
+    uint16_t component_count;
+    uint16_t offset;        // into uniform_values for uniforms, sampler slot for samplers
+    bool used;
+};
+
+struct cpu_shader_sampler_t
+{
+    const texture_t *texture;
+    texture_filter_t filter;
+};
+
+struct cpu_shader_t
+{
+    cpu_shader_stage_t stage;
+
+    cpu_shader_instruction_t code[CPU_SHADER_MAX_INSTRUCTIONS];
+    uint32_t code_size;
+    uint32_t register_count;
+
+    uint32_t constant_count;
+    uint32_t constant_bits[CPU_SHADER_MAX_CONSTANTS];
+    uint16_t constant_first_register;
+
+    cpu_shader_variable_t uniforms[CPU_SHADER_MAX_VARIABLES];
+    uint32_t uniform_count;
+    real32_t uniform_values[CPU_SHADER_MAX_UNIFORM_FLOATS];
+    uint32_t uniform_float_count;
+
+    cpu_shader_variable_t samplers[CPU_SHADER_MAX_VARIABLES];
+    cpu_shader_sampler_t sampler_bindings[CPU_SHADER_MAX_VARIABLES];
+    uint32_t sampler_count;
+
+    // Indexed by location.
+    cpu_shader_variable_t inputs[CPU_SHADER_MAX_VARIABLES];
+    cpu_shader_variable_t outputs[CPU_SHADER_MAX_VARIABLES];
+    uint32_t input_count;
+    uint32_t output_count;
+
+    int32_t vertex_id_register;
+    int32_t instance_id_register;
+};
+
+// Per-invocation data, invocation i component c lives at data[i * stride + c].
+struct cpu_shader_stream_t
+{
+    real32_t *data;
+    uint32_t stride;
+};
+
+struct cpu_shader_run_t
+{
+    uint32_t first_vertex;
+    uint32_t instance;
+    cpu_shader_stream_t inputs[CPU_SHADER_MAX_VARIABLES];
+    cpu_shader_stream_t outputs[CPU_SHADER_MAX_VARIABLES];
+};
+
+// Register file for one thread. group_width is 8 or 16 invocations.
+struct cpu_shader_context_t
+{
+    const cpu_shader_t *shader;
+    uint32_t group_width;
+    real32_t *registers;
+    real32_t *mask;
+    real32_t *mask_stack;
+    void *memory;
+};
+
+//
+// Compiler
+//
+
+enum cpu_shader_token_kind_t
+{
+    CPU_TOKEN_END,
+    CPU_TOKEN_IDENTIFIER,
+    CPU_TOKEN_NUMBER,
+    CPU_TOKEN_SYMBOL,
+};
+
+struct cpu_shader_token_t
+{
+    cpu_shader_token_kind_t kind;
+    const char *text;
+    uint32_t length;
+    real32_t number;
+    bool is_integer;
+    uint32_t line;
+};
+
+enum cpu_shader_storage_t
+{
+    CPU_STORAGE_LOCAL,
+    CPU_STORAGE_CONST,
+    CPU_STORAGE_UNIFORM,
+    CPU_STORAGE_INPUT,
+    CPU_STORAGE_OUTPUT,
+    CPU_STORAGE_SAMPLER,
+};
+
+struct cpu_shader_symbol_t
+{
+    char name[CPU_SHADER_NAME_LENGTH];
+    cpu_shader_type_t type;
+    cpu_shader_storage_t storage;
+    uint16_t first_register;
+    uint16_t slot;
+    uint32_t scope;
+    cpu_shader_variable_t *variable;
+};
+
+// Where an element picked by a dynamic index came from, so a store can write
+// its registers back into the one each lane picked.
+struct cpu_shader_indexed_t
+{
+    uint16_t first;         // first register of element 0
+    uint16_t index;
+    uint16_t count;         // elements, 0 unless the value was indexed
+    uint16_t size;          // registers per element
+    uint16_t element;       // first register of the element read out
+};
+
+struct cpu_shader_value_t
+{
+    cpu_shader_type_t type;
+    uint16_t reg[16];               // one register per component, column-major
+    uint16_t array_register;        // first register of an array value
+    cpu_shader_symbol_t *symbol;    // set when the value can be assigned to
+    cpu_shader_indexed_t indexed;
+};
+
+struct cpu_shader_compiler_t
+{
+    cpu_shader_t *shader;
+    const char *cursor;
+    uint32_t line;
+    cpu_shader_token_t token;
+
+    cpu_shader_symbol_t symbols[CPU_SHADER_MAX_SYMBOLS];
+    uint32_t symbol_count;
+    uint32_t scope;
+
+    uint32_t next_register;
+    uint32_t max_register;
+
+    bool failed;
+    char *error;
+    uint32_t error_size;
+};
+
+void cpu_shader_error(cpu_shader_compiler_t *c, const char *message, const char *detail = "")
+{
+    if (!c->failed)
+    {
+        c->failed = true;
+        snprintf(c->error, c->error_size, "ERROR: 0:%u: %s%s", c->token.line, message, detail);
+    }
+}
+
+void cpu_shader_next_token(cpu_shader_compiler_t *c)
+{
+    const char *p = c->cursor;
+
+    for (;;)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        {
+            if (*p == '\n')
+            {
+                ++c->line;
+            }
+            ++p;
+        }
+
+        if (p[0] == '/' && p[1] == '/')
+        {
+            while (*p && *p != '\n') ++p;
+        }
+        else if (p[0] == '/' && p[1] == '*')
+        {
+            p += 2;
+            while (*p && !(p[0] == '*' && p[1] == '/'))
+            {
+                if (*p == '\n') ++c->line;
+                ++p;
+            }
+            if (*p) p += 2;
+        }
+        else if (*p == '#')
+        {
+            // #version and friends carry nothing the CPU backend needs.
+            while (*p && *p != '\n') ++p;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    cpu_shader_token_t *token = &c->token;
+    token->text = p;
+    token->line = c->line;
+
+    if (*p == 0)
+    {
+        token->kind = CPU_TOKEN_END;
+        token->length = 0;
+    }
+    else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_')
+    {
+        while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_') ++p;
+        token->kind = CPU_TOKEN_IDENTIFIER;
+        token->length = (uint32_t)(p - token->text);
+    }
+    else if ((*p >= '0' && *p <= '9') || (*p == '.' && p[1] >= '0' && p[1] <= '9'))
+    {
+        char *end;
+        token->number = strtof(p, &end);
+        token->is_integer = true;
+        for (const char *q = p; q < end; ++q)
+        {
+            if (*q == '.' || *q == 'e' || *q == 'E') token->is_integer = false;
+        }
+        p = end;
+        if (*p == 'f' || *p == 'F' || *p == 'u' || *p == 'U') ++p;
+        token->kind = CPU_TOKEN_NUMBER;
+        token->length = (uint32_t)(p - token->text);
+    }
+    else
+    {
+        static const char *pairs[] = { "<=", ">=", "==", "!=", "&&", "||", "+=", "-=", "*=", "/=", "++", "--" };
+        token->kind = CPU_TOKEN_SYMBOL;
+        token->length = 1;
+        for (uint32_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i)
+        {
+            if (p[0] == pairs[i][0] && p[1] == pairs[i][1])
+            {
+                token->length = 2;
+                break;
+            }
+        }
+        p += token->length;
+    }
+
+    c->cursor = p;
+}
+
+bool cpu_shader_token_is(cpu_shader_compiler_t *c, const char *text)
+{
+    uint32_t length = (uint32_t)strlen(text);
+    return c->token.kind != CPU_TOKEN_END && c->token.length == length && memcmp(c->token.text, text, length) == 0;
+}
+
+bool cpu_shader_accept(cpu_shader_compiler_t *c, const char *text)
+{
+    if (cpu_shader_token_is(c, text))
+    {
+        cpu_shader_next_token(c);
+        return true;
+    }
+    return false;
+}
+
+void cpu_shader_expect(cpu_shader_compiler_t *c, const char *text)
+{
+    if (!cpu_shader_accept(c, text))
+    {
+        cpu_shader_error(c, "expected ", text);
+    }
+}
+
+void cpu_shader_token_name(cpu_shader_compiler_t *c, char *name)
+{
+    uint32_t length = c->token.length < CPU_SHADER_NAME_LENGTH - 1 ? c->token.length : CPU_SHADER_NAME_LENGTH - 1;
+    memcpy(name, c->token.text, length);
+    name[length] = 0;
+}
+
+inline cpu_shader_type_t cpu_shader_make_type(uint8_t base, uint8_t rows, uint8_t columns = 1)
+{
+    cpu_shader_type_t type = {};
+    type.base = base;
+    type.rows = rows;
+    type.columns = columns;
+    return type;
+}
+
+inline uint32_t cpu_shader_component_count(cpu_shader_type_t type)
+{
+    return (uint32_t)type.rows * type.columns;
+}
+
+inline uint32_t cpu_shader_register_count(cpu_shader_type_t type)
+{
+    return cpu_shader_component_count(type) * (type.array_length ? type.array_length : 1);
+}
+
+bool cpu_shader_parse_type_name(cpu_shader_compiler_t *c, cpu_shader_type_t *type)
+{
+    struct type_name_t { const char *name; uint8_t base, rows, columns; };
+    static const type_name_t names[] = {
+        { "void", CPU_TYPE_VOID, 0, 0 },
+        { "float", CPU_TYPE_FLOAT, 1, 1 }, { "int", CPU_TYPE_INT, 1, 1 }, { "uint", CPU_TYPE_INT, 1, 1 }, { "bool", CPU_TYPE_BOOL, 1, 1 },
+        { "vec2", CPU_TYPE_FLOAT, 2, 1 }, { "vec3", CPU_TYPE_FLOAT, 3, 1 }, { "vec4", CPU_TYPE_FLOAT, 4, 1 },
+        { "ivec2", CPU_TYPE_INT, 2, 1 }, { "ivec3", CPU_TYPE_INT, 3, 1 }, { "ivec4", CPU_TYPE_INT, 4, 1 },
+        { "bvec2", CPU_TYPE_BOOL, 2, 1 }, { "bvec3", CPU_TYPE_BOOL, 3, 1 }, { "bvec4", CPU_TYPE_BOOL, 4, 1 },
+        { "mat2", CPU_TYPE_FLOAT, 2, 2 }, { "mat3", CPU_TYPE_FLOAT, 3, 3 }, { "mat4", CPU_TYPE_FLOAT, 4, 4 },
+        { "sampler2D", CPU_TYPE_SAMPLER, 1, 1 },
+    };
+
+    if (c->token.kind != CPU_TOKEN_IDENTIFIER)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        if (cpu_shader_token_is(c, names[i].name))
+        {
+            *type = cpu_shader_make_type(names[i].base, names[i].rows, names[i].columns);
+            cpu_shader_next_token(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+cpu_shader_symbol_t *cpu_shader_find_symbol(cpu_shader_compiler_t *c, const char *name)
+{
+    for (uint32_t i = c->symbol_count; i > 0; --i)
+    {
+        if (strcmp(c->symbols[i - 1].name, name) == 0)
+        {
+            return &c->symbols[i - 1];
+        }
+    }
+    return 0;
+}
+
+uint16_t cpu_shader_allocate(cpu_shader_compiler_t *c, uint32_t count)
+{
+    uint32_t first = c->next_register;
+    c->next_register += count;
+    if (c->next_register > c->max_register)
+    {
+        c->max_register = c->next_register;
+    }
+    if (c->next_register >= CPU_SHADER_CONSTANT_BIT || c->next_register > CPU_SHADER_MAX_REGISTERS)
+    {
+        cpu_shader_error(c, "shader needs too many registers");
+        c->next_register = 0;
+        return 0;
+    }
+    return (uint16_t)first;
+}
+
+uint16_t cpu_shader_constant_bits(cpu_shader_compiler_t *c, uint32_t bits)
+{
+    cpu_shader_t *shader = c->shader;
+    for (uint32_t i = 0; i < shader->constant_count; ++i)
+    {
+        if (shader->constant_bits[i] == bits)
+        {
+            return (uint16_t)(CPU_SHADER_CONSTANT_BIT | i);
+        }
+    }
+    if (shader->constant_count == CPU_SHADER_MAX_CONSTANTS)
+    {
+        cpu_shader_error(c, "too many constants");
+        return CPU_SHADER_CONSTANT_BIT;
+    }
+    shader->constant_bits[shader->constant_count] = bits;
+    return (uint16_t)(CPU_SHADER_CONSTANT_BIT | shader->constant_count++);
+}
+
+uint16_t cpu_shader_constant(cpu_shader_compiler_t *c, real32_t value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return cpu_shader_constant_bits(c, bits);
+}
+
+uint32_t cpu_shader_emit(cpu_shader_compiler_t *c, cpu_shader_opcode_t op, uint16_t dst, uint16_t a = 0, uint16_t b = 0, uint16_t c2 = 0, uint16_t d = 0)
+{
+    cpu_shader_t *shader = c->shader;
+    if (shader->code_size == CPU_SHADER_MAX_INSTRUCTIONS)
+    {
+        cpu_shader_error(c, "shader is too long");
+        return 0;
+    }
+    cpu_shader_instruction_t *instruction = &shader->code[shader->code_size];
+    instruction->op = (uint16_t)op;
+    instruction->dst = dst;
+    instruction->a = a;
+    instruction->b = b;
+    instruction->c = c2;
+    instruction->d = d;
+    return shader->code_size++;
+}
+
+cpu_shader_value_t cpu_shader_temporary(cpu_shader_compiler_t *c, cpu_shader_type_t type)
+{
+    cpu_shader_value_t value = {};
+    value.type = type;
+    uint32_t count = cpu_shader_component_count(type);
+    uint16_t first = cpu_shader_allocate(c, count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        value.reg[i] = (uint16_t)(first + i);
+    }
+    return value;
+}
+
+cpu_shader_value_t cpu_shader_constant_value(cpu_shader_compiler_t *c, uint8_t base, real32_t number)
+{
+    cpu_shader_value_t value = {};
+    value.type = cpu_shader_make_type(base, 1);
+    value.reg[0] = base == CPU_TYPE_BOOL ? cpu_shader_constant_bits(c, number != 0.0f ? 0xffffffff : 0) : cpu_shader_constant(c, number);
+    return value;
+}
+
+// Component i, broadcasting scalars.
+inline uint16_t cpu_shader_component(const cpu_shader_value_t &value, uint32_t i)
+{
+    return cpu_shader_component_count(value.type) == 1 ? value.reg[0] : value.reg[i];
+}
+
+cpu_shader_value_t cpu_shader_unary(cpu_shader_compiler_t *c, cpu_shader_opcode_t op, const cpu_shader_value_t &a)
+{
+    cpu_shader_value_t result = cpu_shader_temporary(c, a.type);
+    for (uint32_t i = 0; i < cpu_shader_component_count(a.type); ++i)
+    {
+        cpu_shader_emit(c, op, result.reg[i], a.reg[i]);
+    }
+    return result;
+}
+
+bool cpu_shader_is_numeric(const cpu_shader_value_t &value)
+{
+    return value.type.array_length == 0 && (value.type.base == CPU_TYPE_FLOAT || value.type.base == CPU_TYPE_INT);
+}
+
+// Component-wise op with scalar broadcast, GLSL's rules for +, -, * and / on
+// anything that is not a matrix product.
+cpu_shader_value_t cpu_shader_componentwise(cpu_shader_compiler_t *c, cpu_shader_opcode_t op, const cpu_shader_value_t &a, const cpu_shader_value_t &b)
+{
+    uint32_t a_count = cpu_shader_component_count(a.type);
+    uint32_t b_count = cpu_shader_component_count(b.type);
+    if (a_count != b_count && a_count != 1 && b_count != 1)
+    {
+        cpu_shader_error(c, "operand sizes do not match");
+        return a;
+    }
+
+    cpu_shader_type_t type = a_count >= b_count ? a.type : b.type;
+    type.base = (a.type.base == CPU_TYPE_FLOAT || b.type.base == CPU_TYPE_FLOAT) ? (uint8_t)CPU_TYPE_FLOAT : a.type.base;
+
+    cpu_shader_value_t result = cpu_shader_temporary(c, type);
+    for (uint32_t i = 0; i < cpu_shader_component_count(type); ++i)
+    {
+        cpu_shader_emit(c, op, result.reg[i], cpu_shader_component(a, i), cpu_shader_component(b, i));
+        if (op == CPU_OP_DIV && type.base == CPU_TYPE_INT)
+        {
+            cpu_shader_emit(c, CPU_OP_TRUNC, result.reg[i], result.reg[i]);
+        }
+    }
+    return result;
+}
+
+// Sum of a[i] * b[i] over n components, strided so matrix rows work too.
+uint16_t cpu_shader_emit_dot(cpu_shader_compiler_t *c, const uint16_t *a, uint32_t a_stride, const uint16_t *b, uint32_t b_stride, uint32_t n)
+{
+    uint16_t result = cpu_shader_allocate(c, 1);
+    cpu_shader_emit(c, CPU_OP_MUL, result, a[0], b[0]);
+    for (uint32_t i = 1; i < n; ++i)
+    {
+        cpu_shader_emit(c, CPU_OP_MAD, result, a[i * a_stride], b[i * b_stride], result);
+    }
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_multiply(cpu_shader_compiler_t *c, const cpu_shader_value_t &a, const cpu_shader_value_t &b)
+{
+    bool a_matrix = a.type.columns > 1;
+    bool b_matrix = b.type.columns > 1;
+    uint32_t a_count = cpu_shader_component_count(a.type);
+    uint32_t b_count = cpu_shader_component_count(b.type);
+
+    if (!(a_matrix || b_matrix) || a_count == 1 || b_count == 1)
+    {
+        return cpu_shader_componentwise(c, CPU_OP_MUL, a, b);
+    }
+
+    // Result column j, row i is row i of a dotted with column j of b, where a
+    // vector on the left is a row and a vector on the right is a column.
+    uint32_t a_rows = a_matrix ? a.type.rows : 1;
+    uint32_t a_columns = a_matrix ? a.type.columns : a.type.rows;
+    uint32_t b_rows = b_matrix ? b.type.rows : b.type.rows;
+    uint32_t b_columns = b_matrix ? b.type.columns : 1;
+
+    if (a_columns != b_rows)
+    {
+        cpu_shader_error(c, "matrix sizes do not match");
+        return a;
+    }
+
+    cpu_shader_type_t type;
+    if (a_matrix && b_matrix) type = cpu_shader_make_type(CPU_TYPE_FLOAT, (uint8_t)a_rows, (uint8_t)b_columns);
+    else if (a_matrix) type = cpu_shader_make_type(CPU_TYPE_FLOAT, (uint8_t)a_rows);
+    else type = cpu_shader_make_type(CPU_TYPE_FLOAT, (uint8_t)b_columns);
+
+    uint16_t registers[16];
+    for (uint32_t j = 0; j < b_columns; ++j)
+    {
+        for (uint32_t i = 0; i < a_rows; ++i)
+        {
+            registers[j * a_rows + i] = cpu_shader_emit_dot(c, &a.reg[i], a_rows, &b.reg[j * b_rows], 1, a_columns);
+        }
+    }
+
+    cpu_shader_value_t result = {};
+    result.type = type;
+    memcpy(result.reg, registers, sizeof(registers));
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_compare(cpu_shader_compiler_t *c, const char *op, const cpu_shader_value_t &a, const cpu_shader_value_t &b)
+{
+    cpu_shader_value_t result = cpu_shader_temporary(c, cpu_shader_make_type(CPU_TYPE_BOOL, 1));
+    bool equality = op[0] == '=' || op[0] == '!';
+
+    if (equality)
+    {
+        uint32_t count = cpu_shader_component_count(a.type);
+        if (count != cpu_shader_component_count(b.type) || a.type.array_length || b.type.array_length)
+        {
+            cpu_shader_error(c, "cannot compare values of different types");
+            return result;
+        }
+
+        bool not_equal = op[0] == '!';
+        cpu_shader_emit(c, not_equal ? CPU_OP_CMP_NE : CPU_OP_CMP_EQ, result.reg[0], a.reg[0], b.reg[0]);
+        for (uint32_t i = 1; i < count; ++i)
+        {
+            uint16_t t = cpu_shader_allocate(c, 1);
+            cpu_shader_emit(c, not_equal ? CPU_OP_CMP_NE : CPU_OP_CMP_EQ, t, a.reg[i], b.reg[i]);
+            cpu_shader_emit(c, not_equal ? CPU_OP_OR : CPU_OP_AND, result.reg[0], result.reg[0], t);
+        }
+        return result;
+    }
+
+    if (!cpu_shader_is_numeric(a) || !cpu_shader_is_numeric(b) || cpu_shader_component_count(a.type) != 1 || cpu_shader_component_count(b.type) != 1)
+    {
+        cpu_shader_error(c, "relational operators need scalar operands");
+        return result;
+    }
+
+    if (strcmp(op, "<") == 0) cpu_shader_emit(c, CPU_OP_CMP_LT, result.reg[0], a.reg[0], b.reg[0]);
+    else if (strcmp(op, "<=") == 0) cpu_shader_emit(c, CPU_OP_CMP_LE, result.reg[0], a.reg[0], b.reg[0]);
+    else if (strcmp(op, ">") == 0) cpu_shader_emit(c, CPU_OP_CMP_LT, result.reg[0], b.reg[0], a.reg[0]);
+    else cpu_shader_emit(c, CPU_OP_CMP_LE, result.reg[0], b.reg[0], a.reg[0]);
+    return result;
+}
+
+// Copies value into fresh consecutive registers, arrays included.
+cpu_shader_value_t cpu_shader_copy(cpu_shader_compiler_t *c, const cpu_shader_value_t &value)
+{
+    cpu_shader_value_t result = {};
+    result.type = value.type;
+    if (value.type.array_length)
+    {
+        uint32_t count = cpu_shader_register_count(value.type);
+        result.array_register = cpu_shader_allocate(c, count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            cpu_shader_emit(c, CPU_OP_MOV, (uint16_t)(result.array_register + i), (uint16_t)(value.array_register + i));
+        }
+        return result;
+    }
+    result = cpu_shader_temporary(c, value.type);
+    for (uint32_t i = 0; i < cpu_shader_component_count(value.type); ++i)
+    {
+        cpu_shader_emit(c, CPU_OP_MOV, result.reg[i], value.reg[i]);
+    }
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_parse_expression(cpu_shader_compiler_t *c);
+cpu_shader_value_t cpu_shader_parse_assignment_expression(cpu_shader_compiler_t *c);
+
+uint32_t cpu_shader_parse_arguments(cpu_shader_compiler_t *c, cpu_shader_value_t *arguments, uint32_t max_arguments)
+{
+    uint32_t count = 0;
+    cpu_shader_expect(c, "(");
+    if (!cpu_shader_accept(c, ")"))
+    {
+        do
+        {
+            cpu_shader_value_t argument = cpu_shader_parse_assignment_expression(c);
+            if (count < max_arguments)
+            {
+                arguments[count] = argument;
+            }
+            ++count;
+        } while (!c->failed && cpu_shader_accept(c, ","));
+        cpu_shader_expect(c, ")");
+    }
+    if (count > max_arguments)
+    {
+        cpu_shader_error(c, "too many arguments");
+        count = max_arguments;
+    }
+    return count;
+}
+
+// Converts one component to the base type of a constructor.
+uint16_t cpu_shader_convert(cpu_shader_compiler_t *c, uint16_t reg, uint8_t from, uint8_t to)
+{
+    if (from == to || (from != CPU_TYPE_BOOL && to != CPU_TYPE_BOOL && to != CPU_TYPE_INT))
+    {
+        return reg;
+    }
+    uint16_t result = cpu_shader_allocate(c, 1);
+    if (from == CPU_TYPE_BOOL)
+    {
+        cpu_shader_emit(c, CPU_OP_SELECT, result, reg, cpu_shader_constant(c, 1.0f), cpu_shader_constant(c, 0.0f));
+    }
+    else if (to == CPU_TYPE_BOOL)
+    {
+        cpu_shader_emit(c, CPU_OP_CMP_NE, result, reg, cpu_shader_constant(c, 0.0f));
+    }
+    else
+    {
+        cpu_shader_emit(c, CPU_OP_TRUNC, result, reg);
+    }
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_construct(cpu_shader_compiler_t *c, cpu_shader_type_t type, const cpu_shader_value_t *arguments, uint32_t argument_count)
+{
+    cpu_shader_value_t result = {};
+    result.type = type;
+
+    if (type.array_length)
+    {
+        uint32_t element_count = cpu_shader_component_count(type);
+        if (argument_count != type.array_length)
+        {
+            cpu_shader_error(c, "wrong number of array elements");
+            return result;
+        }
+        result.array_register = cpu_shader_allocate(c, cpu_shader_register_count(type));
+        for (uint32_t i = 0; i < argument_count; ++i)
+        {
+            if (cpu_shader_component_count(arguments[i].type) != element_count || arguments[i].type.array_length)
+            {
+                cpu_shader_error(c, "array element has the wrong type");
+                return result;
+            }
+            for (uint32_t j = 0; j < element_count; ++j)
+            {
+                cpu_shader_emit(c, CPU_OP_MOV, (uint16_t)(result.array_register + i * element_count + j), arguments[i].reg[j]);
+            }
+        }
+        return result;
+    }
+
+    uint32_t count = cpu_shader_component_count(type);
+
+    // A single scalar fills a vector, or the diagonal of a matrix.
+    if (argument_count == 1 && cpu_shader_component_count(arguments[0].type) == 1)
+    {
+        uint16_t reg = cpu_shader_convert(c, arguments[0].reg[0], arguments[0].type.base, type.base);
+        uint16_t zero = cpu_shader_constant(c, 0.0f);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            bool off_diagonal = type.columns > 1 && (i / type.rows) != (i % type.rows);
+            result.reg[i] = off_diagonal ? zero : reg;
+        }
+        return result;
+    }
+
+    // Otherwise components are consumed in order, extra ones are dropped.
+    uint32_t filled = 0;
+    for (uint32_t i = 0; i < argument_count && filled < count; ++i)
+    {
+        if (arguments[i].type.array_length || arguments[i].type.base == CPU_TYPE_SAMPLER)
+        {
+            cpu_shader_error(c, "invalid constructor argument");
+            return result;
+        }
+        for (uint32_t j = 0; j < cpu_shader_component_count(arguments[i].type) && filled < count; ++j)
+        {
+            result.reg[filled++] = cpu_shader_convert(c, arguments[i].reg[j], arguments[i].type.base, type.base);
+        }
+    }
+    if (filled < count)
+    {
+        cpu_shader_error(c, "not enough data provided for construction");
+    }
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_texture(cpu_shader_compiler_t *c, const cpu_shader_value_t *arguments, uint32_t argument_count)
+{
+    cpu_shader_value_t result = cpu_shader_temporary(c, cpu_shader_make_type(CPU_TYPE_FLOAT, 4));
+    if (argument_count != 2 || arguments[0].type.base != CPU_TYPE_SAMPLER || !arguments[0].symbol || cpu_shader_component_count(arguments[1].type) != 2)
+    {
+        cpu_shader_error(c, "texture() needs a sampler2D and a vec2");
+        return result;
+    }
+    arguments[0].symbol->variable->used = true;
+    cpu_shader_emit(c, CPU_OP_TEXTURE, result.reg[0], arguments[1].reg[0], arguments[1].reg[1], arguments[0].symbol->slot);
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_call_builtin(cpu_shader_compiler_t *c, const char *name, const cpu_shader_value_t *a, uint32_t count)
+{
+    struct builtin_t { const char *name; uint32_t arguments; };
+    static const builtin_t builtins[] = {
+        { "abs", 1 }, { "floor", 1 }, { "ceil", 1 }, { "fract", 1 }, { "sqrt", 1 }, { "inversesqrt", 1 },
+        { "sin", 1 }, { "cos", 1 }, { "tan", 1 }, { "exp", 1 }, { "exp2", 1 }, { "log", 1 }, { "log2", 1 },
+        { "length", 1 }, { "normalize", 1 },
+        { "min", 2 }, { "max", 2 }, { "mod", 2 }, { "pow", 2 }, { "step", 2 }, { "dot", 2 }, { "cross", 2 }, { "distance", 2 },
+        { "clamp", 3 }, { "mix", 3 }, { "smoothstep", 3 },
+    };
+
+    uint32_t expected = 0xffffffff;
+    for (uint32_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i)
+    {
+        if (strcmp(builtins[i].name, name) == 0)
+        {
+            expected = builtins[i].arguments;
+        }
+    }
+    if (expected == 0xffffffff)
+    {
+        cpu_shader_error(c, "unknown function ", name);
+        return a[0];
+    }
+    if (count != expected)
+    {
+        cpu_shader_error(c, "wrong number of arguments to ", name);
+        return a[0];
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!cpu_shader_is_numeric(a[i]))
+        {
+            cpu_shader_error(c, "invalid argument to ", name);
+            return a[0];
+        }
+    }
+
+    cpu_shader_value_t result = a[0];
+    uint32_t n = cpu_shader_component_count(a[0].type);
+
+    if (strcmp(name, "dot") == 0 || strcmp(name, "length") == 0 || strcmp(name, "normalize") == 0 || strcmp(name, "distance") == 0)
+    {
+        cpu_shader_value_t v = strcmp(name, "distance") == 0 ? cpu_shader_componentwise(c, CPU_OP_SUB, a[0], a[1]) : a[0];
+        const cpu_shader_value_t &w = strcmp(name, "dot") == 0 ? a[1] : v;
+        if (cpu_shader_component_count(w.type) != n)
+        {
+            cpu_shader_error(c, "operand sizes do not match");
+            return result;
+        }
+
+        cpu_shader_value_t scalar = {};
+        scalar.type = cpu_shader_make_type(CPU_TYPE_FLOAT, 1);
+        scalar.reg[0] = cpu_shader_emit_dot(c, v.reg, 1, w.reg, 1, n);
+        if (strcmp(name, "dot") == 0)
+        {
+            return scalar;
+        }
+        cpu_shader_emit(c, CPU_OP_SQRT, scalar.reg[0], scalar.reg[0]);
+        if (strcmp(name, "normalize") != 0)
+        {
+            return scalar;
+        }
+        cpu_shader_emit(c, CPU_OP_DIV, scalar.reg[0], cpu_shader_constant(c, 1.0f), scalar.reg[0]);
+        return cpu_shader_componentwise(c, CPU_OP_MUL, v, scalar);
+    }
+
+    if (strcmp(name, "cross") == 0)
+    {
+        if (n != 3 || cpu_shader_component_count(a[1].type) != 3)
+        {
+            cpu_shader_error(c, "cross() needs two vec3");
+            return result;
+        }
+        result = cpu_shader_temporary(c, a[0].type);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            uint32_t j = (i + 1) % 3, k = (i + 2) % 3;
+            cpu_shader_emit(c, CPU_OP_MUL, result.reg[i], a[0].reg[k], a[1].reg[j]);
+            uint16_t t = cpu_shader_allocate(c, 1);
+            cpu_shader_emit(c, CPU_OP_MUL, t, a[0].reg[j], a[1].reg[k]);
+            cpu_shader_emit(c, CPU_OP_SUB, result.reg[i], t, result.reg[i]);
+        }
+        return result;
+    }
+
+    cpu_shader_value_t zero = cpu_shader_constant_value(c, CPU_TYPE_FLOAT, 0.0f);
+    cpu_shader_value_t one = cpu_shader_constant_value(c, CPU_TYPE_FLOAT, 1.0f);
+
+    if (strcmp(name, "abs") == 0) return cpu_shader_unary(c, CPU_OP_ABS, a[0]);
+    if (strcmp(name, "floor") == 0) return cpu_shader_unary(c, CPU_OP_FLOOR, a[0]);
+    if (strcmp(name, "sqrt") == 0) return cpu_shader_unary(c, CPU_OP_SQRT, a[0]);
+    if (strcmp(name, "sin") == 0) return cpu_shader_unary(c, CPU_OP_SIN, a[0]);
+    if (strcmp(name, "cos") == 0) return cpu_shader_unary(c, CPU_OP_COS, a[0]);
+    if (strcmp(name, "exp2") == 0) return cpu_shader_unary(c, CPU_OP_EXP2, a[0]);
+    if (strcmp(name, "log2") == 0) return cpu_shader_unary(c, CPU_OP_LOG2, a[0]);
+    if (strcmp(name, "min") == 0) return cpu_shader_componentwise(c, CPU_OP_MIN, a[0], a[1]);
+    if (strcmp(name, "max") == 0) return cpu_shader_componentwise(c, CPU_OP_MAX, a[0], a[1]);
+    if (strcmp(name, "ceil") == 0) return cpu_shader_componentwise(c, CPU_OP_SUB, zero, cpu_shader_unary(c, CPU_OP_FLOOR, cpu_shader_componentwise(c, CPU_OP_SUB, zero, a[0])));
+    if (strcmp(name, "fract") == 0) return cpu_shader_componentwise(c, CPU_OP_SUB, a[0], cpu_shader_unary(c, CPU_OP_FLOOR, a[0]));
+    if (strcmp(name, "inversesqrt") == 0) return cpu_shader_componentwise(c, CPU_OP_DIV, one, cpu_shader_unary(c, CPU_OP_SQRT, a[0]));
+    if (strcmp(name, "tan") == 0) return cpu_shader_componentwise(c, CPU_OP_DIV, cpu_shader_unary(c, CPU_OP_SIN, a[0]), cpu_shader_unary(c, CPU_OP_COS, a[0]));
+    if (strcmp(name, "exp") == 0) return cpu_shader_unary(c, CPU_OP_EXP2, cpu_shader_componentwise(c, CPU_OP_MUL, a[0], cpu_shader_constant_value(c, CPU_TYPE_FLOAT, 1.44269504f)));
+    if (strcmp(name, "log") == 0) return cpu_shader_componentwise(c, CPU_OP_MUL, cpu_shader_unary(c, CPU_OP_LOG2, a[0]), cpu_shader_constant_value(c, CPU_TYPE_FLOAT, 0.69314718f));
+    if (strcmp(name, "pow") == 0) return cpu_shader_unary(c, CPU_OP_EXP2, cpu_shader_componentwise(c, CPU_OP_MUL, a[1], cpu_shader_unary(c, CPU_OP_LOG2, a[0])));
+    if (strcmp(name, "clamp") == 0) return cpu_shader_componentwise(c, CPU_OP_MIN, cpu_shader_componentwise(c, CPU_OP_MAX, a[0], a[1]), a[2]);
+
+    if (strcmp(name, "mod") == 0)
+    {
+        cpu_shader_value_t q = cpu_shader_unary(c, CPU_OP_FLOOR, cpu_shader_componentwise(c, CPU_OP_DIV, a[0], a[1]));
+        return cpu_shader_componentwise(c, CPU_OP_SUB, a[0], cpu_shader_componentwise(c, CPU_OP_MUL, a[1], q));
+    }
+
+    if (strcmp(name, "mix") == 0)
+    {
+        cpu_shader_value_t delta = cpu_shader_componentwise(c, CPU_OP_SUB, a[1], a[0]);
+        return cpu_shader_componentwise(c, CPU_OP_ADD, a[0], cpu_shader_componentwise(c, CPU_OP_MUL, delta, a[2]));
+    }
+
+    if (strcmp(name, "step") == 0)
+    {
+        result = cpu_shader_temporary(c, a[1].type);
+        for (uint32_t i = 0; i < cpu_shader_component_count(a[1].type); ++i)
+        {
+            uint16_t below = cpu_shader_allocate(c, 1);
+            cpu_shader_emit(c, CPU_OP_CMP_LT, below, a[1].reg[i], cpu_shader_component(a[0], i));
+            cpu_shader_emit(c, CPU_OP_SELECT, result.reg[i], below, zero.reg[0], one.reg[0]);
+        }
+        return result;
+    }
+
+    // smoothstep
+    cpu_shader_value_t t = cpu_shader_componentwise(c, CPU_OP_DIV, cpu_shader_componentwise(c, CPU_OP_SUB, a[2], a[0]), cpu_shader_componentwise(c, CPU_OP_SUB, a[1], a[0]));
+    t = cpu_shader_componentwise(c, CPU_OP_MIN, cpu_shader_componentwise(c, CPU_OP_MAX, t, zero), one);
+    cpu_shader_value_t shape = cpu_shader_componentwise(c, CPU_OP_SUB, cpu_shader_constant_value(c, CPU_TYPE_FLOAT, 3.0f),
+        cpu_shader_componentwise(c, CPU_OP_MUL, cpu_shader_constant_value(c, CPU_TYPE_FLOAT, 2.0f), t));
+    return cpu_shader_componentwise(c, CPU_OP_MUL, cpu_shader_componentwise(c, CPU_OP_MUL, t, t), shape);
+}
+
+cpu_shader_value_t cpu_shader_parse_primary(cpu_shader_compiler_t *c)
+{
+    cpu_shader_value_t value = {};
+    value.type = cpu_shader_make_type(CPU_TYPE_FLOAT, 1);
+    value.reg[0] = cpu_shader_constant(c, 0.0f);
+
+    if (c->failed)
+    {
+        return value;
+    }
+
+    if (cpu_shader_accept(c, "("))
+    {
+        value = cpu_shader_parse_expression(c);
+        cpu_shader_expect(c, ")");
+        return value;
+    }
+
+    if (c->token.kind == CPU_TOKEN_NUMBER)
+    {
+        value = cpu_shader_constant_value(c, c->token.is_integer ? CPU_TYPE_INT : CPU_TYPE_FLOAT, c->token.number);
+        cpu_shader_next_token(c);
+        return value;
+    }
+
+    if (c->token.kind != CPU_TOKEN_IDENTIFIER)
+    {
+        cpu_shader_error(c, "unexpected token");
+        return value;
+    }
+
+    if (cpu_shader_accept(c, "true")) return cpu_shader_constant_value(c, CPU_TYPE_BOOL, 1.0f);
+    if (cpu_shader_accept(c, "false")) return cpu_shader_constant_value(c, CPU_TYPE_BOOL, 0.0f);
+
+    cpu_shader_type_t type;
+    if (cpu_shader_parse_type_name(c, &type))
+    {
+        if (cpu_shader_accept(c, "["))
+        {
+            // vec4[3](...) or vec4[](...)
+            if (c->token.kind == CPU_TOKEN_NUMBER)
+            {
+                type.array_length = (uint16_t)c->token.number;
+                cpu_shader_next_token(c);
+            }
+            cpu_shader_expect(c, "]");
+            cpu_shader_value_t arguments[64];
+            uint32_t count = cpu_shader_parse_arguments(c, arguments, 64);
+            if (!type.array_length)
+            {
+                type.array_length = (uint16_t)count;
+            }
+            return cpu_shader_construct(c, type, arguments, count);
+        }
+
+        cpu_shader_value_t arguments[16];
+        uint32_t count = cpu_shader_parse_arguments(c, arguments, 16);
+        return cpu_shader_construct(c, type, arguments, count);
+    }
+
+    char name[CPU_SHADER_NAME_LENGTH];
+    cpu_shader_token_name(c, name);
+    cpu_shader_next_token(c);
+
+    if (cpu_shader_token_is(c, "("))
+    {
+        cpu_shader_value_t arguments[4];
+        uint32_t count = cpu_shader_parse_arguments(c, arguments, 4);
+        if (c->failed)
+        {
+            return value;
+        }
+        if (strcmp(name, "texture") == 0 || strcmp(name, "texture2D") == 0)
+        {
+            return cpu_shader_texture(c, arguments, count);
+        }
+        return cpu_shader_call_builtin(c, name, arguments, count);
+    }
+
+    cpu_shader_symbol_t *symbol = cpu_shader_find_symbol(c, name);
+    if (!symbol)
+    {
+        cpu_shader_error(c, "undeclared identifier ", name);
+        return value;
+    }
+
+    if (symbol->variable)
+    {
+        symbol->variable->used = true;
+    }
+
+    value = {};
+    value.type = symbol->type;
+    if (symbol->type.array_length)
+    {
+        value.array_register = symbol->first_register;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < cpu_shader_component_count(symbol->type); ++i)
+        {
+            value.reg[i] = (uint16_t)(symbol->first_register + i);
+        }
+    }
+    if (symbol->storage == CPU_STORAGE_LOCAL || symbol->storage == CPU_STORAGE_OUTPUT || symbol->storage == CPU_STORAGE_SAMPLER)
+    {
+        value.symbol = symbol;
+    }
+    return value;
+}
+
+cpu_shader_value_t cpu_shader_parse_swizzle(cpu_shader_compiler_t *c, const cpu_shader_value_t &value)
+{
+    static const char *sets[] = { "xyzw", "rgba", "stpq" };
+
+    cpu_shader_value_t result = value;
+    uint32_t count = c->token.length;
+    uint32_t n = cpu_shader_component_count(value.type);
+
+    if (c->token.kind != CPU_TOKEN_IDENTIFIER || count > 4 || value.type.columns > 1 || value.type.array_length)
+    {
+        cpu_shader_error(c, "invalid swizzle");
+        return result;
+    }
+
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        int32_t index = -1;
+        for (uint32_t s = 0; s < 3 && index < 0; ++s)
+        {
+            const char *found = strchr(sets[s], c->token.text[i]);
+            if (found)
+            {
+                index = (int32_t)(found - sets[s]);
+            }
+        }
+        if (index < 0 || (uint32_t)index >= n)
+        {
+            cpu_shader_error(c, "invalid swizzle");
+            return result;
+        }
+        result.reg[i] = value.reg[index];
+        if (used & (1u << index))
+        {
+            result.symbol = 0;  // v.xx cannot be assigned to
+        }
+        used |= 1u << index;
+    }
+    result.type.rows = (uint8_t)count;
+    cpu_shader_next_token(c);
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_parse_index(cpu_shader_compiler_t *c, const cpu_shader_value_t &value)
+{
+    cpu_shader_value_t index = cpu_shader_parse_expression(c);
+    cpu_shader_expect(c, "]");
+
+    cpu_shader_value_t result = value;
+    if (c->failed)
+    {
+        return result;
+    }
+    if (index.type.base != CPU_TYPE_INT || cpu_shader_component_count(index.type) != 1)
+    {
+        cpu_shader_error(c, "index must be an int");
+        return result;
+    }
+
+    // Element type, element count and the registers of element k.
+    cpu_shader_type_t element_type = value.type;
+    uint32_t element_count;
+    uint32_t element_size;
+    if (value.type.array_length)
+    {
+        element_type.array_length = 0;
+        element_count = value.type.array_length;
+        element_size = cpu_shader_component_count(element_type);
+    }
+    else if (value.type.columns > 1)
+    {
+        element_type.columns = 1;
+        element_count = value.type.columns;
+        element_size = value.type.rows;
+    }
+    else if (value.type.rows > 1)
+    {
+        element_type.rows = 1;
+        element_count = value.type.rows;
+        element_size = 1;
+    }
+    else
+    {
+        cpu_shader_error(c, "cannot index a scalar");
+        return result;
+    }
+
+    result.type = element_type;
+
+    // A literal index just selects registers.
+    if (index.reg[0] & CPU_SHADER_CONSTANT_BIT)
+    {
+        real32_t constant;
+        memcpy(&constant, &c->shader->constant_bits[index.reg[0] & ~CPU_SHADER_CONSTANT_BIT], sizeof(constant));
+        uint32_t k = (uint32_t)constant;
+        if (constant < 0.0f || k >= element_count)
+        {
+            cpu_shader_error(c, "index out of range");
+            return result;
+        }
+        for (uint32_t i = 0; i < cpu_shader_component_count(element_type); ++i)
+        {
+            result.reg[i] = value.type.array_length ? (uint16_t)(value.array_register + k * element_size + i) : value.reg[k * element_size + i];
+        }
+        return result;
+    }
+
+    // Dynamic indexing selects per lane, so it needs evenly spaced registers.
+    bool contiguous = value.type.array_length != 0;
+    if (!contiguous)
+    {
+        contiguous = true;
+        for (uint32_t i = 1; i < cpu_shader_component_count(value.type); ++i)
+        {
+            contiguous = contiguous && value.reg[i] == value.reg[0] + i;
+        }
+    }
+    cpu_shader_value_t source = contiguous ? value : cpu_shader_copy(c, value);
+    uint16_t first = source.type.array_length ? source.array_register : source.reg[0];
+
+    cpu_shader_value_t element = cpu_shader_temporary(c, element_type);
+    for (uint32_t i = 0; i < cpu_shader_component_count(element_type); ++i)
+    {
+        cpu_shader_emit(c, CPU_OP_INDEX, element.reg[i], (uint16_t)(first + i), index.reg[0], (uint16_t)element_count, (uint16_t)element_size);
+    }
+
+    // Only the variable's own registers can be written back, once.
+    if (contiguous && !value.indexed.count)
+    {
+        element.symbol = value.symbol;
+        element.indexed.first = first;
+        element.indexed.index = index.reg[0];
+        element.indexed.count = (uint16_t)element_count;
+        element.indexed.size = (uint16_t)element_size;
+        element.indexed.element = element.reg[0];
+    }
+    return element;
+}
+
+cpu_shader_value_t cpu_shader_parse_postfix(cpu_shader_compiler_t *c)
+{
+    cpu_shader_value_t value = cpu_shader_parse_primary(c);
+    while (!c->failed)
+    {
+        if (cpu_shader_accept(c, "."))
+        {
+            value = cpu_shader_parse_swizzle(c, value);
+        }
+        else if (cpu_shader_accept(c, "["))
+        {
+            value = cpu_shader_parse_index(c, value);
+        }
+        else
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+cpu_shader_value_t cpu_shader_parse_unary(cpu_shader_compiler_t *c)
+{
+    if (cpu_shader_accept(c, "-"))
+    {
+        cpu_shader_value_t value = cpu_shader_parse_unary(c);
+        if (!cpu_shader_is_numeric(value))
+        {
+            cpu_shader_error(c, "cannot negate this type");
+            return value;
+        }
+        return cpu_shader_componentwise(c, CPU_OP_SUB, cpu_shader_constant_value(c, value.type.base, 0.0f), value);
+    }
+    if (cpu_shader_accept(c, "+"))
+    {
+        return cpu_shader_parse_unary(c);
+    }
+    if (cpu_shader_accept(c, "!"))
+    {
+        cpu_shader_value_t value = cpu_shader_parse_unary(c);
+        if (value.type.base != CPU_TYPE_BOOL)
+        {
+            cpu_shader_error(c, "! needs a bool");
+            return value;
+        }
+        return cpu_shader_unary(c, CPU_OP_NOT, value);
+    }
+    return cpu_shader_parse_postfix(c);
+}
+
+// Binding power of each binary operator, higher binds tighter.
+int32_t cpu_shader_precedence(cpu_shader_compiler_t *c)
+{
+    if (c->token.kind != CPU_TOKEN_SYMBOL) return -1;
+    if (cpu_shader_token_is(c, "||")) return 1;
+    if (cpu_shader_token_is(c, "&&")) return 2;
+    if (cpu_shader_token_is(c, "==") || cpu_shader_token_is(c, "!=")) return 3;
+    if (cpu_shader_token_is(c, "<") || cpu_shader_token_is(c, ">") || cpu_shader_token_is(c, "<=") || cpu_shader_token_is(c, ">=")) return 4;
+    if (cpu_shader_token_is(c, "+") || cpu_shader_token_is(c, "-")) return 5;
+    if (cpu_shader_token_is(c, "*") || cpu_shader_token_is(c, "/") || cpu_shader_token_is(c, "%")) return 6;
+    return -1;
+}
+
+cpu_shader_value_t cpu_shader_parse_binary(cpu_shader_compiler_t *c, int32_t min_precedence)
+{
+    cpu_shader_value_t left = cpu_shader_parse_unary(c);
+
+    for (;;)
+    {
+        int32_t precedence = cpu_shader_precedence(c);
+        if (c->failed || precedence < min_precedence)
+        {
+            return left;
+        }
+
+        char op[3] = {};
+        memcpy(op, c->token.text, c->token.length);
+        cpu_shader_next_token(c);
+
+        cpu_shader_value_t right = cpu_shader_parse_binary(c, precedence + 1);
+        if (c->failed)
+        {
+            return left;
+        }
+
+        if (precedence <= 2)
+        {
+            if (left.type.base != CPU_TYPE_BOOL || right.type.base != CPU_TYPE_BOOL || cpu_shader_component_count(left.type) != 1 || cpu_shader_component_count(right.type) != 1)
+            {
+                cpu_shader_error(c, "logical operators need bool operands");
+                return left;
+            }
+            left = cpu_shader_componentwise(c, precedence == 1 ? CPU_OP_OR : CPU_OP_AND, left, right);
+        }
+        else if (precedence <= 4)
+        {
+            left = cpu_shader_compare(c, op, left, right);
+        }
+        else
+        {
+            if (!cpu_shader_is_numeric(left) || !cpu_shader_is_numeric(right))
+            {
+                cpu_shader_error(c, "arithmetic needs numeric operands");
+                return left;
+            }
+            if (op[0] == '*') left = cpu_shader_multiply(c, left, right);
+            else if (op[0] == '/') left = cpu_shader_componentwise(c, CPU_OP_DIV, left, right);
+            else if (op[0] == '%')
+            {
+                if (left.type.base != CPU_TYPE_INT || right.type.base != CPU_TYPE_INT)
+                {
+                    cpu_shader_error(c, "% needs int operands");
+                    return left;
+                }
+                cpu_shader_value_t quotient = cpu_shader_componentwise(c, CPU_OP_DIV, left, right);
+                left = cpu_shader_componentwise(c, CPU_OP_SUB, left, cpu_shader_componentwise(c, CPU_OP_MUL, right, quotient));
+            }
+            else if (op[0] == '+') left = cpu_shader_componentwise(c, CPU_OP_ADD, left, right);
+            else left = cpu_shader_componentwise(c, CPU_OP_SUB, left, right);
+        }
+    }
+}
+
+cpu_shader_value_t cpu_shader_parse_assignment_expression(cpu_shader_compiler_t *c)
+{
+    cpu_shader_value_t condition = cpu_shader_parse_binary(c, 0);
+    if (c->failed || !cpu_shader_accept(c, "?"))
+    {
+        return condition;
+    }
+
+    cpu_shader_value_t a = cpu_shader_parse_assignment_expression(c);
+    cpu_shader_expect(c, ":");
+    cpu_shader_value_t b = cpu_shader_parse_assignment_expression(c);
+    if (c->failed)
+    {
+        return a;
+    }
+    if (condition.type.base != CPU_TYPE_BOOL || cpu_shader_component_count(condition.type) != 1 ||
+        cpu_shader_component_count(a.type) != cpu_shader_component_count(b.type) || a.type.array_length || b.type.array_length)
+    {
+        cpu_shader_error(c, "invalid operands to ?:");
+        return a;
+    }
+
+    cpu_shader_value_t result = cpu_shader_temporary(c, a.type);
+    for (uint32_t i = 0; i < cpu_shader_component_count(a.type); ++i)
+    {
+        cpu_shader_emit(c, CPU_OP_SELECT, result.reg[i], condition.reg[0], a.reg[i], b.reg[i]);
+    }
+    return result;
+}
+
+cpu_shader_value_t cpu_shader_parse_expression(cpu_shader_compiler_t *c)
+{
+    return cpu_shader_parse_assignment_expression(c);
+}
+
+// Stores value into target, masked by the lanes that are currently executing.
+void cpu_shader_store(cpu_shader_compiler_t *c, const cpu_shader_value_t &target, cpu_shader_value_t value)
+{
+    if (target.type.array_length != value.type.array_length || cpu_shader_component_count(target.type) != cpu_shader_component_count(value.type) ||
+        (target.type.base == CPU_TYPE_BOOL) != (value.type.base == CPU_TYPE_BOOL))
+    {
+        if (!(cpu_shader_component_count(value.type) == 1 && cpu_shader_component_count(target.type) == 1))
+        {
+            cpu_shader_error(c, "cannot assign values of different types");
+            return;
+        }
+    }
+
+    if (target.type.array_length)
+    {
+        for (uint32_t i = 0; i < cpu_shader_register_count(target.type); ++i)
+        {
+            cpu_shader_emit(c, CPU_OP_MOV, (uint16_t)(target.array_register + i), (uint16_t)(value.array_register + i));
+        }
+        return;
+    }
+
+    // Copy first when source and destination overlap, as in v.xy = v.yx.
+    uint32_t count = cpu_shader_component_count(target.type);
+    bool overlap = false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            overlap = overlap || (i != j && target.reg[i] == value.reg[j]);
+        }
+    }
+    if (overlap)
+    {
+        value = cpu_shader_copy(c, value);
+    }
+
+    uint16_t converted[16];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        converted[i] = cpu_shader_convert(c, value.reg[i], value.type.base, target.type.base);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        cpu_shader_emit(c, CPU_OP_MOV, target.reg[i], converted[i]);
+    }
+
+    // target is a copy of a dynamically indexed element, or part of one.
+    const cpu_shader_indexed_t *indexed = &target.indexed;
+    if (indexed->count)
+    {
+        for (uint32_t i = 0; i < indexed->size; ++i)
+        {
+            cpu_shader_emit(c, CPU_OP_STORE_INDEX, (uint16_t)(indexed->first + i), (uint16_t)(indexed->element + i), indexed->index, indexed->count, indexed->size);
+        }
+    }
+}
+
+void cpu_shader_parse_simple_statement(cpu_shader_compiler_t *c)
+{
+    bool prefix_increment = cpu_shader_token_is(c, "++") || cpu_shader_token_is(c, "--");
+    bool prefix_add = prefix_increment && c->token.text[0] == '+';
+    if (prefix_increment)
+    {
+        cpu_shader_next_token(c);
+    }
+
+    cpu_shader_value_t target = cpu_shader_parse_unary(c);
+    if (c->failed)
+    {
+        return;
+    }
+
+    cpu_shader_opcode_t op = CPU_OP_MOV;
+    cpu_shader_value_t value = {};
+    if (prefix_increment || cpu_shader_token_is(c, "++") || cpu_shader_token_is(c, "--"))
+    {
+        bool add = prefix_increment ? prefix_add : c->token.text[0] == '+';
+        if (!prefix_increment)
+        {
+            cpu_shader_next_token(c);
+        }
+        op = add ? CPU_OP_ADD : CPU_OP_SUB;
+        value = cpu_shader_constant_value(c, target.type.base, 1.0f);
+    }
+    else if (cpu_shader_accept(c, "=")) op = CPU_OP_MOV;
+    else if (cpu_shader_accept(c, "+=")) op = CPU_OP_ADD;
+    else if (cpu_shader_accept(c, "-=")) op = CPU_OP_SUB;
+    else if (cpu_shader_accept(c, "*=")) op = CPU_OP_MUL;
+    else if (cpu_shader_accept(c, "/=")) op = CPU_OP_DIV;
+    else
+    {
+        cpu_shader_error(c, "expression statement has no effect");
+        return;
+    }
+
+    if (!target.symbol || target.type.base == CPU_TYPE_SAMPLER)
+    {
+        cpu_shader_error(c, "l-value required");
+        return;
+    }
+
+    if (!prefix_increment && value.type.base == CPU_TYPE_VOID)
+    {
+        value = cpu_shader_parse_expression(c);
+    }
+    if (c->failed)
+    {
+        return;
+    }
+
+    if (op == CPU_OP_MUL)
+    {
+        value = cpu_shader_multiply(c, target, value);
+    }
+    else if (op != CPU_OP_MOV)
+    {
+        value = cpu_shader_componentwise(c, op, target, value);
+    }
+    cpu_shader_store(c, target, value);
+}
+
+cpu_shader_symbol_t *cpu_shader_declare(cpu_shader_compiler_t *c, const char *name, cpu_shader_type_t type, cpu_shader_storage_t storage)
+{
+    for (uint32_t i = c->symbol_count; i > 0; --i)
+    {
+        cpu_shader_symbol_t *existing = &c->symbols[i - 1];
+        if (existing->scope < c->scope)
+        {
+            break;
+        }
+        if (strcmp(existing->name, name) == 0)
+        {
+            cpu_shader_error(c, "redefinition of ", name);
+            return existing;
+        }
+    }
+    if (c->symbol_count == CPU_SHADER_MAX_SYMBOLS)
+    {
+        cpu_shader_error(c, "too many symbols");
+        return &c->symbols[0];
+    }
+
+    cpu_shader_symbol_t *symbol = &c->symbols[c->symbol_count++];
+    *symbol = {};
+    snprintf(symbol->name, CPU_SHADER_NAME_LENGTH, "%s", name);
+    symbol->type = type;
+    symbol->storage = storage;
+    symbol->scope = c->scope;
+    if (storage != CPU_STORAGE_SAMPLER)
+    {
+        symbol->first_register = cpu_shader_allocate(c, cpu_shader_register_count(type));
+    }
+    return symbol;
+}
+
+cpu_shader_variable_t *cpu_shader_add_variable(cpu_shader_compiler_t *c, cpu_shader_variable_t *list, uint32_t *count, int32_t location, cpu_shader_symbol_t *symbol)
+{
+    uint32_t index = location >= 0 ? (uint32_t)location : *count;
+    if (index >= CPU_SHADER_MAX_VARIABLES)
+    {
+        cpu_shader_error(c, "too many variables of this kind");
+        return &list[0];
+    }
+    if (list[index].name[0])
+    {
+        cpu_shader_error(c, "location is already in use by ", list[index].name);
+        return &list[index];
+    }
+
+    cpu_shader_variable_t *variable = &list[index];
+    snprintf(variable->name, CPU_SHADER_NAME_LENGTH, "%s", symbol->name);
+    variable->type = symbol->type;
+    variable->first_register = symbol->first_register;
+    variable->component_count = (uint16_t)cpu_shader_register_count(symbol->type);
+    if (index + 1 > *count)
+    {
+        *count = index + 1;
+    }
+    symbol->variable = variable;
+    return variable;
+}
+
+void cpu_shader_parse_declaration(cpu_shader_compiler_t *c, cpu_shader_type_t type, cpu_shader_storage_t storage, int32_t location)
+{
+    do
+    {
+        if (c->token.kind != CPU_TOKEN_IDENTIFIER)
+        {
+            cpu_shader_error(c, "expected a variable name");
+            return;
+        }
+        char name[CPU_SHADER_NAME_LENGTH];
+        cpu_shader_token_name(c, name);
+        cpu_shader_next_token(c);
+
+        cpu_shader_type_t variable_type = type;
+        bool unsized = false;
+        if (cpu_shader_accept(c, "["))
+        {
+            if (c->token.kind == CPU_TOKEN_NUMBER)
+            {
+                variable_type.array_length = (uint16_t)c->token.number;
+                cpu_shader_next_token(c);
+            }
+            else
+            {
+                unsized = true;
+            }
+            cpu_shader_expect(c, "]");
+        }
+
+        cpu_shader_value_t initializer = {};
+        bool initialized = false;
+        if (cpu_shader_accept(c, "="))
+        {
+            if (storage != CPU_STORAGE_LOCAL && storage != CPU_STORAGE_CONST)
+            {
+                cpu_shader_error(c, "this variable cannot have an initializer");
+                return;
+            }
+            initializer = cpu_shader_parse_assignment_expression(c);
+            initialized = true;
+            if (unsized)
+            {
+                variable_type.array_length = initializer.type.array_length;
+            }
+        }
+        if (c->failed)
+        {
+            return;
+        }
+        if (storage == CPU_STORAGE_CONST && !initialized)
+        {
+            cpu_shader_error(c, "const variables need an initializer");
+            return;
+        }
+
+        // Uniform and sampler storage is laid out before registers are handed out.
+        cpu_shader_symbol_t *symbol = cpu_shader_declare(c, name, variable_type, storage);
+        cpu_shader_t *shader = c->shader;
+        if (storage == CPU_STORAGE_UNIFORM)
+        {
+            cpu_shader_variable_t *variable = cpu_shader_add_variable(c, shader->uniforms, &shader->uniform_count, location, symbol);
+            variable->offset = (uint16_t)shader->uniform_float_count;
+            shader->uniform_float_count += variable->component_count;
+            if (shader->uniform_float_count > CPU_SHADER_MAX_UNIFORM_FLOATS)
+            {
+                cpu_shader_error(c, "too many uniforms");
+            }
+        }
+        else if (storage == CPU_STORAGE_SAMPLER)
+        {
+            symbol->slot = (uint16_t)shader->sampler_count;
+            cpu_shader_variable_t *variable = cpu_shader_add_variable(c, shader->samplers, &shader->sampler_count, -1, symbol);
+            variable->offset = symbol->slot;
+        }
+        else if (storage == CPU_STORAGE_INPUT)
+        {
+            cpu_shader_add_variable(c, shader->inputs, &shader->input_count, location, symbol);
+        }
+        else if (storage == CPU_STORAGE_OUTPUT)
+        {
+            cpu_shader_add_variable(c, shader->outputs, &shader->output_count, location, symbol);
+        }
+
+        if (initialized)
+        {
+            cpu_shader_value_t target = {};
+            target.type = variable_type;
+            target.array_register = symbol->first_register;
+            for (uint32_t i = 0; i < cpu_shader_component_count(variable_type) && !variable_type.array_length; ++i)
+            {
+                target.reg[i] = (uint16_t)(symbol->first_register + i);
+            }
+            cpu_shader_store(c, target, initializer);
+        }
+    } while (!c->failed && cpu_shader_accept(c, ","));
+
+    cpu_shader_expect(c, ";");
+}
+
+void cpu_shader_parse_statement(cpu_shader_compiler_t *c);
+
+void cpu_shader_parse_block(cpu_shader_compiler_t *c)
+{
+    uint32_t symbol_count = c->symbol_count;
+    ++c->scope;
+    while (!c->failed && !cpu_shader_token_is(c, "}"))
+    {
+        if (c->token.kind == CPU_TOKEN_END)
+        {
+            cpu_shader_error(c, "unexpected end of file");
+            break;
+        }
+        cpu_shader_parse_statement(c);
+    }
+    cpu_shader_expect(c, "}");
+    --c->scope;
+    c->symbol_count = symbol_count;
+}
+
+// A condition lives in its own register because it is used again after the
+// statements it guards, which are free to reuse temporaries.
+uint16_t cpu_shader_parse_condition(cpu_shader_compiler_t *c)
+{
+    cpu_shader_value_t condition = cpu_shader_parse_expression(c);
+    if (!c->failed && (condition.type.base != CPU_TYPE_BOOL || cpu_shader_component_count(condition.type) != 1))
+    {
+        cpu_shader_error(c, "condition must be a bool");
+    }
+    return condition.reg[0];
+}
+
+void cpu_shader_patch_jump(cpu_shader_compiler_t *c, uint32_t instruction)
+{
+    c->shader->code[instruction].a = (uint16_t)c->shader->code_size;
+}
+
+void cpu_shader_parse_statement(cpu_shader_compiler_t *c)
+{
+    // Everything allocated past this point, other than new variables, is dead
+    // once the statement is done.
+    uint32_t first_temporary = c->next_register;
+
+    if (cpu_shader_accept(c, "{"))
+    {
+        cpu_shader_parse_block(c);
+        c->next_register = first_temporary;
+        return;
+    }
+
+    if (cpu_shader_accept(c, ";"))
+    {
+        return;
+    }
+
+    if (cpu_shader_accept(c, "if"))
+    {
+        cpu_shader_expect(c, "(");
+        uint16_t condition = cpu_shader_parse_condition(c);
+        cpu_shader_expect(c, ")");
+        uint16_t saved = cpu_shader_allocate(c, 1);
+        cpu_shader_emit(c, CPU_OP_MOV, saved, condition);
+
+        cpu_shader_emit(c, CPU_OP_MASK_PUSH, 0, saved);
+        uint32_t skip_then = cpu_shader_emit(c, CPU_OP_JUMP_IF_NONE, 0);
+        cpu_shader_parse_statement(c);
+        cpu_shader_patch_jump(c, skip_then);
+
+        if (cpu_shader_accept(c, "else"))
+        {
+            cpu_shader_emit(c, CPU_OP_MASK_ELSE, 0, saved);
+            uint32_t skip_else = cpu_shader_emit(c, CPU_OP_JUMP_IF_NONE, 0);
+            cpu_shader_parse_statement(c);
+            cpu_shader_patch_jump(c, skip_else);
+        }
+        cpu_shader_emit(c, CPU_OP_MASK_POP, 0);
+        c->next_register = first_temporary;
+        return;
+    }
+
+    if (cpu_shader_token_is(c, "for") || cpu_shader_token_is(c, "while"))
+    {
+        bool is_for = cpu_shader_accept(c, "for");
+        if (!is_for)
+        {
+            cpu_shader_next_token(c);
+        }
+        uint32_t symbol_count = c->symbol_count;
+        ++c->scope;
+
+        cpu_shader_expect(c, "(");
+        if (is_for)
+        {
+            cpu_shader_type_t type;
+            if (cpu_shader_parse_type_name(c, &type))
+            {
+                cpu_shader_parse_declaration(c, type, CPU_STORAGE_LOCAL, -1);
+            }
+            else if (!cpu_shader_accept(c, ";"))
+            {
+                cpu_shader_parse_simple_statement(c);
+                cpu_shader_expect(c, ";");
+            }
+        }
+
+        // The step expression is compiled where it appears, then jumped over
+        // on the way into the body and jumped back to at its end.
+        cpu_shader_emit(c, CPU_OP_MASK_PUSH, 0, cpu_shader_constant_bits(c, 0xffffffff));
+        uint32_t loop_top = c->shader->code_size;
+        uint32_t loop_mark = c->next_register;
+        uint16_t condition = cpu_shader_constant_bits(c, 0xffffffff);
+        if (!(is_for && cpu_shader_token_is(c, ";")))
+        {
+            condition = cpu_shader_parse_condition(c);
+        }
+        cpu_shader_emit(c, CPU_OP_MASK_AND, 0, condition);
+        uint32_t exit_jump = cpu_shader_emit(c, CPU_OP_JUMP_IF_NONE, 0);
+        c->next_register = loop_mark;
+
+        uint32_t step_start = 0;
+        uint32_t body_jump = 0;
+        if (is_for)
+        {
+            cpu_shader_expect(c, ";");
+            body_jump = cpu_shader_emit(c, CPU_OP_JUMP, 0);
+            step_start = c->shader->code_size;
+            if (!cpu_shader_token_is(c, ")"))
+            {
+                cpu_shader_parse_simple_statement(c);
+                c->next_register = loop_mark;
+            }
+            cpu_shader_emit(c, CPU_OP_JUMP, (uint16_t)0, (uint16_t)loop_top);
+            cpu_shader_patch_jump(c, body_jump);
+        }
+        cpu_shader_expect(c, ")");
+
+        cpu_shader_parse_statement(c);
+        cpu_shader_emit(c, CPU_OP_JUMP, 0, (uint16_t)(is_for ? step_start : loop_top));
+        cpu_shader_patch_jump(c, exit_jump);
+        cpu_shader_emit(c, CPU_OP_MASK_POP, 0);
+
+        --c->scope;
+        c->symbol_count = symbol_count;
+        c->next_register = first_temporary;
+        return;
+    }
+
+    if (cpu_shader_token_is(c, "return") || cpu_shader_token_is(c, "break") || cpu_shader_token_is(c, "continue") || cpu_shader_token_is(c, "discard"))
+    {
+        char name[CPU_SHADER_NAME_LENGTH];
+        cpu_shader_token_name(c, name);
+        cpu_shader_error(c, "unsupported statement ", name);
+        return;
+    }
+
+    bool is_const = cpu_shader_accept(c, "const");
+    cpu_shader_type_t type;
+    if (cpu_shader_parse_type_name(c, &type))
+    {
+        cpu_shader_parse_declaration(c, type, is_const ? CPU_STORAGE_CONST : CPU_STORAGE_LOCAL, -1);
+        return;
+    }
+    if (is_const)
+    {
+        cpu_shader_error(c, "expected a type");
+        return;
+    }
+
+    cpu_shader_parse_simple_statement(c);
+    cpu_shader_expect(c, ";");
+    c->next_register = first_temporary;
+}
+
+void cpu_shader_declare_builtins(cpu_shader_compiler_t *c)
+{
+    cpu_shader_t *shader = c->shader;
+    shader->vertex_id_register = -1;
+    shader->instance_id_register = -1;
+
+    if (shader->stage == CPU_SHADER_VERTEX)
+    {
+        shader->vertex_id_register = cpu_shader_declare(c, "gl_VertexID", cpu_shader_make_type(CPU_TYPE_INT, 1), CPU_STORAGE_INPUT)->first_register;
+        shader->instance_id_register = cpu_shader_declare(c, "gl_InstanceID", cpu_shader_make_type(CPU_TYPE_INT, 1), CPU_STORAGE_INPUT)->first_register;
+    }
+}
+
+// gl_Position and gl_FragCoord become ordinary outputs/inputs the first time
+// the shader touches them, taking the next free location.
+void cpu_shader_declare_late_builtins(cpu_shader_compiler_t *c)
+{
+    cpu_shader_t *shader = c->shader;
+    if (shader->stage == CPU_SHADER_VERTEX)
+    {
+        cpu_shader_symbol_t *position = cpu_shader_declare(c, "gl_Position", cpu_shader_make_type(CPU_TYPE_FLOAT, 4), CPU_STORAGE_OUTPUT);
+        int32_t location = -1;
+        for (uint32_t i = 0; i < CPU_SHADER_MAX_VARIABLES && location < 0; ++i)
+        {
+            if (!shader->outputs[i].name[0]) location = (int32_t)i;
+        }
+        cpu_shader_add_variable(c, shader->outputs, &shader->output_count, location, position);
+    }
+    else
+    {
+        cpu_shader_symbol_t *frag_coord = cpu_shader_declare(c, "gl_FragCoord", cpu_shader_make_type(CPU_TYPE_FLOAT, 4), CPU_STORAGE_INPUT);
+        int32_t location = -1;
+        for (uint32_t i = 0; i < CPU_SHADER_MAX_VARIABLES && location < 0; ++i)
+        {
+            if (!shader->inputs[i].name[0]) location = (int32_t)i;
+        }
+        cpu_shader_add_variable(c, shader->inputs, &shader->input_count, location, frag_coord);
+    }
+}
+
+// Gives the constant pool the registers after everything else and rewrites
+// every operand that referred to it.
+void cpu_shader_place_constants(cpu_shader_compiler_t *c)
+{
+    cpu_shader_t *shader = c->shader;
+    shader->constant_first_register = (uint16_t)c->max_register;
+    shader->register_count = c->max_register + shader->constant_count;
+
+    for (uint32_t i = 0; i < shader->code_size; ++i)
+    {
+        cpu_shader_instruction_t *instruction = &shader->code[i];
+        uint16_t *operands[] = { &instruction->dst, &instruction->a, &instruction->b, &instruction->c, &instruction->d };
+        for (uint32_t j = 0; j < 5; ++j)
+        {
+            if (*operands[j] & CPU_SHADER_CONSTANT_BIT)
+            {
+                *operands[j] = (uint16_t)(shader->constant_first_register + (*operands[j] & ~CPU_SHADER_CONSTANT_BIT));
+            }
+        }
+    }
+}
+
+// Compiles source into shader. On failure returns false and writes a message
+// in the style of a GL info log to error.
+bool cpu_shader_compile(cpu_shader_t *shader, cpu_shader_stage_t stage, const char *source, char *error, uint32_t error_size)
+{
+    memset(shader, 0, sizeof(*shader));
+    shader->stage = stage;
+
+    cpu_shader_compiler_t *c = (cpu_shader_compiler_t *)calloc(1, sizeof(cpu_shader_compiler_t));
+    assert(c);
+    c->shader = shader;
+    c->cursor = source;
+    c->line = 1;
+    c->error = error;
+    c->error_size = error_size;
+    if (error_size)
+    {
+        error[0] = 0;
+    }
+
+    cpu_shader_declare_builtins(c);
+    cpu_shader_next_token(c);
+
+    bool has_main = false;
+    while (!c->failed && c->token.kind != CPU_TOKEN_END)
+    {
+        if (cpu_shader_accept(c, "precision"))
+        {
+            while (!c->failed && c->token.kind != CPU_TOKEN_END && !cpu_shader_accept(c, ";")) cpu_shader_next_token(c);
+            continue;
+        }
+
+        int32_t location = -1;
+        if (cpu_shader_accept(c, "layout"))
+        {
+            cpu_shader_expect(c, "(");
+            while (!c->failed && !cpu_shader_accept(c, ")"))
+            {
+                bool is_location = cpu_shader_accept(c, "location");
+                if (is_location && cpu_shader_accept(c, "=") && c->token.kind == CPU_TOKEN_NUMBER)
+                {
+                    location = (int32_t)c->token.number;
+                }
+                if (c->token.kind == CPU_TOKEN_END)
+                {
+                    cpu_shader_error(c, "unexpected end of file");
+                }
+                else if (!cpu_shader_token_is(c, ")"))
+                {
+                    cpu_shader_next_token(c);
+                }
+            }
+        }
+
+        cpu_shader_storage_t storage = CPU_STORAGE_LOCAL;
+        if (cpu_shader_accept(c, "uniform")) storage = CPU_STORAGE_UNIFORM;
+        else if (cpu_shader_accept(c, "in") || cpu_shader_accept(c, "attribute") || cpu_shader_accept(c, "varying")) storage = CPU_STORAGE_INPUT;
+        else if (cpu_shader_accept(c, "out")) storage = CPU_STORAGE_OUTPUT;
+        else if (cpu_shader_accept(c, "const")) storage = CPU_STORAGE_CONST;
+
+        // Interpolation qualifiers only matter to the rasterizer.
+        while (cpu_shader_accept(c, "flat") || cpu_shader_accept(c, "smooth") || cpu_shader_accept(c, "noperspective") ||
+            cpu_shader_accept(c, "highp") || cpu_shader_accept(c, "mediump") || cpu_shader_accept(c, "lowp"))
+        {
+        }
+
+        cpu_shader_type_t type;
+        if (!cpu_shader_parse_type_name(c, &type))
+        {
+            cpu_shader_error(c, "expected a declaration");
+            break;
+        }
+
+        if (type.base == CPU_TYPE_VOID)
+        {
+            if (!cpu_shader_accept(c, "main"))
+            {
+                cpu_shader_error(c, "only main() is supported");
+                break;
+            }
+            if (has_main)
+            {
+                cpu_shader_error(c, "main() is defined twice");
+                break;
+            }
+            has_main = true;
+            cpu_shader_expect(c, "(");
+            cpu_shader_accept(c, "void");
+            cpu_shader_expect(c, ")");
+            cpu_shader_expect(c, "{");
+            cpu_shader_declare_late_builtins(c);
+            cpu_shader_parse_block(c);
+            continue;
+        }
+
+        if (type.base == CPU_TYPE_SAMPLER)
+        {
+            if (storage != CPU_STORAGE_UNIFORM)
+            {
+                cpu_shader_error(c, "samplers must be uniforms");
+                break;
+            }
+            storage = CPU_STORAGE_SAMPLER;
+        }
+        cpu_shader_parse_declaration(c, type, storage, location);
+    }
+
+    if (!c->failed && !has_main)
+    {
+        cpu_shader_error(c, "missing main()");
+    }
+
+    cpu_shader_emit(c, CPU_OP_END, 0);
+    cpu_shader_place_constants(c);
+
+    bool ok = !c->failed;
+    free(c);
+    return ok;
+}
+
+//
+// Interface, shaped after the GL calls it stands in for.
+//
+
+int32_t cpu_shader_find_variable(const cpu_shader_variable_t *list, uint32_t count, const char *name)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (strcmp(list[i].name, name) == 0)
+        {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+int32_t cpu_shader_uniform_location(const cpu_shader_t *shader, const char *name)
+{
+    return cpu_shader_find_variable(shader->uniforms, shader->uniform_count, name);
+}
+
+int32_t cpu_shader_sampler_location(const cpu_shader_t *shader, const char *name)
+{
+    return cpu_shader_find_variable(shader->samplers, shader->sampler_count, name);
+}
+
+int32_t cpu_shader_input_location(const cpu_shader_t *shader, const char *name)
+{
+    return cpu_shader_find_variable(shader->inputs, shader->input_count, name);
+}
+
+int32_t cpu_shader_output_location(const cpu_shader_t *shader, const char *name)
+{
+    return cpu_shader_find_variable(shader->outputs, shader->output_count, name);
+}
+
+// Matrices are column-major, same as glUniformMatrix4fv with transpose off.
+void cpu_shader_set_uniform(cpu_shader_t *shader, int32_t location, const real32_t *values, uint32_t count)
+{
+    if (location < 0)
+    {
+        return;
+    }
+    assert((uint32_t)location < shader->uniform_count);
+    cpu_shader_variable_t *uniform = &shader->uniforms[location];
+    assert(count <= uniform->component_count);
+    memcpy(&shader->uniform_values[uniform->offset], values, count * sizeof(real32_t));
+}
+
+void cpu_shader_set_texture(cpu_shader_t *shader, int32_t location, const texture_t *texture, texture_filter_t filter)
+{
+    if (location < 0)
+    {
+        return;
+    }
+    assert((uint32_t)location < shader->sampler_count);
+    shader->sampler_bindings[location].texture = texture;
+    shader->sampler_bindings[location].filter = filter;
+}
+
+//
+// Virtual machine
+//
+
+cpu_shader_context_t cpu_shader_create_context(const cpu_shader_t *shader, uint32_t group_width)
+{
+    assert(group_width == 8 || group_width == 16);
+
+    cpu_shader_context_t context = {};
+    context.shader = shader;
+    context.group_width = group_width;
+
+    uint32_t floats = (shader->register_count + 1 + CPU_SHADER_MAX_MASK_DEPTH) * group_width;
+    context.memory = malloc(floats * sizeof(real32_t) + 63);
+    assert(context.memory);
+    context.registers = (real32_t *)(((uintptr_t)context.memory + 63) & ~(uintptr_t)63);
+    memset(context.registers, 0, floats * sizeof(real32_t));
+    context.mask = context.registers + shader->register_count * group_width;
+    context.mask_stack = context.mask + group_width;
+
+    // The constant pool never changes, so it is broadcast once here.
+    for (uint32_t i = 0; i < shader->constant_count; ++i)
+    {
+        real32_t *reg = context.registers + (shader->constant_first_register + i) * group_width;
+        for (uint32_t lane = 0; lane < group_width; ++lane)
+        {
+            memcpy(&reg[lane], &shader->constant_bits[i], sizeof(real32_t));
+        }
+    }
+    return context;
+}
+
+void cpu_shader_destroy_context(cpu_shader_context_t *context)
+{
+    free(context->memory);
+    *context = {};
+}
+
+inline f32x8_t cpu_shader_scalar_op(f32x8_t a, real32_t (*function)(real32_t))
+{
+    real32_t lanes[8];
+    f32x8_store(lanes, a);
+    for (uint32_t lane = 0; lane < 8; ++lane)
+    {
+        lanes[lane] = function(lanes[lane]);
+    }
+    return f32x8_load(lanes);
+}
+
+inline real32_t cpu_shader_sin(real32_t x) { return sinf(x); }
+inline real32_t cpu_shader_cos(real32_t x) { return cosf(x); }
+inline real32_t cpu_shader_exp2(real32_t x) { return exp2f(x); }
+inline real32_t cpu_shader_log2(real32_t x) { return log2f(x); }
+
+void cpu_shader_run_group(cpu_shader_context_t *context)
+{
+    const cpu_shader_t *shader = context->shader;
+    const uint32_t width = context->group_width;
+    real32_t *registers = context->registers;
+    real32_t *mask = context->mask;
+    uint32_t mask_depth = 0;
+
+#define CPU_SHADER_LANES(statement) \
+    for (uint32_t k = 0; k < width; k += 8) { statement; } break;
+#define CPU_SHADER_R(reg) (registers + (reg) * width + k)
+#define CPU_SHADER_F(reg) f32x8_load(CPU_SHADER_R(reg))
+#define CPU_SHADER_I(reg) as_i32(f32x8_load(CPU_SHADER_R(reg)))
+#define CPU_SHADER_OUT(value) f32x8_store(CPU_SHADER_R(in->dst), (value))
+
+    uint32_t pc = 0;
+    for (;;)
+    {
+        const cpu_shader_instruction_t *in = &shader->code[pc++];
+        switch (in->op)
+        {
+        case CPU_OP_MOV: CPU_SHADER_LANES(CPU_SHADER_OUT(select(as_i32(f32x8_load(mask + k)), CPU_SHADER_F(in->a), CPU_SHADER_F(in->dst))))
+        case CPU_OP_ADD: CPU_SHADER_LANES(CPU_SHADER_OUT(CPU_SHADER_F(in->a) + CPU_SHADER_F(in->b)))
+        case CPU_OP_SUB: CPU_SHADER_LANES(CPU_SHADER_OUT(CPU_SHADER_F(in->a) - CPU_SHADER_F(in->b)))
+        case CPU_OP_MUL: CPU_SHADER_LANES(CPU_SHADER_OUT(CPU_SHADER_F(in->a) * CPU_SHADER_F(in->b)))
+        case CPU_OP_DIV: CPU_SHADER_LANES(CPU_SHADER_OUT(CPU_SHADER_F(in->a) / CPU_SHADER_F(in->b)))
+        case CPU_OP_MAD: CPU_SHADER_LANES(CPU_SHADER_OUT(CPU_SHADER_F(in->a) * CPU_SHADER_F(in->b) + CPU_SHADER_F(in->c)))
+        case CPU_OP_MIN: CPU_SHADER_LANES(CPU_SHADER_OUT(simd_min(CPU_SHADER_F(in->a), CPU_SHADER_F(in->b))))
+        case CPU_OP_MAX: CPU_SHADER_LANES(CPU_SHADER_OUT(simd_max(CPU_SHADER_F(in->a), CPU_SHADER_F(in->b))))
+        case CPU_OP_ABS: CPU_SHADER_LANES(CPU_SHADER_OUT(abs(CPU_SHADER_F(in->a))))
+        case CPU_OP_FLOOR: CPU_SHADER_LANES(CPU_SHADER_OUT(floor(CPU_SHADER_F(in->a))))
+        case CPU_OP_TRUNC: CPU_SHADER_LANES(CPU_SHADER_OUT(to_f32(to_i32(CPU_SHADER_F(in->a)))))
+        case CPU_OP_SQRT: CPU_SHADER_LANES(CPU_SHADER_OUT(sqrt(CPU_SHADER_F(in->a))))
+        case CPU_OP_SIN: CPU_SHADER_LANES(CPU_SHADER_OUT(cpu_shader_scalar_op(CPU_SHADER_F(in->a), cpu_shader_sin)))
+        case CPU_OP_COS: CPU_SHADER_LANES(CPU_SHADER_OUT(cpu_shader_scalar_op(CPU_SHADER_F(in->a), cpu_shader_cos)))
+        case CPU_OP_EXP2: CPU_SHADER_LANES(CPU_SHADER_OUT(cpu_shader_scalar_op(CPU_SHADER_F(in->a), cpu_shader_exp2)))
+        case CPU_OP_LOG2: CPU_SHADER_LANES(CPU_SHADER_OUT(cpu_shader_scalar_op(CPU_SHADER_F(in->a), cpu_shader_log2)))
+        case CPU_OP_CMP_LT: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(cmp_lt(CPU_SHADER_F(in->a), CPU_SHADER_F(in->b)))))
+        case CPU_OP_CMP_LE: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(cmp_le(CPU_SHADER_F(in->a), CPU_SHADER_F(in->b)))))
+        case CPU_OP_CMP_EQ: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(cmp_eq(CPU_SHADER_F(in->a), CPU_SHADER_F(in->b)))))
+        case CPU_OP_CMP_NE: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(cmp_eq(CPU_SHADER_F(in->a), CPU_SHADER_F(in->b)) ^ i32x8(-1))))
+        case CPU_OP_AND: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(CPU_SHADER_I(in->a) & CPU_SHADER_I(in->b))))
+        case CPU_OP_OR: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(CPU_SHADER_I(in->a) | CPU_SHADER_I(in->b))))
+        case CPU_OP_NOT: CPU_SHADER_LANES(CPU_SHADER_OUT(as_f32(CPU_SHADER_I(in->a) ^ i32x8(-1))))
+        case CPU_OP_SELECT: CPU_SHADER_LANES(CPU_SHADER_OUT(select(CPU_SHADER_I(in->a), CPU_SHADER_F(in->b), CPU_SHADER_F(in->c))))
+
+        case CPU_OP_INDEX:
+        {
+            CPU_SHADER_LANES(
+                f32x8_t index = CPU_SHADER_F(in->b);
+                f32x8_t value = CPU_SHADER_F(in->a);
+                for (uint32_t element = 1; element < in->c; ++element)
+                {
+                    value = select(cmp_eq(index, f32x8((real32_t)element)), CPU_SHADER_F(in->a + element * in->d), value);
+                }
+                CPU_SHADER_OUT(value))
+        }
+        case CPU_OP_STORE_INDEX:
+        {
+            CPU_SHADER_LANES(
+                f32x8_t index = CPU_SHADER_F(in->b);
+                f32x8_t value = CPU_SHADER_F(in->a);
+                i32x8_t active = as_i32(f32x8_load(mask + k));
+                for (uint32_t element = 0; element < in->c; ++element)
+                {
+                    uint32_t reg = in->dst + element * in->d;
+                    i32x8_t picked = active & cmp_eq(index, f32x8((real32_t)element));
+                    f32x8_store(CPU_SHADER_R(reg), select(picked, value, CPU_SHADER_F(reg)));
+                })
+        }
+
+        case CPU_OP_TEXTURE:
+        {
+            const cpu_shader_sampler_t *binding = &shader->sampler_bindings[in->c];
+            assert(binding->texture);
+            CPU_SHADER_LANES(
+                texture_sample_t sample = texture_sample(binding->texture, binding->filter, CPU_SHADER_F(in->a), CPU_SHADER_F(in->b));
+                f32x8_store(CPU_SHADER_R(in->dst), sample.r);
+                f32x8_store(CPU_SHADER_R(in->dst + 1), sample.g);
+                f32x8_store(CPU_SHADER_R(in->dst + 2), sample.b);
+                f32x8_store(CPU_SHADER_R(in->dst + 3), sample.a))
+        }
+
+        case CPU_OP_MASK_PUSH:
+        {
+            assert(mask_depth < CPU_SHADER_MAX_MASK_DEPTH);
+            memcpy(context->mask_stack + mask_depth * width, mask, width * sizeof(real32_t));
+            ++mask_depth;
+            CPU_SHADER_LANES(f32x8_store(mask + k, as_f32(as_i32(f32x8_load(mask + k)) & CPU_SHADER_I(in->a))))
+        }
+        case CPU_OP_MASK_AND: CPU_SHADER_LANES(f32x8_store(mask + k, as_f32(as_i32(f32x8_load(mask + k)) & CPU_SHADER_I(in->a))))
+        case CPU_OP_MASK_ELSE:
+        {
+            real32_t *outer = context->mask_stack + (mask_depth - 1) * width;
+            CPU_SHADER_LANES(f32x8_store(mask + k, as_f32(andnot(CPU_SHADER_I(in->a), as_i32(f32x8_load(outer + k))))))
+        }
+        case CPU_OP_MASK_POP:
+        {
+            --mask_depth;
+            memcpy(mask, context->mask_stack + mask_depth * width, width * sizeof(real32_t));
+        } break;
+
+        case CPU_OP_JUMP:
+        {
+            pc = in->a;
+        } break;
+
+        case CPU_OP_JUMP_IF_NONE:
+        {
+            uint32_t active = 0;
+            for (uint32_t k = 0; k < width; k += 8)
+            {
+                active |= movemask(as_i32(f32x8_load(mask + k)));
+            }
+            if (!active)
+            {
+                pc = in->a;
+            }
+        } break;
+
+        case CPU_OP_END:
+        {
+            assert(mask_depth == 0);
+            return;
+        }
+
+        default:
+        {
+            assert(0);
+            return;
+        }
+        }
+    }
+
+#undef CPU_SHADER_LANES
+#undef CPU_SHADER_R
+#undef CPU_SHADER_F
+#undef CPU_SHADER_I
+#undef CPU_SHADER_OUT
+}
+
+// Runs invocation_count invocations, group_width at a time. For fragment
+// shaders that sample with trilinear filtering, invocations must come in 2x2
+// quads so derivatives can be taken across lanes.
+void cpu_shader_execute(cpu_shader_context_t *context, const cpu_shader_run_t *run, uint32_t invocation_count)
+{
+    const cpu_shader_t *shader = context->shader;
+    const uint32_t width = context->group_width;
+    real32_t *registers = context->registers;
+
+    for (uint32_t i = 0; i < shader->uniform_count; ++i)
+    {
+        const cpu_shader_variable_t *uniform = &shader->uniforms[i];
+        for (uint32_t component = 0; component < uniform->component_count; ++component)
+        {
+            real32_t value = shader->uniform_values[uniform->offset + component];
+            real32_t *reg = registers + (uniform->first_register + component) * width;
+            for (uint32_t lane = 0; lane < width; ++lane)
+            {
+                reg[lane] = value;
+            }
+        }
+    }
+
+    if (shader->instance_id_register >= 0)
+    {
+        real32_t *reg = registers + shader->instance_id_register * width;
+        for (uint32_t lane = 0; lane < width; ++lane)
+        {
+            reg[lane] = (real32_t)run->instance;
+        }
+    }
+
+    for (uint32_t first = 0; first < invocation_count; first += width)
+    {
+        uint32_t active = invocation_count - first < width ? invocation_count - first : width;
+
+        for (uint32_t lane = 0; lane < width; ++lane)
+        {
+            uint32_t bits = lane < active ? 0xffffffff : 0;
+            memcpy(&context->mask[lane], &bits, sizeof(bits));
+        }
+
+        if (shader->vertex_id_register >= 0)
+        {
+            real32_t *reg = registers + shader->vertex_id_register * width;
+            for (uint32_t lane = 0; lane < width; ++lane)
+            {
+                reg[lane] = (real32_t)(run->first_vertex + first + lane);
+            }
+        }
+
+        for (uint32_t i = 0; i < shader->input_count; ++i)
+        {
+            const cpu_shader_variable_t *input = &shader->inputs[i];
+            const cpu_shader_stream_t *stream = &run->inputs[i];
+            if (!input->used || !stream->data)
+            {
+                continue;
+            }
+            for (uint32_t component = 0; component < input->component_count; ++component)
+            {
+                real32_t *reg = registers + (input->first_register + component) * width;
+                const real32_t *source = stream->data + first * stream->stride + component;
+                for (uint32_t lane = 0; lane < active; ++lane)
+                {
+                    reg[lane] = source[lane * stream->stride];
+                }
+            }
+        }
+
+        cpu_shader_run_group(context);
+
+        for (uint32_t i = 0; i < shader->output_count; ++i)
+        {
+            const cpu_shader_variable_t *output = &shader->outputs[i];
+            const cpu_shader_stream_t *stream = &run->outputs[i];
+            if (!output->name[0] || !stream->data)
+            {
+                continue;
+            }
+            for (uint32_t component = 0; component < output->component_count; ++component)
+            {
+                const real32_t *reg = registers + (output->first_register + component) * width;
+                real32_t *destination = stream->data + first * stream->stride + component;
+                for (uint32_t lane = 0; lane < active; ++lane)
+                {
+                    destination[lane * stream->stride] = reg[lane];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "simd.h"
+#include "jobs.h"
+#include "rasterizer.h"
+
+// Single-sampled CPU colour + depth target stored tile by tile. Clearing only
+// marks tiles; a cleared tile gets its memory written the first time a
+// triangle reaches it, and readback substitutes the clear values for tiles
+// nobody drew to. Each tile also keeps conservative depth bounds so whole
+// triangle/tile pairs can be rejected, or drawn without reading depth.
+
+#define CPU_FRAMEBUFFER_TILE_PIXELS (RASTER_TILE_SIZE * RASTER_TILE_SIZE)
+
+struct cpu_framebuffer_tile_t
+{
+    bool cleared;           // memory is stale, contents are the clear values
+    real32_t min_depth;     // no pixel is closer than this
+    real32_t max_depth;     // no pixel is farther than this
+};
+
+struct cpu_framebuffer_t
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+
+    uint32_t *color;        // CPU_FRAMEBUFFER_TILE_PIXELS per tile, tile after tile
+    real32_t *depth;
+    cpu_framebuffer_tile_t *tiles;
+
+    uint32_t clear_color;
+    real32_t clear_depth;
+
+    raster_bins_t bins;
+    const raster_triangle_t *triangles;
+};
+
+void cpu_framebuffer_create(cpu_framebuffer_t *framebuffer, uint32_t width, uint32_t height)
+{
+    *framebuffer = {};
+    framebuffer->width = width;
+    framebuffer->height = height;
+    framebuffer->tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    framebuffer->tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    uint32_t tile_count = framebuffer->tiles_x * framebuffer->tiles_y;
+    framebuffer->color = (uint32_t *)malloc((size_t)tile_count * CPU_FRAMEBUFFER_TILE_PIXELS * sizeof(uint32_t));
+    framebuffer->depth = (real32_t *)malloc((size_t)tile_count * CPU_FRAMEBUFFER_TILE_PIXELS * sizeof(real32_t));
+    framebuffer->tiles = (cpu_framebuffer_tile_t *)malloc(tile_count * sizeof(cpu_framebuffer_tile_t));
+    assert(framebuffer->color && framebuffer->depth && framebuffer->tiles);
+
+    framebuffer->clear_depth = 1.0f;
+    for (uint32_t t = 0; t < tile_count; ++t)
+    {
+        framebuffer->tiles[t] = { true, 1.0f, 1.0f };
+    }
+}
+
+void cpu_framebuffer_destroy(cpu_framebuffer_t *framebuffer)
+{
+    free(framebuffer->color);
+    free(framebuffer->depth);
+    free(framebuffer->tiles);
+    raster_free_bins(&framebuffer->bins);
+    *framebuffer = {};
+}
+
+// O(tiles), no pixel memory is touched.
+void cpu_framebuffer_clear(cpu_framebuffer_t *framebuffer, uint32_t color, real32_t depth)
+{
+    framebuffer->clear_color = color;
+    framebuffer->clear_depth = depth;
+
+    uint32_t tile_count = framebuffer->tiles_x * framebuffer->tiles_y;
+    for (uint32_t t = 0; t < tile_count; ++t)
+    {
+        framebuffer->tiles[t] = { true, depth, depth };
+    }
+}
+
+// Writes the clear values into a tile that is about to be drawn to.
+void cpu_framebuffer_touch_tile(cpu_framebuffer_t *framebuffer, uint32_t tile_index)
+{
+    cpu_framebuffer_tile_t *tile = &framebuffer->tiles[tile_index];
+    if (!tile->cleared)
+    {
+        return;
+    }
+
+    int32_t *color = (int32_t *)framebuffer->color + (size_t)tile_index * CPU_FRAMEBUFFER_TILE_PIXELS;
+    real32_t *depth = framebuffer->depth + (size_t)tile_index * CPU_FRAMEBUFFER_TILE_PIXELS;
+    i32x8_t clear_color = i32x8((int32_t)framebuffer->clear_color);
+    f32x8_t clear_depth = f32x8(framebuffer->clear_depth);
+    for (uint32_t i = 0; i < CPU_FRAMEBUFFER_TILE_PIXELS; i += 8)
+    {
+        i32x8_store(color + i, clear_color);
+        f32x8_store(depth + i, clear_depth);
+    }
+    tile->cleared = false;
+}
+
+// True when every pixel centre of the rectangle is strictly inside.
+bool cpu_framebuffer_covers_rectangle(const raster_triangle_t *triangle, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+    real32_t left = (real32_t)x0 + 0.5f - triangle->origin_x;
+    real32_t right = (real32_t)x1 + 0.5f - triangle->origin_x;
+    real32_t top = (real32_t)y0 + 0.5f - triangle->origin_y;
+    real32_t bottom = (real32_t)y1 + 0.5f - triangle->origin_y;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        real32_t a = triangle->edge_a[i];
+        real32_t b = triangle->edge_b[i];
+        real32_t c = triangle->edge_c[i];
+        if (a * left + b * top + c <= 0.0f || a * right + b * top + c <= 0.0f ||
+            a * left + b * bottom + c <= 0.0f || a * right + b * bottom + c <= 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void cpu_framebuffer_draw_triangle(cpu_framebuffer_t *framebuffer, uint32_t tile_index, const raster_triangle_t *triangle)
+{
+    cpu_framebuffer_tile_t *tile = &framebuffer->tiles[tile_index];
+
+    // LESS can not pass anywhere in this tile.
+    if (triangle->min_z >= tile->max_depth)
+    {
+        return;
+    }
+
+    int32_t tile_x = (int32_t)((tile_index % framebuffer->tiles_x) * RASTER_TILE_SIZE);
+    int32_t tile_y = (int32_t)((tile_index / framebuffer->tiles_x) * RASTER_TILE_SIZE);
+    int32_t tile_right = tile_x + RASTER_TILE_SIZE - 1 < (int32_t)framebuffer->width - 1 ? tile_x + RASTER_TILE_SIZE - 1 : (int32_t)framebuffer->width - 1;
+    int32_t tile_bottom = tile_y + RASTER_TILE_SIZE - 1 < (int32_t)framebuffer->height - 1 ? tile_y + RASTER_TILE_SIZE - 1 : (int32_t)framebuffer->height - 1;
+
+    cpu_framebuffer_touch_tile(framebuffer, tile_index);
+
+    bool covers_tile = cpu_framebuffer_covers_rectangle(triangle, tile_x, tile_y, tile_right, tile_bottom);
+    bool always_passes = triangle->max_z < tile->min_depth;
+
+    int32_t x_begin = triangle->min_x > tile_x ? triangle->min_x : tile_x;
+    int32_t y_begin = triangle->min_y > tile_y ? triangle->min_y : tile_y;
+    int32_t x_end = triangle->max_x < tile_right ? triangle->max_x : tile_right;
+    int32_t y_end = triangle->max_y < tile_bottom ? triangle->max_y : tile_bottom;
+    x_begin = tile_x + ((x_begin - tile_x) & ~7);
+
+    int32_t *color = (int32_t *)framebuffer->color + (size_t)tile_index * CPU_FRAMEBUFFER_TILE_PIXELS;
+    real32_t *depth = framebuffer->depth + (size_t)tile_index * CPU_FRAMEBUFFER_TILE_PIXELS;
+    i32x8_t triangle_color = i32x8((int32_t)triangle->color);
+
+    for (int32_t y = y_begin; y <= y_end; ++y)
+    {
+        f32x8_t row_y = f32x8((real32_t)y + 0.5f - triangle->origin_y);
+        for (int32_t x = x_begin; x <= x_end; x += 8)
+        {
+            uint32_t pixel = (uint32_t)((y - tile_y) * RASTER_TILE_SIZE + (x - tile_x));
+            f32x8_t span_x = f32x8_ramp((real32_t)x + 0.5f - triangle->origin_x);
+            f32x8_t z = raster_depth(triangle, span_x, row_y);
+
+            i32x8_t pass = covers_tile ? i32x8(-1) : raster_coverage(triangle, span_x, row_y);
+            if (!always_passes)
+            {
+                pass = pass & cmp_lt(z, f32x8_load(depth + pixel));
+            }
+            if (!movemask(pass))
+            {
+                continue;
+            }
+
+            f32x8_store(depth + pixel, select(pass, z, f32x8_load(depth + pixel)));
+            i32x8_store(color + pixel, select(pass, triangle_color, i32x8_load(color + pixel)));
+        }
+    }
+
+    // Any pixel the triangle reached now holds at most its farthest depth,
+    // which bounds the whole tile only if every pixel was reached.
+    if (triangle->min_z < tile->min_depth)
+    {
+        tile->min_depth = triangle->min_z;
+    }
+    if (covers_tile && triangle->max_z < tile->max_depth)
+    {
+        tile->max_depth = triangle->max_z;
+    }
+}
+
+void cpu_framebuffer_draw_tile(void *data, uint32_t tile_index, uint32_t worker)
+{
+    (void)worker;
+    cpu_framebuffer_t *framebuffer = (cpu_framebuffer_t *)data;
+    const raster_bins_t *bins = &framebuffer->bins;
+    for (uint32_t i = bins->offsets[tile_index]; i < bins->offsets[tile_index + 1]; ++i)
+    {
+        cpu_framebuffer_draw_triangle(framebuffer, tile_index, &framebuffer->triangles[bins->indices[i]]);
+    }
+}
+
+// Flat-coloured triangles with a LESS depth test, tiles in parallel.
+void cpu_framebuffer_draw(cpu_framebuffer_t *framebuffer, job_pool_t *pool, const raster_triangle_t *triangles, uint32_t triangle_count)
+{
+    raster_bin_triangles(&framebuffer->bins, triangles, triangle_count, framebuffer->width, framebuffer->height);
+    framebuffer->triangles = triangles;
+    job_pool_run(pool, framebuffer->tiles_x * framebuffer->tiles_y, cpu_framebuffer_draw_tile, framebuffer);
+}
+
+// Copies rows [first_row, first_row + row_count) to a linear RGBA8 image with
+// the given stride in pixels. Cleared tiles are filled in without touching
+// their storage.
+void cpu_framebuffer_read_color(const cpu_framebuffer_t *framebuffer, uint32_t first_row, uint32_t row_count, uint32_t *pixels, uint32_t stride)
+{
+    assert(first_row + row_count <= framebuffer->height);
+    for (uint32_t y = first_row; y < first_row + row_count; ++y)
+    {
+        uint32_t *row = pixels + (size_t)(y - first_row) * stride;
+        uint32_t tile_row = y / RASTER_TILE_SIZE;
+        uint32_t y_in_tile = y % RASTER_TILE_SIZE;
+        for (uint32_t tile_column = 0; tile_column < framebuffer->tiles_x; ++tile_column)
+        {
+            uint32_t tile_index = tile_row * framebuffer->tiles_x + tile_column;
+            uint32_t x0 = tile_column * RASTER_TILE_SIZE;
+            uint32_t count = framebuffer->width - x0 < RASTER_TILE_SIZE ? framebuffer->width - x0 : RASTER_TILE_SIZE;
+            if (framebuffer->tiles[tile_index].cleared)
+            {
+                for (uint32_t x = 0; x < count; ++x)
+                {
+                    row[x0 + x] = framebuffer->clear_color;
+                }
+            }
+            else
+            {
+                memcpy(row + x0, framebuffer->color + (size_t)tile_index * CPU_FRAMEBUFFER_TILE_PIXELS + y_in_tile * RASTER_TILE_SIZE, count * sizeof(uint32_t));
+            }
+        }
+    }
+}
+
+void cpu_framebuffer_read_depth(const cpu_framebuffer_t *framebuffer, uint32_t first_row, uint32_t row_count, real32_t *depths, uint32_t stride)
+{
+    assert(first_row + row_count <= framebuffer->height);
+    for (uint32_t y = first_row; y < first_row + row_count; ++y)
+    {
+        real32_t *row = depths + (size_t)(y - first_row) * stride;
+        uint32_t tile_row = y / RASTER_TILE_SIZE;
+        uint32_t y_in_tile = y % RASTER_TILE_SIZE;
+        for (uint32_t tile_column = 0; tile_column < framebuffer->tiles_x; ++tile_column)
+        {
+            uint32_t tile_index = tile_row * framebuffer->tiles_x + tile_column;
+            uint32_t x0 = tile_column * RASTER_TILE_SIZE;
+            uint32_t count = framebuffer->width - x0 < RASTER_TILE_SIZE ? framebuffer->width - x0 : RASTER_TILE_SIZE;
+            if (framebuffer->tiles[tile_index].cleared)
+            {
+                for (uint32_t x = 0; x < count; ++x)
+                {
+                    row[x0 + x] = framebuffer->clear_depth;
+                }
+            }
+            else
+            {
+                memcpy(row + x0, framebuffer->depth + (size_t)tile_index * CPU_FRAMEBUFFER_TILE_PIXELS + y_in_tile * RASTER_TILE_SIZE, count * sizeof(real32_t));
+            }
+        }
+    }
+}
@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+#
+# Generates gl_dispatch.h from the prototypes in glext.h and the entry points
+# listed in gl_functions.txt. Run it again after editing the list:
+#
+#     python generate_gl_dispatch.py [glext.h] [gl_functions.txt] [gl_dispatch.h]
+#
+
+import os
+import re
+import sys
+
+here = os.path.dirname(os.path.abspath(__file__))
+glext_path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, 'glext.h')
+list_path = sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, 'gl_functions.txt')
+output_path = sys.argv[3] if len(sys.argv) > 3 else os.path.join(here, 'gl_dispatch.h')
+
+prototype_pattern = re.compile(r'^GLAPI\s+(.+?)\s*APIENTRY\s+(\w+)\s*\((.*)\);')
+parameter_name_pattern = re.compile(r'(\w+)\s*(\[\w*\])?\s*$')
+
+
+def fail(message):
+    sys.stderr.write('generate_gl_dispatch: %s\n' % message)
+    sys.exit(1)
+
+
+def read_prototypes(path):
+    prototypes = {}
+    with open(path) as f:
+        for line in f:
+            match = prototype_pattern.match(line)
+            if not match:
+                continue
+            result, name, parameters = match.groups()
+            parameters = parameters.strip()
+            if parameters == 'void':
+                parameters = ''
+            arguments = []
+            if parameters:
+                for parameter in parameters.split(','):
+                    argument = parameter_name_pattern.search(parameter.strip())
+                    if not argument:
+                        fail('can not find the parameter name in "%s" of %s' % (parameter, name))
+                    arguments.append(argument.group(1))
+            prototypes[name] = (result, parameters, arguments)
+    return prototypes
+
+
+def read_function_list(path):
+    functions = []
+    seen = set()
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            if len(fields) != 2 or fields[1] not in ('required', 'optional'):
+                fail('%s:%d: expected "<function> required|optional"' % (path, number))
+            if fields[0] in seen:
+                fail('%s:%d: %s is listed twice' % (path, number, fields[0]))
+            seen.add(fields[0])
+            functions.append((fields[0], fields[1] == 'required'))
+    return functions
+
+
+prototypes = read_prototypes(glext_path)
+functions = read_function_list(list_path)
+for name, _ in functions:
+    if name not in prototypes:
+        fail('%s is not declared in %s' % (name, os.path.basename(glext_path)))
+
+# Required entries come first so loading them is a single loop over a prefix.
+required = [name for name, is_required in functions if is_required]
+optional = [name for name, is_required in functions if not is_required]
+ordered = required + optional
+
+offsets = []
+offset = 0
+for name in ordered:
+    offsets.append(offset)
+    offset += len(name) + 1
+offset_type = 'uint16_t' if offset <= 0xffff else 'uint32_t'
+
+
+# The table declares its own pointer types rather than use glext.h's PFN
+# typedefs, which a system <GL/gl.h> may already have claimed the guard for.
+def pointer_type(name):
+    return 'gl_dispatch_%s_t' % name
+
+
+out = []
+emit = out.append
+
+emit('#pragma once')
+emit('')
+emit('// Generated by generate_gl_dispatch.py from glext.h and gl_functions.txt, do')
+emit('// not edit by hand.')
+emit('//')
+emit('// All entry points live in one table. Required ones are resolved in a single')
+emit('// pass by gl_dispatch_load(), optional ones start out as stubs that resolve')
+emit('// themselves on first call. The loader is a plain function pointer, so the')
+emit('// same table works with wglGetProcAddress, glXGetProcAddress or')
+emit('// eglGetProcAddress. Include after <GL/gl.h> and glext.h.')
+emit('//')
+emit('// With GL_VALIDATION defined, which Debug builds get unless GL_NO_VALIDATION')
+emit('// is, every call first records its entry point and source location for')
+emit('// gl_validation.h. Without it the macros are plain table lookups.')
+emit('')
+emit('#include <cassert>')
+emit('#include <stdio.h>')
+emit('#include <stdint.h>')
+emit('')
+emit('#if defined(_DEBUG) && !defined(GL_NO_VALIDATION) && !defined(GL_VALIDATION)')
+emit('#define GL_VALIDATION')
+emit('#endif')
+emit('')
+emit('#ifdef GL_VALIDATION')
+emit('#include <atomic>')
+emit('#endif')
+emit('')
+emit('typedef void *gl_get_proc_address_t(const char *name);')
+emit('')
+emit('enum gl_dispatch_index_t')
+emit('{')
+for name in ordered:
+    emit('    GL_DISPATCH_%s,' % name)
+emit('    GL_DISPATCH_COUNT')
+emit('};')
+emit('')
+emit('#define GL_DISPATCH_REQUIRED_COUNT %d' % len(required))
+emit('')
+for name in ordered:
+    result, parameters, _ = prototypes[name]
+    emit('typedef %s (APIENTRY *%s)(%s);' % (result, pointer_type(name), parameters))
+emit('')
+emit('static const char gl_dispatch_names[] =')
+for name in ordered:
+    emit('    "%s\\0"' % name)
+emit('    ;')
+emit('')
+emit('static const %s gl_dispatch_name_offsets[GL_DISPATCH_COUNT + 1] =' % offset_type)
+emit('{')
+for index in range(0, len(offsets), 8):
+    emit('    ' + ' '.join('%d,' % o for o in offsets[index:index + 8]))
+emit('    0')
+emit('};')
+emit('')
+emit('struct gl_dispatch_t')
+emit('{')
+emit('    void *procs[GL_DISPATCH_COUNT];')
+emit('    gl_get_proc_address_t *get_proc_address;')
+emit('};')
+emit('')
+emit('gl_dispatch_t gl_dispatch;')
+emit('')
+emit('inline const char *gl_dispatch_name(uint32_t index)')
+emit('{')
+emit('    return gl_dispatch_names + gl_dispatch_name_offsets[index];')
+emit('}')
+emit('')
+emit('// Looks up an optional entry point and patches the table. Racing threads')
+emit('// store the same pointer, so no lock is needed.')
+emit('void *gl_dispatch_resolve(uint32_t index)')
+emit('{')
+emit('    assert(index >= GL_DISPATCH_REQUIRED_COUNT && gl_dispatch.get_proc_address);')
+emit('    void *proc = gl_dispatch.get_proc_address(gl_dispatch_name(index));')
+emit('    if (proc)')
+emit('    {')
+emit('        gl_dispatch.procs[index] = proc;')
+emit('    }')
+emit('    return proc;')
+emit('}')
+emit('')
+for name in optional:
+    result, parameters, arguments = prototypes[name]
+    emit('static %s APIENTRY gl_dispatch_stub_%s(%s)' % (result, name, parameters))
+    emit('{')
+    emit('    void *proc = gl_dispatch_resolve(GL_DISPATCH_%s);' % name)
+    emit('    assert(proc && "%s is not available, check gl_dispatch_available() first");' % name)
+    emit('    return ((%s)proc)(%s);' % (pointer_type(name), ', '.join(arguments)))
+    emit('}')
+    emit('')
+emit('static void *const gl_dispatch_stubs[GL_DISPATCH_COUNT - GL_DISPATCH_REQUIRED_COUNT + 1] =')
+emit('{')
+for name in optional:
+    emit('    (void *)gl_dispatch_stub_%s,' % name)
+emit('    0')
+emit('};')
+emit('')
+emit('// Resolves every required entry point, reporting each missing one. Optional')
+emit('// entries are not looked up until they are first called.')
+emit('bool gl_dispatch_load(gl_get_proc_address_t *get_proc_address)')
+emit('{')
+emit('    gl_dispatch.get_proc_address = get_proc_address;')
+emit('')
+emit('    bool complete = true;')
+emit('    for (uint32_t i = 0; i < GL_DISPATCH_REQUIRED_COUNT; ++i)')
+emit('    {')
+emit('        gl_dispatch.procs[i] = get_proc_address(gl_dispatch_name(i));')
+emit('        if (!gl_dispatch.procs[i])')
+emit('        {')
+emit('            fprintf(stderr, "missing required GL function %s\\n", gl_dispatch_name(i));')
+emit('            complete = false;')
+emit('        }')
+emit('    }')
+emit('    for (uint32_t i = GL_DISPATCH_REQUIRED_COUNT; i < GL_DISPATCH_COUNT; ++i)')
+emit('    {')
+emit('        gl_dispatch.procs[i] = gl_dispatch_stubs[i - GL_DISPATCH_REQUIRED_COUNT];')
+emit('    }')
+emit('    return complete;')
+emit('}')
+emit('')
+emit('// Whether an entry point can be called, resolving it if it is still a stub.')
+emit('inline bool gl_dispatch_available(uint32_t index)')
+emit('{')
+emit('    if (index < GL_DISPATCH_REQUIRED_COUNT || gl_dispatch.procs[index] != gl_dispatch_stubs[index - GL_DISPATCH_REQUIRED_COUNT])')
+emit('    {')
+emit('        return gl_dispatch.procs[index] != 0;')
+emit('    }')
+emit('    return gl_dispatch_resolve(index) != 0;')
+emit('}')
+emit('')
+emit('// Installs the debug message callback on the current context, see')
+emit('// gl_validation.h. Declared here so the platform backends can call it.')
+emit('bool gl_validation_initialize(bool synchronous);')
+emit('')
+emit('#ifdef GL_VALIDATION')
+emit('')
+emit('#define GL_VALIDATION_HISTORY 16    // power of two')
+emit('')
+emit('// The debug callback may run on a driver thread while calls are still being')
+emit('// recorded, hence the atomics. Relaxed stores are plain moves on x86.')
+emit('struct gl_validation_call_t')
+emit('{')
+emit('    std::atomic<const char *> file;')
+emit('    std::atomic<uint32_t> line;')
+emit('    std::atomic<uint32_t> function;')
+emit('};')
+emit('')
+emit('// The latest calls made on one thread.')
+emit('struct gl_validation_history_t')
+emit('{')
+emit('    gl_validation_call_t calls[GL_VALIDATION_HISTORY];')
+emit('    std::atomic<uint32_t> count;')
+emit('};')
+emit('')
+emit('std::atomic<uint32_t> gl_validation_counts[GL_DISPATCH_COUNT];')
+emit('thread_local gl_validation_history_t gl_validation_history;')
+emit('')
+emit('inline void gl_validation_record(uint32_t function, const char *file, uint32_t line)')
+emit('{')
+emit('    gl_validation_counts[function].fetch_add(1, std::memory_order_relaxed);')
+emit('    uint32_t count = gl_validation_history.count.load(std::memory_order_relaxed);')
+emit('    gl_validation_call_t *call = &gl_validation_history.calls[count & (GL_VALIDATION_HISTORY - 1)];')
+emit('    call->file.store(file, std::memory_order_relaxed);')
+emit('    call->line.store(line, std::memory_order_relaxed);')
+emit('    call->function.store(function, std::memory_order_relaxed);')
+emit('    gl_validation_history.count.store(count + 1, std::memory_order_release);')
+emit('}')
+emit('')
+for name in ordered:
+    emit('#define %s (gl_validation_record(GL_DISPATCH_%s, __FILE__, __LINE__), (%s)gl_dispatch.procs[GL_DISPATCH_%s])' % (name, name, pointer_type(name), name))
+emit('')
+emit('#else')
+emit('')
+for name in ordered:
+    emit('#define %s ((%s)gl_dispatch.procs[GL_DISPATCH_%s])' % (name, pointer_type(name), name))
+emit('')
+emit('#endif')
+
+with open(output_path, 'w', newline='\r\n') as f:
+    f.write('\n'.join(out) + '\n')
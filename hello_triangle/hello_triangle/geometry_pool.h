@@ -0,0 +1,464 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "opengl.h"
+#include "gl_state.h"
+
+// Static meshes of one vertex layout sub-allocated from a single vertex
+// buffer and a single index buffer, both behind one vertex array. A mesh is
+// just a base vertex and a first index, so any number of them draw with one
+// binding, through glMultiDrawElementsBaseVertex or an indirect_batch_t on the
+// pool's vertex array (instancing_bind_instances() works on it too).
+//
+// Space comes from a best-fit free list per buffer. When an add does not fit
+// because the free space is fragmented, the pool compacts itself: live meshes
+// are copied into fresh buffers back to back with glCopyBufferSubData and
+// their offsets updated. Handles stay valid; offsets do not, so look them up
+// again after adding meshes.
+
+#define GEOMETRY_MAX_ATTRIBUTES 8
+#define GEOMETRY_NO_MESH 0xffffffffu
+#define GEOMETRY_NO_SPACE 0xffffffffu
+
+struct geometry_attribute_t
+{
+    uint32_t location;
+    int32_t size;               // components
+    uint32_t type;              // GL_FLOAT, GL_UNSIGNED_BYTE, ...
+    bool normalized;
+    bool integer;               // read as ivec/uvec through glVertexAttribIPointer
+    uint32_t offset;
+};
+
+struct geometry_layout_t
+{
+    uint32_t stride;
+    uint32_t attribute_count;
+    geometry_attribute_t attributes[GEOMETRY_MAX_ATTRIBUTES];
+};
+
+struct geometry_range_t
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Free ranges of [0, capacity) kept sorted by offset, neighbours merged.
+struct geometry_free_list_t
+{
+    geometry_range_t *ranges;
+    uint32_t count;
+    uint32_t range_capacity;
+    uint32_t capacity;
+    uint32_t used;
+};
+
+struct geometry_mesh_t
+{
+    uint32_t vertex_offset;     // the base vertex
+    uint32_t vertex_count;
+    uint32_t index_offset;      // the first index
+    uint32_t index_count;
+    bool live;
+};
+
+struct geometry_pool_stats_t
+{
+    uint32_t meshes;
+    uint32_t vertex_fragments;  // free ranges; 1 means no fragmentation
+    uint32_t index_fragments;
+    uint32_t compactions;
+};
+
+struct geometry_pool_t
+{
+    geometry_layout_t layout;
+    uint32_t index_type;
+    uint32_t index_size;
+
+    uint32_t vertex_array;
+    uint32_t vertex_buffer;
+    uint32_t index_buffer;
+    geometry_free_list_t vertices;  // in vertices
+    geometry_free_list_t indices;   // in indices
+
+    geometry_mesh_t *meshes;
+    uint32_t mesh_count;
+    uint32_t mesh_capacity;
+    uint32_t *free_handles;
+    uint32_t free_handle_count;
+
+    geometry_pool_stats_t stats;
+};
+
+//
+// Free list
+//
+
+void geometry_free_list_init(geometry_free_list_t *list, uint32_t capacity)
+{
+    memset(list, 0, sizeof(*list));
+    list->capacity = capacity;
+    list->range_capacity = 64;
+    list->ranges = (geometry_range_t *)malloc(list->range_capacity * sizeof(geometry_range_t));
+    assert(list->ranges);
+    list->ranges[0].offset = 0;
+    list->ranges[0].size = capacity;
+    list->count = capacity ? 1 : 0;
+}
+
+// Smallest free range that holds size, split from its start. Empty
+// allocations take no range and get offset 0, even from a full list.
+uint32_t geometry_free_list_allocate(geometry_free_list_t *list, uint32_t size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    uint32_t best = list->count;
+    for (uint32_t i = 0; i < list->count; ++i)
+    {
+        if (list->ranges[i].size >= size && (best == list->count || list->ranges[i].size < list->ranges[best].size))
+        {
+            best = i;
+            if (list->ranges[i].size == size)
+            {
+                break;
+            }
+        }
+    }
+    if (best == list->count)
+    {
+        return GEOMETRY_NO_SPACE;
+    }
+
+    geometry_range_t *range = &list->ranges[best];
+    uint32_t offset = range->offset;
+    range->offset += size;
+    range->size -= size;
+    if (range->size == 0)
+    {
+        memmove(range, range + 1, (list->count - best - 1) * sizeof(geometry_range_t));
+        --list->count;
+    }
+    list->used += size;
+    return offset;
+}
+
+void geometry_free_list_release(geometry_free_list_t *list, uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    list->used -= size;
+
+    uint32_t at = 0;
+    while (at < list->count && list->ranges[at].offset < offset)
+    {
+        ++at;
+    }
+
+    bool joins_previous = at > 0 && list->ranges[at - 1].offset + list->ranges[at - 1].size == offset;
+    bool joins_next = at < list->count && offset + size == list->ranges[at].offset;
+    if (joins_previous && joins_next)
+    {
+        list->ranges[at - 1].size += size + list->ranges[at].size;
+        memmove(&list->ranges[at], &list->ranges[at + 1], (list->count - at - 1) * sizeof(geometry_range_t));
+        --list->count;
+    }
+    else if (joins_previous)
+    {
+        list->ranges[at - 1].size += size;
+    }
+    else if (joins_next)
+    {
+        list->ranges[at].offset = offset;
+        list->ranges[at].size += size;
+    }
+    else
+    {
+        if (list->count == list->range_capacity)
+        {
+            list->range_capacity *= 2;
+            list->ranges = (geometry_range_t *)realloc(list->ranges, list->range_capacity * sizeof(geometry_range_t));
+            assert(list->ranges);
+        }
+        memmove(&list->ranges[at + 1], &list->ranges[at], (list->count - at) * sizeof(geometry_range_t));
+        list->ranges[at].offset = offset;
+        list->ranges[at].size = size;
+        ++list->count;
+    }
+}
+
+// One free range after everything in use, which the caller has packed to the
+// front.
+void geometry_free_list_reset(geometry_free_list_t *list)
+{
+    list->count = list->used < list->capacity ? 1 : 0;
+    list->ranges[0].offset = list->used;
+    list->ranges[0].size = list->capacity - list->used;
+}
+
+//
+// Pool
+//
+
+uint32_t geometry_pool_create_buffer(uint32_t target, uint32_t size)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    gl_state_bind_buffer(target, buffer);
+    glBufferData(target, size, NULL, GL_STATIC_DRAW);
+    return buffer;
+}
+
+// Points the pool's vertex array at its current buffers.
+void geometry_pool_setup_vertex_array(geometry_pool_t *pool)
+{
+    gl_state_bind_vertex_array(pool->vertex_array);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, pool->vertex_buffer);
+    for (uint32_t i = 0; i < pool->layout.attribute_count; ++i)
+    {
+        const geometry_attribute_t *attribute = &pool->layout.attributes[i];
+        const void *offset = (const void *)(uintptr_t)attribute->offset;
+        glEnableVertexAttribArray(attribute->location);
+        if (attribute->integer)
+        {
+            glVertexAttribIPointer(attribute->location, attribute->size, attribute->type, (GLsizei)pool->layout.stride, offset);
+        }
+        else
+        {
+            glVertexAttribPointer(attribute->location, attribute->size, attribute->type, attribute->normalized, (GLsizei)pool->layout.stride, offset);
+        }
+    }
+    gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pool->index_buffer);
+}
+
+// Capacities are in vertices and indices. index_type is GL_UNSIGNED_SHORT or
+// GL_UNSIGNED_INT; indices are relative to the mesh's first vertex either way.
+geometry_pool_t *geometry_pool_create(const geometry_layout_t *layout, uint32_t vertex_capacity, uint32_t index_capacity, uint32_t index_type)
+{
+    assert(layout->attribute_count <= GEOMETRY_MAX_ATTRIBUTES);
+    assert(index_type == GL_UNSIGNED_SHORT || index_type == GL_UNSIGNED_INT);
+
+    geometry_pool_t *pool = (geometry_pool_t *)calloc(1, sizeof(geometry_pool_t));
+    assert(pool);
+    pool->layout = *layout;
+    pool->index_type = index_type;
+    pool->index_size = index_type == GL_UNSIGNED_INT ? 4 : 2;
+    geometry_free_list_init(&pool->vertices, vertex_capacity);
+    geometry_free_list_init(&pool->indices, index_capacity);
+
+    pool->vertex_buffer = geometry_pool_create_buffer(GL_COPY_WRITE_BUFFER, vertex_capacity * layout->stride);
+    pool->index_buffer = geometry_pool_create_buffer(GL_COPY_WRITE_BUFFER, index_capacity * pool->index_size);
+    glGenVertexArrays(1, &pool->vertex_array);
+    geometry_pool_setup_vertex_array(pool);
+    return pool;
+}
+
+void geometry_pool_destroy(geometry_pool_t *pool)
+{
+    if (gl_state.vertex_array == pool->vertex_array)
+    {
+        gl_state_bind_vertex_array(0);
+    }
+    glDeleteVertexArrays(1, &pool->vertex_array);
+    gl_state_delete_buffer(pool->vertex_buffer);
+    gl_state_delete_buffer(pool->index_buffer);
+    free(pool->vertices.ranges);
+    free(pool->indices.ranges);
+    free(pool->meshes);
+    free(pool->free_handles);
+    free(pool);
+}
+
+inline const geometry_mesh_t *geometry_pool_mesh(const geometry_pool_t *pool, uint32_t handle)
+{
+    assert(handle < pool->mesh_count && pool->meshes[handle].live);
+    return &pool->meshes[handle];
+}
+
+// Copies every live mesh into new buffers, packed from the start in their
+// current order, so all free space becomes one range at the end.
+void geometry_pool_compact(geometry_pool_t *pool)
+{
+    uint32_t stride = pool->layout.stride;
+    uint32_t vertex_buffer = geometry_pool_create_buffer(GL_COPY_WRITE_BUFFER, pool->vertices.capacity * stride);
+    uint32_t index_buffer = geometry_pool_create_buffer(GL_COPY_WRITE_BUFFER, pool->indices.capacity * pool->index_size);
+
+    // Order by old offset so packing keeps meshes loaded together adjacent.
+    uint32_t *order = (uint32_t *)malloc((pool->mesh_count + 1) * sizeof(uint32_t));
+    assert(order);
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < pool->mesh_count; ++i)
+    {
+        if (pool->meshes[i].live)
+        {
+            order[live++] = i;
+        }
+    }
+    for (uint32_t i = 1; i < live; ++i)
+    {
+        uint32_t handle = order[i];
+        uint32_t j = i;
+        for (; j > 0 && pool->meshes[order[j - 1]].vertex_offset > pool->meshes[handle].vertex_offset; --j)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = handle;
+    }
+
+    uint32_t vertex_offset = 0;
+    uint32_t index_offset = 0;
+    for (uint32_t i = 0; i < live; ++i)
+    {
+        geometry_mesh_t *mesh = &pool->meshes[order[i]];
+        gl_state_bind_buffer(GL_COPY_READ_BUFFER, pool->vertex_buffer);
+        gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh->vertex_offset * stride, (GLintptr)vertex_offset * stride, (GLsizeiptr)mesh->vertex_count * stride);
+        gl_state_bind_buffer(GL_COPY_READ_BUFFER, pool->index_buffer);
+        gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, index_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)mesh->index_offset * pool->index_size, (GLintptr)index_offset * pool->index_size, (GLsizeiptr)mesh->index_count * pool->index_size);
+
+        mesh->vertex_offset = vertex_offset;
+        mesh->index_offset = index_offset;
+        vertex_offset += mesh->vertex_count;
+        index_offset += mesh->index_count;
+    }
+    free(order);
+
+    gl_state_delete_buffer(pool->vertex_buffer);
+    gl_state_delete_buffer(pool->index_buffer);
+    pool->vertex_buffer = vertex_buffer;
+    pool->index_buffer = index_buffer;
+    geometry_pool_setup_vertex_array(pool);
+
+    geometry_free_list_reset(&pool->vertices);
+    geometry_free_list_reset(&pool->indices);
+    ++pool->stats.compactions;
+}
+
+void geometry_pool_update_stats(geometry_pool_t *pool)
+{
+    pool->stats.vertex_fragments = pool->vertices.count;
+    pool->stats.index_fragments = pool->indices.count;
+}
+
+// Copies a mesh in and returns its handle, GEOMETRY_NO_MESH when the pool is
+// full even after compacting.
+uint32_t geometry_pool_add(geometry_pool_t *pool, const void *vertices, uint32_t vertex_count, const void *indices, uint32_t index_count)
+{
+    uint32_t vertex_offset = geometry_free_list_allocate(&pool->vertices, vertex_count);
+    uint32_t index_offset = geometry_free_list_allocate(&pool->indices, index_count);
+    if (vertex_offset == GEOMETRY_NO_SPACE || index_offset == GEOMETRY_NO_SPACE)
+    {
+        if (vertex_offset != GEOMETRY_NO_SPACE)
+        {
+            geometry_free_list_release(&pool->vertices, vertex_offset, vertex_count);
+        }
+        if (index_offset != GEOMETRY_NO_SPACE)
+        {
+            geometry_free_list_release(&pool->indices, index_offset, index_count);
+        }
+        if (pool->vertices.capacity - pool->vertices.used < vertex_count || pool->indices.capacity - pool->indices.used < index_count)
+        {
+            return GEOMETRY_NO_MESH;
+        }
+
+        geometry_pool_compact(pool);
+        vertex_offset = geometry_free_list_allocate(&pool->vertices, vertex_count);
+        index_offset = geometry_free_list_allocate(&pool->indices, index_count);
+        assert(vertex_offset != GEOMETRY_NO_SPACE && index_offset != GEOMETRY_NO_SPACE);
+    }
+
+    uint32_t handle;
+    if (pool->free_handle_count)
+    {
+        handle = pool->free_handles[--pool->free_handle_count];
+    }
+    else
+    {
+        if (pool->mesh_count == pool->mesh_capacity)
+        {
+            pool->mesh_capacity = pool->mesh_capacity ? pool->mesh_capacity * 2 : 256;
+            pool->meshes = (geometry_mesh_t *)realloc(pool->meshes, pool->mesh_capacity * sizeof(geometry_mesh_t));
+            pool->free_handles = (uint32_t *)realloc(pool->free_handles, pool->mesh_capacity * sizeof(uint32_t));
+            assert(pool->meshes && pool->free_handles);
+        }
+        handle = pool->mesh_count++;
+    }
+
+    geometry_mesh_t *mesh = &pool->meshes[handle];
+    mesh->vertex_offset = vertex_offset;
+    mesh->vertex_count = vertex_count;
+    mesh->index_offset = index_offset;
+    mesh->index_count = index_count;
+    mesh->live = true;
+
+    uint32_t stride = pool->layout.stride;
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pool->vertex_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)vertex_offset * stride, (GLsizeiptr)vertex_count * stride, vertices);
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pool->index_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)index_offset * pool->index_size, (GLsizeiptr)index_count * pool->index_size, indices);
+
+    ++pool->stats.meshes;
+    geometry_pool_update_stats(pool);
+    return handle;
+}
+
+void geometry_pool_remove(geometry_pool_t *pool, uint32_t handle)
+{
+    assert(handle < pool->mesh_count && pool->meshes[handle].live);
+    geometry_mesh_t *mesh = &pool->meshes[handle];
+    geometry_free_list_release(&pool->vertices, mesh->vertex_offset, mesh->vertex_count);
+    geometry_free_list_release(&pool->indices, mesh->index_offset, mesh->index_count);
+    mesh->live = false;
+    pool->free_handles[pool->free_handle_count++] = handle;
+
+    --pool->stats.meshes;
+    geometry_pool_update_stats(pool);
+}
+
+inline void geometry_pool_bind(const geometry_pool_t *pool)
+{
+    gl_state_bind_vertex_array(pool->vertex_array);
+}
+
+void geometry_pool_draw(const geometry_pool_t *pool, uint32_t mode, uint32_t handle, int32_t instance_count)
+{
+    const geometry_mesh_t *mesh = geometry_pool_mesh(pool, handle);
+    geometry_pool_bind(pool);
+    glDrawElementsInstancedBaseVertex(mode,
+        (GLsizei)mesh->index_count,
+        pool->index_type,
+        (const void *)(uintptr_t)(mesh->index_offset * pool->index_size),
+        instance_count,
+        (GLint)mesh->vertex_offset);
+}
+
+// Every mesh in handles with one call per 256.
+void geometry_pool_draw_many(const geometry_pool_t *pool, uint32_t mode, const uint32_t *handles, uint32_t count)
+{
+    geometry_pool_bind(pool);
+
+    GLsizei counts[256];
+    const void *offsets[256];
+    GLint base_vertices[256];
+    for (uint32_t begin = 0; begin < count; begin += 256)
+    {
+        uint32_t batch = count - begin < 256 ? count - begin : 256;
+        for (uint32_t i = 0; i < batch; ++i)
+        {
+            const geometry_mesh_t *mesh = geometry_pool_mesh(pool, handles[begin + i]);
+            counts[i] = (GLsizei)mesh->index_count;
+            offsets[i] = (const void *)(uintptr_t)(mesh->index_offset * pool->index_size);
+            base_vertices[i] = (GLint)mesh->vertex_offset;
+        }
+        glMultiDrawElementsBaseVertex(mode, counts, pool->index_type, offsets, (GLsizei)batch, base_vertices);
+    }
+}
@@ -0,0 +1,779 @@
+#pragma once
+
+// Generated by generate_gl_dispatch.py from glext.h and gl_functions.txt, do
+// not edit by hand.
+//
+// All entry points live in one table. Required ones are resolved in a single
+// pass by gl_dispatch_load(), optional ones start out as stubs that resolve
+// themselves on first call. The loader is a plain function pointer, so the
+// same table works with wglGetProcAddress, glXGetProcAddress or
+// eglGetProcAddress. Include after <GL/gl.h> and glext.h.
+//
+// With GL_VALIDATION defined, which Debug builds get unless GL_NO_VALIDATION
+// is, every call first records its entry point and source location for
+// gl_validation.h. Without it the macros are plain table lookups.
+
+#include <cassert>
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(_DEBUG) && !defined(GL_NO_VALIDATION) && !defined(GL_VALIDATION)
+#define GL_VALIDATION
+#endif
+
+#ifdef GL_VALIDATION
+#include <atomic>
+#endif
+
+typedef void *gl_get_proc_address_t(const char *name);
+
+enum gl_dispatch_index_t
+{
+    GL_DISPATCH_glCreateShader,
+    GL_DISPATCH_glShaderSource,
+    GL_DISPATCH_glCompileShader,
+    GL_DISPATCH_glGetShaderiv,
+    GL_DISPATCH_glGetShaderInfoLog,
+    GL_DISPATCH_glDeleteShader,
+    GL_DISPATCH_glCreateProgram,
+    GL_DISPATCH_glAttachShader,
+    GL_DISPATCH_glDetachShader,
+    GL_DISPATCH_glLinkProgram,
+    GL_DISPATCH_glGetProgramiv,
+    GL_DISPATCH_glGetProgramInfoLog,
+    GL_DISPATCH_glUseProgram,
+    GL_DISPATCH_glDeleteProgram,
+    GL_DISPATCH_glGetUniformLocation,
+    GL_DISPATCH_glUniform1i,
+    GL_DISPATCH_glUniform1ui,
+    GL_DISPATCH_glUniform1f,
+    GL_DISPATCH_glUniform2fv,
+    GL_DISPATCH_glUniform3fv,
+    GL_DISPATCH_glUniform4fv,
+    GL_DISPATCH_glUniformMatrix4fv,
+    GL_DISPATCH_glGetUniformBlockIndex,
+    GL_DISPATCH_glGetActiveUniformBlockiv,
+    GL_DISPATCH_glUniformBlockBinding,
+    GL_DISPATCH_glGenVertexArrays,
+    GL_DISPATCH_glBindVertexArray,
+    GL_DISPATCH_glDeleteVertexArrays,
+    GL_DISPATCH_glEnableVertexAttribArray,
+    GL_DISPATCH_glDisableVertexAttribArray,
+    GL_DISPATCH_glVertexAttribPointer,
+    GL_DISPATCH_glVertexAttribIPointer,
+    GL_DISPATCH_glVertexAttribDivisor,
+    GL_DISPATCH_glGenBuffers,
+    GL_DISPATCH_glDeleteBuffers,
+    GL_DISPATCH_glBindBuffer,
+    GL_DISPATCH_glBindBufferBase,
+    GL_DISPATCH_glBindBufferRange,
+    GL_DISPATCH_glBufferData,
+    GL_DISPATCH_glBufferSubData,
+    GL_DISPATCH_glMapBufferRange,
+    GL_DISPATCH_glUnmapBuffer,
+    GL_DISPATCH_glFenceSync,
+    GL_DISPATCH_glClientWaitSync,
+    GL_DISPATCH_glDeleteSync,
+    GL_DISPATCH_glGenQueries,
+    GL_DISPATCH_glDeleteQueries,
+    GL_DISPATCH_glBeginQuery,
+    GL_DISPATCH_glEndQuery,
+    GL_DISPATCH_glGetQueryObjectiv,
+    GL_DISPATCH_glGetStringi,
+    GL_DISPATCH_glDrawArraysInstanced,
+    GL_DISPATCH_glTexBuffer,
+    GL_DISPATCH_glDrawElementsInstancedBaseVertex,
+    GL_DISPATCH_glMultiDrawElementsBaseVertex,
+    GL_DISPATCH_glCopyBufferSubData,
+    GL_DISPATCH_glActiveTexture,
+    GL_DISPATCH_glGenerateMipmap,
+    GL_DISPATCH_glBindSampler,
+    GL_DISPATCH_glBlendFuncSeparate,
+    GL_DISPATCH_glBlendEquationSeparate,
+    GL_DISPATCH_glGenFramebuffers,
+    GL_DISPATCH_glDeleteFramebuffers,
+    GL_DISPATCH_glBindFramebuffer,
+    GL_DISPATCH_glFramebufferRenderbuffer,
+    GL_DISPATCH_glFramebufferTexture2D,
+    GL_DISPATCH_glCheckFramebufferStatus,
+    GL_DISPATCH_glGenRenderbuffers,
+    GL_DISPATCH_glDeleteRenderbuffers,
+    GL_DISPATCH_glBindRenderbuffer,
+    GL_DISPATCH_glRenderbufferStorage,
+    GL_DISPATCH_glBufferStorage,
+    GL_DISPATCH_glMultiDrawElementsIndirect,
+    GL_DISPATCH_glMultiDrawElementsIndirectCount,
+    GL_DISPATCH_glMultiDrawElementsIndirectCountARB,
+    GL_DISPATCH_glDispatchCompute,
+    GL_DISPATCH_glMemoryBarrier,
+    GL_DISPATCH_glTexStorage2D,
+    GL_DISPATCH_glDrawElementsInstancedBaseVertexBaseInstance,
+    GL_DISPATCH_glObjectLabel,
+    GL_DISPATCH_glPushDebugGroup,
+    GL_DISPATCH_glPopDebugGroup,
+    GL_DISPATCH_glDebugMessageCallback,
+    GL_DISPATCH_glDebugMessageControl,
+    GL_DISPATCH_glGetProgramBinary,
+    GL_DISPATCH_glProgramBinary,
+    GL_DISPATCH_glProgramParameteri,
+    GL_DISPATCH_glMaxShaderCompilerThreadsKHR,
+    GL_DISPATCH_glMaxShaderCompilerThreadsARB,
+    GL_DISPATCH_glQueryCounter,
+    GL_DISPATCH_glGetQueryObjectui64v,
+    GL_DISPATCH_COUNT
+};
+
+#define GL_DISPATCH_REQUIRED_COUNT 71
+
+typedef GLuint (APIENTRY *gl_dispatch_glCreateShader_t)(GLenum type);
+typedef void (APIENTRY *gl_dispatch_glShaderSource_t)(GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length);
+typedef void (APIENTRY *gl_dispatch_glCompileShader_t)(GLuint shader);
+typedef void (APIENTRY *gl_dispatch_glGetShaderiv_t)(GLuint shader, GLenum pname, GLint *params);
+typedef void (APIENTRY *gl_dispatch_glGetShaderInfoLog_t)(GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog);
+typedef void (APIENTRY *gl_dispatch_glDeleteShader_t)(GLuint shader);
+typedef GLuint (APIENTRY *gl_dispatch_glCreateProgram_t)();
+typedef void (APIENTRY *gl_dispatch_glAttachShader_t)(GLuint program, GLuint shader);
+typedef void (APIENTRY *gl_dispatch_glDetachShader_t)(GLuint program, GLuint shader);
+typedef void (APIENTRY *gl_dispatch_glLinkProgram_t)(GLuint program);
+typedef void (APIENTRY *gl_dispatch_glGetProgramiv_t)(GLuint program, GLenum pname, GLint *params);
+typedef void (APIENTRY *gl_dispatch_glGetProgramInfoLog_t)(GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog);
+typedef void (APIENTRY *gl_dispatch_glUseProgram_t)(GLuint program);
+typedef void (APIENTRY *gl_dispatch_glDeleteProgram_t)(GLuint program);
+typedef GLint (APIENTRY *gl_dispatch_glGetUniformLocation_t)(GLuint program, const GLchar *name);
+typedef void (APIENTRY *gl_dispatch_glUniform1i_t)(GLint location, GLint v0);
+typedef void (APIENTRY *gl_dispatch_glUniform1ui_t)(GLint location, GLuint v0);
+typedef void (APIENTRY *gl_dispatch_glUniform1f_t)(GLint location, GLfloat v0);
+typedef void (APIENTRY *gl_dispatch_glUniform2fv_t)(GLint location, GLsizei count, const GLfloat *value);
+typedef void (APIENTRY *gl_dispatch_glUniform3fv_t)(GLint location, GLsizei count, const GLfloat *value);
+typedef void (APIENTRY *gl_dispatch_glUniform4fv_t)(GLint location, GLsizei count, const GLfloat *value);
+typedef void (APIENTRY *gl_dispatch_glUniformMatrix4fv_t)(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+typedef GLuint (APIENTRY *gl_dispatch_glGetUniformBlockIndex_t)(GLuint program, const GLchar *uniformBlockName);
+typedef void (APIENTRY *gl_dispatch_glGetActiveUniformBlockiv_t)(GLuint program, GLuint uniformBlockIndex, GLenum pname, GLint *params);
+typedef void (APIENTRY *gl_dispatch_glUniformBlockBinding_t)(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+typedef void (APIENTRY *gl_dispatch_glGenVertexArrays_t)(GLsizei n, GLuint *arrays);
+typedef void (APIENTRY *gl_dispatch_glBindVertexArray_t)(GLuint array);
+typedef void (APIENTRY *gl_dispatch_glDeleteVertexArrays_t)(GLsizei n, const GLuint *arrays);
+typedef void (APIENTRY *gl_dispatch_glEnableVertexAttribArray_t)(GLuint index);
+typedef void (APIENTRY *gl_dispatch_glDisableVertexAttribArray_t)(GLuint index);
+typedef void (APIENTRY *gl_dispatch_glVertexAttribPointer_t)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+typedef void (APIENTRY *gl_dispatch_glVertexAttribIPointer_t)(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer);
+typedef void (APIENTRY *gl_dispatch_glVertexAttribDivisor_t)(GLuint index, GLuint divisor);
+typedef void (APIENTRY *gl_dispatch_glGenBuffers_t)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *gl_dispatch_glDeleteBuffers_t)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *gl_dispatch_glBindBuffer_t)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *gl_dispatch_glBindBufferBase_t)(GLenum target, GLuint index, GLuint buffer);
+typedef void (APIENTRY *gl_dispatch_glBindBufferRange_t)(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+typedef void (APIENTRY *gl_dispatch_glBufferData_t)(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+typedef void (APIENTRY *gl_dispatch_glBufferSubData_t)(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+typedef void * (APIENTRY *gl_dispatch_glMapBufferRange_t)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRY *gl_dispatch_glUnmapBuffer_t)(GLenum target);
+typedef GLsync (APIENTRY *gl_dispatch_glFenceSync_t)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY *gl_dispatch_glClientWaitSync_t)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (APIENTRY *gl_dispatch_glDeleteSync_t)(GLsync sync);
+typedef void (APIENTRY *gl_dispatch_glGenQueries_t)(GLsizei n, GLuint *ids);
+typedef void (APIENTRY *gl_dispatch_glDeleteQueries_t)(GLsizei n, const GLuint *ids);
+typedef void (APIENTRY *gl_dispatch_glBeginQuery_t)(GLenum target, GLuint id);
+typedef void (APIENTRY *gl_dispatch_glEndQuery_t)(GLenum target);
+typedef void (APIENTRY *gl_dispatch_glGetQueryObjectiv_t)(GLuint id, GLenum pname, GLint *params);
+typedef const GLubyte * (APIENTRY *gl_dispatch_glGetStringi_t)(GLenum name, GLuint index);
+typedef void (APIENTRY *gl_dispatch_glDrawArraysInstanced_t)(GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+typedef void (APIENTRY *gl_dispatch_glTexBuffer_t)(GLenum target, GLenum internalformat, GLuint buffer);
+typedef void (APIENTRY *gl_dispatch_glDrawElementsInstancedBaseVertex_t)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex);
+typedef void (APIENTRY *gl_dispatch_glMultiDrawElementsBaseVertex_t)(GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei drawcount, const GLint *basevertex);
+typedef void (APIENTRY *gl_dispatch_glCopyBufferSubData_t)(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+typedef void (APIENTRY *gl_dispatch_glActiveTexture_t)(GLenum texture);
+typedef void (APIENTRY *gl_dispatch_glGenerateMipmap_t)(GLenum target);
+typedef void (APIENTRY *gl_dispatch_glBindSampler_t)(GLuint unit, GLuint sampler);
+typedef void (APIENTRY *gl_dispatch_glBlendFuncSeparate_t)(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha);
+typedef void (APIENTRY *gl_dispatch_glBlendEquationSeparate_t)(GLenum modeRGB, GLenum modeAlpha);
+typedef void (APIENTRY *gl_dispatch_glGenFramebuffers_t)(GLsizei n, GLuint *framebuffers);
+typedef void (APIENTRY *gl_dispatch_glDeleteFramebuffers_t)(GLsizei n, const GLuint *framebuffers);
+typedef void (APIENTRY *gl_dispatch_glBindFramebuffer_t)(GLenum target, GLuint framebuffer);
+typedef void (APIENTRY *gl_dispatch_glFramebufferRenderbuffer_t)(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+typedef void (APIENTRY *gl_dispatch_glFramebufferTexture2D_t)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum (APIENTRY *gl_dispatch_glCheckFramebufferStatus_t)(GLenum target);
+typedef void (APIENTRY *gl_dispatch_glGenRenderbuffers_t)(GLsizei n, GLuint *renderbuffers);
+typedef void (APIENTRY *gl_dispatch_glDeleteRenderbuffers_t)(GLsizei n, const GLuint *renderbuffers);
+typedef void (APIENTRY *gl_dispatch_glBindRenderbuffer_t)(GLenum target, GLuint renderbuffer);
+typedef void (APIENTRY *gl_dispatch_glRenderbufferStorage_t)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRY *gl_dispatch_glBufferStorage_t)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRY *gl_dispatch_glMultiDrawElementsIndirect_t)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRY *gl_dispatch_glMultiDrawElementsIndirectCount_t)(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+typedef void (APIENTRY *gl_dispatch_glMultiDrawElementsIndirectCountARB_t)(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+typedef void (APIENTRY *gl_dispatch_glDispatchCompute_t)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRY *gl_dispatch_glMemoryBarrier_t)(GLbitfield barriers);
+typedef void (APIENTRY *gl_dispatch_glTexStorage2D_t)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRY *gl_dispatch_glDrawElementsInstancedBaseVertexBaseInstance_t)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex, GLuint baseinstance);
+typedef void (APIENTRY *gl_dispatch_glObjectLabel_t)(GLenum identifier, GLuint name, GLsizei length, const GLchar *label);
+typedef void (APIENTRY *gl_dispatch_glPushDebugGroup_t)(GLenum source, GLuint id, GLsizei length, const GLchar *message);
+typedef void (APIENTRY *gl_dispatch_glPopDebugGroup_t)();
+typedef void (APIENTRY *gl_dispatch_glDebugMessageCallback_t)(GLDEBUGPROC callback, const void *userParam);
+typedef void (APIENTRY *gl_dispatch_glDebugMessageControl_t)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled);
+typedef void (APIENTRY *gl_dispatch_glGetProgramBinary_t)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRY *gl_dispatch_glProgramBinary_t)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRY *gl_dispatch_glProgramParameteri_t)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRY *gl_dispatch_glMaxShaderCompilerThreadsKHR_t)(GLuint count);
+typedef void (APIENTRY *gl_dispatch_glMaxShaderCompilerThreadsARB_t)(GLuint count);
+typedef void (APIENTRY *gl_dispatch_glQueryCounter_t)(GLuint id, GLenum target);
+typedef void (APIENTRY *gl_dispatch_glGetQueryObjectui64v_t)(GLuint id, GLenum pname, GLuint64 *params);
+
+static const char gl_dispatch_names[] =
+    "glCreateShader\0"
+    "glShaderSource\0"
+    "glCompileShader\0"
+    "glGetShaderiv\0"
+    "glGetShaderInfoLog\0"
+    "glDeleteShader\0"
+    "glCreateProgram\0"
+    "glAttachShader\0"
+    "glDetachShader\0"
+    "glLinkProgram\0"
+    "glGetProgramiv\0"
+    "glGetProgramInfoLog\0"
+    "glUseProgram\0"
+    "glDeleteProgram\0"
+    "glGetUniformLocation\0"
+    "glUniform1i\0"
+    "glUniform1ui\0"
+    "glUniform1f\0"
+    "glUniform2fv\0"
+    "glUniform3fv\0"
+    "glUniform4fv\0"
+    "glUniformMatrix4fv\0"
+    "glGetUniformBlockIndex\0"
+    "glGetActiveUniformBlockiv\0"
+    "glUniformBlockBinding\0"
+    "glGenVertexArrays\0"
+    "glBindVertexArray\0"
+    "glDeleteVertexArrays\0"
+    "glEnableVertexAttribArray\0"
+    "glDisableVertexAttribArray\0"
+    "glVertexAttribPointer\0"
+    "glVertexAttribIPointer\0"
+    "glVertexAttribDivisor\0"
+    "glGenBuffers\0"
+    "glDeleteBuffers\0"
+    "glBindBuffer\0"
+    "glBindBufferBase\0"
+    "glBindBufferRange\0"
+    "glBufferData\0"
+    "glBufferSubData\0"
+    "glMapBufferRange\0"
+    "glUnmapBuffer\0"
+    "glFenceSync\0"
+    "glClientWaitSync\0"
+    "glDeleteSync\0"
+    "glGenQueries\0"
+    "glDeleteQueries\0"
+    "glBeginQuery\0"
+    "glEndQuery\0"
+    "glGetQueryObjectiv\0"
+    "glGetStringi\0"
+    "glDrawArraysInstanced\0"
+    "glTexBuffer\0"
+    "glDrawElementsInstancedBaseVertex\0"
+    "glMultiDrawElementsBaseVertex\0"
+    "glCopyBufferSubData\0"
+    "glActiveTexture\0"
+    "glGenerateMipmap\0"
+    "glBindSampler\0"
+    "glBlendFuncSeparate\0"
+    "glBlendEquationSeparate\0"
+    "glGenFramebuffers\0"
+    "glDeleteFramebuffers\0"
+    "glBindFramebuffer\0"
+    "glFramebufferRenderbuffer\0"
+    "glFramebufferTexture2D\0"
+    "glCheckFramebufferStatus\0"
+    "glGenRenderbuffers\0"
+    "glDeleteRenderbuffers\0"
+    "glBindRenderbuffer\0"
+    "glRenderbufferStorage\0"
+    "glBufferStorage\0"
+    "glMultiDrawElementsIndirect\0"
+    "glMultiDrawElementsIndirectCount\0"
+    "glMultiDrawElementsIndirectCountARB\0"
+    "glDispatchCompute\0"
+    "glMemoryBarrier\0"
+    "glTexStorage2D\0"
+    "glDrawElementsInstancedBaseVertexBaseInstance\0"
+    "glObjectLabel\0"
+    "glPushDebugGroup\0"
+    "glPopDebugGroup\0"
+    "glDebugMessageCallback\0"
+    "glDebugMessageControl\0"
+    "glGetProgramBinary\0"
+    "glProgramBinary\0"
+    "glProgramParameteri\0"
+    "glMaxShaderCompilerThreadsKHR\0"
+    "glMaxShaderCompilerThreadsARB\0"
+    "glQueryCounter\0"
+    "glGetQueryObjectui64v\0"
+    ;
+
+static const uint16_t gl_dispatch_name_offsets[GL_DISPATCH_COUNT + 1] =
+{
+    0, 15, 30, 46, 60, 79, 94, 110,
+    125, 140, 154, 169, 189, 202, 218, 239,
+    251, 264, 276, 289, 302, 315, 334, 357,
+    383, 405, 423, 441, 462, 488, 515, 537,
+    560, 582, 595, 611, 624, 641, 659, 672,
+    688, 705, 719, 731, 748, 761, 774, 790,
+    803, 814, 833, 846, 868, 880, 914, 944,
+    964, 980, 997, 1011, 1031, 1055, 1073, 1094,
+    1112, 1138, 1161, 1186, 1205, 1227, 1246, 1268,
+    1284, 1312, 1345, 1381, 1399, 1415, 1430, 1476,
+    1490, 1507, 1523, 1546, 1568, 1587, 1603, 1623,
+    1653, 1683, 1698,
+    0
+};
+
+struct gl_dispatch_t
+{
+    void *procs[GL_DISPATCH_COUNT];
+    gl_get_proc_address_t *get_proc_address;
+};
+
+gl_dispatch_t gl_dispatch;
+
+inline const char *gl_dispatch_name(uint32_t index)
+{
+    return gl_dispatch_names + gl_dispatch_name_offsets[index];
+}
+
+// Looks up an optional entry point and patches the table. Racing threads
+// store the same pointer, so no lock is needed.
+void *gl_dispatch_resolve(uint32_t index)
+{
+    assert(index >= GL_DISPATCH_REQUIRED_COUNT && gl_dispatch.get_proc_address);
+    void *proc = gl_dispatch.get_proc_address(gl_dispatch_name(index));
+    if (proc)
+    {
+        gl_dispatch.procs[index] = proc;
+    }
+    return proc;
+}
+
+static void APIENTRY gl_dispatch_stub_glBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glBufferStorage);
+    assert(proc && "glBufferStorage is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glBufferStorage_t)proc)(target, size, data, flags);
+}
+
+static void APIENTRY gl_dispatch_stub_glMultiDrawElementsIndirect(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glMultiDrawElementsIndirect);
+    assert(proc && "glMultiDrawElementsIndirect is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glMultiDrawElementsIndirect_t)proc)(mode, type, indirect, drawcount, stride);
+}
+
+static void APIENTRY gl_dispatch_stub_glMultiDrawElementsIndirectCount(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glMultiDrawElementsIndirectCount);
+    assert(proc && "glMultiDrawElementsIndirectCount is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glMultiDrawElementsIndirectCount_t)proc)(mode, type, indirect, drawcount, maxdrawcount, stride);
+}
+
+static void APIENTRY gl_dispatch_stub_glMultiDrawElementsIndirectCountARB(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glMultiDrawElementsIndirectCountARB);
+    assert(proc && "glMultiDrawElementsIndirectCountARB is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glMultiDrawElementsIndirectCountARB_t)proc)(mode, type, indirect, drawcount, maxdrawcount, stride);
+}
+
+static void APIENTRY gl_dispatch_stub_glDispatchCompute(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glDispatchCompute);
+    assert(proc && "glDispatchCompute is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glDispatchCompute_t)proc)(num_groups_x, num_groups_y, num_groups_z);
+}
+
+static void APIENTRY gl_dispatch_stub_glMemoryBarrier(GLbitfield barriers)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glMemoryBarrier);
+    assert(proc && "glMemoryBarrier is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glMemoryBarrier_t)proc)(barriers);
+}
+
+static void APIENTRY gl_dispatch_stub_glTexStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glTexStorage2D);
+    assert(proc && "glTexStorage2D is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glTexStorage2D_t)proc)(target, levels, internalformat, width, height);
+}
+
+static void APIENTRY gl_dispatch_stub_glDrawElementsInstancedBaseVertexBaseInstance(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex, GLuint baseinstance)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glDrawElementsInstancedBaseVertexBaseInstance);
+    assert(proc && "glDrawElementsInstancedBaseVertexBaseInstance is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glDrawElementsInstancedBaseVertexBaseInstance_t)proc)(mode, count, type, indices, instancecount, basevertex, baseinstance);
+}
+
+static void APIENTRY gl_dispatch_stub_glObjectLabel(GLenum identifier, GLuint name, GLsizei length, const GLchar *label)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glObjectLabel);
+    assert(proc && "glObjectLabel is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glObjectLabel_t)proc)(identifier, name, length, label);
+}
+
+static void APIENTRY gl_dispatch_stub_glPushDebugGroup(GLenum source, GLuint id, GLsizei length, const GLchar *message)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glPushDebugGroup);
+    assert(proc && "glPushDebugGroup is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glPushDebugGroup_t)proc)(source, id, length, message);
+}
+
+static void APIENTRY gl_dispatch_stub_glPopDebugGroup()
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glPopDebugGroup);
+    assert(proc && "glPopDebugGroup is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glPopDebugGroup_t)proc)();
+}
+
+static void APIENTRY gl_dispatch_stub_glDebugMessageCallback(GLDEBUGPROC callback, const void *userParam)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glDebugMessageCallback);
+    assert(proc && "glDebugMessageCallback is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glDebugMessageCallback_t)proc)(callback, userParam);
+}
+
+static void APIENTRY gl_dispatch_stub_glDebugMessageControl(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glDebugMessageControl);
+    assert(proc && "glDebugMessageControl is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glDebugMessageControl_t)proc)(source, type, severity, count, ids, enabled);
+}
+
+static void APIENTRY gl_dispatch_stub_glGetProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glGetProgramBinary);
+    assert(proc && "glGetProgramBinary is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glGetProgramBinary_t)proc)(program, bufSize, length, binaryFormat, binary);
+}
+
+static void APIENTRY gl_dispatch_stub_glProgramBinary(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glProgramBinary);
+    assert(proc && "glProgramBinary is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glProgramBinary_t)proc)(program, binaryFormat, binary, length);
+}
+
+static void APIENTRY gl_dispatch_stub_glProgramParameteri(GLuint program, GLenum pname, GLint value)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glProgramParameteri);
+    assert(proc && "glProgramParameteri is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glProgramParameteri_t)proc)(program, pname, value);
+}
+
+static void APIENTRY gl_dispatch_stub_glMaxShaderCompilerThreadsKHR(GLuint count)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glMaxShaderCompilerThreadsKHR);
+    assert(proc && "glMaxShaderCompilerThreadsKHR is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glMaxShaderCompilerThreadsKHR_t)proc)(count);
+}
+
+static void APIENTRY gl_dispatch_stub_glMaxShaderCompilerThreadsARB(GLuint count)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glMaxShaderCompilerThreadsARB);
+    assert(proc && "glMaxShaderCompilerThreadsARB is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glMaxShaderCompilerThreadsARB_t)proc)(count);
+}
+
+static void APIENTRY gl_dispatch_stub_glQueryCounter(GLuint id, GLenum target)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glQueryCounter);
+    assert(proc && "glQueryCounter is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glQueryCounter_t)proc)(id, target);
+}
+
+static void APIENTRY gl_dispatch_stub_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params)
+{
+    void *proc = gl_dispatch_resolve(GL_DISPATCH_glGetQueryObjectui64v);
+    assert(proc && "glGetQueryObjectui64v is not available, check gl_dispatch_available() first");
+    return ((gl_dispatch_glGetQueryObjectui64v_t)proc)(id, pname, params);
+}
+
+static void *const gl_dispatch_stubs[GL_DISPATCH_COUNT - GL_DISPATCH_REQUIRED_COUNT + 1] =
+{
+    (void *)gl_dispatch_stub_glBufferStorage,
+    (void *)gl_dispatch_stub_glMultiDrawElementsIndirect,
+    (void *)gl_dispatch_stub_glMultiDrawElementsIndirectCount,
+    (void *)gl_dispatch_stub_glMultiDrawElementsIndirectCountARB,
+    (void *)gl_dispatch_stub_glDispatchCompute,
+    (void *)gl_dispatch_stub_glMemoryBarrier,
+    (void *)gl_dispatch_stub_glTexStorage2D,
+    (void *)gl_dispatch_stub_glDrawElementsInstancedBaseVertexBaseInstance,
+    (void *)gl_dispatch_stub_glObjectLabel,
+    (void *)gl_dispatch_stub_glPushDebugGroup,
+    (void *)gl_dispatch_stub_glPopDebugGroup,
+    (void *)gl_dispatch_stub_glDebugMessageCallback,
+    (void *)gl_dispatch_stub_glDebugMessageControl,
+    (void *)gl_dispatch_stub_glGetProgramBinary,
+    (void *)gl_dispatch_stub_glProgramBinary,
+    (void *)gl_dispatch_stub_glProgramParameteri,
+    (void *)gl_dispatch_stub_glMaxShaderCompilerThreadsKHR,
+    (void *)gl_dispatch_stub_glMaxShaderCompilerThreadsARB,
+    (void *)gl_dispatch_stub_glQueryCounter,
+    (void *)gl_dispatch_stub_glGetQueryObjectui64v,
+    0
+};
+
+// Resolves every required entry point, reporting each missing one. Optional
+// entries are not looked up until they are first called.
+bool gl_dispatch_load(gl_get_proc_address_t *get_proc_address)
+{
+    gl_dispatch.get_proc_address = get_proc_address;
+
+    bool complete = true;
+    for (uint32_t i = 0; i < GL_DISPATCH_REQUIRED_COUNT; ++i)
+    {
+        gl_dispatch.procs[i] = get_proc_address(gl_dispatch_name(i));
+        if (!gl_dispatch.procs[i])
+        {
+            fprintf(stderr, "missing required GL function %s\n", gl_dispatch_name(i));
+            complete = false;
+        }
+    }
+    for (uint32_t i = GL_DISPATCH_REQUIRED_COUNT; i < GL_DISPATCH_COUNT; ++i)
+    {
+        gl_dispatch.procs[i] = gl_dispatch_stubs[i - GL_DISPATCH_REQUIRED_COUNT];
+    }
+    return complete;
+}
+
+// Whether an entry point can be called, resolving it if it is still a stub.
+inline bool gl_dispatch_available(uint32_t index)
+{
+    if (index < GL_DISPATCH_REQUIRED_COUNT || gl_dispatch.procs[index] != gl_dispatch_stubs[index - GL_DISPATCH_REQUIRED_COUNT])
+    {
+        return gl_dispatch.procs[index] != 0;
+    }
+    return gl_dispatch_resolve(index) != 0;
+}
+
+// Installs the debug message callback on the current context, see
+// gl_validation.h. Declared here so the platform backends can call it.
+bool gl_validation_initialize(bool synchronous);
+
+#ifdef GL_VALIDATION
+
+#define GL_VALIDATION_HISTORY 16    // power of two
+
+// The debug callback may run on a driver thread while calls are still being
+// recorded, hence the atomics. Relaxed stores are plain moves on x86.
+struct gl_validation_call_t
+{
+    std::atomic<const char *> file;
+    std::atomic<uint32_t> line;
+    std::atomic<uint32_t> function;
+};
+
+// The latest calls made on one thread.
+struct gl_validation_history_t
+{
+    gl_validation_call_t calls[GL_VALIDATION_HISTORY];
+    std::atomic<uint32_t> count;
+};
+
+std::atomic<uint32_t> gl_validation_counts[GL_DISPATCH_COUNT];
+thread_local gl_validation_history_t gl_validation_history;
+
+inline void gl_validation_record(uint32_t function, const char *file, uint32_t line)
+{
+    gl_validation_counts[function].fetch_add(1, std::memory_order_relaxed);
+    uint32_t count = gl_validation_history.count.load(std::memory_order_relaxed);
+    gl_validation_call_t *call = &gl_validation_history.calls[count & (GL_VALIDATION_HISTORY - 1)];
+    call->file.store(file, std::memory_order_relaxed);
+    call->line.store(line, std::memory_order_relaxed);
+    call->function.store(function, std::memory_order_relaxed);
+    gl_validation_history.count.store(count + 1, std::memory_order_release);
+}
+
+#define glCreateShader (gl_validation_record(GL_DISPATCH_glCreateShader, __FILE__, __LINE__), (gl_dispatch_glCreateShader_t)gl_dispatch.procs[GL_DISPATCH_glCreateShader])
+#define glShaderSource (gl_validation_record(GL_DISPATCH_glShaderSource, __FILE__, __LINE__), (gl_dispatch_glShaderSource_t)gl_dispatch.procs[GL_DISPATCH_glShaderSource])
+#define glCompileShader (gl_validation_record(GL_DISPATCH_glCompileShader, __FILE__, __LINE__), (gl_dispatch_glCompileShader_t)gl_dispatch.procs[GL_DISPATCH_glCompileShader])
+#define glGetShaderiv (gl_validation_record(GL_DISPATCH_glGetShaderiv, __FILE__, __LINE__), (gl_dispatch_glGetShaderiv_t)gl_dispatch.procs[GL_DISPATCH_glGetShaderiv])
+#define glGetShaderInfoLog (gl_validation_record(GL_DISPATCH_glGetShaderInfoLog, __FILE__, __LINE__), (gl_dispatch_glGetShaderInfoLog_t)gl_dispatch.procs[GL_DISPATCH_glGetShaderInfoLog])
+#define glDeleteShader (gl_validation_record(GL_DISPATCH_glDeleteShader, __FILE__, __LINE__), (gl_dispatch_glDeleteShader_t)gl_dispatch.procs[GL_DISPATCH_glDeleteShader])
+#define glCreateProgram (gl_validation_record(GL_DISPATCH_glCreateProgram, __FILE__, __LINE__), (gl_dispatch_glCreateProgram_t)gl_dispatch.procs[GL_DISPATCH_glCreateProgram])
+#define glAttachShader (gl_validation_record(GL_DISPATCH_glAttachShader, __FILE__, __LINE__), (gl_dispatch_glAttachShader_t)gl_dispatch.procs[GL_DISPATCH_glAttachShader])
+#define glDetachShader (gl_validation_record(GL_DISPATCH_glDetachShader, __FILE__, __LINE__), (gl_dispatch_glDetachShader_t)gl_dispatch.procs[GL_DISPATCH_glDetachShader])
+#define glLinkProgram (gl_validation_record(GL_DISPATCH_glLinkProgram, __FILE__, __LINE__), (gl_dispatch_glLinkProgram_t)gl_dispatch.procs[GL_DISPATCH_glLinkProgram])
+#define glGetProgramiv (gl_validation_record(GL_DISPATCH_glGetProgramiv, __FILE__, __LINE__), (gl_dispatch_glGetProgramiv_t)gl_dispatch.procs[GL_DISPATCH_glGetProgramiv])
+#define glGetProgramInfoLog (gl_validation_record(GL_DISPATCH_glGetProgramInfoLog, __FILE__, __LINE__), (gl_dispatch_glGetProgramInfoLog_t)gl_dispatch.procs[GL_DISPATCH_glGetProgramInfoLog])
+#define glUseProgram (gl_validation_record(GL_DISPATCH_glUseProgram, __FILE__, __LINE__), (gl_dispatch_glUseProgram_t)gl_dispatch.procs[GL_DISPATCH_glUseProgram])
+#define glDeleteProgram (gl_validation_record(GL_DISPATCH_glDeleteProgram, __FILE__, __LINE__), (gl_dispatch_glDeleteProgram_t)gl_dispatch.procs[GL_DISPATCH_glDeleteProgram])
+#define glGetUniformLocation (gl_validation_record(GL_DISPATCH_glGetUniformLocation, __FILE__, __LINE__), (gl_dispatch_glGetUniformLocation_t)gl_dispatch.procs[GL_DISPATCH_glGetUniformLocation])
+#define glUniform1i (gl_validation_record(GL_DISPATCH_glUniform1i, __FILE__, __LINE__), (gl_dispatch_glUniform1i_t)gl_dispatch.procs[GL_DISPATCH_glUniform1i])
+#define glUniform1ui (gl_validation_record(GL_DISPATCH_glUniform1ui, __FILE__, __LINE__), (gl_dispatch_glUniform1ui_t)gl_dispatch.procs[GL_DISPATCH_glUniform1ui])
+#define glUniform1f (gl_validation_record(GL_DISPATCH_glUniform1f, __FILE__, __LINE__), (gl_dispatch_glUniform1f_t)gl_dispatch.procs[GL_DISPATCH_glUniform1f])
+#define glUniform2fv (gl_validation_record(GL_DISPATCH_glUniform2fv, __FILE__, __LINE__), (gl_dispatch_glUniform2fv_t)gl_dispatch.procs[GL_DISPATCH_glUniform2fv])
+#define glUniform3fv (gl_validation_record(GL_DISPATCH_glUniform3fv, __FILE__, __LINE__), (gl_dispatch_glUniform3fv_t)gl_dispatch.procs[GL_DISPATCH_glUniform3fv])
+#define glUniform4fv (gl_validation_record(GL_DISPATCH_glUniform4fv, __FILE__, __LINE__), (gl_dispatch_glUniform4fv_t)gl_dispatch.procs[GL_DISPATCH_glUniform4fv])
+#define glUniformMatrix4fv (gl_validation_record(GL_DISPATCH_glUniformMatrix4fv, __FILE__, __LINE__), (gl_dispatch_glUniformMatrix4fv_t)gl_dispatch.procs[GL_DISPATCH_glUniformMatrix4fv])
+#define glGetUniformBlockIndex (gl_validation_record(GL_DISPATCH_glGetUniformBlockIndex, __FILE__, __LINE__), (gl_dispatch_glGetUniformBlockIndex_t)gl_dispatch.procs[GL_DISPATCH_glGetUniformBlockIndex])
+#define glGetActiveUniformBlockiv (gl_validation_record(GL_DISPATCH_glGetActiveUniformBlockiv, __FILE__, __LINE__), (gl_dispatch_glGetActiveUniformBlockiv_t)gl_dispatch.procs[GL_DISPATCH_glGetActiveUniformBlockiv])
+#define glUniformBlockBinding (gl_validation_record(GL_DISPATCH_glUniformBlockBinding, __FILE__, __LINE__), (gl_dispatch_glUniformBlockBinding_t)gl_dispatch.procs[GL_DISPATCH_glUniformBlockBinding])
+#define glGenVertexArrays (gl_validation_record(GL_DISPATCH_glGenVertexArrays, __FILE__, __LINE__), (gl_dispatch_glGenVertexArrays_t)gl_dispatch.procs[GL_DISPATCH_glGenVertexArrays])
+#define glBindVertexArray (gl_validation_record(GL_DISPATCH_glBindVertexArray, __FILE__, __LINE__), (gl_dispatch_glBindVertexArray_t)gl_dispatch.procs[GL_DISPATCH_glBindVertexArray])
+#define glDeleteVertexArrays (gl_validation_record(GL_DISPATCH_glDeleteVertexArrays, __FILE__, __LINE__), (gl_dispatch_glDeleteVertexArrays_t)gl_dispatch.procs[GL_DISPATCH_glDeleteVertexArrays])
+#define glEnableVertexAttribArray (gl_validation_record(GL_DISPATCH_glEnableVertexAttribArray, __FILE__, __LINE__), (gl_dispatch_glEnableVertexAttribArray_t)gl_dispatch.procs[GL_DISPATCH_glEnableVertexAttribArray])
+#define glDisableVertexAttribArray (gl_validation_record(GL_DISPATCH_glDisableVertexAttribArray, __FILE__, __LINE__), (gl_dispatch_glDisableVertexAttribArray_t)gl_dispatch.procs[GL_DISPATCH_glDisableVertexAttribArray])
+#define glVertexAttribPointer (gl_validation_record(GL_DISPATCH_glVertexAttribPointer, __FILE__, __LINE__), (gl_dispatch_glVertexAttribPointer_t)gl_dispatch.procs[GL_DISPATCH_glVertexAttribPointer])
+#define glVertexAttribIPointer (gl_validation_record(GL_DISPATCH_glVertexAttribIPointer, __FILE__, __LINE__), (gl_dispatch_glVertexAttribIPointer_t)gl_dispatch.procs[GL_DISPATCH_glVertexAttribIPointer])
+#define glVertexAttribDivisor (gl_validation_record(GL_DISPATCH_glVertexAttribDivisor, __FILE__, __LINE__), (gl_dispatch_glVertexAttribDivisor_t)gl_dispatch.procs[GL_DISPATCH_glVertexAttribDivisor])
+#define glGenBuffers (gl_validation_record(GL_DISPATCH_glGenBuffers, __FILE__, __LINE__), (gl_dispatch_glGenBuffers_t)gl_dispatch.procs[GL_DISPATCH_glGenBuffers])
+#define glDeleteBuffers (gl_validation_record(GL_DISPATCH_glDeleteBuffers, __FILE__, __LINE__), (gl_dispatch_glDeleteBuffers_t)gl_dispatch.procs[GL_DISPATCH_glDeleteBuffers])
+#define glBindBuffer (gl_validation_record(GL_DISPATCH_glBindBuffer, __FILE__, __LINE__), (gl_dispatch_glBindBuffer_t)gl_dispatch.procs[GL_DISPATCH_glBindBuffer])
+#define glBindBufferBase (gl_validation_record(GL_DISPATCH_glBindBufferBase, __FILE__, __LINE__), (gl_dispatch_glBindBufferBase_t)gl_dispatch.procs[GL_DISPATCH_glBindBufferBase])
+#define glBindBufferRange (gl_validation_record(GL_DISPATCH_glBindBufferRange, __FILE__, __LINE__), (gl_dispatch_glBindBufferRange_t)gl_dispatch.procs[GL_DISPATCH_glBindBufferRange])
+#define glBufferData (gl_validation_record(GL_DISPATCH_glBufferData, __FILE__, __LINE__), (gl_dispatch_glBufferData_t)gl_dispatch.procs[GL_DISPATCH_glBufferData])
+#define glBufferSubData (gl_validation_record(GL_DISPATCH_glBufferSubData, __FILE__, __LINE__), (gl_dispatch_glBufferSubData_t)gl_dispatch.procs[GL_DISPATCH_glBufferSubData])
+#define glMapBufferRange (gl_validation_record(GL_DISPATCH_glMapBufferRange, __FILE__, __LINE__), (gl_dispatch_glMapBufferRange_t)gl_dispatch.procs[GL_DISPATCH_glMapBufferRange])
+#define glUnmapBuffer (gl_validation_record(GL_DISPATCH_glUnmapBuffer, __FILE__, __LINE__), (gl_dispatch_glUnmapBuffer_t)gl_dispatch.procs[GL_DISPATCH_glUnmapBuffer])
+#define glFenceSync (gl_validation_record(GL_DISPATCH_glFenceSync, __FILE__, __LINE__), (gl_dispatch_glFenceSync_t)gl_dispatch.procs[GL_DISPATCH_glFenceSync])
+#define glClientWaitSync (gl_validation_record(GL_DISPATCH_glClientWaitSync, __FILE__, __LINE__), (gl_dispatch_glClientWaitSync_t)gl_dispatch.procs[GL_DISPATCH_glClientWaitSync])
+#define glDeleteSync (gl_validation_record(GL_DISPATCH_glDeleteSync, __FILE__, __LINE__), (gl_dispatch_glDeleteSync_t)gl_dispatch.procs[GL_DISPATCH_glDeleteSync])
+#define glGenQueries (gl_validation_record(GL_DISPATCH_glGenQueries, __FILE__, __LINE__), (gl_dispatch_glGenQueries_t)gl_dispatch.procs[GL_DISPATCH_glGenQueries])
+#define glDeleteQueries (gl_validation_record(GL_DISPATCH_glDeleteQueries, __FILE__, __LINE__), (gl_dispatch_glDeleteQueries_t)gl_dispatch.procs[GL_DISPATCH_glDeleteQueries])
+#define glBeginQuery (gl_validation_record(GL_DISPATCH_glBeginQuery, __FILE__, __LINE__), (gl_dispatch_glBeginQuery_t)gl_dispatch.procs[GL_DISPATCH_glBeginQuery])
+#define glEndQuery (gl_validation_record(GL_DISPATCH_glEndQuery, __FILE__, __LINE__), (gl_dispatch_glEndQuery_t)gl_dispatch.procs[GL_DISPATCH_glEndQuery])
+#define glGetQueryObjectiv (gl_validation_record(GL_DISPATCH_glGetQueryObjectiv, __FILE__, __LINE__), (gl_dispatch_glGetQueryObjectiv_t)gl_dispatch.procs[GL_DISPATCH_glGetQueryObjectiv])
+#define glGetStringi (gl_validation_record(GL_DISPATCH_glGetStringi, __FILE__, __LINE__), (gl_dispatch_glGetStringi_t)gl_dispatch.procs[GL_DISPATCH_glGetStringi])
+#define glDrawArraysInstanced (gl_validation_record(GL_DISPATCH_glDrawArraysInstanced, __FILE__, __LINE__), (gl_dispatch_glDrawArraysInstanced_t)gl_dispatch.procs[GL_DISPATCH_glDrawArraysInstanced])
+#define glTexBuffer (gl_validation_record(GL_DISPATCH_glTexBuffer, __FILE__, __LINE__), (gl_dispatch_glTexBuffer_t)gl_dispatch.procs[GL_DISPATCH_glTexBuffer])
+#define glDrawElementsInstancedBaseVertex (gl_validation_record(GL_DISPATCH_glDrawElementsInstancedBaseVertex, __FILE__, __LINE__), (gl_dispatch_glDrawElementsInstancedBaseVertex_t)gl_dispatch.procs[GL_DISPATCH_glDrawElementsInstancedBaseVertex])
+#define glMultiDrawElementsBaseVertex (gl_validation_record(GL_DISPATCH_glMultiDrawElementsBaseVertex, __FILE__, __LINE__), (gl_dispatch_glMultiDrawElementsBaseVertex_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsBaseVertex])
+#define glCopyBufferSubData (gl_validation_record(GL_DISPATCH_glCopyBufferSubData, __FILE__, __LINE__), (gl_dispatch_glCopyBufferSubData_t)gl_dispatch.procs[GL_DISPATCH_glCopyBufferSubData])
+#define glActiveTexture (gl_validation_record(GL_DISPATCH_glActiveTexture, __FILE__, __LINE__), (gl_dispatch_glActiveTexture_t)gl_dispatch.procs[GL_DISPATCH_glActiveTexture])
+#define glGenerateMipmap (gl_validation_record(GL_DISPATCH_glGenerateMipmap, __FILE__, __LINE__), (gl_dispatch_glGenerateMipmap_t)gl_dispatch.procs[GL_DISPATCH_glGenerateMipmap])
+#define glBindSampler (gl_validation_record(GL_DISPATCH_glBindSampler, __FILE__, __LINE__), (gl_dispatch_glBindSampler_t)gl_dispatch.procs[GL_DISPATCH_glBindSampler])
+#define glBlendFuncSeparate (gl_validation_record(GL_DISPATCH_glBlendFuncSeparate, __FILE__, __LINE__), (gl_dispatch_glBlendFuncSeparate_t)gl_dispatch.procs[GL_DISPATCH_glBlendFuncSeparate])
+#define glBlendEquationSeparate (gl_validation_record(GL_DISPATCH_glBlendEquationSeparate, __FILE__, __LINE__), (gl_dispatch_glBlendEquationSeparate_t)gl_dispatch.procs[GL_DISPATCH_glBlendEquationSeparate])
+#define glGenFramebuffers (gl_validation_record(GL_DISPATCH_glGenFramebuffers, __FILE__, __LINE__), (gl_dispatch_glGenFramebuffers_t)gl_dispatch.procs[GL_DISPATCH_glGenFramebuffers])
+#define glDeleteFramebuffers (gl_validation_record(GL_DISPATCH_glDeleteFramebuffers, __FILE__, __LINE__), (gl_dispatch_glDeleteFramebuffers_t)gl_dispatch.procs[GL_DISPATCH_glDeleteFramebuffers])
+#define glBindFramebuffer (gl_validation_record(GL_DISPATCH_glBindFramebuffer, __FILE__, __LINE__), (gl_dispatch_glBindFramebuffer_t)gl_dispatch.procs[GL_DISPATCH_glBindFramebuffer])
+#define glFramebufferRenderbuffer (gl_validation_record(GL_DISPATCH_glFramebufferRenderbuffer, __FILE__, __LINE__), (gl_dispatch_glFramebufferRenderbuffer_t)gl_dispatch.procs[GL_DISPATCH_glFramebufferRenderbuffer])
+#define glFramebufferTexture2D (gl_validation_record(GL_DISPATCH_glFramebufferTexture2D, __FILE__, __LINE__), (gl_dispatch_glFramebufferTexture2D_t)gl_dispatch.procs[GL_DISPATCH_glFramebufferTexture2D])
+#define glCheckFramebufferStatus (gl_validation_record(GL_DISPATCH_glCheckFramebufferStatus, __FILE__, __LINE__), (gl_dispatch_glCheckFramebufferStatus_t)gl_dispatch.procs[GL_DISPATCH_glCheckFramebufferStatus])
+#define glGenRenderbuffers (gl_validation_record(GL_DISPATCH_glGenRenderbuffers, __FILE__, __LINE__), (gl_dispatch_glGenRenderbuffers_t)gl_dispatch.procs[GL_DISPATCH_glGenRenderbuffers])
+#define glDeleteRenderbuffers (gl_validation_record(GL_DISPATCH_glDeleteRenderbuffers, __FILE__, __LINE__), (gl_dispatch_glDeleteRenderbuffers_t)gl_dispatch.procs[GL_DISPATCH_glDeleteRenderbuffers])
+#define glBindRenderbuffer (gl_validation_record(GL_DISPATCH_glBindRenderbuffer, __FILE__, __LINE__), (gl_dispatch_glBindRenderbuffer_t)gl_dispatch.procs[GL_DISPATCH_glBindRenderbuffer])
+#define glRenderbufferStorage (gl_validation_record(GL_DISPATCH_glRenderbufferStorage, __FILE__, __LINE__), (gl_dispatch_glRenderbufferStorage_t)gl_dispatch.procs[GL_DISPATCH_glRenderbufferStorage])
+#define glBufferStorage (gl_validation_record(GL_DISPATCH_glBufferStorage, __FILE__, __LINE__), (gl_dispatch_glBufferStorage_t)gl_dispatch.procs[GL_DISPATCH_glBufferStorage])
+#define glMultiDrawElementsIndirect (gl_validation_record(GL_DISPATCH_glMultiDrawElementsIndirect, __FILE__, __LINE__), (gl_dispatch_glMultiDrawElementsIndirect_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsIndirect])
+#define glMultiDrawElementsIndirectCount (gl_validation_record(GL_DISPATCH_glMultiDrawElementsIndirectCount, __FILE__, __LINE__), (gl_dispatch_glMultiDrawElementsIndirectCount_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsIndirectCount])
+#define glMultiDrawElementsIndirectCountARB (gl_validation_record(GL_DISPATCH_glMultiDrawElementsIndirectCountARB, __FILE__, __LINE__), (gl_dispatch_glMultiDrawElementsIndirectCountARB_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsIndirectCountARB])
+#define glDispatchCompute (gl_validation_record(GL_DISPATCH_glDispatchCompute, __FILE__, __LINE__), (gl_dispatch_glDispatchCompute_t)gl_dispatch.procs[GL_DISPATCH_glDispatchCompute])
+#define glMemoryBarrier (gl_validation_record(GL_DISPATCH_glMemoryBarrier, __FILE__, __LINE__), (gl_dispatch_glMemoryBarrier_t)gl_dispatch.procs[GL_DISPATCH_glMemoryBarrier])
+#define glTexStorage2D (gl_validation_record(GL_DISPATCH_glTexStorage2D, __FILE__, __LINE__), (gl_dispatch_glTexStorage2D_t)gl_dispatch.procs[GL_DISPATCH_glTexStorage2D])
+#define glDrawElementsInstancedBaseVertexBaseInstance (gl_validation_record(GL_DISPATCH_glDrawElementsInstancedBaseVertexBaseInstance, __FILE__, __LINE__), (gl_dispatch_glDrawElementsInstancedBaseVertexBaseInstance_t)gl_dispatch.procs[GL_DISPATCH_glDrawElementsInstancedBaseVertexBaseInstance])
+#define glObjectLabel (gl_validation_record(GL_DISPATCH_glObjectLabel, __FILE__, __LINE__), (gl_dispatch_glObjectLabel_t)gl_dispatch.procs[GL_DISPATCH_glObjectLabel])
+#define glPushDebugGroup (gl_validation_record(GL_DISPATCH_glPushDebugGroup, __FILE__, __LINE__), (gl_dispatch_glPushDebugGroup_t)gl_dispatch.procs[GL_DISPATCH_glPushDebugGroup])
+#define glPopDebugGroup (gl_validation_record(GL_DISPATCH_glPopDebugGroup, __FILE__, __LINE__), (gl_dispatch_glPopDebugGroup_t)gl_dispatch.procs[GL_DISPATCH_glPopDebugGroup])
+#define glDebugMessageCallback (gl_validation_record(GL_DISPATCH_glDebugMessageCallback, __FILE__, __LINE__), (gl_dispatch_glDebugMessageCallback_t)gl_dispatch.procs[GL_DISPATCH_glDebugMessageCallback])
+#define glDebugMessageControl (gl_validation_record(GL_DISPATCH_glDebugMessageControl, __FILE__, __LINE__), (gl_dispatch_glDebugMessageControl_t)gl_dispatch.procs[GL_DISPATCH_glDebugMessageControl])
+#define glGetProgramBinary (gl_validation_record(GL_DISPATCH_glGetProgramBinary, __FILE__, __LINE__), (gl_dispatch_glGetProgramBinary_t)gl_dispatch.procs[GL_DISPATCH_glGetProgramBinary])
+#define glProgramBinary (gl_validation_record(GL_DISPATCH_glProgramBinary, __FILE__, __LINE__), (gl_dispatch_glProgramBinary_t)gl_dispatch.procs[GL_DISPATCH_glProgramBinary])
+#define glProgramParameteri (gl_validation_record(GL_DISPATCH_glProgramParameteri, __FILE__, __LINE__), (gl_dispatch_glProgramParameteri_t)gl_dispatch.procs[GL_DISPATCH_glProgramParameteri])
+#define glMaxShaderCompilerThreadsKHR (gl_validation_record(GL_DISPATCH_glMaxShaderCompilerThreadsKHR, __FILE__, __LINE__), (gl_dispatch_glMaxShaderCompilerThreadsKHR_t)gl_dispatch.procs[GL_DISPATCH_glMaxShaderCompilerThreadsKHR])
+#define glMaxShaderCompilerThreadsARB (gl_validation_record(GL_DISPATCH_glMaxShaderCompilerThreadsARB, __FILE__, __LINE__), (gl_dispatch_glMaxShaderCompilerThreadsARB_t)gl_dispatch.procs[GL_DISPATCH_glMaxShaderCompilerThreadsARB])
+#define glQueryCounter (gl_validation_record(GL_DISPATCH_glQueryCounter, __FILE__, __LINE__), (gl_dispatch_glQueryCounter_t)gl_dispatch.procs[GL_DISPATCH_glQueryCounter])
+#define glGetQueryObjectui64v (gl_validation_record(GL_DISPATCH_glGetQueryObjectui64v, __FILE__, __LINE__), (gl_dispatch_glGetQueryObjectui64v_t)gl_dispatch.procs[GL_DISPATCH_glGetQueryObjectui64v])
+
+#else
+
+#define glCreateShader ((gl_dispatch_glCreateShader_t)gl_dispatch.procs[GL_DISPATCH_glCreateShader])
+#define glShaderSource ((gl_dispatch_glShaderSource_t)gl_dispatch.procs[GL_DISPATCH_glShaderSource])
+#define glCompileShader ((gl_dispatch_glCompileShader_t)gl_dispatch.procs[GL_DISPATCH_glCompileShader])
+#define glGetShaderiv ((gl_dispatch_glGetShaderiv_t)gl_dispatch.procs[GL_DISPATCH_glGetShaderiv])
+#define glGetShaderInfoLog ((gl_dispatch_glGetShaderInfoLog_t)gl_dispatch.procs[GL_DISPATCH_glGetShaderInfoLog])
+#define glDeleteShader ((gl_dispatch_glDeleteShader_t)gl_dispatch.procs[GL_DISPATCH_glDeleteShader])
+#define glCreateProgram ((gl_dispatch_glCreateProgram_t)gl_dispatch.procs[GL_DISPATCH_glCreateProgram])
+#define glAttachShader ((gl_dispatch_glAttachShader_t)gl_dispatch.procs[GL_DISPATCH_glAttachShader])
+#define glDetachShader ((gl_dispatch_glDetachShader_t)gl_dispatch.procs[GL_DISPATCH_glDetachShader])
+#define glLinkProgram ((gl_dispatch_glLinkProgram_t)gl_dispatch.procs[GL_DISPATCH_glLinkProgram])
+#define glGetProgramiv ((gl_dispatch_glGetProgramiv_t)gl_dispatch.procs[GL_DISPATCH_glGetProgramiv])
+#define glGetProgramInfoLog ((gl_dispatch_glGetProgramInfoLog_t)gl_dispatch.procs[GL_DISPATCH_glGetProgramInfoLog])
+#define glUseProgram ((gl_dispatch_glUseProgram_t)gl_dispatch.procs[GL_DISPATCH_glUseProgram])
+#define glDeleteProgram ((gl_dispatch_glDeleteProgram_t)gl_dispatch.procs[GL_DISPATCH_glDeleteProgram])
+#define glGetUniformLocation ((gl_dispatch_glGetUniformLocation_t)gl_dispatch.procs[GL_DISPATCH_glGetUniformLocation])
+#define glUniform1i ((gl_dispatch_glUniform1i_t)gl_dispatch.procs[GL_DISPATCH_glUniform1i])
+#define glUniform1ui ((gl_dispatch_glUniform1ui_t)gl_dispatch.procs[GL_DISPATCH_glUniform1ui])
+#define glUniform1f ((gl_dispatch_glUniform1f_t)gl_dispatch.procs[GL_DISPATCH_glUniform1f])
+#define glUniform2fv ((gl_dispatch_glUniform2fv_t)gl_dispatch.procs[GL_DISPATCH_glUniform2fv])
+#define glUniform3fv ((gl_dispatch_glUniform3fv_t)gl_dispatch.procs[GL_DISPATCH_glUniform3fv])
+#define glUniform4fv ((gl_dispatch_glUniform4fv_t)gl_dispatch.procs[GL_DISPATCH_glUniform4fv])
+#define glUniformMatrix4fv ((gl_dispatch_glUniformMatrix4fv_t)gl_dispatch.procs[GL_DISPATCH_glUniformMatrix4fv])
+#define glGetUniformBlockIndex ((gl_dispatch_glGetUniformBlockIndex_t)gl_dispatch.procs[GL_DISPATCH_glGetUniformBlockIndex])
+#define glGetActiveUniformBlockiv ((gl_dispatch_glGetActiveUniformBlockiv_t)gl_dispatch.procs[GL_DISPATCH_glGetActiveUniformBlockiv])
+#define glUniformBlockBinding ((gl_dispatch_glUniformBlockBinding_t)gl_dispatch.procs[GL_DISPATCH_glUniformBlockBinding])
+#define glGenVertexArrays ((gl_dispatch_glGenVertexArrays_t)gl_dispatch.procs[GL_DISPATCH_glGenVertexArrays])
+#define glBindVertexArray ((gl_dispatch_glBindVertexArray_t)gl_dispatch.procs[GL_DISPATCH_glBindVertexArray])
+#define glDeleteVertexArrays ((gl_dispatch_glDeleteVertexArrays_t)gl_dispatch.procs[GL_DISPATCH_glDeleteVertexArrays])
+#define glEnableVertexAttribArray ((gl_dispatch_glEnableVertexAttribArray_t)gl_dispatch.procs[GL_DISPATCH_glEnableVertexAttribArray])
+#define glDisableVertexAttribArray ((gl_dispatch_glDisableVertexAttribArray_t)gl_dispatch.procs[GL_DISPATCH_glDisableVertexAttribArray])
+#define glVertexAttribPointer ((gl_dispatch_glVertexAttribPointer_t)gl_dispatch.procs[GL_DISPATCH_glVertexAttribPointer])
+#define glVertexAttribIPointer ((gl_dispatch_glVertexAttribIPointer_t)gl_dispatch.procs[GL_DISPATCH_glVertexAttribIPointer])
+#define glVertexAttribDivisor ((gl_dispatch_glVertexAttribDivisor_t)gl_dispatch.procs[GL_DISPATCH_glVertexAttribDivisor])
+#define glGenBuffers ((gl_dispatch_glGenBuffers_t)gl_dispatch.procs[GL_DISPATCH_glGenBuffers])
+#define glDeleteBuffers ((gl_dispatch_glDeleteBuffers_t)gl_dispatch.procs[GL_DISPATCH_glDeleteBuffers])
+#define glBindBuffer ((gl_dispatch_glBindBuffer_t)gl_dispatch.procs[GL_DISPATCH_glBindBuffer])
+#define glBindBufferBase ((gl_dispatch_glBindBufferBase_t)gl_dispatch.procs[GL_DISPATCH_glBindBufferBase])
+#define glBindBufferRange ((gl_dispatch_glBindBufferRange_t)gl_dispatch.procs[GL_DISPATCH_glBindBufferRange])
+#define glBufferData ((gl_dispatch_glBufferData_t)gl_dispatch.procs[GL_DISPATCH_glBufferData])
+#define glBufferSubData ((gl_dispatch_glBufferSubData_t)gl_dispatch.procs[GL_DISPATCH_glBufferSubData])
+#define glMapBufferRange ((gl_dispatch_glMapBufferRange_t)gl_dispatch.procs[GL_DISPATCH_glMapBufferRange])
+#define glUnmapBuffer ((gl_dispatch_glUnmapBuffer_t)gl_dispatch.procs[GL_DISPATCH_glUnmapBuffer])
+#define glFenceSync ((gl_dispatch_glFenceSync_t)gl_dispatch.procs[GL_DISPATCH_glFenceSync])
+#define glClientWaitSync ((gl_dispatch_glClientWaitSync_t)gl_dispatch.procs[GL_DISPATCH_glClientWaitSync])
+#define glDeleteSync ((gl_dispatch_glDeleteSync_t)gl_dispatch.procs[GL_DISPATCH_glDeleteSync])
+#define glGenQueries ((gl_dispatch_glGenQueries_t)gl_dispatch.procs[GL_DISPATCH_glGenQueries])
+#define glDeleteQueries ((gl_dispatch_glDeleteQueries_t)gl_dispatch.procs[GL_DISPATCH_glDeleteQueries])
+#define glBeginQuery ((gl_dispatch_glBeginQuery_t)gl_dispatch.procs[GL_DISPATCH_glBeginQuery])
+#define glEndQuery ((gl_dispatch_glEndQuery_t)gl_dispatch.procs[GL_DISPATCH_glEndQuery])
+#define glGetQueryObjectiv ((gl_dispatch_glGetQueryObjectiv_t)gl_dispatch.procs[GL_DISPATCH_glGetQueryObjectiv])
+#define glGetStringi ((gl_dispatch_glGetStringi_t)gl_dispatch.procs[GL_DISPATCH_glGetStringi])
+#define glDrawArraysInstanced ((gl_dispatch_glDrawArraysInstanced_t)gl_dispatch.procs[GL_DISPATCH_glDrawArraysInstanced])
+#define glTexBuffer ((gl_dispatch_glTexBuffer_t)gl_dispatch.procs[GL_DISPATCH_glTexBuffer])
+#define glDrawElementsInstancedBaseVertex ((gl_dispatch_glDrawElementsInstancedBaseVertex_t)gl_dispatch.procs[GL_DISPATCH_glDrawElementsInstancedBaseVertex])
+#define glMultiDrawElementsBaseVertex ((gl_dispatch_glMultiDrawElementsBaseVertex_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsBaseVertex])
+#define glCopyBufferSubData ((gl_dispatch_glCopyBufferSubData_t)gl_dispatch.procs[GL_DISPATCH_glCopyBufferSubData])
+#define glActiveTexture ((gl_dispatch_glActiveTexture_t)gl_dispatch.procs[GL_DISPATCH_glActiveTexture])
+#define glGenerateMipmap ((gl_dispatch_glGenerateMipmap_t)gl_dispatch.procs[GL_DISPATCH_glGenerateMipmap])
+#define glBindSampler ((gl_dispatch_glBindSampler_t)gl_dispatch.procs[GL_DISPATCH_glBindSampler])
+#define glBlendFuncSeparate ((gl_dispatch_glBlendFuncSeparate_t)gl_dispatch.procs[GL_DISPATCH_glBlendFuncSeparate])
+#define glBlendEquationSeparate ((gl_dispatch_glBlendEquationSeparate_t)gl_dispatch.procs[GL_DISPATCH_glBlendEquationSeparate])
+#define glGenFramebuffers ((gl_dispatch_glGenFramebuffers_t)gl_dispatch.procs[GL_DISPATCH_glGenFramebuffers])
+#define glDeleteFramebuffers ((gl_dispatch_glDeleteFramebuffers_t)gl_dispatch.procs[GL_DISPATCH_glDeleteFramebuffers])
+#define glBindFramebuffer ((gl_dispatch_glBindFramebuffer_t)gl_dispatch.procs[GL_DISPATCH_glBindFramebuffer])
+#define glFramebufferRenderbuffer ((gl_dispatch_glFramebufferRenderbuffer_t)gl_dispatch.procs[GL_DISPATCH_glFramebufferRenderbuffer])
+#define glFramebufferTexture2D ((gl_dispatch_glFramebufferTexture2D_t)gl_dispatch.procs[GL_DISPATCH_glFramebufferTexture2D])
+#define glCheckFramebufferStatus ((gl_dispatch_glCheckFramebufferStatus_t)gl_dispatch.procs[GL_DISPATCH_glCheckFramebufferStatus])
+#define glGenRenderbuffers ((gl_dispatch_glGenRenderbuffers_t)gl_dispatch.procs[GL_DISPATCH_glGenRenderbuffers])
+#define glDeleteRenderbuffers ((gl_dispatch_glDeleteRenderbuffers_t)gl_dispatch.procs[GL_DISPATCH_glDeleteRenderbuffers])
+#define glBindRenderbuffer ((gl_dispatch_glBindRenderbuffer_t)gl_dispatch.procs[GL_DISPATCH_glBindRenderbuffer])
+#define glRenderbufferStorage ((gl_dispatch_glRenderbufferStorage_t)gl_dispatch.procs[GL_DISPATCH_glRenderbufferStorage])
+#define glBufferStorage ((gl_dispatch_glBufferStorage_t)gl_dispatch.procs[GL_DISPATCH_glBufferStorage])
+#define glMultiDrawElementsIndirect ((gl_dispatch_glMultiDrawElementsIndirect_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsIndirect])
+#define glMultiDrawElementsIndirectCount ((gl_dispatch_glMultiDrawElementsIndirectCount_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsIndirectCount])
+#define glMultiDrawElementsIndirectCountARB ((gl_dispatch_glMultiDrawElementsIndirectCountARB_t)gl_dispatch.procs[GL_DISPATCH_glMultiDrawElementsIndirectCountARB])
+#define glDispatchCompute ((gl_dispatch_glDispatchCompute_t)gl_dispatch.procs[GL_DISPATCH_glDispatchCompute])
+#define glMemoryBarrier ((gl_dispatch_glMemoryBarrier_t)gl_dispatch.procs[GL_DISPATCH_glMemoryBarrier])
+#define glTexStorage2D ((gl_dispatch_glTexStorage2D_t)gl_dispatch.procs[GL_DISPATCH_glTexStorage2D])
+#define glDrawElementsInstancedBaseVertexBaseInstance ((gl_dispatch_glDrawElementsInstancedBaseVertexBaseInstance_t)gl_dispatch.procs[GL_DISPATCH_glDrawElementsInstancedBaseVertexBaseInstance])
+#define glObjectLabel ((gl_dispatch_glObjectLabel_t)gl_dispatch.procs[GL_DISPATCH_glObjectLabel])
+#define glPushDebugGroup ((gl_dispatch_glPushDebugGroup_t)gl_dispatch.procs[GL_DISPATCH_glPushDebugGroup])
+#define glPopDebugGroup ((gl_dispatch_glPopDebugGroup_t)gl_dispatch.procs[GL_DISPATCH_glPopDebugGroup])
+#define glDebugMessageCallback ((gl_dispatch_glDebugMessageCallback_t)gl_dispatch.procs[GL_DISPATCH_glDebugMessageCallback])
+#define glDebugMessageControl ((gl_dispatch_glDebugMessageControl_t)gl_dispatch.procs[GL_DISPATCH_glDebugMessageControl])
+#define glGetProgramBinary ((gl_dispatch_glGetProgramBinary_t)gl_dispatch.procs[GL_DISPATCH_glGetProgramBinary])
+#define glProgramBinary ((gl_dispatch_glProgramBinary_t)gl_dispatch.procs[GL_DISPATCH_glProgramBinary])
+#define glProgramParameteri ((gl_dispatch_glProgramParameteri_t)gl_dispatch.procs[GL_DISPATCH_glProgramParameteri])
+#define glMaxShaderCompilerThreadsKHR ((gl_dispatch_glMaxShaderCompilerThreadsKHR_t)gl_dispatch.procs[GL_DISPATCH_glMaxShaderCompilerThreadsKHR])
+#define glMaxShaderCompilerThreadsARB ((gl_dispatch_glMaxShaderCompilerThreadsARB_t)gl_dispatch.procs[GL_DISPATCH_glMaxShaderCompilerThreadsARB])
+#define glQueryCounter ((gl_dispatch_glQueryCounter_t)gl_dispatch.procs[GL_DISPATCH_glQueryCounter])
+#define glGetQueryObjectui64v ((gl_dispatch_glGetQueryObjectui64v_t)gl_dispatch.procs[GL_DISPATCH_glGetQueryObjectui64v])
+
+#endif
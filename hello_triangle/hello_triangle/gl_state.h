@@ -0,0 +1,815 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "opengl.h"
+
+// Shadow copy of the GL state we touch, so setting something that is already
+// set costs a compare instead of a driver call. Every value starts unknown
+// and the first set always reaches GL. Code that changes state behind the
+// cache's back has to call gl_state_invalidate() afterwards.
+//
+// Each thread has its own cache, for the render context current on it.
+
+#define GL_STATE_UNKNOWN 0xffffffffu
+#define GL_STATE_MAX_TEXTURE_UNITS 32
+#define GL_STATE_MAX_BUFFER_SLOTS 16
+#define GL_STATE_MAX_PROGRAMS 256
+#define GL_STATE_UNIFORM_MAX_WORDS 16
+
+enum gl_state_buffer_target_t
+{
+    GL_STATE_ARRAY_BUFFER,
+    GL_STATE_ELEMENT_ARRAY_BUFFER,
+    GL_STATE_UNIFORM_BUFFER,
+    GL_STATE_SHADER_STORAGE_BUFFER,
+    GL_STATE_DRAW_INDIRECT_BUFFER,
+    GL_STATE_DISPATCH_INDIRECT_BUFFER,
+    GL_STATE_PIXEL_PACK_BUFFER,
+    GL_STATE_PIXEL_UNPACK_BUFFER,
+    GL_STATE_COPY_READ_BUFFER,
+    GL_STATE_COPY_WRITE_BUFFER,
+    GL_STATE_PARAMETER_BUFFER,
+    GL_STATE_BUFFER_TARGET_COUNT,
+};
+
+enum gl_state_texture_target_t
+{
+    GL_STATE_TEXTURE_2D,
+    GL_STATE_TEXTURE_3D,
+    GL_STATE_TEXTURE_CUBE_MAP,
+    GL_STATE_TEXTURE_2D_ARRAY,
+    GL_STATE_TEXTURE_BUFFER,
+    GL_STATE_TEXTURE_TARGET_COUNT,
+};
+
+enum gl_state_uniform_type_t
+{
+    GL_STATE_UNIFORM_UNKNOWN,
+    GL_STATE_UNIFORM_INT,
+    GL_STATE_UNIFORM_UINT,
+    GL_STATE_UNIFORM_FLOAT,
+    GL_STATE_UNIFORM_VEC2,
+    GL_STATE_UNIFORM_VEC3,
+    GL_STATE_UNIFORM_VEC4,
+    GL_STATE_UNIFORM_MAT4,
+};
+
+struct gl_state_uniform_t
+{
+    uint32_t type;
+    uint32_t words[GL_STATE_UNIFORM_MAX_WORDS];
+};
+
+// Uniform values of one program, indexed by location.
+struct gl_state_program_t
+{
+    uint32_t program = 0;
+    gl_state_uniform_t *uniforms = NULL;
+    uint32_t uniform_capacity = 0;
+};
+
+// The initializers here and in gl_state_program_t keep gl_state_t constant-
+// initialized: GCC gives up on value-initialized arrays of plain structs in a
+// constexpr constructor.
+struct gl_state_buffer_slot_t
+{
+    uint32_t buffer = 0;
+    int64_t offset = 0;
+    int64_t size = 0;   // -1 for glBindBufferBase
+};
+
+struct gl_state_stats_t
+{
+    uint64_t issued;
+    uint64_t skipped;
+    uint64_t uniforms_issued;
+    uint64_t uniforms_skipped;
+};
+
+struct gl_state_t
+{
+    uint32_t program;
+    gl_state_program_t *current_program;
+    uint32_t vertex_array;
+    uint32_t buffers[GL_STATE_BUFFER_TARGET_COUNT];
+    gl_state_buffer_slot_t uniform_slots[GL_STATE_MAX_BUFFER_SLOTS];
+    gl_state_buffer_slot_t storage_slots[GL_STATE_MAX_BUFFER_SLOTS];
+    uint32_t active_texture;
+    uint32_t textures[GL_STATE_MAX_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGET_COUNT];
+    uint32_t samplers[GL_STATE_MAX_TEXTURE_UNITS];
+    uint32_t draw_framebuffer;
+    uint32_t read_framebuffer;
+
+    uint32_t blend_enabled;
+    uint32_t blend_function[4];     // source rgb, destination rgb, source alpha, destination alpha
+    uint32_t blend_equation[2];     // rgb, alpha
+    uint32_t depth_test_enabled;
+    uint32_t depth_write_enabled;
+    uint32_t depth_function;
+    uint32_t cull_enabled;
+    uint32_t cull_face;
+    uint32_t color_mask;            // bit 0 red ... bit 3 alpha
+    uint32_t stencil_test_enabled;
+    uint32_t stencil_function[3];   // function, reference, read mask
+    uint32_t stencil_operation[3];  // stencil fail, depth fail, pass
+    uint32_t stencil_write_mask;
+    uint32_t front_face;
+    uint32_t polygon_mode;
+    uint32_t polygon_offset_enabled;
+    uint32_t polygon_offset[2];     // factor and units, as float bits
+    uint32_t scissor_test_enabled;
+
+    gl_state_program_t programs[GL_STATE_MAX_PROGRAMS];
+    uint32_t program_count;
+
+    uint32_t generation;    // bumped by gl_state_invalidate(), so caches built on this one can tell
+    gl_state_stats_t stats;
+
+    constexpr gl_state_t();
+};
+
+// Marks every value unknown, leaving uniforms alone.
+constexpr void gl_state_forget(gl_state_t *state)
+{
+    state->program = GL_STATE_UNKNOWN;
+    state->current_program = NULL;
+    state->vertex_array = GL_STATE_UNKNOWN;
+    for (uint32_t i = 0; i < GL_STATE_BUFFER_TARGET_COUNT; ++i)
+    {
+        state->buffers[i] = GL_STATE_UNKNOWN;
+    }
+    for (uint32_t i = 0; i < GL_STATE_MAX_BUFFER_SLOTS; ++i)
+    {
+        state->uniform_slots[i].buffer = GL_STATE_UNKNOWN;
+        state->storage_slots[i].buffer = GL_STATE_UNKNOWN;
+    }
+    state->active_texture = GL_STATE_UNKNOWN;
+    for (uint32_t unit = 0; unit < GL_STATE_MAX_TEXTURE_UNITS; ++unit)
+    {
+        for (uint32_t target = 0; target < GL_STATE_TEXTURE_TARGET_COUNT; ++target)
+        {
+            state->textures[unit][target] = GL_STATE_UNKNOWN;
+        }
+        state->samplers[unit] = GL_STATE_UNKNOWN;
+    }
+    state->draw_framebuffer = GL_STATE_UNKNOWN;
+    state->read_framebuffer = GL_STATE_UNKNOWN;
+
+    state->blend_enabled = GL_STATE_UNKNOWN;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        state->blend_function[i] = GL_STATE_UNKNOWN;
+    }
+    state->blend_equation[0] = GL_STATE_UNKNOWN;
+    state->blend_equation[1] = GL_STATE_UNKNOWN;
+    state->depth_test_enabled = GL_STATE_UNKNOWN;
+    state->depth_write_enabled = GL_STATE_UNKNOWN;
+    state->depth_function = GL_STATE_UNKNOWN;
+    state->cull_enabled = GL_STATE_UNKNOWN;
+    state->cull_face = GL_STATE_UNKNOWN;
+    state->color_mask = GL_STATE_UNKNOWN;
+    state->stencil_test_enabled = GL_STATE_UNKNOWN;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        state->stencil_function[i] = GL_STATE_UNKNOWN;
+        state->stencil_operation[i] = GL_STATE_UNKNOWN;
+    }
+    state->stencil_write_mask = GL_STATE_UNKNOWN;
+    state->front_face = GL_STATE_UNKNOWN;
+    state->polygon_mode = GL_STATE_UNKNOWN;
+    state->polygon_offset_enabled = GL_STATE_UNKNOWN;
+    state->polygon_offset[0] = GL_STATE_UNKNOWN;
+    state->polygon_offset[1] = GL_STATE_UNKNOWN;
+    state->scissor_test_enabled = GL_STATE_UNKNOWN;
+}
+
+// Constant, so the thread_local below needs no initialization on first use
+// and every thread starts with everything unknown.
+constexpr gl_state_t::gl_state_t()
+    : program(), current_program(), vertex_array(), buffers(), uniform_slots(), storage_slots(), active_texture(), textures(), samplers(),
+      draw_framebuffer(), read_framebuffer(), blend_enabled(), blend_function(), blend_equation(), depth_test_enabled(), depth_write_enabled(),
+      depth_function(), cull_enabled(), cull_face(), color_mask(), stencil_test_enabled(), stencil_function(), stencil_operation(),
+      stencil_write_mask(), front_face(), polygon_mode(), polygon_offset_enabled(), polygon_offset(), scissor_test_enabled(), programs(),
+      program_count(), generation(), stats()
+{
+    gl_state_forget(this);
+}
+
+thread_local gl_state_t gl_state;
+
+// Forgets everything the cache believes about GL, uniforms included.
+void gl_state_invalidate()
+{
+    gl_state_forget(&gl_state);
+    ++gl_state.generation;
+
+    for (uint32_t i = 0; i < gl_state.program_count; ++i)
+    {
+        gl_state_program_t *program = &gl_state.programs[i];
+        memset(program->uniforms, 0, program->uniform_capacity * sizeof(gl_state_uniform_t));
+    }
+}
+
+// The cache describes the context current on its thread, so it starts over
+// whenever make_render_context_current() switches contexts.
+const bool gl_state_switch_hook_installed = (render_context_switch_hook = gl_state_invalidate, true);
+
+inline void gl_state_count(bool issued)
+{
+    if (issued)
+    {
+        ++gl_state.stats.issued;
+    }
+    else
+    {
+        ++gl_state.stats.skipped;
+    }
+}
+
+void gl_state_reset_stats()
+{
+    gl_state.stats = {};
+}
+
+//
+// Objects
+//
+
+gl_state_program_t *gl_state_find_program(uint32_t program)
+{
+    for (uint32_t i = 0; i < gl_state.program_count; ++i)
+    {
+        if (gl_state.programs[i].program == program)
+        {
+            return &gl_state.programs[i];
+        }
+    }
+
+    assert(gl_state.program_count < GL_STATE_MAX_PROGRAMS);
+    gl_state_program_t *entry = &gl_state.programs[gl_state.program_count++];
+    entry->program = program;
+    entry->uniforms = NULL;
+    entry->uniform_capacity = 0;
+    return entry;
+}
+
+void gl_state_use_program(uint32_t program)
+{
+    bool changed = gl_state.program != program;
+    if (changed)
+    {
+        glUseProgram(program);
+        gl_state.program = program;
+        gl_state.current_program = program ? gl_state_find_program(program) : NULL;
+    }
+    gl_state_count(changed);
+}
+
+// Deletes the program and drops its uniform values, GL may hand the name out
+// again.
+void gl_state_delete_program(uint32_t program)
+{
+    glDeleteProgram(program);
+    if (gl_state.program == program)
+    {
+        gl_state.program = GL_STATE_UNKNOWN;
+        gl_state.current_program = NULL;
+    }
+    for (uint32_t i = 0; i < gl_state.program_count; ++i)
+    {
+        if (gl_state.programs[i].program == program)
+        {
+            free(gl_state.programs[i].uniforms);
+            gl_state.programs[i] = gl_state.programs[--gl_state.program_count];
+            break;
+        }
+    }
+}
+
+void gl_state_bind_vertex_array(uint32_t vertex_array)
+{
+    bool changed = gl_state.vertex_array != vertex_array;
+    if (changed)
+    {
+        glBindVertexArray(vertex_array);
+        gl_state.vertex_array = vertex_array;
+
+        // The element buffer binding belongs to the vertex array.
+        gl_state.buffers[GL_STATE_ELEMENT_ARRAY_BUFFER] = GL_STATE_UNKNOWN;
+    }
+    gl_state_count(changed);
+}
+
+uint32_t gl_state_buffer_target_index(uint32_t target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER: return GL_STATE_ARRAY_BUFFER;
+    case GL_ELEMENT_ARRAY_BUFFER: return GL_STATE_ELEMENT_ARRAY_BUFFER;
+    case GL_UNIFORM_BUFFER: return GL_STATE_UNIFORM_BUFFER;
+    case GL_SHADER_STORAGE_BUFFER: return GL_STATE_SHADER_STORAGE_BUFFER;
+    case GL_DRAW_INDIRECT_BUFFER: return GL_STATE_DRAW_INDIRECT_BUFFER;
+    case GL_DISPATCH_INDIRECT_BUFFER: return GL_STATE_DISPATCH_INDIRECT_BUFFER;
+    case GL_PIXEL_PACK_BUFFER: return GL_STATE_PIXEL_PACK_BUFFER;
+    case GL_PIXEL_UNPACK_BUFFER: return GL_STATE_PIXEL_UNPACK_BUFFER;
+    case GL_COPY_READ_BUFFER: return GL_STATE_COPY_READ_BUFFER;
+    case GL_COPY_WRITE_BUFFER: return GL_STATE_COPY_WRITE_BUFFER;
+    case GL_PARAMETER_BUFFER: return GL_STATE_PARAMETER_BUFFER;
+    }
+    assert(!"buffer target is not tracked by gl_state");
+    return 0;
+}
+
+void gl_state_bind_buffer(uint32_t target, uint32_t buffer)
+{
+    uint32_t index = gl_state_buffer_target_index(target);
+    bool changed = gl_state.buffers[index] != buffer;
+    if (changed)
+    {
+        glBindBuffer(target, buffer);
+        gl_state.buffers[index] = buffer;
+    }
+    gl_state_count(changed);
+}
+
+// Indexed uniform or shader storage binding; size -1 binds the whole buffer.
+// Both forms also set the generic binding point.
+void gl_state_bind_buffer_range(uint32_t target, uint32_t index, uint32_t buffer, int64_t offset, int64_t size)
+{
+    assert(target == GL_UNIFORM_BUFFER || target == GL_SHADER_STORAGE_BUFFER);
+    assert(index < GL_STATE_MAX_BUFFER_SLOTS);
+    gl_state_buffer_slot_t *slot = target == GL_UNIFORM_BUFFER ? &gl_state.uniform_slots[index] : &gl_state.storage_slots[index];
+
+    bool changed = slot->buffer != buffer || slot->offset != offset || slot->size != size;
+    if (changed)
+    {
+        if (size < 0)
+        {
+            glBindBufferBase(target, index, buffer);
+        }
+        else
+        {
+            glBindBufferRange(target, index, buffer, (GLintptr)offset, (GLsizeiptr)size);
+        }
+        slot->buffer = buffer;
+        slot->offset = offset;
+        slot->size = size;
+        gl_state.buffers[gl_state_buffer_target_index(target)] = buffer;
+    }
+    gl_state_count(changed);
+}
+
+// GL unbinds a deleted buffer from every binding point.
+void gl_state_delete_buffer(uint32_t buffer)
+{
+    glDeleteBuffers(1, &buffer);
+    for (uint32_t i = 0; i < GL_STATE_BUFFER_TARGET_COUNT; ++i)
+    {
+        if (gl_state.buffers[i] == buffer)
+        {
+            gl_state.buffers[i] = 0;
+        }
+    }
+    for (uint32_t i = 0; i < GL_STATE_MAX_BUFFER_SLOTS; ++i)
+    {
+        if (gl_state.uniform_slots[i].buffer == buffer)
+        {
+            gl_state.uniform_slots[i].buffer = GL_STATE_UNKNOWN;
+        }
+        if (gl_state.storage_slots[i].buffer == buffer)
+        {
+            gl_state.storage_slots[i].buffer = GL_STATE_UNKNOWN;
+        }
+    }
+}
+
+uint32_t gl_state_texture_target_index(uint32_t target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D: return GL_STATE_TEXTURE_2D;
+    case GL_TEXTURE_3D: return GL_STATE_TEXTURE_3D;
+    case GL_TEXTURE_CUBE_MAP: return GL_STATE_TEXTURE_CUBE_MAP;
+    case GL_TEXTURE_2D_ARRAY: return GL_STATE_TEXTURE_2D_ARRAY;
+    case GL_TEXTURE_BUFFER: return GL_STATE_TEXTURE_BUFFER;
+    }
+    assert(!"texture target is not tracked by gl_state");
+    return 0;
+}
+
+void gl_state_active_texture(uint32_t unit)
+{
+    assert(unit < GL_STATE_MAX_TEXTURE_UNITS);
+    bool changed = gl_state.active_texture != unit;
+    if (changed)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        gl_state.active_texture = unit;
+    }
+    gl_state_count(changed);
+}
+
+// Switches the active unit only when the binding actually changes.
+void gl_state_bind_texture(uint32_t unit, uint32_t target, uint32_t texture)
+{
+    assert(unit < GL_STATE_MAX_TEXTURE_UNITS);
+    uint32_t *binding = &gl_state.textures[unit][gl_state_texture_target_index(target)];
+    bool changed = *binding != texture;
+    if (changed)
+    {
+        gl_state_active_texture(unit);
+        glBindTexture(target, texture);
+        *binding = texture;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_delete_texture(uint32_t texture)
+{
+    glDeleteTextures(1, &texture);
+    for (uint32_t unit = 0; unit < GL_STATE_MAX_TEXTURE_UNITS; ++unit)
+    {
+        for (uint32_t target = 0; target < GL_STATE_TEXTURE_TARGET_COUNT; ++target)
+        {
+            if (gl_state.textures[unit][target] == texture)
+            {
+                gl_state.textures[unit][target] = 0;
+            }
+        }
+    }
+}
+
+void gl_state_bind_sampler(uint32_t unit, uint32_t sampler)
+{
+    assert(unit < GL_STATE_MAX_TEXTURE_UNITS);
+    bool changed = gl_state.samplers[unit] != sampler;
+    if (changed)
+    {
+        glBindSampler(unit, sampler);
+        gl_state.samplers[unit] = sampler;
+    }
+    gl_state_count(changed);
+}
+
+// GL_FRAMEBUFFER sets both the draw and the read binding.
+void gl_state_bind_framebuffer(uint32_t target, uint32_t framebuffer)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool changed = (draw && gl_state.draw_framebuffer != framebuffer) || (read && gl_state.read_framebuffer != framebuffer);
+    if (changed)
+    {
+        glBindFramebuffer(target, framebuffer);
+        if (draw)
+        {
+            gl_state.draw_framebuffer = framebuffer;
+        }
+        if (read)
+        {
+            gl_state.read_framebuffer = framebuffer;
+        }
+    }
+    gl_state_count(changed);
+}
+
+//
+// Fixed function
+//
+
+inline void gl_state_set_capability(uint32_t *shadow, uint32_t capability, bool enabled)
+{
+    bool changed = *shadow != (uint32_t)enabled;
+    if (changed)
+    {
+        if (enabled)
+        {
+            glEnable(capability);
+        }
+        else
+        {
+            glDisable(capability);
+        }
+        *shadow = enabled;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_blend(bool enabled)
+{
+    gl_state_set_capability(&gl_state.blend_enabled, GL_BLEND, enabled);
+}
+
+void gl_state_set_blend_function(uint32_t source_rgb, uint32_t destination_rgb, uint32_t source_alpha, uint32_t destination_alpha)
+{
+    uint32_t *function = gl_state.blend_function;
+    bool changed = function[0] != source_rgb || function[1] != destination_rgb || function[2] != source_alpha || function[3] != destination_alpha;
+    if (changed)
+    {
+        glBlendFuncSeparate(source_rgb, destination_rgb, source_alpha, destination_alpha);
+        function[0] = source_rgb;
+        function[1] = destination_rgb;
+        function[2] = source_alpha;
+        function[3] = destination_alpha;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_blend_equation(uint32_t rgb, uint32_t alpha)
+{
+    bool changed = gl_state.blend_equation[0] != rgb || gl_state.blend_equation[1] != alpha;
+    if (changed)
+    {
+        glBlendEquationSeparate(rgb, alpha);
+        gl_state.blend_equation[0] = rgb;
+        gl_state.blend_equation[1] = alpha;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_depth_test(bool enabled)
+{
+    gl_state_set_capability(&gl_state.depth_test_enabled, GL_DEPTH_TEST, enabled);
+}
+
+void gl_state_set_depth_write(bool enabled)
+{
+    bool changed = gl_state.depth_write_enabled != (uint32_t)enabled;
+    if (changed)
+    {
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        gl_state.depth_write_enabled = enabled;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_depth_function(uint32_t function)
+{
+    bool changed = gl_state.depth_function != function;
+    if (changed)
+    {
+        glDepthFunc(function);
+        gl_state.depth_function = function;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_cull(bool enabled)
+{
+    gl_state_set_capability(&gl_state.cull_enabled, GL_CULL_FACE, enabled);
+}
+
+void gl_state_set_cull_face(uint32_t face)
+{
+    bool changed = gl_state.cull_face != face;
+    if (changed)
+    {
+        glCullFace(face);
+        gl_state.cull_face = face;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_front_face(uint32_t mode)
+{
+    bool changed = gl_state.front_face != mode;
+    if (changed)
+    {
+        glFrontFace(mode);
+        gl_state.front_face = mode;
+    }
+    gl_state_count(changed);
+}
+
+// mask has red in bit 0 through alpha in bit 3.
+void gl_state_set_color_mask(uint32_t mask)
+{
+    bool changed = gl_state.color_mask != mask;
+    if (changed)
+    {
+        glColorMask((mask & 1) != 0, (mask & 2) != 0, (mask & 4) != 0, (mask & 8) != 0);
+        gl_state.color_mask = mask;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_stencil_test(bool enabled)
+{
+    gl_state_set_capability(&gl_state.stencil_test_enabled, GL_STENCIL_TEST, enabled);
+}
+
+// Front and back faces alike.
+void gl_state_set_stencil_function(uint32_t function, int32_t reference, uint32_t read_mask)
+{
+    uint32_t *shadow = gl_state.stencil_function;
+    bool changed = shadow[0] != function || shadow[1] != (uint32_t)reference || shadow[2] != read_mask;
+    if (changed)
+    {
+        glStencilFunc(function, reference, read_mask);
+        shadow[0] = function;
+        shadow[1] = (uint32_t)reference;
+        shadow[2] = read_mask;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_stencil_operation(uint32_t stencil_fail, uint32_t depth_fail, uint32_t pass)
+{
+    uint32_t *shadow = gl_state.stencil_operation;
+    bool changed = shadow[0] != stencil_fail || shadow[1] != depth_fail || shadow[2] != pass;
+    if (changed)
+    {
+        glStencilOp(stencil_fail, depth_fail, pass);
+        shadow[0] = stencil_fail;
+        shadow[1] = depth_fail;
+        shadow[2] = pass;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_stencil_write_mask(uint32_t mask)
+{
+    bool changed = gl_state.stencil_write_mask != mask;
+    if (changed)
+    {
+        glStencilMask(mask);
+        gl_state.stencil_write_mask = mask;
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_polygon_mode(uint32_t mode)
+{
+    bool changed = gl_state.polygon_mode != mode;
+    if (changed)
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        gl_state.polygon_mode = mode;
+    }
+    gl_state_count(changed);
+}
+
+// Offset for filled polygons only.
+void gl_state_set_polygon_offset(bool enabled, real32_t factor, real32_t units)
+{
+    gl_state_set_capability(&gl_state.polygon_offset_enabled, GL_POLYGON_OFFSET_FILL, enabled);
+    if (!enabled)
+    {
+        return;
+    }
+
+    uint32_t bits[2];
+    memcpy(&bits[0], &factor, sizeof(factor));
+    memcpy(&bits[1], &units, sizeof(units));
+    bool changed = gl_state.polygon_offset[0] != bits[0] || gl_state.polygon_offset[1] != bits[1];
+    if (changed)
+    {
+        glPolygonOffset(factor, units);
+        gl_state.polygon_offset[0] = bits[0];
+        gl_state.polygon_offset[1] = bits[1];
+    }
+    gl_state_count(changed);
+}
+
+void gl_state_set_scissor_test(bool enabled)
+{
+    gl_state_set_capability(&gl_state.scissor_test_enabled, GL_SCISSOR_TEST, enabled);
+}
+
+//
+// Uniforms of the program in use
+//
+
+// Returns true when the value differs from what the program already holds,
+// recording it. Uniforms set without a cached program always go through.
+bool gl_state_update_uniform(int32_t location, uint32_t type, const void *value, uint32_t size)
+{
+    assert(size <= GL_STATE_UNIFORM_MAX_WORDS * sizeof(uint32_t));
+    gl_state_program_t *program = gl_state.current_program;
+    if (location < 0 || !program)
+    {
+        return location >= 0;
+    }
+
+    if ((uint32_t)location >= program->uniform_capacity)
+    {
+        uint32_t capacity = program->uniform_capacity ? program->uniform_capacity : 16;
+        while (capacity <= (uint32_t)location)
+        {
+            capacity *= 2;
+        }
+        program->uniforms = (gl_state_uniform_t *)realloc(program->uniforms, capacity * sizeof(gl_state_uniform_t));
+        assert(program->uniforms);
+        memset(program->uniforms + program->uniform_capacity, 0, (capacity - program->uniform_capacity) * sizeof(gl_state_uniform_t));
+        program->uniform_capacity = capacity;
+    }
+
+    gl_state_uniform_t *uniform = &program->uniforms[location];
+    bool changed = uniform->type != type || memcmp(uniform->words, value, size) != 0;
+    if (changed)
+    {
+        uniform->type = type;
+        memcpy(uniform->words, value, size);
+        ++gl_state.stats.uniforms_issued;
+    }
+    else
+    {
+        ++gl_state.stats.uniforms_skipped;
+    }
+    return changed;
+}
+
+// Arrays are uploaded every time, but the elements they cover are forgotten.
+void gl_state_forget_uniforms(int32_t location, int32_t count)
+{
+    gl_state_program_t *program = gl_state.current_program;
+    if (location < 0 || !program)
+    {
+        return;
+    }
+    for (int32_t i = location; i < location + count && (uint32_t)i < program->uniform_capacity; ++i)
+    {
+        program->uniforms[i].type = GL_STATE_UNIFORM_UNKNOWN;
+    }
+    ++gl_state.stats.uniforms_issued;
+}
+
+void gl_state_uniform_1i(int32_t location, int32_t value)
+{
+    if (gl_state_update_uniform(location, GL_STATE_UNIFORM_INT, &value, sizeof(value)))
+    {
+        glUniform1i(location, value);
+    }
+}
+
+void gl_state_uniform_1ui(int32_t location, uint32_t value)
+{
+    if (gl_state_update_uniform(location, GL_STATE_UNIFORM_UINT, &value, sizeof(value)))
+    {
+        glUniform1ui(location, value);
+    }
+}
+
+void gl_state_uniform_1f(int32_t location, real32_t value)
+{
+    if (gl_state_update_uniform(location, GL_STATE_UNIFORM_FLOAT, &value, sizeof(value)))
+    {
+        glUniform1f(location, value);
+    }
+}
+
+void gl_state_uniform_2fv(int32_t location, int32_t count, const real32_t *value)
+{
+    if (count != 1)
+    {
+        gl_state_forget_uniforms(location, count);
+        glUniform2fv(location, count, value);
+    }
+    else if (gl_state_update_uniform(location, GL_STATE_UNIFORM_VEC2, value, 2 * sizeof(real32_t)))
+    {
+        glUniform2fv(location, 1, value);
+    }
+}
+
+void gl_state_uniform_3fv(int32_t location, int32_t count, const real32_t *value)
+{
+    if (count != 1)
+    {
+        gl_state_forget_uniforms(location, count);
+        glUniform3fv(location, count, value);
+    }
+    else if (gl_state_update_uniform(location, GL_STATE_UNIFORM_VEC3, value, 3 * sizeof(real32_t)))
+    {
+        glUniform3fv(location, 1, value);
+    }
+}
+
+void gl_state_uniform_4fv(int32_t location, int32_t count, const real32_t *value)
+{
+    if (count != 1)
+    {
+        gl_state_forget_uniforms(location, count);
+        glUniform4fv(location, count, value);
+    }
+    else if (gl_state_update_uniform(location, GL_STATE_UNIFORM_VEC4, value, 4 * sizeof(real32_t)))
+    {
+        glUniform4fv(location, 1, value);
+    }
+}
+
+// Transposed uploads are cached as their own type, so switching the flag
+// for the same bits still reaches GL.
+void gl_state_uniform_matrix_4fv(int32_t location, int32_t count, bool transpose, const real32_t *value)
+{
+    if (count != 1)
+    {
+        gl_state_forget_uniforms(location, count * 4);
+        glUniformMatrix4fv(location, count, transpose ? GL_TRUE : GL_FALSE, value);
+    }
+    else if (gl_state_update_uniform(location, GL_STATE_UNIFORM_MAT4 | (transpose ? 0x100 : 0), value, 16 * sizeof(real32_t)))
+    {
+        glUniformMatrix4fv(location, 1, transpose ? GL_TRUE : GL_FALSE, value);
+    }
+}
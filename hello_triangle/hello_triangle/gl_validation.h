@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdint.h>
+#include "opengl.h"
+
+// GL error reporting through KHR_debug. With GL_VALIDATION defined (see
+// gl_dispatch.h) every dispatched call records its entry point and source
+// location, and the driver reports errors to a debug message callback instead
+// of the code polling glGetError, which would drain the pipeline after every
+// call. The platform backends install the callback on every render context;
+// shared contexts call gl_validation_initialize() once they are current.
+//
+// Output is asynchronous by default: the driver may report an error some
+// calls after the one that caused it, so each message lists the latest calls
+// of the thread that installed the callback. gl_validation_initialize(true)
+// makes the callback run inside the failing call, which costs speed but makes
+// the first call listed the culprit, unless it was a GL 1.1 function, which
+// bypasses the dispatch table and is not recorded.
+//
+// Without GL_VALIDATION nothing is recorded and the functions below do nothing.
+
+#define GL_VALIDATION_REPORTED_CALLS 4
+
+#ifdef GL_VALIDATION
+
+struct gl_validation_stats_t
+{
+    std::atomic<uint32_t> messages;
+    std::atomic<uint32_t> errors;   // GL_DEBUG_TYPE_ERROR messages
+};
+
+gl_validation_stats_t gl_validation_stats;
+
+const char *gl_validation_type_name(GLenum type)
+{
+    switch (type)
+    {
+    case GL_DEBUG_TYPE_ERROR: return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+    default: return "other";
+    }
+}
+
+const char *gl_validation_severity_name(GLenum severity)
+{
+    switch (severity)
+    {
+    case GL_DEBUG_SEVERITY_HIGH: return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+    case GL_DEBUG_SEVERITY_LOW: return "low";
+    default: return "notification";
+    }
+}
+
+// user is the call history of the thread that installed the callback.
+void APIENTRY gl_validation_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *user)
+{
+    (void)source;
+    (void)length;
+    gl_validation_stats.messages.fetch_add(1, std::memory_order_relaxed);
+    if (type == GL_DEBUG_TYPE_ERROR)
+    {
+        gl_validation_stats.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    fprintf(stderr, "gl_validation: %s %s %u: %s\n", gl_validation_severity_name(severity), gl_validation_type_name(type), id, message);
+
+    const gl_validation_history_t *history = (const gl_validation_history_t *)user;
+    uint32_t count = history->count.load(std::memory_order_acquire);
+    if (!count)
+    {
+        fprintf(stderr, "    before any dispatched call\n");
+        return;
+    }
+    uint32_t reported = count < GL_VALIDATION_REPORTED_CALLS ? count : GL_VALIDATION_REPORTED_CALLS;
+    for (uint32_t i = 0; i < reported; ++i)
+    {
+        const gl_validation_call_t *call = &history->calls[(count - 1 - i) & (GL_VALIDATION_HISTORY - 1)];
+        fprintf(stderr, "    %s %s at %s:%u\n", i ? "      " : "after", gl_dispatch_name(call->function.load(std::memory_order_relaxed)),
+            call->file.load(std::memory_order_relaxed), call->line.load(std::memory_order_relaxed));
+    }
+}
+
+// Installs the callback on the current context and mutes notifications.
+// Returns false when the context has no KHR_debug.
+bool gl_validation_initialize(bool synchronous)
+{
+    if (!gl_dispatch_available(GL_DISPATCH_glDebugMessageCallback) ||
+        !gl_dispatch_available(GL_DISPATCH_glDebugMessageControl) ||
+        !gl_supports(4, 3, "GL_KHR_debug"))
+    {
+        fprintf(stderr, "gl_validation: KHR_debug is not available, GL errors go unreported\n");
+        return false;
+    }
+
+    glEnable(GL_DEBUG_OUTPUT);
+    if (synchronous)
+    {
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    else
+    {
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    glDebugMessageCallback(gl_validation_callback, &gl_validation_history);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+    return true;
+}
+
+// Calls per entry point since the last reset, across all threads.
+void gl_validation_print_counts(FILE *file)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < GL_DISPATCH_COUNT; ++i)
+    {
+        uint32_t count = gl_validation_counts[i].load(std::memory_order_relaxed);
+        if (count)
+        {
+            fprintf(file, "%-48s %10u\n", gl_dispatch_name(i), count);
+            total += count;
+        }
+    }
+    fprintf(file, "%-48s %10llu\n", "total", (unsigned long long)total);
+}
+
+void gl_validation_reset_counts()
+{
+    for (uint32_t i = 0; i < GL_DISPATCH_COUNT; ++i)
+    {
+        gl_validation_counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+bool gl_validation_initialize(bool synchronous)
+{
+    (void)synchronous;
+    return false;
+}
+
+void gl_validation_print_counts(FILE *file)
+{
+    (void)file;
+}
+
+void gl_validation_reset_counts()
+{
+}
+
+#endif
@@ -0,0 +1,557 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+#include "opengl.h"
+#include "gl_state.h"
+#include "instancing.h"
+
+// Instance culling on the GPU, feeding the multi-draw path without a CPU
+// readback. Needs GL 4.3 for compute shaders; llvmpipe is enough.
+//
+// Instances are grouped by mesh: every mesh gets a fixed range of
+// instance_capacity slots in the visible instance buffer. Each frame three
+// compute passes run:
+//
+//   reset    one command per mesh with no instances, draw count 0
+//   cull     one thread per instance: frustum test against the planes of the
+//            view-projection and optionally a Hi-Z occlusion test, then the
+//            survivors are appended to their mesh's range
+//   compact  commands that kept instances are appended to the compacted
+//            command buffer, their number goes to the draw count
+//
+// gpu_culling_draw() submits the compacted commands with
+// glMultiDrawElementsIndirectCount; without GL 4.6 or
+// GL_ARB_indirect_parameters it draws all per-mesh commands instead, the ones
+// without instances cost next to nothing.
+//
+// The Hi-Z pyramid is built from a depth texture drawn before culling, the
+// previous frame's depth or an occluder pass. It lives in a storage buffer
+// with a table of level offsets rather than in a mipmapped texture: the cull
+// pass reads a different level in every thread, and llvmpipe gets
+// texelFetch() with divergent levels wrong.
+
+#define GPU_CULLING_GROUP_SIZE 64
+#define GPU_CULLING_HIZ_MAX_LEVELS 16
+
+// Bounding sphere in world space, center in xyz and radius in w.
+struct gpu_cull_bounds_t
+{
+    vector4_t sphere;
+    uint32_t mesh;
+    uint32_t pad[3];
+};
+
+struct gpu_cull_mesh_t
+{
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t instance_capacity;
+};
+
+// std430 layout of the mesh table.
+struct gpu_cull_mesh_entry_t
+{
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t first_instance;
+    uint32_t instance_capacity;
+    uint32_t pad[3];
+};
+
+struct gpu_culling_t
+{
+    uint32_t reset_program;
+    uint32_t cull_program;
+    uint32_t compact_program;
+    uint32_t hiz_program;
+
+    uint32_t instance_buffer;
+    uint32_t bounds_buffer;
+    uint32_t mesh_buffer;
+    uint32_t command_buffer;
+    uint32_t compacted_buffer;
+    uint32_t count_buffer;
+    uint32_t visible_buffer;
+
+    uint32_t max_meshes;
+    uint32_t max_instances;
+    uint32_t mesh_count;
+    uint32_t instance_count;
+
+    uint32_t hiz_buffer;
+    uint32_t hiz_width;
+    uint32_t hiz_height;
+    uint32_t hiz_levels;
+    bool hiz_valid;
+
+    bool draw_count_core;
+    bool draw_count_arb;
+};
+
+const char *gpu_culling_source = R"(
+
+struct instance_t { mat4 transform; vec4 color; };
+struct bounds_t { vec4 sphere; uint mesh; uint pad0; uint pad1; uint pad2; };
+struct mesh_t { uint index_count; uint first_index; int base_vertex; uint first_instance; uint instance_capacity; uint pad0; uint pad1; uint pad2; };
+struct command_t { uint index_count; uint instance_count; uint first_index; int base_vertex; uint base_instance; };
+
+layout(std430, binding = 0) readonly buffer instance_block { instance_t instances[]; };
+layout(std430, binding = 1) readonly buffer bounds_block { bounds_t bounds[]; };
+layout(std430, binding = 2) readonly buffer mesh_block { mesh_t meshes[]; };
+layout(std430, binding = 3) buffer command_block { command_t commands[]; };
+layout(std430, binding = 4) writeonly buffer compacted_block { command_t compacted[]; };
+layout(std430, binding = 5) buffer count_block { uint draw_count; };
+layout(std430, binding = 6) writeonly buffer visible_block { instance_t visible[]; };
+layout(std430, binding = 7) readonly buffer hiz_block { uvec4 hiz_table[HIZ_MAX_LEVELS]; float hiz[]; };
+
+layout(location = 0) uniform uint item_count;
+layout(location = 1) uniform mat4 view_projection;
+layout(location = 2) uniform vec4 planes[6];
+layout(location = 8) uniform int hiz_levels;
+
+layout(local_size_x = GROUP_SIZE) in;
+
+#if STAGE_RESET
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index == 0)
+    {
+        draw_count = 0u;
+    }
+    if (index < item_count)
+    {
+        mesh_t mesh = meshes[index];
+        commands[index] = command_t(mesh.index_count, 0u, mesh.first_index, mesh.base_vertex, mesh.first_instance);
+    }
+}
+
+#elif STAGE_CULL
+
+float hiz_fetch(uvec4 level, ivec2 position)
+{
+    return hiz[level.x + uint(position.y) * level.y + uint(position.x)];
+}
+
+// Projects the box around the sphere, picks the pyramid level where it
+// covers at most 2x2 texels and compares its nearest depth against the
+// farthest depth stored there. Table entries are offset, width, height.
+//
+// Levels are floor-halved and the reduce folds the odd row and column into
+// the last texel, so texel x of a level covers level 0 texels x << level up
+// to the next one. The corners are therefore mapped in level 0 texels and
+// shifted down; scaling them by the level size would drift below the texels
+// that cover them on odd levels. Clamping to the level size lands past-the-end
+// texels in the last one, which holds them.
+bool is_occluded(vec4 sphere)
+{
+    vec2 rect_min = vec2(1.0);
+    vec2 rect_max = vec2(0.0);
+    float nearest = 1.0;
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = view_projection * vec4(corner, 1.0);
+        if (clip.w <= 0.0)
+        {
+            return false;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        rect_min = min(rect_min, ndc.xy * 0.5 + 0.5);
+        rect_max = max(rect_max, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    rect_min = clamp(rect_min, 0.0, 1.0);
+    rect_max = clamp(rect_max, 0.0, 1.0);
+
+    vec2 size = (rect_max - rect_min) * vec2(hiz_table[0].yz);
+    int level = min(int(ceil(log2(max(max(size.x, size.y), 1.0)))), hiz_levels - 1);
+    uvec4 table = hiz_table[level];
+    ivec2 level_size = ivec2(table.yz);
+    ivec2 level0_size = ivec2(hiz_table[0].yz);
+    ivec2 a = min(min(ivec2(rect_min * vec2(level0_size)), level0_size - 1) >> level, level_size - 1);
+    ivec2 b = min(min(ivec2(rect_max * vec2(level0_size)), level0_size - 1) >> level, level_size - 1);
+
+    float farthest = max(max(hiz_fetch(table, a), hiz_fetch(table, ivec2(b.x, a.y))),
+                         max(hiz_fetch(table, ivec2(a.x, b.y)), hiz_fetch(table, b)));
+    return nearest > farthest;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= item_count)
+    {
+        return;
+    }
+
+    vec4 sphere = bounds[index].sphere;
+    for (int i = 0; i < 6; ++i)
+    {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w)
+        {
+            return;
+        }
+    }
+    if (hiz_levels > 0 && is_occluded(sphere))
+    {
+        return;
+    }
+
+    uint mesh = bounds[index].mesh;
+    uint slot = atomicAdd(commands[mesh].instance_count, 1u);
+    if (slot < meshes[mesh].instance_capacity)
+    {
+        visible[meshes[mesh].first_instance + slot] = instances[index];
+    }
+}
+
+#elif STAGE_COMPACT
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= item_count)
+    {
+        return;
+    }
+
+    command_t command = commands[index];
+    command.instance_count = min(command.instance_count, meshes[index].instance_capacity);
+    commands[index].instance_count = command.instance_count;
+    if (command.instance_count > 0u)
+    {
+        compacted[atomicAdd(draw_count, 1u)] = command;
+    }
+}
+
+#endif
+
+)";
+
+// Level 0 copies the depth texture, every other level max-reduces the one
+// before it. The last row and column pick up the extra source texel of odd
+// sizes so nothing is dropped.
+const char *gpu_culling_hiz_source = R"(
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(std430, binding = 7) buffer hiz_block { uvec4 hiz_table[HIZ_MAX_LEVELS]; float hiz[]; };
+layout(binding = 0) uniform sampler2D depth;
+layout(location = 0) uniform int level;
+
+void main()
+{
+    ivec2 position = ivec2(gl_GlobalInvocationID.xy);
+    uvec4 destination = hiz_table[level];
+    if (position.x >= int(destination.y) || position.y >= int(destination.z))
+    {
+        return;
+    }
+
+    float farthest = 0.0;
+    if (level == 0)
+    {
+        farthest = texelFetch(depth, position, 0).r;
+    }
+    else
+    {
+        uvec4 source = hiz_table[level - 1];
+        ivec2 begin = position * 2;
+        ivec2 end = min(begin + 1, ivec2(source.yz) - 1);
+        if (position.x == int(destination.y) - 1) end.x = int(source.y) - 1;
+        if (position.y == int(destination.z) - 1) end.y = int(source.z) - 1;
+
+        for (int y = begin.y; y <= end.y; ++y)
+        {
+            for (int x = begin.x; x <= end.x; ++x)
+            {
+                farthest = max(farthest, hiz[source.x + uint(y) * source.y + uint(x)]);
+            }
+        }
+    }
+    hiz[destination.x + uint(position.y) * destination.y + uint(position.x)] = farthest;
+}
+
+)";
+
+uint32_t gpu_culling_compile(const char *prefix, const char *source)
+{
+    const char *sources[] = { prefix, source };
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 2, sources, NULL);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status)
+    {
+        char log[2048];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "gpu_culling: %s\n", log);
+    }
+    assert(status);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    assert(status);
+    return program;
+}
+
+uint32_t gpu_culling_create_buffer(uint32_t size)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    return buffer;
+}
+
+gpu_culling_t *gpu_culling_create(uint32_t max_meshes, uint32_t max_instances)
+{
+    assert(gl_supports(4, 3, "GL_ARB_compute_shader"));
+
+    gpu_culling_t *culling = new gpu_culling_t();
+    culling->max_meshes = max_meshes;
+    culling->max_instances = max_instances;
+
+    char prefix[160];
+    const char *format = "#version 430\n#define GROUP_SIZE %d\n#define HIZ_MAX_LEVELS %d\n#define STAGE_RESET %d\n#define STAGE_CULL %d\n#define STAGE_COMPACT %d\n";
+    snprintf(prefix, sizeof(prefix), format, GPU_CULLING_GROUP_SIZE, GPU_CULLING_HIZ_MAX_LEVELS, 1, 0, 0);
+    culling->reset_program = gpu_culling_compile(prefix, gpu_culling_source);
+    snprintf(prefix, sizeof(prefix), format, GPU_CULLING_GROUP_SIZE, GPU_CULLING_HIZ_MAX_LEVELS, 0, 1, 0);
+    culling->cull_program = gpu_culling_compile(prefix, gpu_culling_source);
+    snprintf(prefix, sizeof(prefix), format, GPU_CULLING_GROUP_SIZE, GPU_CULLING_HIZ_MAX_LEVELS, 0, 0, 1);
+    culling->compact_program = gpu_culling_compile(prefix, gpu_culling_source);
+    culling->hiz_program = gpu_culling_compile(prefix, gpu_culling_hiz_source);
+
+    culling->instance_buffer = gpu_culling_create_buffer(max_instances * sizeof(instance_t));
+    culling->bounds_buffer = gpu_culling_create_buffer(max_instances * sizeof(gpu_cull_bounds_t));
+    culling->mesh_buffer = gpu_culling_create_buffer(max_meshes * sizeof(gpu_cull_mesh_entry_t));
+    culling->command_buffer = gpu_culling_create_buffer(max_meshes * sizeof(draw_elements_indirect_t));
+    culling->compacted_buffer = gpu_culling_create_buffer(max_meshes * sizeof(draw_elements_indirect_t));
+    culling->count_buffer = gpu_culling_create_buffer(sizeof(uint32_t));
+    culling->visible_buffer = gpu_culling_create_buffer(max_instances * sizeof(instance_t));
+
+    culling->draw_count_core = gl_dispatch_available(GL_DISPATCH_glMultiDrawElementsIndirectCount) && gl_supports(4, 6, NULL);
+    culling->draw_count_arb = !culling->draw_count_core && gl_dispatch_available(GL_DISPATCH_glMultiDrawElementsIndirectCountARB) && gl_has_extension("GL_ARB_indirect_parameters");
+    return culling;
+}
+
+void gpu_culling_destroy(gpu_culling_t *culling)
+{
+    gl_state_delete_program(culling->reset_program);
+    gl_state_delete_program(culling->cull_program);
+    gl_state_delete_program(culling->compact_program);
+    gl_state_delete_program(culling->hiz_program);
+
+    gl_state_delete_buffer(culling->instance_buffer);
+    gl_state_delete_buffer(culling->bounds_buffer);
+    gl_state_delete_buffer(culling->mesh_buffer);
+    gl_state_delete_buffer(culling->command_buffer);
+    gl_state_delete_buffer(culling->compacted_buffer);
+    gl_state_delete_buffer(culling->count_buffer);
+    gl_state_delete_buffer(culling->visible_buffer);
+    if (culling->hiz_buffer)
+    {
+        gl_state_delete_buffer(culling->hiz_buffer);
+    }
+    delete culling;
+}
+
+// Meshes rarely change, so their table is uploaded on its own. Instances of
+// mesh i may only use mesh i's instance_capacity slots; extras are dropped.
+void gpu_culling_set_meshes(gpu_culling_t *culling, const gpu_cull_mesh_t *meshes, uint32_t count)
+{
+    assert(count <= culling->max_meshes);
+
+    gpu_cull_mesh_entry_t entries[256];
+    uint32_t first_instance = 0;
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culling->mesh_buffer);
+    for (uint32_t begin = 0; begin < count; begin += 256)
+    {
+        uint32_t batch = count - begin < 256 ? count - begin : 256;
+        for (uint32_t i = 0; i < batch; ++i)
+        {
+            const gpu_cull_mesh_t *mesh = &meshes[begin + i];
+            entries[i] = {};
+            entries[i].index_count = mesh->index_count;
+            entries[i].first_index = mesh->first_index;
+            entries[i].base_vertex = mesh->base_vertex;
+            entries[i].first_instance = first_instance;
+            entries[i].instance_capacity = mesh->instance_capacity;
+            first_instance += mesh->instance_capacity;
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, begin * sizeof(gpu_cull_mesh_entry_t), batch * sizeof(gpu_cull_mesh_entry_t), entries);
+    }
+    assert(first_instance <= culling->max_instances);
+    culling->mesh_count = count;
+}
+
+// One upload for all instances, skip it on frames where nothing moved.
+void gpu_culling_set_instances(gpu_culling_t *culling, const instance_t *instances, const gpu_cull_bounds_t *bounds, uint32_t count)
+{
+    assert(count <= culling->max_instances);
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culling->instance_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(instance_t), instances);
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culling->bounds_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(gpu_cull_bounds_t), bounds);
+    culling->instance_count = count;
+}
+
+// Builds the max-depth pyramid from depth_texture, which has to be sampleable
+// (a depth texture, not a renderbuffer).
+void gpu_culling_build_hiz(gpu_culling_t *culling, uint32_t depth_texture, uint32_t width, uint32_t height)
+{
+    if (culling->hiz_width != width || culling->hiz_height != height)
+    {
+        if (culling->hiz_buffer)
+        {
+            gl_state_delete_buffer(culling->hiz_buffer);
+        }
+
+        uint32_t table[GPU_CULLING_HIZ_MAX_LEVELS][4] = {};
+        uint32_t level_width = width;
+        uint32_t level_height = height;
+        uint32_t offset = 0;
+        culling->hiz_levels = 0;
+        for (;;)
+        {
+            assert(culling->hiz_levels < GPU_CULLING_HIZ_MAX_LEVELS);
+            uint32_t *level = table[culling->hiz_levels++];
+            level[0] = offset;
+            level[1] = level_width;
+            level[2] = level_height;
+            offset += level_width * level_height;
+            if (level_width == 1 && level_height == 1)
+            {
+                break;
+            }
+            level_width = level_width > 1 ? level_width / 2 : 1;
+            level_height = level_height > 1 ? level_height / 2 : 1;
+        }
+
+        culling->hiz_buffer = gpu_culling_create_buffer(sizeof(table) + offset * sizeof(real32_t));
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(table), table);
+        culling->hiz_width = width;
+        culling->hiz_height = height;
+    }
+
+    gl_state_use_program(culling->hiz_program);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, depth_texture);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 7, culling->hiz_buffer, 0, -1);
+    for (uint32_t level = 0; level < culling->hiz_levels; ++level)
+    {
+        uint32_t level_width = width >> level ? width >> level : 1;
+        uint32_t level_height = height >> level ? height >> level : 1;
+        gl_state_uniform_1i(0, (int32_t)level);
+        glDispatchCompute((level_width + 7) / 8, (level_height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    culling->hiz_valid = true;
+}
+
+// Normalized planes with the inside on the positive side, from the rows of
+// the matrix.
+void gpu_culling_frustum_planes(const matrix4_t &view_projection, vector4_t planes[6])
+{
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        for (uint32_t side = 0; side < 2; ++side)
+        {
+            real32_t sign = side ? -1.0f : 1.0f;
+            vector4_t plane;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                plane.v[i] = view_projection.col[i].v[3] + sign * view_projection.col[i].v[axis];
+            }
+            real32_t length = (real32_t)sqrt((double)(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z));
+            planes[axis * 2 + side] = plane / length;
+        }
+    }
+}
+
+void gpu_culling_run(gpu_culling_t *culling, const matrix4_t &view_projection, bool use_hiz)
+{
+    assert(!use_hiz || culling->hiz_valid);
+
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 0, culling->instance_buffer, 0, -1);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 1, culling->bounds_buffer, 0, -1);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 2, culling->mesh_buffer, 0, -1);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 3, culling->command_buffer, 0, -1);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 4, culling->compacted_buffer, 0, -1);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 5, culling->count_buffer, 0, -1);
+    gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 6, culling->visible_buffer, 0, -1);
+    if (use_hiz)
+    {
+        gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, 7, culling->hiz_buffer, 0, -1);
+    }
+
+    uint32_t mesh_groups = (culling->mesh_count + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE;
+    gl_state_use_program(culling->reset_program);
+    gl_state_uniform_1ui(0, culling->mesh_count);
+    glDispatchCompute(mesh_groups ? mesh_groups : 1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    vector4_t planes[6];
+    gpu_culling_frustum_planes(view_projection, planes);
+    gl_state_use_program(culling->cull_program);
+    gl_state_uniform_1ui(0, culling->instance_count);
+    gl_state_uniform_matrix_4fv(1, 1, false, view_projection.col[0].v);
+    gl_state_uniform_4fv(2, 6, planes[0].v);
+    gl_state_uniform_1i(8, use_hiz ? (int32_t)culling->hiz_levels : 0);
+    if (culling->instance_count)
+    {
+        glDispatchCompute((culling->instance_count + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE, 1, 1);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    gl_state_use_program(culling->compact_program);
+    gl_state_uniform_1ui(0, culling->mesh_count);
+    if (mesh_groups)
+    {
+        glDispatchCompute(mesh_groups, 1, 1);
+    }
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Draws what the last gpu_culling_run() left visible. vertex_array holds the
+// meshes of the table, with their index buffer bound.
+void gpu_culling_draw(gpu_culling_t *culling, uint32_t vertex_array, uint32_t mode, uint32_t index_type)
+{
+    if (!culling->mesh_count)
+    {
+        return;
+    }
+
+    instancing_bind_instances(vertex_array, culling->visible_buffer, 0);
+    if (culling->draw_count_core || culling->draw_count_arb)
+    {
+        gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, culling->compacted_buffer);
+        gl_state_bind_buffer(GL_PARAMETER_BUFFER, culling->count_buffer);
+        if (culling->draw_count_core)
+        {
+            glMultiDrawElementsIndirectCount(mode, index_type, NULL, 0, culling->mesh_count, 0);
+        }
+        else
+        {
+            glMultiDrawElementsIndirectCountARB(mode, index_type, NULL, 0, culling->mesh_count, 0);
+        }
+    }
+    else
+    {
+        gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, culling->command_buffer);
+        glMultiDrawElementsIndirect(mode, index_type, NULL, culling->mesh_count, 0);
+    }
+}
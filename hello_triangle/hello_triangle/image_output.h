@@ -0,0 +1,892 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "jobs.h"
+#include "framebuffer.h"
+
+// Writes finished frames to disk as PPM, QOI or PNG. Frames wait in a small
+// fixed queue and a writer thread encodes them, splitting each image into
+// row stripes that its own worker pool encodes in parallel, so the render
+// thread only stalls when the queue is full. Pixels are RGBA8 with red in
+// the lowest byte, which is what GL_RGBA/GL_UNSIGNED_BYTE reads back.
+
+#define IMAGE_OUTPUT_QUEUE_SIZE 4
+#define IMAGE_OUTPUT_MAX_PATH 260
+#define IMAGE_OUTPUT_STRIPES_PER_WORKER 4
+
+enum image_format_t
+{
+    IMAGE_FORMAT_PPM,
+    IMAGE_FORMAT_QOI,
+    IMAGE_FORMAT_PNG,
+};
+
+struct image_output_frame_t
+{
+    uint32_t *pixels;
+    size_t capacity;        // in pixels
+    uint32_t width;
+    uint32_t height;
+    bool bottom_up;         // row 0 is the bottom row, as glReadPixels returns it
+    image_format_t format;
+    char path[IMAGE_OUTPUT_MAX_PATH];
+};
+
+// Encoded bytes of one stripe of rows.
+struct image_stripe_t
+{
+    uint32_t first_row;
+    uint32_t row_count;
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint32_t adler;         // PNG only, of this stripe's filtered bytes
+};
+
+// Per-worker LZ77 match finder state.
+#define IMAGE_DEFLATE_WINDOW 32768
+#define IMAGE_DEFLATE_HASH_BITS 15
+#define IMAGE_DEFLATE_MAX_CHAIN 32
+
+struct image_deflate_scratch_t
+{
+    int32_t head[1 << IMAGE_DEFLATE_HASH_BITS];
+    int32_t previous[IMAGE_DEFLATE_WINDOW];
+};
+
+struct image_output_t
+{
+    job_pool_t *pool;
+    std::thread writer;
+
+    std::mutex mutex;
+    std::condition_variable frame_ready;
+    std::condition_variable frame_done;
+    image_output_frame_t frames[IMAGE_OUTPUT_QUEUE_SIZE];
+    uint32_t first;         // oldest frame that is not written yet
+    uint32_t reserved;      // frames handed out by begin_frame and not written yet
+    uint32_t ready;         // of those, the ones end_frame has submitted
+    bool quit;
+
+    // Encoder state, only touched by the writer thread and its pool.
+    const image_output_frame_t *frame;
+    image_stripe_t *stripes;
+    uint32_t stripe_count;
+    uint32_t stripe_capacity;
+    uint8_t *filtered;
+    size_t filtered_capacity;
+    image_deflate_scratch_t *deflate_scratch;
+
+    std::atomic<uint32_t> frames_written;
+    std::atomic<uint32_t> frames_failed;
+    std::atomic<uint64_t> bytes_written;
+};
+
+inline const uint32_t *image_output_row(const image_output_frame_t *frame, uint32_t y)
+{
+    uint32_t row = frame->bottom_up ? frame->height - 1 - y : y;
+    return frame->pixels + (size_t)row * frame->width;
+}
+
+void image_stripe_reserve(image_stripe_t *stripe, size_t size)
+{
+    if (size > stripe->capacity)
+    {
+        free(stripe->data);
+        stripe->capacity = size;
+        stripe->data = (uint8_t *)malloc(size);
+        assert(stripe->data);
+    }
+}
+
+inline void image_put_u32_be(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+//
+// PPM
+//
+
+void image_encode_ppm_stripe(void *data, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    image_output_t *output = (image_output_t *)data;
+    const image_output_frame_t *frame = output->frame;
+    image_stripe_t *stripe = &output->stripes[index];
+
+    image_stripe_reserve(stripe, (size_t)stripe->row_count * frame->width * 3);
+    uint8_t *out = stripe->data;
+    for (uint32_t y = stripe->first_row; y < stripe->first_row + stripe->row_count; ++y)
+    {
+        const uint32_t *row = image_output_row(frame, y);
+        for (uint32_t x = 0; x < frame->width; ++x)
+        {
+            *out++ = (uint8_t)row[x];
+            *out++ = (uint8_t)(row[x] >> 8);
+            *out++ = (uint8_t)(row[x] >> 16);
+        }
+    }
+    stripe->size = out - stripe->data;
+}
+
+//
+// QOI
+//
+
+#define IMAGE_QOI_OP_INDEX 0x00
+#define IMAGE_QOI_OP_DIFF 0x40
+#define IMAGE_QOI_OP_LUMA 0x80
+#define IMAGE_QOI_OP_RUN 0xc0
+#define IMAGE_QOI_OP_RGB 0xfe
+#define IMAGE_QOI_OP_RGBA 0xff
+
+inline uint32_t image_qoi_hash(uint32_t pixel)
+{
+    return ((pixel & 0xff) * 3 + ((pixel >> 8) & 0xff) * 5 + ((pixel >> 16) & 0xff) * 7 + (pixel >> 24) * 11) % 64;
+}
+
+// Stripes are encoded independently but still form one standard stream: the
+// previous pixel is known from the image, and the index is only used for
+// entries written inside the stripe, which the decoder holds too.
+void image_encode_qoi_stripe(void *data, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    image_output_t *output = (image_output_t *)data;
+    const image_output_frame_t *frame = output->frame;
+    image_stripe_t *stripe = &output->stripes[index];
+
+    image_stripe_reserve(stripe, (size_t)stripe->row_count * frame->width * 5);
+    uint8_t *out = stripe->data;
+
+    uint32_t colors[64];
+    uint64_t valid = 0;
+    uint32_t previous = 0xff000000;
+    if (stripe->first_row > 0)
+    {
+        previous = image_output_row(frame, stripe->first_row - 1)[frame->width - 1];
+        colors[image_qoi_hash(previous)] = previous;
+        valid |= 1ull << image_qoi_hash(previous);
+    }
+
+    uint32_t run = 0;
+    for (uint32_t y = stripe->first_row; y < stripe->first_row + stripe->row_count; ++y)
+    {
+        const uint32_t *row = image_output_row(frame, y);
+        for (uint32_t x = 0; x < frame->width; ++x)
+        {
+            uint32_t pixel = row[x];
+            if (pixel == previous)
+            {
+                if (++run == 62)
+                {
+                    *out++ = (uint8_t)(IMAGE_QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run)
+            {
+                *out++ = (uint8_t)(IMAGE_QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            uint32_t hash = image_qoi_hash(pixel);
+            if ((valid & (1ull << hash)) && colors[hash] == pixel)
+            {
+                *out++ = (uint8_t)(IMAGE_QOI_OP_INDEX | hash);
+            }
+            else
+            {
+                colors[hash] = pixel;
+                valid |= 1ull << hash;
+
+                if ((pixel >> 24) == (previous >> 24))
+                {
+                    int32_t dr = (int8_t)(uint8_t)(pixel - previous);
+                    int32_t dg = (int8_t)(uint8_t)((pixel >> 8) - (previous >> 8));
+                    int32_t db = (int8_t)(uint8_t)((pixel >> 16) - (previous >> 16));
+                    int32_t dr_dg = dr - dg;
+                    int32_t db_dg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        *out++ = (uint8_t)(IMAGE_QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+                    {
+                        *out++ = (uint8_t)(IMAGE_QOI_OP_LUMA | (dg + 32));
+                        *out++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+                    }
+                    else
+                    {
+                        *out++ = IMAGE_QOI_OP_RGB;
+                        *out++ = (uint8_t)pixel;
+                        *out++ = (uint8_t)(pixel >> 8);
+                        *out++ = (uint8_t)(pixel >> 16);
+                    }
+                }
+                else
+                {
+                    *out++ = IMAGE_QOI_OP_RGBA;
+                    *out++ = (uint8_t)pixel;
+                    *out++ = (uint8_t)(pixel >> 8);
+                    *out++ = (uint8_t)(pixel >> 16);
+                    *out++ = (uint8_t)(pixel >> 24);
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run)
+    {
+        *out++ = (uint8_t)(IMAGE_QOI_OP_RUN | (run - 1));
+    }
+    stripe->size = out - stripe->data;
+}
+
+//
+// PNG
+//
+
+struct image_crc_table_t
+{
+    uint32_t entries[256];
+
+    image_crc_table_t()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (uint32_t k = 0; k < 8; ++k)
+            {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+// Start with crc 0 and feed the result back in to continue a checksum.
+uint32_t image_crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    static const image_crc_table_t table;
+    crc ^= 0xffffffffu;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+#define IMAGE_ADLER_BASE 65521
+
+uint32_t image_adler32(const uint8_t *data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size)
+    {
+        // Largest block before b can overflow 32 bits.
+        size_t block = size < 5552 ? size : 5552;
+        size -= block;
+        while (block--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= IMAGE_ADLER_BASE;
+        b %= IMAGE_ADLER_BASE;
+    }
+    return b << 16 | a;
+}
+
+// Checksum of A followed by B, from the checksums of A and B.
+uint32_t image_adler32_combine(uint32_t adler_a, uint32_t adler_b, size_t size_b)
+{
+    uint32_t remainder = (uint32_t)(size_b % IMAGE_ADLER_BASE);
+    uint32_t a = adler_a & 0xffff;
+    uint32_t b = (uint32_t)(((uint64_t)remainder * a) % IMAGE_ADLER_BASE);
+    a += (adler_b & 0xffff) + IMAGE_ADLER_BASE - 1;
+    b += (adler_a >> 16) + (adler_b >> 16) + IMAGE_ADLER_BASE - remainder;
+    if (a >= IMAGE_ADLER_BASE) a -= IMAGE_ADLER_BASE;
+    if (a >= IMAGE_ADLER_BASE) a -= IMAGE_ADLER_BASE;
+    if (b >= 2 * IMAGE_ADLER_BASE) b -= 2 * IMAGE_ADLER_BASE;
+    if (b >= IMAGE_ADLER_BASE) b -= IMAGE_ADLER_BASE;
+    return b << 16 | a;
+}
+
+inline uint8_t image_paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int32_t p = (int32_t)a + b - c;
+    int32_t pa = p > a ? p - a : a - p;
+    int32_t pb = p > b ? p - b : b - p;
+    int32_t pc = p > c ? p - c : c - p;
+    return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+
+inline uint8_t image_png_predict(uint32_t filter, uint8_t left, uint8_t up, uint8_t up_left)
+{
+    switch (filter)
+    {
+    case 1: return left;
+    case 2: return up;
+    case 3: return (uint8_t)(((uint32_t)left + up) / 2);
+    case 4: return image_paeth(left, up, up_left);
+    default: return 0;
+    }
+}
+
+// Picks the filter with the smallest sum of absolute signed residuals per
+// row, the usual heuristic.
+void image_filter_png_stripe(void *data, uint32_t index, uint32_t worker)
+{
+    (void)worker;
+    image_output_t *output = (image_output_t *)data;
+    const image_output_frame_t *frame = output->frame;
+    const image_stripe_t *stripe = &output->stripes[index];
+
+    const uint32_t row_bytes = frame->width * 4;
+
+    for (uint32_t y = stripe->first_row; y < stripe->first_row + stripe->row_count; ++y)
+    {
+        const uint8_t *row = (const uint8_t *)image_output_row(frame, y);
+        const uint8_t *above = y > 0 ? (const uint8_t *)image_output_row(frame, y - 1) : 0;
+        uint8_t *out = output->filtered + (size_t)y * (row_bytes + 1);
+
+        uint32_t best_filter = 0;
+        uint32_t best_cost = UINT32_MAX;
+        for (uint32_t filter = 0; filter < 5; ++filter)
+        {
+            uint32_t cost = 0;
+            for (uint32_t i = 0; i < row_bytes && cost < best_cost; ++i)
+            {
+                uint8_t left = i >= 4 ? row[i - 4] : 0;
+                uint8_t up = above ? above[i] : 0;
+                uint8_t up_left = above && i >= 4 ? above[i - 4] : 0;
+                int32_t residual = (int8_t)(uint8_t)(row[i] - image_png_predict(filter, left, up, up_left));
+                cost += residual < 0 ? -residual : residual;
+            }
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_filter = filter;
+            }
+        }
+
+        out[0] = (uint8_t)best_filter;
+        for (uint32_t i = 0; i < row_bytes; ++i)
+        {
+            uint8_t left = i >= 4 ? row[i - 4] : 0;
+            uint8_t up = above ? above[i] : 0;
+            uint8_t up_left = above && i >= 4 ? above[i - 4] : 0;
+            out[1 + i] = (uint8_t)(row[i] - image_png_predict(best_filter, left, up, up_left));
+        }
+    }
+}
+
+inline uint32_t image_reverse_bits(uint32_t code, uint32_t bits)
+{
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < bits; ++i)
+    {
+        reversed = reversed << 1 | ((code >> i) & 1);
+    }
+    return reversed;
+}
+
+// Deflate with the fixed Huffman code. Codes are stored bit-reversed since
+// deflate packs bits from the least significant end.
+struct image_deflate_tables_t
+{
+    uint16_t literal_code[288];
+    uint8_t literal_bits[288];
+    uint8_t distance_code[30];
+
+    image_deflate_tables_t()
+    {
+        for (uint32_t symbol = 0; symbol < 288; ++symbol)
+        {
+            uint32_t code, bits;
+            if (symbol < 144) { code = 0x30 + symbol; bits = 8; }
+            else if (symbol < 256) { code = 0x190 + symbol - 144; bits = 9; }
+            else if (symbol < 280) { code = symbol - 256; bits = 7; }
+            else { code = 0xc0 + symbol - 280; bits = 8; }
+            literal_code[symbol] = (uint16_t)image_reverse_bits(code, bits);
+            literal_bits[symbol] = (uint8_t)bits;
+        }
+        for (uint32_t symbol = 0; symbol < 30; ++symbol)
+        {
+            distance_code[symbol] = (uint8_t)image_reverse_bits(symbol, 5);
+        }
+    }
+};
+
+static const uint16_t image_deflate_length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t image_deflate_length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t image_deflate_distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t image_deflate_distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+struct image_bit_writer_t
+{
+    uint8_t *out;
+    uint64_t bits;
+    uint32_t count;
+};
+
+inline void image_put_bits(image_bit_writer_t *writer, uint32_t value, uint32_t count)
+{
+    writer->bits |= (uint64_t)value << writer->count;
+    writer->count += count;
+    while (writer->count >= 8)
+    {
+        *writer->out++ = (uint8_t)writer->bits;
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+
+inline void image_align_bits(image_bit_writer_t *writer)
+{
+    if (writer->count)
+    {
+        image_put_bits(writer, 0, 8 - writer->count);
+    }
+}
+
+inline uint32_t image_deflate_hash(const uint8_t *p)
+{
+    return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u) >> (32 - IMAGE_DEFLATE_HASH_BITS);
+}
+
+// Compresses data[begin, end) as one fixed-Huffman block that may refer back
+// into the 32K before begin, so stripes compress almost as well as one
+// sequential stream. Every stripe but the last ends with an empty stored
+// block, which leaves it byte aligned so stripes can simply be concatenated.
+uint8_t *image_deflate_range(image_deflate_scratch_t *scratch, const uint8_t *data, size_t begin, size_t end, size_t total, bool last, uint8_t *out)
+{
+    static const image_deflate_tables_t tables;
+
+    image_bit_writer_t writer = { out, 0, 0 };
+    image_put_bits(&writer, last ? 1 : 0, 1);
+    image_put_bits(&writer, 1, 2);
+
+    for (uint32_t i = 0; i < (1 << IMAGE_DEFLATE_HASH_BITS); ++i)
+    {
+        scratch->head[i] = -1;
+    }
+    size_t dictionary = begin > IMAGE_DEFLATE_WINDOW ? begin - IMAGE_DEFLATE_WINDOW : 0;
+    for (size_t p = dictionary; p < begin && p + 3 <= total; ++p)
+    {
+        uint32_t hash = image_deflate_hash(data + p);
+        scratch->previous[p & (IMAGE_DEFLATE_WINDOW - 1)] = scratch->head[hash];
+        scratch->head[hash] = (int32_t)p;
+    }
+
+    size_t p = begin;
+    while (p < end)
+    {
+        uint32_t best_length = 0;
+        uint32_t best_distance = 0;
+        if (p + 3 <= end)
+        {
+            uint32_t max_length = end - p < 258 ? (uint32_t)(end - p) : 258;
+            uint32_t hash = image_deflate_hash(data + p);
+            int32_t candidate = scratch->head[hash];
+            for (uint32_t chain = 0; candidate >= 0 && p - candidate <= IMAGE_DEFLATE_WINDOW && chain < IMAGE_DEFLATE_MAX_CHAIN; ++chain)
+            {
+                const uint8_t *a = data + candidate;
+                const uint8_t *b = data + p;
+                if (a[best_length] == b[best_length])
+                {
+                    uint32_t length = 0;
+                    while (length < max_length && a[length] == b[length])
+                    {
+                        ++length;
+                    }
+                    if (length > best_length)
+                    {
+                        best_length = length;
+                        best_distance = (uint32_t)(p - candidate);
+                        if (length == max_length)
+                        {
+                            break;
+                        }
+                    }
+                }
+                candidate = scratch->previous[candidate & (IMAGE_DEFLATE_WINDOW - 1)];
+            }
+        }
+
+        if (best_length >= 3)
+        {
+            uint32_t code = 0;
+            while (code < 28 && image_deflate_length_base[code + 1] <= best_length)
+            {
+                ++code;
+            }
+            image_put_bits(&writer, tables.literal_code[257 + code], tables.literal_bits[257 + code]);
+            image_put_bits(&writer, best_length - image_deflate_length_base[code], image_deflate_length_extra[code]);
+
+            uint32_t distance_code = 0;
+            while (distance_code < 29 && image_deflate_distance_base[distance_code + 1] <= best_distance)
+            {
+                ++distance_code;
+            }
+            image_put_bits(&writer, tables.distance_code[distance_code], 5);
+            image_put_bits(&writer, best_distance - image_deflate_distance_base[distance_code], image_deflate_distance_extra[distance_code]);
+        }
+        else
+        {
+            best_length = 1;
+            image_put_bits(&writer, tables.literal_code[data[p]], tables.literal_bits[data[p]]);
+        }
+
+        for (size_t q = p; q < p + best_length; ++q)
+        {
+            if (q + 3 <= total)
+            {
+                uint32_t hash = image_deflate_hash(data + q);
+                scratch->previous[q & (IMAGE_DEFLATE_WINDOW - 1)] = scratch->head[hash];
+                scratch->head[hash] = (int32_t)q;
+            }
+        }
+        p += best_length;
+    }
+
+    image_put_bits(&writer, tables.literal_code[256], tables.literal_bits[256]);
+    if (!last)
+    {
+        image_put_bits(&writer, 0, 3);
+        image_align_bits(&writer);
+        image_put_bits(&writer, 0x0000, 16);
+        image_put_bits(&writer, 0xffff, 16);
+    }
+    image_align_bits(&writer);
+    return writer.out;
+}
+
+// Each stripe becomes one IDAT chunk; the zlib header rides in the first.
+void image_deflate_png_stripe(void *data, uint32_t index, uint32_t worker)
+{
+    image_output_t *output = (image_output_t *)data;
+    const image_output_frame_t *frame = output->frame;
+    image_stripe_t *stripe = &output->stripes[index];
+
+    size_t row_bytes = (size_t)frame->width * 4 + 1;
+    size_t begin = stripe->first_row * row_bytes;
+    size_t end = begin + stripe->row_count * row_bytes;
+    size_t total = frame->height * row_bytes;
+
+    // Fixed codes spend at most 9 bits per byte.
+    image_stripe_reserve(stripe, (end - begin) + (end - begin) / 8 + 64);
+    uint8_t *chunk_data = stripe->data + 8;
+    uint8_t *out = chunk_data;
+    if (index == 0)
+    {
+        *out++ = 0x78;
+        *out++ = 0x01;
+    }
+    out = image_deflate_range(&output->deflate_scratch[worker], output->filtered, begin, end, total, index == output->stripe_count - 1, out);
+
+    uint32_t length = (uint32_t)(out - chunk_data);
+    image_put_u32_be(stripe->data, length);
+    memcpy(stripe->data + 4, "IDAT", 4);
+    image_put_u32_be(out, image_crc32(0, stripe->data + 4, length + 4));
+    stripe->size = length + 12;
+    stripe->adler = image_adler32(output->filtered + begin, end - begin);
+}
+
+void image_write_png_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t size)
+{
+    uint8_t header[8];
+    image_put_u32_be(header, size);
+    memcpy(header + 4, type, 4);
+
+    uint8_t crc[4];
+    image_put_u32_be(crc, image_crc32(image_crc32(0, header + 4, 4), data, size));
+
+    fwrite(header, 1, 8, file);
+    if (size)
+    {
+        fwrite(data, 1, size, file);
+    }
+    fwrite(crc, 1, 4, file);
+}
+
+//
+// Writer
+//
+
+FILE *image_output_open_file(const char *path)
+{
+    FILE *file = 0;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "wb") != 0)
+    {
+        file = 0;
+    }
+#else
+    file = fopen(path, "wb");
+#endif
+    return file;
+}
+
+void image_output_split_stripes(image_output_t *output, const image_output_frame_t *frame)
+{
+    uint32_t stripe_count = job_pool_worker_count(output->pool) * IMAGE_OUTPUT_STRIPES_PER_WORKER;
+    if (stripe_count > frame->height)
+    {
+        stripe_count = frame->height;
+    }
+    uint32_t rows_per_stripe = (frame->height + stripe_count - 1) / stripe_count;
+    stripe_count = (frame->height + rows_per_stripe - 1) / rows_per_stripe;
+
+    if (stripe_count > output->stripe_capacity)
+    {
+        output->stripes = (image_stripe_t *)realloc(output->stripes, stripe_count * sizeof(image_stripe_t));
+        assert(output->stripes);
+        memset(output->stripes + output->stripe_capacity, 0, (stripe_count - output->stripe_capacity) * sizeof(image_stripe_t));
+        output->stripe_capacity = stripe_count;
+    }
+
+    output->stripe_count = stripe_count;
+    for (uint32_t i = 0; i < stripe_count; ++i)
+    {
+        output->stripes[i].first_row = i * rows_per_stripe;
+        output->stripes[i].row_count = frame->height - i * rows_per_stripe < rows_per_stripe ? frame->height - i * rows_per_stripe : rows_per_stripe;
+    }
+}
+
+bool image_output_write_frame(image_output_t *output, const image_output_frame_t *frame)
+{
+    FILE *file = image_output_open_file(frame->path);
+    if (!file)
+    {
+        return false;
+    }
+
+    output->frame = frame;
+    image_output_split_stripes(output, frame);
+
+    uint64_t bytes = 0;
+    switch (frame->format)
+    {
+    case IMAGE_FORMAT_PPM:
+    {
+        job_pool_run(output->pool, output->stripe_count, image_encode_ppm_stripe, output);
+        bytes += fprintf(file, "P6\n%u %u\n255\n", frame->width, frame->height);
+    } break;
+
+    case IMAGE_FORMAT_QOI:
+    {
+        job_pool_run(output->pool, output->stripe_count, image_encode_qoi_stripe, output);
+        uint8_t header[14] = { 'q', 'o', 'i', 'f' };
+        image_put_u32_be(header + 4, frame->width);
+        image_put_u32_be(header + 8, frame->height);
+        header[12] = 4;
+        header[13] = 0;
+        bytes += fwrite(header, 1, sizeof(header), file);
+    } break;
+
+    case IMAGE_FORMAT_PNG:
+    {
+        size_t filtered_size = (size_t)frame->height * (frame->width * 4 + 1);
+        if (filtered_size > output->filtered_capacity)
+        {
+            free(output->filtered);
+            output->filtered_capacity = filtered_size;
+            output->filtered = (uint8_t *)malloc(filtered_size);
+            assert(output->filtered);
+        }
+
+        // Deflate looks back into the previous stripe, so all filtering has
+        // to finish first.
+        job_pool_run(output->pool, output->stripe_count, image_filter_png_stripe, output);
+        job_pool_run(output->pool, output->stripe_count, image_deflate_png_stripe, output);
+
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        uint8_t header[13];
+        image_put_u32_be(header, frame->width);
+        image_put_u32_be(header + 4, frame->height);
+        header[8] = 8;      // bits per channel
+        header[9] = 6;      // RGBA
+        header[10] = 0;
+        header[11] = 0;
+        header[12] = 0;
+        bytes += fwrite(signature, 1, sizeof(signature), file);
+        image_write_png_chunk(file, "IHDR", header, sizeof(header));
+        bytes += 12 + sizeof(header);
+    } break;
+    }
+
+    for (uint32_t i = 0; i < output->stripe_count; ++i)
+    {
+        bytes += fwrite(output->stripes[i].data, 1, output->stripes[i].size, file);
+    }
+
+    if (frame->format == IMAGE_FORMAT_QOI)
+    {
+        static const uint8_t end_marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+        bytes += fwrite(end_marker, 1, sizeof(end_marker), file);
+    }
+    else if (frame->format == IMAGE_FORMAT_PNG)
+    {
+        size_t row_bytes = (size_t)frame->width * 4 + 1;
+        uint32_t adler = output->stripes[0].adler;
+        for (uint32_t i = 1; i < output->stripe_count; ++i)
+        {
+            adler = image_adler32_combine(adler, output->stripes[i].adler, output->stripes[i].row_count * row_bytes);
+        }
+        uint8_t trailer[4];
+        image_put_u32_be(trailer, adler);
+        image_write_png_chunk(file, "IDAT", trailer, sizeof(trailer));
+        image_write_png_chunk(file, "IEND", 0, 0);
+        bytes += 12 + sizeof(trailer) + 12;
+    }
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (ok)
+    {
+        output->bytes_written += bytes;
+    }
+    return ok;
+}
+
+void image_output_thread(image_output_t *output)
+{
+    for (;;)
+    {
+        image_output_frame_t *frame;
+        {
+            std::unique_lock<std::mutex> lock(output->mutex);
+            output->frame_ready.wait(lock, [&] { return output->ready > 0 || output->quit; });
+            if (output->ready == 0)
+            {
+                return;
+            }
+            frame = &output->frames[output->first];
+        }
+
+        if (image_output_write_frame(output, frame))
+        {
+            ++output->frames_written;
+        }
+        else
+        {
+            ++output->frames_failed;
+        }
+
+        std::lock_guard<std::mutex> lock(output->mutex);
+        output->first = (output->first + 1) % IMAGE_OUTPUT_QUEUE_SIZE;
+        --output->ready;
+        --output->reserved;
+        output->frame_done.notify_all();
+    }
+}
+
+// thread_count is the number of encoding threads besides the writer, 0
+// picks one per hardware thread.
+image_output_t *image_output_create(uint32_t thread_count)
+{
+    image_output_t *output = new image_output_t();
+    output->pool = job_pool_create(thread_count);
+    output->deflate_scratch = (image_deflate_scratch_t *)malloc(job_pool_worker_count(output->pool) * sizeof(image_deflate_scratch_t));
+    assert(output->deflate_scratch);
+    output->frames_written = 0;
+    output->frames_failed = 0;
+    output->bytes_written = 0;
+    output->writer = std::thread(image_output_thread, output);
+    return output;
+}
+
+// Blocks until every submitted frame is on disk.
+void image_output_flush(image_output_t *output)
+{
+    std::unique_lock<std::mutex> lock(output->mutex);
+    output->frame_done.wait(lock, [&] { return output->reserved == 0; });
+}
+
+void image_output_destroy(image_output_t *output)
+{
+    image_output_flush(output);
+    {
+        std::lock_guard<std::mutex> lock(output->mutex);
+        output->quit = true;
+    }
+    output->frame_ready.notify_one();
+    output->writer.join();
+    job_pool_destroy(output->pool);
+
+    for (uint32_t i = 0; i < IMAGE_OUTPUT_QUEUE_SIZE; ++i)
+    {
+        free(output->frames[i].pixels);
+    }
+    for (uint32_t i = 0; i < output->stripe_capacity; ++i)
+    {
+        free(output->stripes[i].data);
+    }
+    free(output->stripes);
+    free(output->filtered);
+    free(output->deflate_scratch);
+    delete output;
+}
+
+// Returns width * height pixels to fill, waiting while the queue is full.
+// Frames are written in the order they are begun; one producer thread only.
+uint32_t *image_output_begin_frame(image_output_t *output, uint32_t width, uint32_t height, bool bottom_up)
+{
+    assert(width > 0 && height > 0);
+
+    image_output_frame_t *frame;
+    {
+        std::unique_lock<std::mutex> lock(output->mutex);
+        output->frame_done.wait(lock, [&] { return output->reserved < IMAGE_OUTPUT_QUEUE_SIZE; });
+        assert(output->reserved == output->ready);
+        frame = &output->frames[(output->first + output->reserved) % IMAGE_OUTPUT_QUEUE_SIZE];
+        ++output->reserved;
+    }
+
+    size_t pixel_count = (size_t)width * height;
+    if (pixel_count > frame->capacity)
+    {
+        free(frame->pixels);
+        frame->capacity = pixel_count;
+        frame->pixels = (uint32_t *)malloc(pixel_count * sizeof(uint32_t));
+        assert(frame->pixels);
+    }
+    frame->width = width;
+    frame->height = height;
+    frame->bottom_up = bottom_up;
+    return frame->pixels;
+}
+
+void image_output_end_frame(image_output_t *output, const char *path, image_format_t format)
+{
+    {
+        std::lock_guard<std::mutex> lock(output->mutex);
+        image_output_frame_t *frame = &output->frames[(output->first + output->ready) % IMAGE_OUTPUT_QUEUE_SIZE];
+        frame->format = format;
+        snprintf(frame->path, sizeof(frame->path), "%s", path);
+        ++output->ready;
+    }
+    output->frame_ready.notify_one();
+}
+
+void image_output_save_cpu_framebuffer(image_output_t *output, const cpu_framebuffer_t *framebuffer, const char *path, image_format_t format)
+{
+    uint32_t *pixels = image_output_begin_frame(output, framebuffer->width, framebuffer->height, false);
+    cpu_framebuffer_read_color(framebuffer, 0, framebuffer->height, pixels, framebuffer->width);
+    image_output_end_frame(output, path, format);
+}
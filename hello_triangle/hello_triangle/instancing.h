@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "opengl.h"
+#include "gl_state.h"
+#include "upload_ring.h"
+
+// Many copies of a mesh per draw call. Per-instance data is an array of
+// instance_t in a buffer, read by the vertex shader through
+//
+//     layout(location = 4) in mat4 instance_transform;    // 4..7
+//     layout(location = 8) in vec4 instance_color;
+//
+// Thousands of different meshes go out in one call through indirect_batch_t,
+// which writes the instances into the upload ring, collects
+// DrawElementsIndirectCommand records next to them and submits them with
+// glMultiDrawElementsIndirect. The meshes have to share the vertex array and
+// its index buffer, see base_vertex and first_index.
+
+#define INSTANCE_ATTRIBUTE_TRANSFORM 4
+#define INSTANCE_ATTRIBUTE_COLOR 8
+
+struct instance_t
+{
+    matrix4_t transform;
+    vector4_t color;
+};
+
+// Points the instance attributes of vertex_array at instances starting at
+// offset in buffer.
+void instancing_bind_instances(uint32_t vertex_array, uint32_t buffer, uint32_t offset)
+{
+    gl_state_bind_vertex_array(vertex_array);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, buffer);
+
+    GLsizei stride = sizeof(instance_t);
+    for (uint32_t column = 0; column < 4; ++column)
+    {
+        GLuint location = INSTANCE_ATTRIBUTE_TRANSFORM + column;
+        uintptr_t column_offset = offset + offsetof(instance_t, transform) + column * sizeof(vector4_t);
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (const void *)column_offset);
+        glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_COLOR);
+    glVertexAttribPointer(INSTANCE_ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, stride, (const void *)(uintptr_t)(offset + offsetof(instance_t, color)));
+    glVertexAttribDivisor(INSTANCE_ATTRIBUTE_COLOR, 1);
+}
+
+// Copies instances into the ring and binds them to vertex_array.
+void instancing_upload(upload_ring_t *ring, uint32_t vertex_array, const instance_t *instances, uint32_t count)
+{
+    upload_allocation_t allocation = upload_ring_allocate(ring, count * sizeof(instance_t), 16);
+    memcpy(allocation.memory, instances, count * sizeof(instance_t));
+    instancing_bind_instances(vertex_array, allocation.buffer, allocation.offset);
+}
+
+void instancing_draw_arrays(uint32_t mode, int32_t first, int32_t vertex_count, int32_t instance_count)
+{
+    glDrawArraysInstanced(mode, first, vertex_count, instance_count);
+}
+
+// index_offset is in bytes into the element buffer of the bound vertex array.
+void instancing_draw_elements(uint32_t mode, int32_t index_count, uint32_t index_type, uint32_t index_offset, int32_t instance_count)
+{
+    glDrawElementsInstancedBaseVertex(mode, index_count, index_type, (const void *)(uintptr_t)index_offset, instance_count, 0);
+}
+
+//
+// Multi-draw indirect
+//
+
+// Layout fixed by GL.
+struct draw_elements_indirect_t
+{
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+};
+
+// Start from a zeroed batch and keep it from frame to frame, so the command
+// array is only reallocated when a frame needs more.
+struct indirect_batch_t
+{
+    upload_ring_t *ring;
+
+    // Kept on the CPU and copied into the ring for the multi-draw only: the
+    // fallback reads them, and a persistent ring mapping is write only.
+    draw_elements_indirect_t *commands;
+    uint32_t command_count;
+    uint32_t command_capacity;
+
+    upload_allocation_t instances;
+    uint32_t instance_count;
+    uint32_t instance_capacity;
+};
+
+// Reserves room for up to max_instances instances in the ring's current frame
+// and up to max_commands meshes.
+void indirect_batch_begin(indirect_batch_t *batch, upload_ring_t *ring, uint32_t max_commands, uint32_t max_instances)
+{
+    batch->ring = ring;
+    if (batch->command_capacity < max_commands)
+    {
+        batch->command_capacity = max_commands;
+        batch->commands = (draw_elements_indirect_t *)realloc(batch->commands, max_commands * sizeof(draw_elements_indirect_t));
+        assert(batch->commands);
+    }
+    batch->command_count = 0;
+    batch->instances = upload_ring_allocate(ring, max_instances * sizeof(instance_t), 16);
+    batch->instance_count = 0;
+    batch->instance_capacity = max_instances;
+}
+
+// Adds one mesh drawn instance_count times; fill in the returned instances.
+instance_t *indirect_batch_add(indirect_batch_t *batch, uint32_t index_count, uint32_t first_index, int32_t base_vertex, uint32_t instance_count)
+{
+    assert(batch->command_count < batch->command_capacity);
+    assert(batch->instance_count + instance_count <= batch->instance_capacity);
+
+    draw_elements_indirect_t *command = &batch->commands[batch->command_count++];
+    command->index_count = index_count;
+    command->instance_count = instance_count;
+    command->first_index = first_index;
+    command->base_vertex = base_vertex;
+    command->base_instance = batch->instance_count;
+
+    instance_t *instances = (instance_t *)batch->instances.memory + batch->instance_count;
+    batch->instance_count += instance_count;
+    return instances;
+}
+
+void indirect_batch_destroy(indirect_batch_t *batch)
+{
+    free(batch->commands);
+    batch->commands = NULL;
+    batch->command_capacity = 0;
+}
+
+// One call for the whole batch. base_instance offsets the instance
+// attributes, so the batch binds them once at the start of its instances.
+// Drivers without GL 4.3 or GL_ARB_multi_draw_indirect, as the ring found at
+// creation, get a loop of base-instance draws straight from the CPU commands.
+void indirect_batch_draw(indirect_batch_t *batch, uint32_t vertex_array, uint32_t mode, uint32_t index_type)
+{
+    if (!batch->command_count)
+    {
+        return;
+    }
+
+    instancing_bind_instances(vertex_array, batch->instances.buffer, batch->instances.offset);
+    if (batch->ring->multi_draw_indirect)
+    {
+        uint32_t size = batch->command_count * sizeof(draw_elements_indirect_t);
+        upload_allocation_t commands = upload_ring_allocate(batch->ring, size, 16);
+        memcpy(commands.memory, batch->commands, size);
+        upload_ring_flush(batch->ring);
+        gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+        glMultiDrawElementsIndirect(mode, index_type, (const void *)(uintptr_t)commands.offset, batch->command_count, 0);
+    }
+    else
+    {
+        upload_ring_flush(batch->ring);
+        assert(gl_dispatch_available(GL_DISPATCH_glDrawElementsInstancedBaseVertexBaseInstance));
+        uint32_t index_size = index_type == GL_UNSIGNED_INT ? 4 : (index_type == GL_UNSIGNED_SHORT ? 2 : 1);
+        for (uint32_t i = 0; i < batch->command_count; ++i)
+        {
+            const draw_elements_indirect_t *command = &batch->commands[i];
+            glDrawElementsInstancedBaseVertexBaseInstance(mode,
+                command->index_count,
+                index_type,
+                (const void *)(uintptr_t)(command->first_index * index_size),
+                command->instance_count,
+                command->base_vertex,
+                command->base_instance);
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cassert>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Fixed set of worker threads that run "for index in [0, count)" loops. The
+// calling thread joins in, so a pool with zero workers still makes progress.
+
+#define JOB_MAX_THREADS 64
+
+// worker is in [0, job_pool_worker_count()), use it to index per-thread scratch.
+typedef void job_function_t(void *data, uint32_t index, uint32_t worker);
+
+struct job_pool_t
+{
+    std::thread threads[JOB_MAX_THREADS];
+    uint32_t thread_count;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation;
+    uint32_t busy_workers;
+    bool quit;
+
+    job_function_t *function;
+    void *data;
+    uint32_t count;
+    std::atomic<uint32_t> next;
+};
+
+inline uint32_t job_pool_worker_count(const job_pool_t *pool)
+{
+    return pool->thread_count + 1;
+}
+
+void job_pool_work(job_pool_t *pool, uint32_t worker)
+{
+    for (;;)
+    {
+        uint32_t index = pool->next.fetch_add(1);
+        if (index >= pool->count)
+        {
+            break;
+        }
+        pool->function(pool->data, index, worker);
+    }
+}
+
+void job_pool_thread(job_pool_t *pool, uint32_t worker)
+{
+    uint64_t seen_generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [&] { return pool->quit || pool->generation != seen_generation; });
+            if (pool->quit)
+            {
+                return;
+            }
+            seen_generation = pool->generation;
+        }
+
+        job_pool_work(pool, worker);
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (--pool->busy_workers == 0)
+        {
+            pool->done.notify_one();
+        }
+    }
+}
+
+// thread_count of 0 means one worker per hardware thread besides the caller.
+job_pool_t *job_pool_create(uint32_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        uint32_t hardware = std::thread::hardware_concurrency();
+        thread_count = hardware > 1 ? hardware - 1 : 0;
+    }
+    if (thread_count > JOB_MAX_THREADS)
+    {
+        thread_count = JOB_MAX_THREADS;
+    }
+
+    job_pool_t *pool = new job_pool_t();
+    pool->thread_count = thread_count;
+    pool->next = 0;
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        pool->threads[i] = std::thread(job_pool_thread, pool, i);
+    }
+    return pool;
+}
+
+void job_pool_destroy(job_pool_t *pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->wake.notify_all();
+    for (uint32_t i = 0; i < pool->thread_count; ++i)
+    {
+        pool->threads[i].join();
+    }
+    delete pool;
+}
+
+// Calls function for every index in [0, count) and returns once all are done.
+void job_pool_run(job_pool_t *pool, uint32_t count, job_function_t *function, void *data)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->function = function;
+        pool->data = data;
+        pool->count = count;
+        pool->next = 0;
+        pool->busy_workers = pool->thread_count;
+        ++pool->generation;
+    }
+    pool->wake.notify_all();
+
+    job_pool_work(pool, pool->thread_count);
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done.wait(lock, [&] { return pool->busy_workers == 0; });
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include "simd.h"
+#include "jobs.h"
+#include "rasterizer.h"
+
+// 4x and 8x multisampling for the CPU rasterizer. Each worker renders whole
+// tiles into its own scratch tile and resolves it straight into the output,
+// so samples never leave the cache. Inside a tile a pixel keeps a single
+// colour until a triangle edge splits it; only then does it get a slot with
+// one colour per sample. A pixel that is covered whole again goes back to a
+// single colour but keeps its slot, so a tile never needs more slots than
+// pixels however many triangles land on it.
+
+#define MSAA_MAX_SAMPLES 8
+#define MSAA_NO_SLOT 0xffff
+#define MSAA_COMPRESSED_BIT 0x8000
+
+// Standard D3D sample positions in 1/16 pixel, relative to the pixel centre.
+static const int8_t msaa_sample_positions_4[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+static const int8_t msaa_sample_positions_8[8][2] = { { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+
+struct msaa_tile_t
+{
+    uint32_t color[RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+    uint16_t slot[RASTER_TILE_SIZE * RASTER_TILE_SIZE];  // MSAA_COMPRESSED_BIT set when color holds the pixel
+
+    // Per-sample colours of split pixels, sample_count per slot.
+    uint32_t samples[RASTER_TILE_SIZE * RASTER_TILE_SIZE * MSAA_MAX_SAMPLES];
+    uint32_t slot_count;
+
+    // Sample-major so eight neighbouring pixels of one sample are contiguous.
+    real32_t depth[MSAA_MAX_SAMPLES][RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+};
+
+struct msaa_stats_t
+{
+    uint64_t pixels;
+    uint64_t split_pixels;  // pixels that needed per-sample storage
+};
+
+struct msaa_renderer_t
+{
+    job_pool_t *pool;
+    uint32_t sample_count;
+    real32_t sample_x[MSAA_MAX_SAMPLES];
+    real32_t sample_y[MSAA_MAX_SAMPLES];
+
+    msaa_tile_t *tiles;     // one per worker
+    raster_bins_t bins;
+
+    // Per-frame inputs read by the tile jobs.
+    const raster_triangle_t *triangles;
+    uint32_t clear_color;
+    uint32_t *pixels;
+    uint32_t width;
+    uint32_t height;
+
+    std::atomic<uint64_t> split_pixels;
+};
+
+msaa_renderer_t *msaa_create_renderer(job_pool_t *pool, uint32_t sample_count)
+{
+    assert(sample_count == 4 || sample_count == 8);
+
+    msaa_renderer_t *renderer = new msaa_renderer_t();
+    renderer->pool = pool;
+    renderer->sample_count = sample_count;
+    for (uint32_t s = 0; s < sample_count; ++s)
+    {
+        const int8_t *position = sample_count == 4 ? msaa_sample_positions_4[s] : msaa_sample_positions_8[s];
+        renderer->sample_x[s] = 0.5f + position[0] / 16.0f;
+        renderer->sample_y[s] = 0.5f + position[1] / 16.0f;
+    }
+
+    uint32_t worker_count = job_pool_worker_count(pool);
+    renderer->tiles = (msaa_tile_t *)malloc(worker_count * sizeof(msaa_tile_t));
+    assert(renderer->tiles);
+    return renderer;
+}
+
+void msaa_destroy_renderer(msaa_renderer_t *renderer)
+{
+    free(renderer->tiles);
+    raster_free_bins(&renderer->bins);
+    delete renderer;
+}
+
+void msaa_clear_tile(msaa_tile_t *tile, uint32_t sample_count, uint32_t clear_color)
+{
+    for (uint32_t i = 0; i < RASTER_TILE_SIZE * RASTER_TILE_SIZE; ++i)
+    {
+        tile->color[i] = clear_color;
+        tile->slot[i] = MSAA_NO_SLOT;
+    }
+    tile->slot_count = 0;
+
+    for (uint32_t s = 0; s < sample_count; ++s)
+    {
+        for (uint32_t i = 0; i < RASTER_TILE_SIZE * RASTER_TILE_SIZE; i += 8)
+        {
+            f32x8_store(&tile->depth[s][i], f32x8(1.0f));
+        }
+    }
+}
+
+void msaa_draw_triangle(msaa_renderer_t *renderer, msaa_tile_t *tile, const raster_triangle_t *triangle, int32_t tile_x, int32_t tile_y)
+{
+    const uint32_t sample_count = renderer->sample_count;
+
+    int32_t x_begin = triangle->min_x > tile_x ? triangle->min_x : tile_x;
+    int32_t y_begin = triangle->min_y > tile_y ? triangle->min_y : tile_y;
+    int32_t x_end = triangle->max_x < tile_x + RASTER_TILE_SIZE - 1 ? triangle->max_x : tile_x + RASTER_TILE_SIZE - 1;
+    int32_t y_end = triangle->max_y < tile_y + RASTER_TILE_SIZE - 1 ? triangle->max_y : tile_y + RASTER_TILE_SIZE - 1;
+
+    // Spans start on 8-pixel boundaries inside the tile, the edge test takes
+    // care of lanes left of the triangle.
+    x_begin = tile_x + ((x_begin - tile_x) & ~7);
+
+    for (int32_t y = y_begin; y <= y_end; ++y)
+    {
+        f32x8_t row_y = f32x8((real32_t)y - triangle->origin_y);
+
+        for (int32_t x = x_begin; x <= x_end; x += 8)
+        {
+            f32x8_t span_x = f32x8_ramp((real32_t)x - triangle->origin_x);
+            uint32_t pixel = (uint32_t)((y - tile_y) * RASTER_TILE_SIZE + (x - tile_x));
+
+            uint32_t sample_bits[MSAA_MAX_SAMPLES];
+            i32x8_t all = i32x8(-1);
+            uint32_t any_bits = 0;
+            for (uint32_t s = 0; s < sample_count; ++s)
+            {
+                f32x8_t sx = span_x + f32x8(renderer->sample_x[s]);
+                f32x8_t sy = row_y + f32x8(renderer->sample_y[s]);
+                f32x8_t z = raster_depth(triangle, sx, sy);
+                f32x8_t depth = f32x8_load(&tile->depth[s][pixel]);
+
+                i32x8_t pass = raster_coverage(triangle, sx, sy) & cmp_lt(z, depth);
+                f32x8_store(&tile->depth[s][pixel], select(pass, z, depth));
+
+                sample_bits[s] = movemask(pass);
+                all = all & pass;
+                any_bits |= sample_bits[s];
+            }
+
+            if (!any_bits)
+            {
+                continue;
+            }
+
+            // Every sample covered: the pixel collapses back to one colour.
+            uint32_t all_bits = movemask(all);
+            if (all_bits)
+            {
+                int32_t *color = (int32_t *)&tile->color[pixel];
+                i32x8_store(color, select(all, i32x8((int32_t)triangle->color), i32x8_load(color)));
+                if (tile->slot_count)
+                {
+                    for (uint32_t lane = 0; lane < 8; ++lane)
+                    {
+                        if (all_bits & (1u << lane))
+                        {
+                            tile->slot[pixel + lane] |= MSAA_COMPRESSED_BIT;
+                        }
+                    }
+                }
+            }
+
+            uint32_t partial_bits = any_bits & ~all_bits;
+            for (uint32_t lane = 0; partial_bits >> lane; ++lane)
+            {
+                if (!(partial_bits & (1u << lane)))
+                {
+                    continue;
+                }
+                uint32_t p = pixel + lane;
+
+                uint32_t slot = tile->slot[p];
+                if (slot & MSAA_COMPRESSED_BIT)
+                {
+                    if (tile->color[p] == triangle->color)
+                    {
+                        continue;
+                    }
+                    slot = slot == MSAA_NO_SLOT ? tile->slot_count++ : slot & ~MSAA_COMPRESSED_BIT;
+                    tile->slot[p] = (uint16_t)slot;
+                    for (uint32_t s = 0; s < sample_count; ++s)
+                    {
+                        tile->samples[slot * sample_count + s] = tile->color[p];
+                    }
+                }
+
+                for (uint32_t s = 0; s < sample_count; ++s)
+                {
+                    if (sample_bits[s] & (1u << lane))
+                    {
+                        tile->samples[slot * sample_count + s] = triangle->color;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Box filter of the samples of one split pixel.
+inline uint32_t msaa_resolve_pixel(const uint32_t *samples, uint32_t sample_count)
+{
+    uint32_t r = 0, g = 0, b = 0, a = 0;
+    for (uint32_t s = 0; s < sample_count; ++s)
+    {
+        r += samples[s] & 0xff;
+        g += (samples[s] >> 8) & 0xff;
+        b += (samples[s] >> 16) & 0xff;
+        a += samples[s] >> 24;
+    }
+    uint32_t half = sample_count / 2;
+    return ((r + half) / sample_count) | (((g + half) / sample_count) << 8) | (((b + half) / sample_count) << 16) | (((a + half) / sample_count) << 24);
+}
+
+void msaa_render_tile(void *data, uint32_t tile_index, uint32_t worker)
+{
+    msaa_renderer_t *renderer = (msaa_renderer_t *)data;
+    msaa_tile_t *tile = &renderer->tiles[worker];
+    const raster_bins_t *bins = &renderer->bins;
+
+    int32_t tile_x = (int32_t)((tile_index % bins->tiles_x) * RASTER_TILE_SIZE);
+    int32_t tile_y = (int32_t)((tile_index / bins->tiles_x) * RASTER_TILE_SIZE);
+
+    msaa_clear_tile(tile, renderer->sample_count, renderer->clear_color);
+
+    for (uint32_t i = bins->offsets[tile_index]; i < bins->offsets[tile_index + 1]; ++i)
+    {
+        msaa_draw_triangle(renderer, tile, &renderer->triangles[bins->indices[i]], tile_x, tile_y);
+    }
+
+    uint32_t width = renderer->width - tile_x < RASTER_TILE_SIZE ? renderer->width - tile_x : RASTER_TILE_SIZE;
+    uint32_t height = renderer->height - tile_y < RASTER_TILE_SIZE ? renderer->height - tile_y : RASTER_TILE_SIZE;
+    uint32_t split = 0;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint32_t *row = renderer->pixels + (tile_y + y) * renderer->width + tile_x;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t p = y * RASTER_TILE_SIZE + x;
+            if (tile->slot[p] & MSAA_COMPRESSED_BIT)
+            {
+                row[x] = tile->color[p];
+            }
+            else
+            {
+                row[x] = msaa_resolve_pixel(&tile->samples[tile->slot[p] * renderer->sample_count], renderer->sample_count);
+                ++split;
+            }
+        }
+    }
+    renderer->split_pixels += split;
+}
+
+// Renders triangles in order with a LESS depth test against a depth cleared
+// to 1, and writes the resolved RGBA8 image to pixels (width * height).
+void msaa_render(msaa_renderer_t *renderer, const raster_triangle_t *triangles, uint32_t triangle_count, uint32_t clear_color, uint32_t *pixels, uint32_t width, uint32_t height, msaa_stats_t *stats = 0)
+{
+    raster_bin_triangles(&renderer->bins, triangles, triangle_count, width, height);
+
+    renderer->triangles = triangles;
+    renderer->clear_color = clear_color;
+    renderer->pixels = pixels;
+    renderer->width = width;
+    renderer->height = height;
+    renderer->split_pixels = 0;
+
+    job_pool_run(renderer->pool, renderer->bins.tiles_x * renderer->bins.tiles_y, msaa_render_tile, renderer);
+
+    if (stats)
+    {
+        stats->pixels = (uint64_t)width * height;
+        stats->split_pixels = renderer->split_pixels;
+    }
+}
@@ -1,161 +1,128 @@
 #pragma once
 
 #include <cassert>
-#include <Windows.h>
-#include <GL/gl.h>
-#include "glext.h"
-#include "wglext.h"
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <stdint.h>
 #include "math.h"
-#include <stdio.h>
 
-bool running;
-bool resized;
-uint32_t viewport_width;
-uint32_t viewport_height;
-HWND window_handle;
-HDC device_context;
-HGLRC opengl_render_context;
-
-#define DECLARE_GL_PROC(pointer_name, function_name) pointer_name function_name
-#define LOAD_GL_PROC(pointer_name, function_name) function_name = (pointer_name)wglGetProcAddress(#function_name);
-
-DECLARE_GL_PROC(PFNGLCREATESHADERPROC, glCreateShader);
-DECLARE_GL_PROC(PFNGLCREATEPROGRAMPROC, glCreateProgram);
-DECLARE_GL_PROC(PFNGLLINKPROGRAMPROC, glLinkProgram);
-DECLARE_GL_PROC(PFNGLUSEPROGRAMPROC, glUseProgram);
-DECLARE_GL_PROC(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation);
-DECLARE_GL_PROC(PFNGLUNIFORMMATRIX4FVPROC, glUniformMatrix4fv);
-DECLARE_GL_PROC(PFNGLUNIFORM4FVPROC, glUniform4fv);
-DECLARE_GL_PROC(PFNGLSHADERSOURCEPROC, glShaderSource);
-DECLARE_GL_PROC(PFNGLCOMPILESHADERPROC, glCompileShader);
-DECLARE_GL_PROC(PFNGLGETSHADERIVPROC, glGetShaderiv);
-DECLARE_GL_PROC(PFNGLGETPROGRAMIVPROC, glGetProgramiv);
-DECLARE_GL_PROC(PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog);
-DECLARE_GL_PROC(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog);
-DECLARE_GL_PROC(PFNGLATTACHSHADERPROC, glAttachShader);
-DECLARE_GL_PROC(PFNGLDETACHSHADERPROC, glDetachShader);
-
-void initialize_opengl()
+// Window and GL context setup. One backend provides create_render_context(),
+// destroy_render_context(), make_render_context_current(),
+// catch_input_events() and swap_buffers():
+//
+//   PLATFORM_WIN32     Win32 window + WGL, the default on Windows
+//   PLATFORM_GLX       X11 window + GLX, the default elsewhere
+//   PLATFORM_EGL       X11 window + EGL
+//   PLATFORM_HEADLESS  EGL without any display, renders into an FBO
+//
+// The headless backend uses a surfaceless context when the driver has one
+// (Mesa, render nodes) and a 1x1 pbuffer otherwise.
+//
+// A process can have any number of render contexts, each a window or, with
+// the headless backend, an offscreen framebuffer. They share no objects, so
+// each can be current on its own thread and render in parallel with the
+// others; gl_state keeps one cache per thread to match. Create and destroy
+// contexts on one thread at a time. A new context is current on the thread
+// that created it; release it with make_render_context_current(NULL) before
+// another thread takes it over. Switching the calling thread's context
+// invalidates its gl_state and pipeline_state caches.
+
+#if !defined(PLATFORM_WIN32) && !defined(PLATFORM_GLX) && !defined(PLATFORM_EGL) && !defined(PLATFORM_HEADLESS)
+#ifdef _WIN32
+#define PLATFORM_WIN32
+#else
+#define PLATFORM_GLX
+#endif
+#endif
+
+struct platform_context_t;     // defined by the backend
+
+struct render_context_t
 {
-    PIXELFORMATDESCRIPTOR pfd = {};
-
-    pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
-    pfd.nVersion = 1;
-    pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
-    pfd.iPixelType = PFD_TYPE_RGBA;
-    pfd.cColorBits = 32;
-    pfd.cDepthBits = 24;
-
-    device_context = GetDC(window_handle);
-    int32_t format_index = ChoosePixelFormat(device_context, &pfd);
-    assert(format_index);
-    assert(SetPixelFormat(device_context, format_index, &pfd));
-
-    opengl_render_context = wglCreateContext(device_context);
-    assert(opengl_render_context);
-
-    assert(wglMakeCurrent(device_context, opengl_render_context));
-
-    LOAD_GL_PROC(PFNGLCREATESHADERPROC, glCreateShader);
-    LOAD_GL_PROC(PFNGLCREATEPROGRAMPROC, glCreateProgram);
-    LOAD_GL_PROC(PFNGLLINKPROGRAMPROC, glLinkProgram);
-    LOAD_GL_PROC(PFNGLSHADERSOURCEPROC, glShaderSource);
-    LOAD_GL_PROC(PFNGLCOMPILESHADERPROC, glCompileShader);
-    LOAD_GL_PROC(PFNGLGETSHADERIVPROC, glGetShaderiv);
-    LOAD_GL_PROC(PFNGLGETPROGRAMIVPROC, glGetProgramiv);
-    LOAD_GL_PROC(PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog);
-    LOAD_GL_PROC(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog);
-    LOAD_GL_PROC(PFNGLATTACHSHADERPROC, glAttachShader);
-    LOAD_GL_PROC(PFNGLDETACHSHADERPROC, glDetachShader);
-    LOAD_GL_PROC(PFNGLUSEPROGRAMPROC, glUseProgram);
-    LOAD_GL_PROC(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation);
-    LOAD_GL_PROC(PFNGLUNIFORMMATRIX4FVPROC, glUniformMatrix4fv);
-    LOAD_GL_PROC(PFNGLUNIFORM4FVPROC, glUniform4fv);
-}
-
-LRESULT CALLBACK window_callback(HWND window_handle, UINT message, WPARAM wparam, LPARAM lparam)
+    bool running;
+    bool resized;
+    uint32_t viewport_width;
+    uint32_t viewport_height;
+    uint32_t color_read_buffer;    // what save_frame() reads, the back buffer or the headless FBO
+    uint32_t framebuffer;          // what stands in for framebuffer 0, the headless FBO or 0
+    platform_context_t *platform;
+};
+
+// The render context current on the calling thread, NULL if none is.
+thread_local render_context_t *current_render_context;
+
+// Run on the calling thread whenever its current render context changes.
+// gl_state.h installs gl_state_invalidate(), which resets pipeline_state too.
+void (*render_context_switch_hook)();
+
+// For the backends, once the platform call succeeded.
+void set_current_render_context(render_context_t *context)
 {
-    switch (message)
+    if (context != current_render_context && render_context_switch_hook)
     {
-    case WM_CLOSE: {
-        running = 0;
-        PostQuitMessage(0);
-    } break;
+        render_context_switch_hook();
     }
-
-    return DefWindowProc(window_handle, message, wparam, lparam);
+    current_render_context = context;
 }
 
-void initialize_window_and_opengl()
-{
-    HINSTANCE hinstance = GetModuleHandle(NULL);
-
-    running = 0;
-
-    const char *window_class_name = "triangle_demo_class";
-    const char *window_name = "Triangle!";
-
-    SetProcessDPIAware();
-
-    WNDCLASS window_class = {};
-    window_class.style = CS_OWNDC | CS_VREDRAW | CS_HREDRAW;
-    window_class.hInstance = hinstance;
-    window_class.lpszClassName = window_class_name;
-    window_class.lpfnWndProc = window_callback;
-
-    assert(RegisterClass(&window_class));
+#if defined(PLATFORM_WIN32)
+#include "platform_win32.h"
+#elif defined(PLATFORM_GLX)
+#include "platform_glx.h"
+#else
+#include "platform_egl.h"
+#endif
 
-    window_handle = CreateWindowEx(0,
-        window_class_name,
-        window_name,
-        WS_OVERLAPPEDWINDOW,
-        CW_USEDEFAULT,
-        CW_USEDEFAULT,
-        CW_USEDEFAULT,
-        CW_USEDEFAULT,
-        NULL,
-        NULL,
-        hinstance,
-        NULL);
+#include "image_output.h"
 
-    RECT rect = {};
-    GetClientRect(window_handle, &rect);
-
-    viewport_width = rect.right;
-    viewport_height = rect.bottom;
-    
-    assert(window_handle);
-
-    initialize_opengl();
-
-    ShowWindow(window_handle, SW_SHOW);
-
-    running = 1;
-
-    glViewport(0, 0, viewport_width, viewport_height);
+bool gl_has_extension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (extension && strcmp(extension, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
-void catch_input_events()
+// True when the context is at least major.minor or, if given, has the
+// extension that brought the feature in earlier.
+bool gl_supports(int32_t major, int32_t minor, const char *extension)
 {
-    MSG message;
-    while (PeekMessage(&message, NULL, 0, 0, PM_REMOVE))
+    GLint context_major = 0;
+    GLint context_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    if (context_major > major || (context_major == major && context_minor >= minor))
     {
-        TranslateMessage(&message);
-        DispatchMessage(&message);
+        return true;
     }
+    return extension && gl_has_extension(extension);
 }
 
-void swap_buffers()
+#include "gl_validation.h"
+
+// Queues the rendered frame of context, which has to be current, for writing;
+// call before swap_buffers().
+void save_frame(render_context_t *context, image_output_t *output, const char *path, image_format_t format)
 {
-    SwapBuffers(device_context);
+    assert(context == current_render_context);
+    uint32_t *pixels = image_output_begin_frame(output, context->viewport_width, context->viewport_height, true);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadBuffer(context->color_read_buffer);
+    glReadPixels(0, 0, context->viewport_width, context->viewport_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    image_output_end_frame(output, path, format);
 }
 
-bool is_window_open()
+bool is_window_open(const render_context_t *context)
 {
-    return running;
+    return context->running;
 }
 
 const char *load_vertex_shader_code()
@@ -193,4 +160,4 @@ void main()
 )";
 
     return source;
-}
\ No newline at end of file
+}
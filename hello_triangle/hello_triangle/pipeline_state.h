@@ -0,0 +1,314 @@
+#pragma once
+
+#include <cassert>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include "opengl.h"
+#include "gl_state.h"
+
+// Immutable bundles of the state a draw needs: program, vertex layout, blend,
+// depth/stencil and raster state. pipeline_state_create() interns a
+// description and returns a small handle, equal descriptions get the same
+// handle, and draws refer to that. pipeline_state_apply() only touches the
+// groups that differ from the pipeline applied before, and within a group
+// gl_state skips the calls whose value is already set.
+//
+// Program and vertex array always go through gl_state, since other code binds
+// them too. Code that changes blend, depth, stencil or raster state outside
+// pipelines has to call pipeline_state_invalidate() afterwards.
+// gl_state_invalidate() takes care of this itself: the next apply sees the
+// new gl_state generation and starts over as if nothing had been applied.
+//
+// Pipelines can be created on any thread, under a lock, and handles used
+// anywhere. What was applied last is tracked per thread, like gl_state.
+
+#define PIPELINE_STATE_MAX 1024
+#define PIPELINE_STATE_TABLE_SIZE 2048     // power of two, at least twice the maximum
+#define PIPELINE_STATE_NONE 0xffffffffu
+
+// Every field is 32 bits wide so descriptions hash and compare as words.
+struct pipeline_blend_t
+{
+    uint32_t enabled;
+    uint32_t source_rgb;
+    uint32_t destination_rgb;
+    uint32_t source_alpha;
+    uint32_t destination_alpha;
+    uint32_t equation_rgb;
+    uint32_t equation_alpha;
+    uint32_t color_mask;        // bit 0 red ... bit 3 alpha
+};
+
+struct pipeline_depth_stencil_t
+{
+    uint32_t depth_test;
+    uint32_t depth_write;
+    uint32_t depth_function;
+    uint32_t stencil_test;
+    uint32_t stencil_function;
+    uint32_t stencil_reference;
+    uint32_t stencil_read_mask;
+    uint32_t stencil_write_mask;
+    uint32_t stencil_fail;
+    uint32_t stencil_depth_fail;
+    uint32_t stencil_pass;
+};
+
+struct pipeline_raster_t
+{
+    uint32_t cull;
+    uint32_t cull_face;
+    uint32_t front_face;
+    uint32_t polygon_mode;
+    uint32_t polygon_offset;
+    real32_t polygon_offset_factor;
+    real32_t polygon_offset_units;
+    uint32_t scissor_test;
+};
+
+struct pipeline_state_t
+{
+    uint32_t program;
+    uint32_t vertex_array;      // the vertex layout and its buffers
+    pipeline_blend_t blend;
+    pipeline_depth_stencil_t depth_stencil;
+    pipeline_raster_t raster;
+};
+
+static_assert(sizeof(pipeline_state_t) % sizeof(uint32_t) == 0, "pipeline_state_t has to be made of 32-bit words");
+
+struct pipeline_state_stats_t
+{
+    uint64_t applied;
+    uint64_t skipped;           // the pipeline was already current
+    uint64_t groups_changed;    // blend, depth/stencil or raster groups applied
+};
+
+struct pipeline_state_table_t
+{
+    pipeline_state_t states[PIPELINE_STATE_MAX];
+    uint32_t hashes[PIPELINE_STATE_MAX];
+    uint16_t slots[PIPELINE_STATE_TABLE_SIZE];     // handle + 1, 0 when empty
+    std::atomic<uint32_t> count;
+    std::mutex mutex;           // held while interning
+};
+
+// The pipeline applied last on this thread.
+struct pipeline_state_cursor_t
+{
+    uint32_t current;
+    uint32_t generation;    // of gl_state when current was applied
+    pipeline_state_stats_t stats;
+};
+
+pipeline_state_table_t pipeline_states;
+thread_local pipeline_state_cursor_t pipeline_state_cursor = { PIPELINE_STATE_NONE, 0, {} };
+
+// GL's initial state, with no program or vertex array.
+pipeline_state_t pipeline_state_defaults()
+{
+    pipeline_state_t state = {};
+    state.blend.source_rgb = GL_ONE;
+    state.blend.destination_rgb = GL_ZERO;
+    state.blend.source_alpha = GL_ONE;
+    state.blend.destination_alpha = GL_ZERO;
+    state.blend.equation_rgb = GL_FUNC_ADD;
+    state.blend.equation_alpha = GL_FUNC_ADD;
+    state.blend.color_mask = 0xf;
+    state.depth_stencil.depth_write = 1;
+    state.depth_stencil.depth_function = GL_LESS;
+    state.depth_stencil.stencil_function = GL_ALWAYS;
+    state.depth_stencil.stencil_read_mask = 0xffffffff;
+    state.depth_stencil.stencil_write_mask = 0xffffffff;
+    state.depth_stencil.stencil_fail = GL_KEEP;
+    state.depth_stencil.stencil_depth_fail = GL_KEEP;
+    state.depth_stencil.stencil_pass = GL_KEEP;
+    state.raster.cull_face = GL_BACK;
+    state.raster.front_face = GL_CCW;
+    state.raster.polygon_mode = GL_FILL;
+    return state;
+}
+
+// Resets the values a disabled feature ignores, so states differing only in
+// those intern to one handle.
+void pipeline_state_normalize(pipeline_state_t *state)
+{
+    pipeline_state_t defaults = pipeline_state_defaults();
+    state->blend.enabled = state->blend.enabled != 0;
+    if (!state->blend.enabled)
+    {
+        uint32_t color_mask = state->blend.color_mask;
+        state->blend = defaults.blend;
+        state->blend.color_mask = color_mask;
+    }
+
+    pipeline_depth_stencil_t *depth_stencil = &state->depth_stencil;
+    depth_stencil->depth_test = depth_stencil->depth_test != 0;
+    depth_stencil->depth_write = depth_stencil->depth_write != 0;
+    depth_stencil->stencil_test = depth_stencil->stencil_test != 0;
+    if (!depth_stencil->depth_test)
+    {
+        depth_stencil->depth_function = defaults.depth_stencil.depth_function;
+    }
+    if (!depth_stencil->stencil_test)
+    {
+        uint32_t depth_test = depth_stencil->depth_test;
+        uint32_t depth_write = depth_stencil->depth_write;
+        uint32_t depth_function = depth_stencil->depth_function;
+        *depth_stencil = defaults.depth_stencil;
+        depth_stencil->depth_test = depth_test;
+        depth_stencil->depth_write = depth_write;
+        depth_stencil->depth_function = depth_function;
+    }
+
+    pipeline_raster_t *raster = &state->raster;
+    raster->cull = raster->cull != 0;
+    raster->polygon_offset = raster->polygon_offset != 0;
+    raster->scissor_test = raster->scissor_test != 0;
+    if (!raster->cull)
+    {
+        raster->cull_face = defaults.raster.cull_face;
+    }
+    if (!raster->polygon_offset)
+    {
+        raster->polygon_offset_factor = 0.0f;
+        raster->polygon_offset_units = 0.0f;
+    }
+}
+
+uint32_t pipeline_state_hash(const pipeline_state_t *state)
+{
+    const uint32_t *words = (const uint32_t *)state;
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < sizeof(pipeline_state_t) / sizeof(uint32_t); ++i)
+    {
+        hash = (hash ^ words[i]) * 16777619u;
+        hash ^= hash >> 15;
+    }
+    return hash;
+}
+
+// Returns the handle of the interned copy of desc.
+uint32_t pipeline_state_create(const pipeline_state_t *desc)
+{
+    pipeline_state_table_t *table = &pipeline_states;
+    pipeline_state_t state = *desc;
+    pipeline_state_normalize(&state);
+    uint32_t hash = pipeline_state_hash(&state);
+
+    std::lock_guard<std::mutex> lock(table->mutex);
+    uint32_t mask = PIPELINE_STATE_TABLE_SIZE - 1;
+    for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        uint32_t entry = table->slots[slot];
+        if (!entry)
+        {
+            uint32_t handle = table->count.load(std::memory_order_relaxed);
+            assert(handle < PIPELINE_STATE_MAX);
+            table->states[handle] = state;
+            table->hashes[handle] = hash;
+            table->slots[slot] = (uint16_t)(handle + 1);
+            table->count.store(handle + 1, std::memory_order_release);
+            return handle;
+        }
+        uint32_t handle = entry - 1;
+        if (table->hashes[handle] == hash && memcmp(&table->states[handle], &state, sizeof(state)) == 0)
+        {
+            return handle;
+        }
+    }
+}
+
+inline const pipeline_state_t *pipeline_state_get(uint32_t handle)
+{
+    assert(handle < pipeline_states.count.load(std::memory_order_acquire));
+    return &pipeline_states.states[handle];
+}
+
+inline void pipeline_state_invalidate()
+{
+    pipeline_state_cursor.current = PIPELINE_STATE_NONE;
+}
+
+void pipeline_state_apply_blend(const pipeline_blend_t *blend)
+{
+    gl_state_set_blend(blend->enabled != 0);
+    if (blend->enabled)
+    {
+        gl_state_set_blend_function(blend->source_rgb, blend->destination_rgb, blend->source_alpha, blend->destination_alpha);
+        gl_state_set_blend_equation(blend->equation_rgb, blend->equation_alpha);
+    }
+    gl_state_set_color_mask(blend->color_mask);
+}
+
+void pipeline_state_apply_depth_stencil(const pipeline_depth_stencil_t *depth_stencil)
+{
+    gl_state_set_depth_test(depth_stencil->depth_test != 0);
+    if (depth_stencil->depth_test)
+    {
+        gl_state_set_depth_function(depth_stencil->depth_function);
+    }
+    gl_state_set_depth_write(depth_stencil->depth_write != 0);
+
+    gl_state_set_stencil_test(depth_stencil->stencil_test != 0);
+    if (depth_stencil->stencil_test)
+    {
+        gl_state_set_stencil_function(depth_stencil->stencil_function, (int32_t)depth_stencil->stencil_reference, depth_stencil->stencil_read_mask);
+        gl_state_set_stencil_operation(depth_stencil->stencil_fail, depth_stencil->stencil_depth_fail, depth_stencil->stencil_pass);
+    }
+    gl_state_set_stencil_write_mask(depth_stencil->stencil_write_mask);
+}
+
+void pipeline_state_apply_raster(const pipeline_raster_t *raster)
+{
+    gl_state_set_cull(raster->cull != 0);
+    if (raster->cull)
+    {
+        gl_state_set_cull_face(raster->cull_face);
+    }
+    gl_state_set_front_face(raster->front_face);
+    gl_state_set_polygon_mode(raster->polygon_mode);
+    gl_state_set_polygon_offset(raster->polygon_offset != 0, raster->polygon_offset_factor, raster->polygon_offset_units);
+    gl_state_set_scissor_test(raster->scissor_test != 0);
+}
+
+void pipeline_state_apply(uint32_t handle)
+{
+    const pipeline_state_t *state = pipeline_state_get(handle);
+    gl_state_use_program(state->program);
+    gl_state_bind_vertex_array(state->vertex_array);
+
+    pipeline_state_cursor_t *cursor = &pipeline_state_cursor;
+    if (cursor->generation != gl_state.generation)
+    {
+        cursor->current = PIPELINE_STATE_NONE;
+        cursor->generation = gl_state.generation;
+    }
+    if (cursor->current == handle)
+    {
+        ++cursor->stats.skipped;
+        return;
+    }
+
+    const pipeline_state_t *previous = cursor->current != PIPELINE_STATE_NONE ? pipeline_state_get(cursor->current) : NULL;
+    if (!previous || memcmp(&previous->blend, &state->blend, sizeof(state->blend)) != 0)
+    {
+        pipeline_state_apply_blend(&state->blend);
+        ++cursor->stats.groups_changed;
+    }
+    if (!previous || memcmp(&previous->depth_stencil, &state->depth_stencil, sizeof(state->depth_stencil)) != 0)
+    {
+        pipeline_state_apply_depth_stencil(&state->depth_stencil);
+        ++cursor->stats.groups_changed;
+    }
+    if (!previous || memcmp(&previous->raster, &state->raster, sizeof(state->raster)) != 0)
+    {
+        pipeline_state_apply_raster(&state->raster);
+        ++cursor->stats.groups_changed;
+    }
+
+    cursor->current = handle;
+    ++cursor->stats.applied;
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+// EGL context, either on an X11 window (PLATFORM_EGL) or with no display at
+// all (PLATFORM_HEADLESS). Included by opengl.h.
+//
+// Headless rendering goes into an FBO of the context's size that stays bound;
+// there is no default framebuffer to fall back to, so code that binds
+// framebuffer 0 has to bind the context's framebuffer instead.
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include "glext.h"
+#include "gl_dispatch.h"
+
+#ifndef PLATFORM_HEADLESS
+#include "platform_x11.h"
+#endif
+
+struct platform_context_t
+{
+#ifndef PLATFORM_HEADLESS
+    x11_window_t window;
+#endif
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+    EGLConfig config;
+    uint32_t shared_contexts;   // made from this one and not destroyed yet
+
+    // Headless only, attached to the render context's framebuffer.
+    GLuint color_buffer;
+    GLuint depth_buffer;
+};
+
+void *egl_get_proc_address(const char *name)
+{
+    return (void *)eglGetProcAddress(name);
+}
+
+bool egl_has_extension(const char *extensions, const char *name)
+{
+    size_t length = strlen(name);
+    for (const char *found = extensions ? strstr(extensions, name) : NULL; found; found = strstr(found + length, name))
+    {
+        bool starts = found == extensions || found[-1] == ' ';
+        bool ends = found[length] == ' ' || found[length] == '\0';
+        if (starts && ends)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+EGLConfig egl_choose_config(EGLDisplay display, EGLint surface_type)
+{
+    EGLint attributes[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_SURFACE_TYPE, surface_type,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, surface_type & EGL_WINDOW_BIT ? 8 : 0,
+        EGL_DEPTH_SIZE, surface_type & EGL_WINDOW_BIT ? 24 : 0,
+        EGL_NONE
+    };
+    EGLConfig config = NULL;
+    EGLint config_count = 0;
+    EGLBoolean chosen = eglChooseConfig(display, attributes, &config, 1, &config_count);
+    assert(chosen && config_count > 0);
+    return config;
+}
+
+// Binds context to the calling thread, or releases the thread's context when
+// context is NULL.
+bool make_render_context_current(render_context_t *context)
+{
+    EGLBoolean bound = eglBindAPI(EGL_OPENGL_API);
+    assert(bound);
+    bool current;
+    if (!context)
+    {
+        EGLDisplay display = eglGetCurrentDisplay();
+        current = display == EGL_NO_DISPLAY || eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_TRUE;
+    }
+    else
+    {
+        platform_context_t *platform = context->platform;
+        current = eglMakeCurrent(platform->display, platform->surface, platform->surface, platform->context) == EGL_TRUE;
+    }
+    if (current)
+    {
+        set_current_render_context(context);
+    }
+    return current;
+}
+
+// Under GL_VALIDATION a debug context, which some drivers need before they
+// report anything through KHR_debug, or a plain one where EGL 1.5 is missing.
+EGLContext egl_create_gl_context(EGLDisplay display, EGLConfig config, EGLContext share)
+{
+#ifdef GL_VALIDATION
+    EGLint attributes[] = { EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, share, attributes);
+    if (context != EGL_NO_CONTEXT)
+    {
+        return context;
+    }
+    fprintf(stderr, "platform_egl: no debug context, GL errors may go unreported\n");
+#endif
+    return eglCreateContext(display, config, share, NULL);
+}
+
+void egl_create_context(render_context_t *context, EGLConfig config)
+{
+    platform_context_t *platform = context->platform;
+    EGLBoolean bound = eglBindAPI(EGL_OPENGL_API);
+    assert(bound);
+    platform->config = config;
+    platform->context = egl_create_gl_context(platform->display, config, EGL_NO_CONTEXT);
+    assert(platform->context != EGL_NO_CONTEXT);
+
+    bool current = make_render_context_current(context);
+    assert(current);
+
+    if (!gl_dispatch.get_proc_address)
+    {
+        bool loaded = gl_dispatch_load(egl_get_proc_address);
+        assert(loaded);
+    }
+    gl_validation_initialize(false);
+}
+
+render_context_t *egl_allocate_context(uint32_t width, uint32_t height)
+{
+    render_context_t *context = (render_context_t *)calloc(1, sizeof(render_context_t));
+    assert(context);
+    context->platform = (platform_context_t *)calloc(1, sizeof(platform_context_t));
+    assert(context->platform);
+    context->viewport_width = width;
+    context->viewport_height = height;
+    context->platform->surface = EGL_NO_SURFACE;
+    return context;
+}
+
+// A context sharing objects with the render context current on the calling
+// thread, for worker threads. Create it on that thread, then make it current
+// on the worker. It never draws, so it is surfaceless where the driver allows
+// and has a 1x1 pbuffer otherwise.
+struct shared_context_t
+{
+    platform_context_t *parent;
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+};
+
+shared_context_t *create_shared_context()
+{
+    render_context_t *parent = current_render_context;
+    assert(parent);
+    shared_context_t *shared = (shared_context_t *)calloc(1, sizeof(shared_context_t));
+    assert(shared);
+    shared->parent = parent->platform;
+    ++shared->parent->shared_contexts;
+    shared->display = parent->platform->display;
+    shared->context = egl_create_gl_context(shared->display, parent->platform->config, parent->platform->context);
+    assert(shared->context != EGL_NO_CONTEXT);
+
+    shared->surface = EGL_NO_SURFACE;
+    if (!egl_has_extension(eglQueryString(shared->display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+    {
+        EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        shared->surface = eglCreatePbufferSurface(shared->display, parent->platform->config, pbuffer_attributes);
+        assert(shared->surface != EGL_NO_SURFACE);
+    }
+    return shared;
+}
+
+// Binds shared to the calling thread, or releases the thread's context when
+// shared is NULL.
+bool make_shared_context_current(shared_context_t *shared)
+{
+    EGLBoolean bound = eglBindAPI(EGL_OPENGL_API);
+    assert(bound);
+    if (!shared)
+    {
+        EGLDisplay display = eglGetCurrentDisplay();
+        return display == EGL_NO_DISPLAY || eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_TRUE;
+    }
+    return eglMakeCurrent(shared->display, shared->surface, shared->surface, shared->context) == EGL_TRUE;
+}
+
+void destroy_shared_context(shared_context_t *shared)
+{
+    eglDestroyContext(shared->display, shared->context);
+    if (shared->surface != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(shared->display, shared->surface);
+    }
+    --shared->parent->shared_contexts;
+    free(shared);
+}
+
+// The context's objects go with it, as nothing shares them. Destroy the
+// shared contexts made from it first.
+void destroy_render_context(render_context_t *context)
+{
+    platform_context_t *platform = context->platform;
+    assert(!platform->shared_contexts);
+    if (current_render_context == context)
+    {
+        make_render_context_current(NULL);
+    }
+    eglDestroyContext(platform->display, platform->context);
+    if (platform->surface != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(platform->display, platform->surface);
+    }
+#ifndef PLATFORM_HEADLESS
+    // Every window has its own X connection and so its own EGL display, which
+    // has to be terminated while the connection is still open.
+    eglTerminate(platform->display);
+    x11_destroy_window(&platform->window);
+#endif
+    free(platform);
+    free(context);
+}
+
+#ifdef PLATFORM_HEADLESS
+
+// An offscreen framebuffer of width x height with its own context, current
+// on the calling thread. The dispatch table is loaded with the first one.
+render_context_t *create_render_context(uint32_t width, uint32_t height)
+{
+    render_context_t *context = egl_allocate_context(width, height);
+    platform_context_t *platform = context->platform;
+
+    // Prefer Mesa's surfaceless platform, which needs nothing but a render
+    // node, then whatever the default display is. Every context gets the same
+    // display back.
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    platform->display = EGL_NO_DISPLAY;
+    if (get_platform_display && egl_has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        platform->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (platform->display == EGL_NO_DISPLAY)
+    {
+        platform->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    assert(platform->display != EGL_NO_DISPLAY);
+
+    EGLBoolean initialized = eglInitialize(platform->display, NULL, NULL);
+    assert(initialized);
+
+    // Without surfaceless contexts a throwaway pbuffer makes the context current.
+    EGLConfig config;
+    if (egl_has_extension(eglQueryString(platform->display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+    {
+        config = egl_choose_config(platform->display, 0);
+    }
+    else
+    {
+        config = egl_choose_config(platform->display, EGL_PBUFFER_BIT);
+        EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        platform->surface = eglCreatePbufferSurface(platform->display, config, pbuffer_attributes);
+        assert(platform->surface != EGL_NO_SURFACE);
+    }
+    egl_create_context(context, config);
+
+    glGenRenderbuffers(1, &platform->color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, platform->color_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &platform->depth_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, platform->depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &context->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, platform->color_buffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, platform->depth_buffer);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+    context->color_read_buffer = GL_COLOR_ATTACHMENT0;
+    context->running = 1;
+
+    glViewport(0, 0, width, height);
+    return context;
+}
+
+// Nothing to present or listen to; the caller decides when to stop.
+void catch_input_events(render_context_t *context)
+{
+    (void)context;
+}
+
+void swap_buffers(render_context_t *context)
+{
+    (void)context;
+    glFlush();
+}
+
+#else
+
+// Opens a window of width x height with its own context, current on the
+// calling thread. The dispatch table is loaded with the first one.
+render_context_t *create_render_context(uint32_t width, uint32_t height)
+{
+    render_context_t *context = egl_allocate_context(width, height);
+    platform_context_t *platform = context->platform;
+
+    x11_open_display(&platform->window);
+    Display *display = platform->window.display;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    platform->display = get_platform_display ? get_platform_display(EGL_PLATFORM_X11_KHR, display, NULL) : eglGetDisplay((EGLNativeDisplayType)display);
+    assert(platform->display != EGL_NO_DISPLAY);
+
+    EGLBoolean initialized = eglInitialize(platform->display, NULL, NULL);
+    assert(initialized);
+
+    EGLConfig config = egl_choose_config(platform->display, EGL_WINDOW_BIT);
+
+    XVisualInfo visual_template = {};
+    EGLint visual_id = 0;
+    eglGetConfigAttrib(platform->display, config, EGL_NATIVE_VISUAL_ID, &visual_id);
+    visual_template.visualid = (VisualID)visual_id;
+    int visual_count = 0;
+    XVisualInfo *visual = XGetVisualInfo(display, VisualIDMask, &visual_template, &visual_count);
+    assert(visual && visual_count > 0);
+    x11_create_window(context, &platform->window, visual);
+    XFree(visual);
+
+    platform->surface = eglCreateWindowSurface(platform->display, config, (EGLNativeWindowType)platform->window.window, NULL);
+    assert(platform->surface != EGL_NO_SURFACE);
+    egl_create_context(context, config);
+
+    x11_show_window(&platform->window);
+
+    context->color_read_buffer = GL_BACK;
+    context->running = 1;
+
+    glViewport(0, 0, width, height);
+    return context;
+}
+
+void catch_input_events(render_context_t *context)
+{
+    x11_catch_input_events(context, &context->platform->window);
+}
+
+void swap_buffers(render_context_t *context)
+{
+    eglSwapBuffers(context->platform->display, context->platform->surface);
+}
+
+#endif
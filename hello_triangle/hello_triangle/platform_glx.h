@@ -0,0 +1,227 @@
+#pragma once
+
+// X11 window with a GLX context. Included by opengl.h.
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include <GL/glx.h>
+#include "glext.h"
+#include "gl_dispatch.h"
+#include "platform_x11.h"
+
+struct platform_context_t
+{
+    x11_window_t window;
+    GLXContext context;
+    GLXFBConfig config;
+};
+
+// GLX hands out a dispatch stub for any name, so a non-null result does not
+// prove the driver implements the function; check the version or extension
+// before using optional entry points.
+void *glx_get_proc_address(const char *name)
+{
+    return (void *)glXGetProcAddressARB((const GLubyte *)name);
+}
+
+#ifdef GL_VALIDATION
+
+bool glx_has_extension(Display *display, const char *name)
+{
+    const char *extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+    size_t length = strlen(name);
+    for (const char *found = extensions ? strstr(extensions, name) : NULL; found; found = strstr(found + length, name))
+    {
+        bool starts = found == extensions || found[-1] == ' ';
+        bool ends = found[length] == ' ' || found[length] == '\0';
+        if (starts && ends)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int glx_ignore_error(Display *display, XErrorEvent *event)
+{
+    (void)display;
+    (void)event;
+    return 0;
+}
+
+#endif
+
+// Under GL_VALIDATION a debug context, which some drivers need before they
+// report anything through KHR_debug, or a plain one where
+// GLX_ARB_create_context is missing or refuses.
+GLXContext glx_create_context(Display *display, GLXFBConfig config, GLXContext share)
+{
+#ifdef GL_VALIDATION
+    PFNGLXCREATECONTEXTATTRIBSARBPROC create_context_attribs = (PFNGLXCREATECONTEXTATTRIBSARBPROC)glx_get_proc_address("glXCreateContextAttribsARB");
+    if (create_context_attribs && glx_has_extension(display, "GLX_ARB_create_context"))
+    {
+        int attributes[] = { GLX_CONTEXT_FLAGS_ARB, GLX_CONTEXT_DEBUG_BIT_ARB, None };
+
+        // A refusal arrives as an X error, which would end the process.
+        int (*previous_handler)(Display *, XErrorEvent *) = XSetErrorHandler(glx_ignore_error);
+        GLXContext context = create_context_attribs(display, config, share, True, attributes);
+        XSync(display, False);
+        XSetErrorHandler(previous_handler);
+        if (context)
+        {
+            return context;
+        }
+    }
+    fprintf(stderr, "platform_glx: no debug context, GL errors may go unreported\n");
+#endif
+    return glXCreateNewContext(display, config, GLX_RGBA_TYPE, share, True);
+}
+
+// Binds context to the calling thread, or releases the thread's context when
+// context is NULL.
+bool make_render_context_current(render_context_t *context)
+{
+    bool current;
+    if (!context)
+    {
+        Display *display = glXGetCurrentDisplay();
+        current = !display || glXMakeCurrent(display, None, NULL) == True;
+    }
+    else
+    {
+        platform_context_t *platform = context->platform;
+        current = glXMakeCurrent(platform->window.display, platform->window.window, platform->context) == True;
+    }
+    if (current)
+    {
+        set_current_render_context(context);
+    }
+    return current;
+}
+
+// Opens a window of width x height with its own context, current on the
+// calling thread. The dispatch table is loaded with the first one.
+render_context_t *create_render_context(uint32_t width, uint32_t height)
+{
+    render_context_t *context = (render_context_t *)calloc(1, sizeof(render_context_t));
+    assert(context);
+    context->platform = (platform_context_t *)calloc(1, sizeof(platform_context_t));
+    assert(context->platform);
+    context->viewport_width = width;
+    context->viewport_height = height;
+
+    platform_context_t *platform = context->platform;
+    x11_open_display(&platform->window);
+    Display *display = platform->window.display;
+
+    int attributes[] = {
+        GLX_X_RENDERABLE, True,
+        GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+        GLX_RENDER_TYPE, GLX_RGBA_BIT,
+        GLX_DOUBLEBUFFER, True,
+        GLX_RED_SIZE, 8,
+        GLX_GREEN_SIZE, 8,
+        GLX_BLUE_SIZE, 8,
+        GLX_ALPHA_SIZE, 8,
+        GLX_DEPTH_SIZE, 24,
+        None
+    };
+    int config_count = 0;
+    GLXFBConfig *configs = glXChooseFBConfig(display, DefaultScreen(display), attributes, &config_count);
+    assert(configs && config_count > 0);
+
+    XVisualInfo *visual = glXGetVisualFromFBConfig(display, configs[0]);
+    assert(visual);
+    x11_create_window(context, &platform->window, visual);
+    XFree(visual);
+
+    platform->config = configs[0];
+    platform->context = glx_create_context(display, platform->config, NULL);
+    assert(platform->context);
+    XFree(configs);
+
+    bool current = make_render_context_current(context);
+    assert(current);
+
+    if (!gl_dispatch.get_proc_address)
+    {
+        bool loaded = gl_dispatch_load(glx_get_proc_address);
+        assert(loaded);
+    }
+    gl_validation_initialize(false);
+
+    x11_show_window(&platform->window);
+
+    context->color_read_buffer = GL_BACK;
+    context->running = 1;
+
+    glViewport(0, 0, context->viewport_width, context->viewport_height);
+    return context;
+}
+
+void destroy_render_context(render_context_t *context)
+{
+    platform_context_t *platform = context->platform;
+    if (current_render_context == context)
+    {
+        make_render_context_current(NULL);
+    }
+    glXDestroyContext(platform->window.display, platform->context);
+    x11_destroy_window(&platform->window);
+    free(platform);
+    free(context);
+}
+
+void catch_input_events(render_context_t *context)
+{
+    x11_catch_input_events(context, &context->platform->window);
+}
+
+void swap_buffers(render_context_t *context)
+{
+    glXSwapBuffers(context->platform->window.display, context->platform->window.window);
+}
+
+// A context sharing objects with the render context current on the calling
+// thread, for worker threads. Create it on that thread, then make it current
+// on the worker. It never draws, so it is made current on the window rather
+// than needing a pbuffer config.
+struct shared_context_t
+{
+    Display *display;
+    Window window;
+    GLXContext context;
+};
+
+shared_context_t *create_shared_context()
+{
+    render_context_t *parent = current_render_context;
+    assert(parent);
+    shared_context_t *shared = (shared_context_t *)calloc(1, sizeof(shared_context_t));
+    assert(shared);
+    shared->display = parent->platform->window.display;
+    shared->window = parent->platform->window.window;
+    shared->context = glx_create_context(shared->display, parent->platform->config, parent->platform->context);
+    assert(shared->context);
+    return shared;
+}
+
+// Binds shared to the calling thread, or releases the thread's context when
+// shared is NULL.
+bool make_shared_context_current(shared_context_t *shared)
+{
+    if (!shared)
+    {
+        Display *display = glXGetCurrentDisplay();
+        return !display || glXMakeCurrent(display, None, NULL) == True;
+    }
+    return glXMakeCurrent(shared->display, shared->window, shared->context) == True;
+}
+
+void destroy_shared_context(shared_context_t *shared)
+{
+    glXDestroyContext(shared->display, shared->context);
+    free(shared);
+}
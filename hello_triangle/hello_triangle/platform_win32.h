@@ -0,0 +1,269 @@
+#pragma once
+
+// Win32 window with a WGL context. Included by opengl.h.
+
+#include <stdlib.h>
+#include <Windows.h>
+#include <GL/gl.h>
+#include "glext.h"
+#include "wglext.h"
+#include "gl_dispatch.h"
+
+struct platform_context_t
+{
+    HWND window_handle;
+    HDC device_context;
+    HGLRC opengl_render_context;
+};
+
+// wglGetProcAddress only knows extension and post-1.1 entry points, and some
+// drivers return small sentinel values instead of NULL on failure.
+void *wgl_get_proc_address(const char *name)
+{
+    void *proc = (void *)wglGetProcAddress(name);
+    if (proc == 0 || proc == (void *)1 || proc == (void *)2 || proc == (void *)3 || proc == (void *)-1)
+    {
+        static HMODULE opengl_module = LoadLibraryA("opengl32.dll");
+        proc = (void *)GetProcAddress(opengl_module, name);
+    }
+    return proc;
+}
+
+// Binds context to the calling thread, or releases the thread's context when
+// context is NULL.
+bool make_render_context_current(render_context_t *context)
+{
+    BOOL current = context ? wglMakeCurrent(context->platform->device_context, context->platform->opengl_render_context) : wglMakeCurrent(NULL, NULL);
+    if (current)
+    {
+        set_current_render_context(context);
+    }
+    return current != FALSE;
+}
+
+void initialize_opengl(render_context_t *context)
+{
+    platform_context_t *platform = context->platform;
+    PIXELFORMATDESCRIPTOR pfd = {};
+
+    pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
+    pfd.nVersion = 1;
+    pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+    pfd.iPixelType = PFD_TYPE_RGBA;
+    pfd.cColorBits = 32;
+    pfd.cDepthBits = 24;
+
+    platform->device_context = GetDC(platform->window_handle);
+    int32_t format_index = ChoosePixelFormat(platform->device_context, &pfd);
+    assert(format_index);
+    BOOL format_set = SetPixelFormat(platform->device_context, format_index, &pfd);
+    assert(format_set);
+
+    platform->opengl_render_context = wglCreateContext(platform->device_context);
+    assert(platform->opengl_render_context);
+
+    bool current = make_render_context_current(context);
+    assert(current);
+
+#ifdef GL_VALIDATION
+    // Some drivers only report through KHR_debug on a debug context.
+    // wglCreateContextAttribsARB needs a current context to be found, so
+    // the plain one above is swapped for a debug one where the driver has it.
+    PFNWGLCREATECONTEXTATTRIBSARBPROC create_context_attribs = (PFNWGLCREATECONTEXTATTRIBSARBPROC)wgl_get_proc_address("wglCreateContextAttribsARB");
+    HGLRC debug_context = NULL;
+    if (create_context_attribs)
+    {
+        int attributes[] = { WGL_CONTEXT_FLAGS_ARB, WGL_CONTEXT_DEBUG_BIT_ARB, 0 };
+        debug_context = create_context_attribs(platform->device_context, NULL, attributes);
+    }
+    if (debug_context)
+    {
+        HGLRC plain_context = platform->opengl_render_context;
+        platform->opengl_render_context = debug_context;
+        current = make_render_context_current(context);
+        assert(current);
+        wglDeleteContext(plain_context);
+    }
+    else
+    {
+        fprintf(stderr, "platform_win32: no debug context, GL errors may go unreported\n");
+    }
+#endif
+
+    if (!gl_dispatch.get_proc_address)
+    {
+        bool loaded = gl_dispatch_load(wgl_get_proc_address);
+        assert(loaded);
+    }
+    gl_validation_initialize(false);
+}
+
+LRESULT CALLBACK window_callback(HWND window_handle, UINT message, WPARAM wparam, LPARAM lparam)
+{
+    render_context_t *context = (render_context_t *)GetWindowLongPtr(window_handle, GWLP_USERDATA);
+    switch (message)
+    {
+    case WM_CLOSE: {
+        // The window stays until destroy_render_context().
+        if (context)
+        {
+            context->running = 0;
+        }
+    } return 0;
+    }
+
+    return DefWindowProc(window_handle, message, wparam, lparam);
+}
+
+// Opens a window whose client area is width x height, with its own context
+// current on the calling thread. Its messages arrive on this thread, so call
+// catch_input_events() here too. The dispatch table is loaded with the first
+// context.
+render_context_t *create_render_context(uint32_t width, uint32_t height)
+{
+    HINSTANCE hinstance = GetModuleHandle(NULL);
+
+    render_context_t *context = (render_context_t *)calloc(1, sizeof(render_context_t));
+    assert(context);
+    context->platform = (platform_context_t *)calloc(1, sizeof(platform_context_t));
+    assert(context->platform);
+    platform_context_t *platform = context->platform;
+
+    const char *window_class_name = "triangle_demo_class";
+    const char *window_name = "Triangle!";
+
+    SetProcessDPIAware();
+
+    WNDCLASS window_class = {};
+    window_class.style = CS_OWNDC | CS_VREDRAW | CS_HREDRAW;
+    window_class.hInstance = hinstance;
+    window_class.lpszClassName = window_class_name;
+    window_class.lpfnWndProc = window_callback;
+
+    // Registered with the first window.
+    ATOM registered = RegisterClass(&window_class);
+    assert(registered || GetLastError() == ERROR_CLASS_ALREADY_EXISTS);
+
+    RECT window_rect = { 0, 0, (LONG)width, (LONG)height };
+    AdjustWindowRect(&window_rect, WS_OVERLAPPEDWINDOW, FALSE);
+
+    platform->window_handle = CreateWindowEx(0,
+        window_class_name,
+        window_name,
+        WS_OVERLAPPEDWINDOW,
+        CW_USEDEFAULT,
+        CW_USEDEFAULT,
+        window_rect.right - window_rect.left,
+        window_rect.bottom - window_rect.top,
+        NULL,
+        NULL,
+        hinstance,
+        NULL);
+    assert(platform->window_handle);
+    SetWindowLongPtr(platform->window_handle, GWLP_USERDATA, (LONG_PTR)context);
+
+    RECT rect = {};
+    GetClientRect(platform->window_handle, &rect);
+
+    context->viewport_width = rect.right;
+    context->viewport_height = rect.bottom;
+
+    initialize_opengl(context);
+
+    ShowWindow(platform->window_handle, SW_SHOW);
+
+    context->color_read_buffer = GL_BACK;
+    context->running = 1;
+
+    glViewport(0, 0, context->viewport_width, context->viewport_height);
+    return context;
+}
+
+void destroy_render_context(render_context_t *context)
+{
+    platform_context_t *platform = context->platform;
+    if (current_render_context == context)
+    {
+        make_render_context_current(NULL);
+    }
+    wglDeleteContext(platform->opengl_render_context);
+    ReleaseDC(platform->window_handle, platform->device_context);
+    DestroyWindow(platform->window_handle);
+    free(platform);
+    free(context);
+}
+
+// Dispatches the messages of every window created on the calling thread.
+void catch_input_events(render_context_t *context)
+{
+    (void)context;
+    MSG message;
+    while (PeekMessage(&message, NULL, 0, 0, PM_REMOVE))
+    {
+        TranslateMessage(&message);
+        DispatchMessage(&message);
+    }
+}
+
+void swap_buffers(render_context_t *context)
+{
+    SwapBuffers(context->platform->device_context);
+}
+
+// A context sharing objects with the render context current on the calling
+// thread, for worker threads. Create it on that thread, then make it current
+// on the worker. The context shares at creation through
+// wglCreateContextAttribsARB where the driver has it; otherwise wglShareLists
+// runs before the new context owns any objects.
+struct shared_context_t
+{
+    HDC device_context;
+    HGLRC context;
+};
+
+shared_context_t *create_shared_context()
+{
+    render_context_t *parent = current_render_context;
+    assert(parent);
+    shared_context_t *shared = (shared_context_t *)calloc(1, sizeof(shared_context_t));
+    assert(shared);
+    shared->device_context = parent->platform->device_context;
+    HGLRC opengl_render_context = parent->platform->opengl_render_context;
+
+    PFNWGLCREATECONTEXTATTRIBSARBPROC create_context_attribs = (PFNWGLCREATECONTEXTATTRIBSARBPROC)wglGetProcAddress("wglCreateContextAttribsARB");
+    if (create_context_attribs)
+    {
+        int attributes[] = {
+#ifdef GL_VALIDATION
+            WGL_CONTEXT_FLAGS_ARB, WGL_CONTEXT_DEBUG_BIT_ARB,
+#endif
+            0
+        };
+        shared->context = create_context_attribs(shared->device_context, opengl_render_context, attributes);
+    }
+    if (!shared->context)
+    {
+        shared->context = wglCreateContext(shared->device_context);
+        assert(shared->context);
+        BOOL shared_lists = wglShareLists(opengl_render_context, shared->context);
+        assert(shared_lists);
+    }
+    return shared;
+}
+
+// Binds shared to the calling thread, or releases the thread's context when
+// shared is NULL.
+bool make_shared_context_current(shared_context_t *shared)
+{
+    if (!shared)
+    {
+        return wglMakeCurrent(NULL, NULL) != FALSE;
+    }
+    return wglMakeCurrent(shared->device_context, shared->context) != FALSE;
+}
+
+void destroy_shared_context(shared_context_t *shared)
+{
+    wglDeleteContext(shared->context);
+    free(shared);
+}
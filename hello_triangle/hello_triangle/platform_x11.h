@@ -0,0 +1,94 @@
+#pragma once
+
+// X11 window shared by the GLX and EGL backends.
+
+#include <cassert>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+// Every window has its own display connection, so windows on different
+// threads do not contend for one.
+struct x11_window_t
+{
+    Display *display;
+    Window window;
+    Atom delete_window;
+};
+
+// Threads with a shared GL context talk to the same display, so Xlib has to
+// be made thread safe before the display is opened.
+void x11_open_display(x11_window_t *window)
+{
+    XInitThreads();
+    window->display = XOpenDisplay(NULL);
+    assert(window->display);
+}
+
+// The visual has to come from the GL config so the surface matches it.
+void x11_create_window(render_context_t *context, x11_window_t *window, XVisualInfo *visual)
+{
+    Window root = RootWindow(window->display, visual->screen);
+
+    XSetWindowAttributes attributes = {};
+    attributes.colormap = XCreateColormap(window->display, root, visual->visual, AllocNone);
+    attributes.event_mask = StructureNotifyMask;
+
+    window->window = XCreateWindow(window->display,
+        root,
+        0,
+        0,
+        context->viewport_width,
+        context->viewport_height,
+        0,
+        visual->depth,
+        InputOutput,
+        visual->visual,
+        CWColormap | CWEventMask,
+        &attributes);
+    assert(window->window);
+
+    XStoreName(window->display, window->window, "Triangle!");
+    window->delete_window = XInternAtom(window->display, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(window->display, window->window, &window->delete_window, 1);
+}
+
+void x11_show_window(x11_window_t *window)
+{
+    XMapWindow(window->display, window->window);
+    XFlush(window->display);
+}
+
+void x11_destroy_window(x11_window_t *window)
+{
+    XDestroyWindow(window->display, window->window);
+    XCloseDisplay(window->display);
+}
+
+void x11_catch_input_events(render_context_t *context, x11_window_t *window)
+{
+    while (XPending(window->display))
+    {
+        XEvent event;
+        XNextEvent(window->display, &event);
+        switch (event.type)
+        {
+        case ClientMessage: {
+            if ((Atom)event.xclient.data.l[0] == window->delete_window)
+            {
+                context->running = 0;
+            }
+        } break;
+
+        case ConfigureNotify: {
+            uint32_t width = (uint32_t)event.xconfigure.width;
+            uint32_t height = (uint32_t)event.xconfigure.height;
+            if (width != context->viewport_width || height != context->viewport_height)
+            {
+                context->viewport_width = width;
+                context->viewport_height = height;
+                context->resized = 1;
+            }
+        } break;
+        }
+    }
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include "opengl.h"
+
+// CPU and GPU time per render pass. Every pass is timed on the CPU and, when
+// the driver has timer queries, wrapped in a GL_TIME_ELAPSED query; the frame
+// as a whole is bracketed by two GL_TIMESTAMP queries. Queries live in a ring
+// PROFILER_FRAMES deep and are read back only once GL_QUERY_RESULT_AVAILABLE
+// says so, so GPU numbers arrive a few frames late but never stall.
+//
+//     profiler_begin_frame(profiler);
+//     profiler_begin_pass(profiler, "shadows");
+//     ...
+//     profiler_end_pass(profiler);
+//     profiler_end_frame(profiler);
+//
+// Passes are identified by their name, which is not copied, and cannot nest:
+// GL allows one GL_TIME_ELAPSED query at a time.
+
+#define PROFILER_FRAMES 4
+#define PROFILER_MAX_PASSES 32
+#define PROFILER_NO_PASS 0xffffffffu
+
+// Averages are exponential with this weight for the newest frame.
+#define PROFILER_SMOOTHING 0.1f
+
+struct profiler_pass_t
+{
+    const char *name;
+    real32_t cpu_ms;            // last frame
+    real32_t gpu_ms;            // latest frame the GPU results arrived for
+    real32_t cpu_average_ms;
+    real32_t gpu_average_ms;
+    uint32_t cpu_samples;
+    uint32_t gpu_samples;
+};
+
+struct profiler_stats_t
+{
+    real32_t cpu_frame_ms;
+    real32_t gpu_frame_ms;      // from the first to the last GPU command of the frame
+    uint32_t gpu_latency;       // frames between recording and reading the latest results
+    uint32_t frames_dropped;    // results still pending when their queries were reused
+};
+
+struct profiler_frame_t
+{
+    uint32_t queries[PROFILER_MAX_PASSES];
+    uint32_t passes[PROFILER_MAX_PASSES];   // what each query measures
+    uint32_t count;
+    uint32_t timestamps[2];
+    uint64_t number;
+    bool pending;
+};
+
+struct profiler_t
+{
+    bool gpu;
+
+    profiler_frame_t frames[PROFILER_FRAMES];
+    uint32_t frame;             // slot being recorded
+    uint64_t frame_number;
+
+    profiler_pass_t passes[PROFILER_MAX_PASSES];
+    uint32_t pass_count;
+    uint32_t open_pass;
+    uint64_t pass_begin;
+    uint64_t frame_begin;
+
+    profiler_stats_t stats;
+};
+
+inline uint64_t profiler_now()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The first sample starts the average rather than being blended with zero.
+inline real32_t profiler_average(real32_t average, real32_t value, uint32_t samples)
+{
+    return samples ? average + (value - average) * PROFILER_SMOOTHING : value;
+}
+
+profiler_t *profiler_create()
+{
+    profiler_t *profiler = (profiler_t *)calloc(1, sizeof(profiler_t));
+    assert(profiler);
+    profiler->open_pass = PROFILER_NO_PASS;
+    profiler->gpu = gl_dispatch_available(GL_DISPATCH_glQueryCounter) &&
+        gl_dispatch_available(GL_DISPATCH_glGetQueryObjectui64v) &&
+        gl_supports(3, 3, "GL_ARB_timer_query");
+
+    if (profiler->gpu)
+    {
+        for (uint32_t i = 0; i < PROFILER_FRAMES; ++i)
+        {
+            glGenQueries(PROFILER_MAX_PASSES, profiler->frames[i].queries);
+            glGenQueries(2, profiler->frames[i].timestamps);
+        }
+    }
+    return profiler;
+}
+
+void profiler_destroy(profiler_t *profiler)
+{
+    if (profiler->gpu)
+    {
+        for (uint32_t i = 0; i < PROFILER_FRAMES; ++i)
+        {
+            glDeleteQueries(PROFILER_MAX_PASSES, profiler->frames[i].queries);
+            glDeleteQueries(2, profiler->frames[i].timestamps);
+        }
+    }
+    free(profiler);
+}
+
+// The pass called name, added on first use.
+uint32_t profiler_find_pass(profiler_t *profiler, const char *name)
+{
+    for (uint32_t i = 0; i < profiler->pass_count; ++i)
+    {
+        if (profiler->passes[i].name == name || strcmp(profiler->passes[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    assert(profiler->pass_count < PROFILER_MAX_PASSES);
+    profiler_pass_t *pass = &profiler->passes[profiler->pass_count];
+    memset(pass, 0, sizeof(*pass));
+    pass->name = name;
+    return profiler->pass_count++;
+}
+
+// NULL when the pass has not run yet.
+const profiler_pass_t *profiler_pass(const profiler_t *profiler, const char *name)
+{
+    for (uint32_t i = 0; i < profiler->pass_count; ++i)
+    {
+        if (strcmp(profiler->passes[i].name, name) == 0)
+        {
+            return &profiler->passes[i];
+        }
+    }
+    return NULL;
+}
+
+bool profiler_frame_available(const profiler_frame_t *frame)
+{
+    GLint available = 0;
+    glGetQueryObjectiv(frame->timestamps[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    for (uint32_t i = 0; available && i < frame->count; ++i)
+    {
+        glGetQueryObjectiv(frame->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    return available != 0;
+}
+
+// Some drivers report nonsense for the first elapsed query of a context, so
+// a pass longer than its whole frame is ignored.
+void profiler_read_frame(profiler_t *profiler, profiler_frame_t *frame)
+{
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(frame->timestamps[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame->timestamps[1], GL_QUERY_RESULT, &end);
+    GLuint64 span = end > begin ? end - begin : 0;
+    profiler->stats.gpu_frame_ms = (real32_t)((double)span * 1e-6);
+
+    for (uint32_t i = 0; i < frame->count; ++i)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &elapsed);
+        if (elapsed > span)
+        {
+            continue;
+        }
+        profiler_pass_t *pass = &profiler->passes[frame->passes[i]];
+        pass->gpu_ms = (real32_t)((double)elapsed * 1e-6);
+        pass->gpu_average_ms = profiler_average(pass->gpu_average_ms, pass->gpu_ms, pass->gpu_samples++);
+    }
+    profiler->stats.gpu_latency = (uint32_t)(profiler->frame_number - frame->number);
+    frame->pending = false;
+}
+
+// Reads every finished frame, oldest first, and stops at the first that is
+// still in flight. The slot about to be recorded holds the oldest frame.
+void profiler_collect(profiler_t *profiler)
+{
+    for (uint32_t i = 0; i < PROFILER_FRAMES; ++i)
+    {
+        profiler_frame_t *frame = &profiler->frames[(profiler->frame + i) % PROFILER_FRAMES];
+        if (!frame->pending)
+        {
+            continue;
+        }
+        if (!profiler_frame_available(frame))
+        {
+            break;
+        }
+        profiler_read_frame(profiler, frame);
+    }
+}
+
+void profiler_begin_frame(profiler_t *profiler)
+{
+    assert(profiler->open_pass == PROFILER_NO_PASS);
+    profiler->frame_begin = profiler_now();
+    if (!profiler->gpu)
+    {
+        return;
+    }
+
+    profiler_collect(profiler);
+    profiler_frame_t *frame = &profiler->frames[profiler->frame];
+    if (frame->pending)
+    {
+        ++profiler->stats.frames_dropped;
+        frame->pending = false;
+    }
+    frame->count = 0;
+    frame->number = profiler->frame_number;
+    glQueryCounter(frame->timestamps[0], GL_TIMESTAMP);
+}
+
+void profiler_end_frame(profiler_t *profiler)
+{
+    assert(profiler->open_pass == PROFILER_NO_PASS);
+    profiler->stats.cpu_frame_ms = (real32_t)((double)(profiler_now() - profiler->frame_begin) * 1e-6);
+    if (profiler->gpu)
+    {
+        profiler_frame_t *frame = &profiler->frames[profiler->frame];
+        glQueryCounter(frame->timestamps[1], GL_TIMESTAMP);
+        frame->pending = true;
+        profiler->frame = (profiler->frame + 1) % PROFILER_FRAMES;
+    }
+    ++profiler->frame_number;
+}
+
+void profiler_begin_pass(profiler_t *profiler, const char *name)
+{
+    assert(profiler->open_pass == PROFILER_NO_PASS);
+    profiler->open_pass = profiler_find_pass(profiler, name);
+    profiler->pass_begin = profiler_now();
+    if (profiler->gpu)
+    {
+        profiler_frame_t *frame = &profiler->frames[profiler->frame];
+        assert(frame->count < PROFILER_MAX_PASSES);
+        frame->passes[frame->count] = profiler->open_pass;
+        glBeginQuery(GL_TIME_ELAPSED, frame->queries[frame->count]);
+    }
+}
+
+void profiler_end_pass(profiler_t *profiler)
+{
+    assert(profiler->open_pass != PROFILER_NO_PASS);
+    if (profiler->gpu)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        ++profiler->frames[profiler->frame].count;
+    }
+
+    profiler_pass_t *pass = &profiler->passes[profiler->open_pass];
+    pass->cpu_ms = (real32_t)((double)(profiler_now() - profiler->pass_begin) * 1e-6);
+    pass->cpu_average_ms = profiler_average(pass->cpu_average_ms, pass->cpu_ms, pass->cpu_samples++);
+    profiler->open_pass = PROFILER_NO_PASS;
+}
+
+// One line per pass with averaged times. The frame is CPU-bound when its CPU
+// time is the larger of the two.
+void profiler_print(const profiler_t *profiler, FILE *file)
+{
+    fprintf(file, "%-24s %9s %9s\n", "pass", "cpu ms", "gpu ms");
+    for (uint32_t i = 0; i < profiler->pass_count; ++i)
+    {
+        const profiler_pass_t *pass = &profiler->passes[i];
+        fprintf(file, "%-24s %9.3f %9.3f\n", pass->name, pass->cpu_average_ms, pass->gpu_average_ms);
+    }
+    fprintf(file, "%-24s %9.3f %9.3f\n", "frame", profiler->stats.cpu_frame_ms, profiler->stats.gpu_frame_ms);
+}
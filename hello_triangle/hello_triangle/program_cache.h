@@ -0,0 +1,547 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "opengl.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Linked programs kept on disk between runs. A program is looked up by a hash
+// of its stage sources, the defines inserted after their #version line and
+// the driver's vendor, renderer and version strings; a hit is loaded with
+// glProgramBinary instead of compiling. Binaries the driver rejects, say
+// after an update that kept the version string, are compiled again and
+// replace the stale entry.
+//
+// The file is memory mapped on open and only read; program_cache_save()
+// writes the old and new binaries to a temporary file that replaces the
+// original. Drivers without GL 4.1 or GL_ARB_get_program_binary, or with no
+// binary formats, always compile.
+//
+// File layout, little endian:
+//
+//     program_cache_header_t
+//     entry_count x (program_cache_record_t, binary padded to 8 bytes)
+//
+// Only the thread that owns the context may use the cache.
+
+#define PROGRAM_CACHE_MAGIC 0x43505448u     // "HTPC"
+#define PROGRAM_CACHE_VERSION 1
+
+struct program_cache_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t driver_hash;
+    uint32_t entry_count;
+    uint32_t padding;
+};
+
+struct program_cache_record_t
+{
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+};
+
+struct program_cache_entry_t
+{
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+    const uint8_t *binary;  // into the mapping, or owned when added this run
+    bool owned;
+};
+
+struct program_stage_t
+{
+    uint32_t type;          // GL_VERTEX_SHADER, ...
+    const char *source;
+};
+
+struct program_cache_stats_t
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t rejected;      // binaries the driver refused to load
+};
+
+struct program_cache_t
+{
+    char path[512];
+    bool supported;
+    bool dirty;
+    uint64_t driver_hash;
+
+    const uint8_t *mapped;
+    size_t mapped_size;
+
+    program_cache_entry_t *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+
+    program_cache_stats_t stats;
+};
+
+//
+// Hashing
+//
+
+inline uint64_t program_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Strings are hashed with their terminator so "ab" + "c" differs from "a" + "bc".
+inline uint64_t program_cache_hash_string(uint64_t hash, const char *string)
+{
+    return program_cache_hash(hash, string ? string : "", string ? strlen(string) + 1 : 1);
+}
+
+uint64_t program_cache_driver_hash()
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = program_cache_hash_string(hash, (const char *)glGetString(GL_VENDOR));
+    hash = program_cache_hash_string(hash, (const char *)glGetString(GL_RENDERER));
+    hash = program_cache_hash_string(hash, (const char *)glGetString(GL_VERSION));
+    hash = program_cache_hash_string(hash, (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+    return hash;
+}
+
+uint64_t program_cache_key(const program_cache_t *cache, const char *defines, const program_stage_t *stages, uint32_t stage_count)
+{
+    uint64_t hash = program_cache_hash_string(cache->driver_hash, defines);
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        hash = program_cache_hash(hash, &stages[i].type, sizeof(stages[i].type));
+        hash = program_cache_hash_string(hash, stages[i].source);
+    }
+    return hash;
+}
+
+//
+// File
+//
+
+void program_cache_unmap(program_cache_t *cache)
+{
+    if (!cache->mapped)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(cache->mapped);
+#else
+    munmap((void *)cache->mapped, cache->mapped_size);
+#endif
+    cache->mapped = NULL;
+    cache->mapped_size = 0;
+}
+
+bool program_cache_map(program_cache_t *cache)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(cache->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG)sizeof(program_cache_header_t))
+    {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return false;
+    }
+    // The view keeps the mapping alive after its handle is closed.
+    cache->mapped = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    cache->mapped_size = (size_t)size.QuadPart;
+    CloseHandle(mapping);
+#else
+    int file = open(cache->path, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    void *view = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size >= (off_t)sizeof(program_cache_header_t))
+    {
+        view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    close(file);
+    cache->mapped = view == MAP_FAILED ? NULL : (const uint8_t *)view;
+    cache->mapped_size = view == MAP_FAILED ? 0 : (size_t)status.st_size;
+#endif
+    return cache->mapped != NULL;
+}
+
+void program_cache_add(program_cache_t *cache, const program_cache_entry_t *entry)
+{
+    if (cache->entry_count == cache->entry_capacity)
+    {
+        cache->entry_capacity = cache->entry_capacity ? cache->entry_capacity * 2 : 64;
+        cache->entries = (program_cache_entry_t *)realloc(cache->entries, cache->entry_capacity * sizeof(program_cache_entry_t));
+        assert(cache->entries);
+    }
+    cache->entries[cache->entry_count++] = *entry;
+}
+
+// Linear, a few hundred variants are looked up once each at load time.
+program_cache_entry_t *program_cache_find(program_cache_t *cache, uint64_t key)
+{
+    for (uint32_t i = 0; i < cache->entry_count; ++i)
+    {
+        if (cache->entries[i].key == key)
+        {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+void program_cache_clear(program_cache_t *cache)
+{
+    for (uint32_t i = 0; i < cache->entry_count; ++i)
+    {
+        if (cache->entries[i].owned)
+        {
+            free((void *)cache->entries[i].binary);
+        }
+    }
+    cache->entry_count = 0;
+    program_cache_unmap(cache);
+}
+
+// Maps the file and indexes its entries. A file from another driver or in an
+// older layout is ignored and overwritten by the next save.
+void program_cache_load(program_cache_t *cache)
+{
+    if (!program_cache_map(cache))
+    {
+        return;
+    }
+
+    program_cache_header_t header;
+    memcpy(&header, cache->mapped, sizeof(header));
+    if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.driver_hash != cache->driver_hash)
+    {
+        program_cache_unmap(cache);
+        cache->dirty = true;
+        return;
+    }
+
+    // A truncated or corrupt file ends the index early. Sizes are compared
+    // against what is left, which cannot wrap since offset stays below
+    // mapped_size, and the padding is added last, in size_t.
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.entry_count && offset < cache->mapped_size; ++i)
+    {
+        program_cache_record_t record;
+        if (sizeof(record) > cache->mapped_size - offset)
+        {
+            break;
+        }
+        memcpy(&record, cache->mapped + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.size > cache->mapped_size - offset)
+        {
+            break;
+        }
+
+        program_cache_entry_t entry;
+        entry.key = record.key;
+        entry.format = record.format;
+        entry.size = record.size;
+        entry.binary = cache->mapped + offset;
+        entry.owned = false;
+        program_cache_add(cache, &entry);
+        offset += ((size_t)record.size + 7) & ~(size_t)7;
+    }
+}
+
+FILE *program_cache_open_file(const char *path)
+{
+    FILE *file = 0;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "wb") != 0)
+    {
+        file = 0;
+    }
+#else
+    file = fopen(path, "wb");
+#endif
+    return file;
+}
+
+//
+// Cache
+//
+
+program_cache_t *program_cache_create(const char *path)
+{
+    program_cache_t *cache = (program_cache_t *)calloc(1, sizeof(program_cache_t));
+    assert(cache);
+    snprintf(cache->path, sizeof(cache->path), "%s", path);
+
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    cache->supported = gl_dispatch_available(GL_DISPATCH_glGetProgramBinary) &&
+        gl_dispatch_available(GL_DISPATCH_glProgramBinary) &&
+        gl_dispatch_available(GL_DISPATCH_glProgramParameteri) &&
+        gl_supports(4, 1, "GL_ARB_get_program_binary") &&
+        format_count > 0;
+
+    cache->driver_hash = program_cache_driver_hash();
+    if (cache->supported)
+    {
+        program_cache_load(cache);
+    }
+    return cache;
+}
+
+void program_cache_destroy(program_cache_t *cache)
+{
+    program_cache_clear(cache);
+    free(cache->entries);
+    free(cache);
+}
+
+// Writes every entry if anything changed since the cache was loaded. The
+// file is replaced in one rename, so a crash mid-write leaves the old one.
+bool program_cache_save(program_cache_t *cache)
+{
+    if (!cache->supported || !cache->dirty)
+    {
+        return true;
+    }
+
+    char temporary_path[sizeof(cache->path) + 8];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", cache->path);
+    FILE *file = program_cache_open_file(temporary_path);
+    if (!file)
+    {
+        return false;
+    }
+
+    program_cache_header_t header = {};
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.driver_hash = cache->driver_hash;
+    header.entry_count = cache->entry_count;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    static const uint8_t padding[8] = {};
+    for (uint32_t i = 0; i < cache->entry_count && written; ++i)
+    {
+        const program_cache_entry_t *entry = &cache->entries[i];
+        program_cache_record_t record = { entry->key, entry->format, entry->size };
+        uint32_t padding_size = ((entry->size + 7) & ~7u) - entry->size;
+        written = fwrite(&record, sizeof(record), 1, file) == 1 &&
+            fwrite(entry->binary, 1, entry->size, file) == entry->size &&
+            fwrite(padding, 1, padding_size, file) == padding_size;
+    }
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        remove(temporary_path);
+        return false;
+    }
+
+    // The entries point into the mapping, which has to go before Windows
+    // lets the file be replaced; reload from the new file afterwards.
+    program_cache_clear(cache);
+#ifdef _WIN32
+    bool replaced = MoveFileExA(temporary_path, cache->path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool replaced = rename(temporary_path, cache->path) == 0;
+#endif
+    program_cache_load(cache);
+    cache->dirty = !replaced;
+    return replaced;
+}
+
+//
+// Programs
+//
+
+// Sets source with defines inserted after its #version line, which GLSL
+// requires to come first.
+void program_cache_shader_source(uint32_t shader, const char *source, const char *defines)
+{
+    const char *version = strstr(source, "#version");
+    const char *body = source;
+    if (version)
+    {
+        const char *line_end = strchr(version, '\n');
+        body = line_end ? line_end + 1 : version + strlen(version);
+    }
+
+    const char *sources[] = { source, defines ? defines : "", body };
+    GLint lengths[] = { (GLint)(body - source), -1, -1 };
+    glShaderSource(shader, 3, sources, lengths);
+}
+
+uint32_t program_cache_compile_shader(uint32_t type, const char *source, const char *defines)
+{
+    GLuint shader = glCreateShader(type);
+    program_cache_shader_source(shader, source, defines);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status)
+    {
+        char log[2048];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "program_cache: %s\n", log);
+    }
+    assert(status);
+    return shader;
+}
+
+uint32_t program_cache_compile(program_cache_t *cache, const char *defines, const program_stage_t *stages, uint32_t stage_count)
+{
+    GLuint program = glCreateProgram();
+    GLuint shaders[8];
+    assert(stage_count <= sizeof(shaders) / sizeof(shaders[0]));
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        shaders[i] = program_cache_compile_shader(stages[i].type, stages[i].source, defines);
+        glAttachShader(program, shaders[i]);
+    }
+    if (cache->supported)
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        glDetachShader(program, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
+
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        char log[2048];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "program_cache: %s\n", log);
+    }
+    assert(status);
+    return program;
+}
+
+// Stores the binary of a freshly linked program under key, replacing an
+// entry the driver rejected.
+void program_cache_store(program_cache_t *cache, uint64_t key, uint32_t program)
+{
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+    {
+        return;
+    }
+
+    uint8_t *binary = (uint8_t *)malloc((size_t)size);
+    assert(binary);
+    GLenum format = 0;
+    GLsizei length = 0;
+    glGetProgramBinary(program, size, &length, &format, binary);
+    if (length <= 0)
+    {
+        free(binary);
+        return;
+    }
+
+    program_cache_entry_t *entry = program_cache_find(cache, key);
+    if (entry)
+    {
+        if (entry->owned)
+        {
+            free((void *)entry->binary);
+        }
+    }
+    else
+    {
+        program_cache_entry_t added = {};
+        added.key = key;
+        program_cache_add(cache, &added);
+        entry = &cache->entries[cache->entry_count - 1];
+    }
+    entry->format = format;
+    entry->size = (uint32_t)length;
+    entry->binary = binary;
+    entry->owned = true;
+    cache->dirty = true;
+}
+
+// Creates the program stored under key, or returns 0 when there is none or
+// the driver rejects it.
+uint32_t program_cache_load_program(program_cache_t *cache, uint64_t key)
+{
+    const program_cache_entry_t *entry = program_cache_find(cache, key);
+    if (!entry)
+    {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, entry->format, entry->binary, (GLsizei)entry->size);
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        glDeleteProgram(program);
+        ++cache->stats.rejected;
+        return 0;
+    }
+    ++cache->stats.hits;
+    return program;
+}
+
+// Returns a linked program for the stages, from the cache when it has a
+// binary the driver accepts.
+uint32_t program_cache_get(program_cache_t *cache, const char *defines, const program_stage_t *stages, uint32_t stage_count)
+{
+    if (!cache->supported)
+    {
+        return program_cache_compile(cache, defines, stages, stage_count);
+    }
+
+    uint64_t key = program_cache_key(cache, defines, stages, stage_count);
+    uint32_t program = program_cache_load_program(cache, key);
+    if (program)
+    {
+        return program;
+    }
+
+    ++cache->stats.misses;
+    program = program_cache_compile(cache, defines, stages, stage_count);
+    program_cache_store(cache, key, program);
+    return program;
+}
+
+inline uint32_t program_cache_get_vertex_fragment(program_cache_t *cache, const char *defines, const char *vertex_source, const char *fragment_source)
+{
+    program_stage_t stages[] = { { GL_VERTEX_SHADER, vertex_source }, { GL_FRAGMENT_SHADER, fragment_source } };
+    return program_cache_get(cache, defines, stages, 2);
+}
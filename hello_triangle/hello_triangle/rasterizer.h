@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "simd.h"
+
+// Triangle setup, tile binning and the 8-wide edge test shared by the CPU
+// render paths. Screen space has its origin at the top-left corner of the
+// target and pixel (x, y) covers [x, x + 1) x [y, y + 1).
+
+#define RASTER_TILE_SIZE 32
+
+struct raster_vertex_t
+{
+    real32_t x, y;  // pixels
+    real32_t z;     // [0, 1], smaller is closer
+};
+
+struct raster_triangle_t
+{
+    // Edge functions a * x + b * y + c and the depth plane, all relative to
+    // origin so they keep their precision on large targets. Inside is
+    // positive, edges that test true at exactly zero are the top-left ones.
+    real32_t edge_a[3];
+    real32_t edge_b[3];
+    real32_t edge_c[3];
+    bool edge_inclusive[3];
+    real32_t z_a, z_b, z_c;
+    real32_t origin_x, origin_y;
+
+    // Inclusive pixel bounds, already clipped to the target.
+    int32_t min_x, min_y;
+    int32_t max_x, max_y;
+    real32_t min_z, max_z;
+
+    uint32_t color;
+};
+
+// Returns false when the triangle has no area or misses the target. Both
+// windings are accepted.
+bool raster_setup_triangle(raster_triangle_t *triangle, raster_vertex_t v0, raster_vertex_t v1, raster_vertex_t v2, uint32_t color, uint32_t width, uint32_t height)
+{
+    double area = ((double)v1.x - v0.x) * ((double)v2.y - v0.y) - ((double)v2.x - v0.x) * ((double)v1.y - v0.y);
+    if (area == 0.0)
+    {
+        return false;
+    }
+    if (area < 0.0)
+    {
+        raster_vertex_t swap = v1;
+        v1 = v2;
+        v2 = swap;
+        area = -area;
+    }
+
+    real32_t min_x = v0.x < v1.x ? (v0.x < v2.x ? v0.x : v2.x) : (v1.x < v2.x ? v1.x : v2.x);
+    real32_t max_x = v0.x > v1.x ? (v0.x > v2.x ? v0.x : v2.x) : (v1.x > v2.x ? v1.x : v2.x);
+    real32_t min_y = v0.y < v1.y ? (v0.y < v2.y ? v0.y : v2.y) : (v1.y < v2.y ? v1.y : v2.y);
+    real32_t max_y = v0.y > v1.y ? (v0.y > v2.y ? v0.y : v2.y) : (v1.y > v2.y ? v1.y : v2.y);
+
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= (real32_t)width || min_y >= (real32_t)height)
+    {
+        return false;
+    }
+
+    triangle->min_x = min_x > 0.0f ? (int32_t)min_x : 0;
+    triangle->min_y = min_y > 0.0f ? (int32_t)min_y : 0;
+    triangle->max_x = max_x < (real32_t)(width - 1) ? (int32_t)max_x : (int32_t)width - 1;
+    triangle->max_y = max_y < (real32_t)(height - 1) ? (int32_t)max_y : (int32_t)height - 1;
+    triangle->origin_x = (real32_t)triangle->min_x;
+    triangle->origin_y = (real32_t)triangle->min_y;
+
+    const raster_vertex_t *v[3] = { &v0, &v1, &v2 };
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const raster_vertex_t *from = v[i];
+        const raster_vertex_t *to = v[(i + 1) % 3];
+        double a = -((double)to->y - from->y);
+        double b = (double)to->x - from->x;
+        double c = -(a * ((double)from->x - triangle->origin_x) + b * ((double)from->y - triangle->origin_y));
+        triangle->edge_a[i] = (real32_t)a;
+        triangle->edge_b[i] = (real32_t)b;
+        triangle->edge_c[i] = (real32_t)c;
+
+        // A shared edge is seen with opposite signs by its two triangles, so
+        // exactly one of them owns samples that land on it.
+        triangle->edge_inclusive[i] = a > 0.0 || (a == 0.0 && b > 0.0);
+    }
+
+    double dz1 = (double)v1.z - v0.z;
+    double dz2 = (double)v2.z - v0.z;
+    double z_a = (dz1 * ((double)v2.y - v0.y) - dz2 * ((double)v1.y - v0.y)) / area;
+    double z_b = (dz2 * ((double)v1.x - v0.x) - dz1 * ((double)v2.x - v0.x)) / area;
+    triangle->z_a = (real32_t)z_a;
+    triangle->z_b = (real32_t)z_b;
+    triangle->z_c = (real32_t)(v0.z - z_a * ((double)v0.x - triangle->origin_x) - z_b * ((double)v0.y - triangle->origin_y));
+    triangle->min_z = v0.z < v1.z ? (v0.z < v2.z ? v0.z : v2.z) : (v1.z < v2.z ? v1.z : v2.z);
+    triangle->max_z = v0.z > v1.z ? (v0.z > v2.z ? v0.z : v2.z) : (v1.z > v2.z ? v1.z : v2.z);
+
+    triangle->color = color;
+    return true;
+}
+
+// Coverage of eight sample points, x and y relative to the triangle origin.
+inline i32x8_t raster_coverage(const raster_triangle_t *triangle, f32x8_t x, f32x8_t y)
+{
+    i32x8_t inside = i32x8(-1);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        f32x8_t e = f32x8(triangle->edge_a[i]) * x + f32x8(triangle->edge_b[i]) * y + f32x8(triangle->edge_c[i]);
+        inside = inside & (triangle->edge_inclusive[i] ? cmp_ge(e, f32x8(0.0f)) : cmp_gt(e, f32x8(0.0f)));
+    }
+    return inside;
+}
+
+inline f32x8_t raster_depth(const raster_triangle_t *triangle, f32x8_t x, f32x8_t y)
+{
+    return f32x8(triangle->z_a) * x + f32x8(triangle->z_b) * y + f32x8(triangle->z_c);
+}
+
+// Triangle indices per tile, in submission order so per-tile rendering keeps
+// the draw order. Tile t owns indices[offsets[t] .. offsets[t + 1]).
+struct raster_bins_t
+{
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint32_t *offsets;
+    uint32_t *indices;
+    uint32_t index_capacity;
+    uint32_t tile_capacity;
+};
+
+void raster_bin_triangles(raster_bins_t *bins, const raster_triangle_t *triangles, uint32_t triangle_count, uint32_t width, uint32_t height)
+{
+    bins->tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    bins->tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    uint32_t tile_count = bins->tiles_x * bins->tiles_y;
+
+    if (tile_count + 1 > bins->tile_capacity)
+    {
+        free(bins->offsets);
+        bins->tile_capacity = tile_count + 1;
+        bins->offsets = (uint32_t *)malloc(bins->tile_capacity * sizeof(uint32_t));
+        assert(bins->offsets);
+    }
+
+    // Count, prefix sum, then fill: two passes over the triangles and no
+    // per-tile allocations.
+    memset(bins->offsets, 0, (tile_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < triangle_count; ++i)
+    {
+        const raster_triangle_t *triangle = &triangles[i];
+        for (int32_t ty = triangle->min_y / RASTER_TILE_SIZE; ty <= triangle->max_y / RASTER_TILE_SIZE; ++ty)
+        {
+            for (int32_t tx = triangle->min_x / RASTER_TILE_SIZE; tx <= triangle->max_x / RASTER_TILE_SIZE; ++tx)
+            {
+                ++bins->offsets[ty * bins->tiles_x + tx + 1];
+            }
+        }
+    }
+    for (uint32_t t = 0; t < tile_count; ++t)
+    {
+        bins->offsets[t + 1] += bins->offsets[t];
+    }
+
+    uint32_t total = bins->offsets[tile_count];
+    if (total > bins->index_capacity)
+    {
+        free(bins->indices);
+        bins->index_capacity = total + total / 2;
+        bins->indices = (uint32_t *)malloc(bins->index_capacity * sizeof(uint32_t));
+        assert(bins->indices);
+    }
+
+    for (uint32_t i = 0; i < triangle_count; ++i)
+    {
+        const raster_triangle_t *triangle = &triangles[i];
+        for (int32_t ty = triangle->min_y / RASTER_TILE_SIZE; ty <= triangle->max_y / RASTER_TILE_SIZE; ++ty)
+        {
+            for (int32_t tx = triangle->min_x / RASTER_TILE_SIZE; tx <= triangle->max_x / RASTER_TILE_SIZE; ++tx)
+            {
+                bins->indices[bins->offsets[ty * bins->tiles_x + tx]++] = i;
+            }
+        }
+    }
+
+    // The fill pass advanced every offset to the start of the next tile.
+    for (uint32_t t = tile_count; t > 0; --t)
+    {
+        bins->offsets[t] = bins->offsets[t - 1];
+    }
+    bins->offsets[0] = 0;
+}
+
+void raster_free_bins(raster_bins_t *bins)
+{
+    free(bins->offsets);
+    free(bins->indices);
+    *bins = {};
+}
@@ -0,0 +1,499 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "opengl.h"
+#include "gl_state.h"
+#include "program_cache.h"
+
+// Programs compiled in the background. Submit every program at load time,
+// call shader_compiler_poll() once a frame and draw with
+// shader_compiler_program(), which returns the request's fallback program
+// (0 to skip the draw) until the real one has linked. Nothing on the render
+// thread waits for the compiler.
+//
+// With GL_KHR_parallel_shader_compile (or the ARB version) the driver
+// compiles on its own threads and polling asks GL_COMPLETION_STATUS_KHR, which
+// never blocks. Other drivers get a worker thread with a shared context that
+// compiles and links, and fences the result for the render thread. Define
+// SHADER_COMPILER_FORCE_THREAD to test the worker on drivers that have the
+// extension.
+//
+// Binaries found in the program cache are loaded at submit time; programs
+// compiled here are added to it once they have linked.
+//
+// A handle stays valid until shader_compiler_take() hands its program over or
+// shader_compiler_release() gives it up, failed requests included; then it is
+// reused by a later submit.
+
+#define SHADER_COMPILER_MAX_STAGES 4
+
+enum program_status_t
+{
+    PROGRAM_PENDING,
+    PROGRAM_READY,
+    PROGRAM_FAILED,
+};
+
+struct program_request_t
+{
+    uint64_t key;
+    char *defines;
+    program_stage_t stages[SHADER_COMPILER_MAX_STAGES];
+    uint32_t stage_count;
+    uint32_t fallback;
+
+    uint32_t program;
+    uint32_t shaders[SHADER_COMPILER_MAX_STAGES];
+    program_status_t status;
+
+    // Worker path: set by the worker after the link, with fence marking the
+    // end of its commands.
+    std::atomic<bool> compiled;
+    GLsync fence;
+
+    bool released;              // unwanted, deleted once its compile finishes
+    program_request_t *next;    // in the worker's queue
+};
+
+struct shader_compiler_stats_t
+{
+    uint32_t submitted;
+    uint32_t cached;        // loaded from the program cache at submit
+    uint32_t compiled;
+    uint32_t failed;
+};
+
+struct shader_compiler_t
+{
+    program_cache_t *cache;
+    bool parallel;
+
+    // Render thread only. requests is indexed by handle and NULL for the
+    // handles on the free list; pending holds the handles poll still checks.
+    program_request_t **requests;
+    uint32_t request_count;
+    uint32_t request_capacity;
+    uint32_t *free_handles;
+    uint32_t free_count;
+    uint32_t *pending;
+    uint32_t pending_count;
+
+    // Worker path only. The queue holds submitted requests the worker has not
+    // started, under mutex.
+    shared_context_t *context;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    program_request_t *queue_head;
+    program_request_t *queue_tail;
+    bool stop;
+
+    shader_compiler_stats_t stats;
+};
+
+inline char *shader_compiler_copy_string(const char *string)
+{
+    size_t size = strlen(string) + 1;
+    char *copy = (char *)malloc(size);
+    assert(copy);
+    memcpy(copy, string, size);
+    return copy;
+}
+
+// Logs the first stage that failed, or the link error.
+void shader_compiler_report(const program_request_t *request, uint32_t program, const uint32_t *shaders)
+{
+    char log[2048];
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        GLint status = 0;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+        if (!status)
+        {
+            glGetShaderInfoLog(shaders[i], sizeof(log), NULL, log);
+            fprintf(stderr, "shader_compiler: %s\n", log);
+            return;
+        }
+    }
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    fprintf(stderr, "shader_compiler: %s\n", log);
+}
+
+// Starts compiling and linking. Without parallel compile this blocks, so only
+// the worker calls it then.
+void shader_compiler_start(shader_compiler_t *compiler, program_request_t *request)
+{
+    request->program = glCreateProgram();
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        request->shaders[i] = glCreateShader(request->stages[i].type);
+        program_cache_shader_source(request->shaders[i], request->stages[i].source, request->defines);
+        glCompileShader(request->shaders[i]);
+        glAttachShader(request->program, request->shaders[i]);
+    }
+    if (compiler->cache && compiler->cache->supported)
+    {
+        glProgramParameteri(request->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(request->program);
+}
+
+// Checks the link, drops the shaders and hands the binary to the cache. On the
+// worker path the fence has signalled, so the link is visible here.
+void shader_compiler_finish(shader_compiler_t *compiler, program_request_t *request)
+{
+    GLint status = 0;
+    glGetProgramiv(request->program, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        shader_compiler_report(request, request->program, request->shaders);
+    }
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        glDetachShader(request->program, request->shaders[i]);
+        glDeleteShader(request->shaders[i]);
+    }
+
+    if (status)
+    {
+        request->status = PROGRAM_READY;
+        ++compiler->stats.compiled;
+        if (compiler->cache && compiler->cache->supported)
+        {
+            program_cache_store(compiler->cache, request->key, request->program);
+        }
+    }
+    else
+    {
+        glDeleteProgram(request->program);
+        request->program = 0;
+        request->status = PROGRAM_FAILED;
+        ++compiler->stats.failed;
+    }
+}
+
+void shader_compiler_free_inputs(program_request_t *request)
+{
+    free(request->defines);
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        free((void *)request->stages[i].source);
+        request->stages[i].source = NULL;
+    }
+    request->defines = NULL;
+}
+
+void shader_compiler_worker(shader_compiler_t *compiler)
+{
+    bool current = make_shared_context_current(compiler->context);
+    assert(current);
+
+    for (;;)
+    {
+        program_request_t *request = NULL;
+        {
+            std::unique_lock<std::mutex> lock(compiler->mutex);
+            compiler->wake.wait(lock, [compiler] { return compiler->stop || compiler->queue_head; });
+            if (compiler->stop)
+            {
+                break;
+            }
+            request = compiler->queue_head;
+            compiler->queue_head = request->next;
+            if (!compiler->queue_head)
+            {
+                compiler->queue_tail = NULL;
+            }
+        }
+
+        shader_compiler_start(compiler, request);
+        request->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        request->compiled.store(true, std::memory_order_release);
+    }
+
+    make_shared_context_current(NULL);
+}
+
+shader_compiler_t *shader_compiler_create(program_cache_t *cache)
+{
+    shader_compiler_t *compiler = new shader_compiler_t();
+    compiler->cache = cache;
+
+#ifdef SHADER_COMPILER_FORCE_THREAD
+    compiler->parallel = false;
+#else
+    compiler->parallel = gl_has_extension("GL_KHR_parallel_shader_compile") || gl_has_extension("GL_ARB_parallel_shader_compile");
+#endif
+    if (compiler->parallel)
+    {
+        // Let the driver use as many threads as it likes; the default may be fewer.
+        if (gl_has_extension("GL_KHR_parallel_shader_compile") && gl_dispatch_available(GL_DISPATCH_glMaxShaderCompilerThreadsKHR))
+        {
+            glMaxShaderCompilerThreadsKHR(0xffffffff);
+        }
+        else if (gl_dispatch_available(GL_DISPATCH_glMaxShaderCompilerThreadsARB))
+        {
+            glMaxShaderCompilerThreadsARB(0xffffffff);
+        }
+    }
+    else
+    {
+        compiler->context = create_shared_context();
+        compiler->worker = std::thread(shader_compiler_worker, compiler);
+    }
+    return compiler;
+}
+
+// Deletes every program the compiler made, finished or not.
+void shader_compiler_destroy(shader_compiler_t *compiler)
+{
+    if (!compiler->parallel)
+    {
+        {
+            std::lock_guard<std::mutex> lock(compiler->mutex);
+            compiler->stop = true;
+        }
+        compiler->wake.notify_one();
+        compiler->worker.join();
+        destroy_shared_context(compiler->context);
+    }
+
+    for (uint32_t i = 0; i < compiler->request_count; ++i)
+    {
+        program_request_t *request = compiler->requests[i];
+        if (!request)
+        {
+            continue;
+        }
+        if (request->fence)
+        {
+            glDeleteSync(request->fence);
+        }
+        if (request->status == PROGRAM_PENDING)
+        {
+            for (uint32_t stage = 0; stage < request->stage_count; ++stage)
+            {
+                glDeleteShader(request->shaders[stage]);
+            }
+        }
+        if (request->program)
+        {
+            gl_state_delete_program(request->program);
+        }
+        shader_compiler_free_inputs(request);
+        delete request;
+    }
+    free(compiler->requests);
+    free(compiler->free_handles);
+    free(compiler->pending);
+    delete compiler;
+}
+
+// Queues a program and returns its handle. The strings are copied.
+uint32_t shader_compiler_submit(shader_compiler_t *compiler, const char *defines, const program_stage_t *stages, uint32_t stage_count, uint32_t fallback)
+{
+    assert(stage_count <= SHADER_COMPILER_MAX_STAGES);
+
+    program_request_t *request = new program_request_t();
+    request->defines = shader_compiler_copy_string(defines ? defines : "");
+    request->stage_count = stage_count;
+    request->fallback = fallback;
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        request->stages[i].type = stages[i].type;
+        request->stages[i].source = shader_compiler_copy_string(stages[i].source);
+    }
+    request->status = PROGRAM_PENDING;
+    ++compiler->stats.submitted;
+
+    if (compiler->cache && compiler->cache->supported)
+    {
+        request->key = program_cache_key(compiler->cache, defines, stages, stage_count);
+        request->program = program_cache_load_program(compiler->cache, request->key);
+        if (request->program)
+        {
+            request->status = PROGRAM_READY;
+            ++compiler->stats.cached;
+            shader_compiler_free_inputs(request);
+        }
+        else
+        {
+            ++compiler->cache->stats.misses;
+        }
+    }
+
+    // The free and pending lists never hold more handles than there are, so
+    // they grow with the request array.
+    uint32_t handle;
+    if (compiler->free_count)
+    {
+        handle = compiler->free_handles[--compiler->free_count];
+    }
+    else
+    {
+        if (compiler->request_count == compiler->request_capacity)
+        {
+            compiler->request_capacity = compiler->request_capacity ? compiler->request_capacity * 2 : 64;
+            compiler->requests = (program_request_t **)realloc(compiler->requests, compiler->request_capacity * sizeof(program_request_t *));
+            compiler->free_handles = (uint32_t *)realloc(compiler->free_handles, compiler->request_capacity * sizeof(uint32_t));
+            compiler->pending = (uint32_t *)realloc(compiler->pending, compiler->request_capacity * sizeof(uint32_t));
+            assert(compiler->requests && compiler->free_handles && compiler->pending);
+        }
+        handle = compiler->request_count++;
+    }
+    compiler->requests[handle] = request;
+
+    if (request->status != PROGRAM_PENDING)
+    {
+        return handle;
+    }
+    compiler->pending[compiler->pending_count++] = handle;
+    if (compiler->parallel)
+    {
+        shader_compiler_start(compiler, request);
+        return handle;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(compiler->mutex);
+        if (compiler->queue_tail)
+        {
+            compiler->queue_tail->next = request;
+        }
+        else
+        {
+            compiler->queue_head = request;
+        }
+        compiler->queue_tail = request;
+    }
+    compiler->wake.notify_one();
+    return handle;
+}
+
+// Frees the request, which is no longer pending, and puts its handle up for
+// reuse.
+void shader_compiler_recycle(shader_compiler_t *compiler, uint32_t handle)
+{
+    delete compiler->requests[handle];
+    compiler->requests[handle] = NULL;
+    compiler->free_handles[compiler->free_count++] = handle;
+}
+
+inline uint32_t shader_compiler_submit_vertex_fragment(shader_compiler_t *compiler, const char *defines, const char *vertex_source, const char *fragment_source, uint32_t fallback)
+{
+    program_stage_t stages[] = { { GL_VERTEX_SHADER, vertex_source }, { GL_FRAGMENT_SHADER, fragment_source } };
+    return shader_compiler_submit(compiler, defines, stages, 2, fallback);
+}
+
+// Picks up finished programs without waiting for the rest; once a frame. Only
+// the requests still pending are looked at.
+void shader_compiler_poll(shader_compiler_t *compiler)
+{
+    for (uint32_t i = 0; i < compiler->pending_count;)
+    {
+        uint32_t handle = compiler->pending[i];
+        program_request_t *request = compiler->requests[handle];
+        if (compiler->parallel)
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(request->program, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+            {
+                ++i;
+                continue;
+            }
+        }
+        else
+        {
+            if (!request->compiled.load(std::memory_order_acquire))
+            {
+                ++i;
+                continue;
+            }
+            GLenum result = glClientWaitSync(request->fence, 0, 0);
+            if (result == GL_TIMEOUT_EXPIRED)
+            {
+                ++i;
+                continue;
+            }
+            assert(result != GL_WAIT_FAILED);
+            glDeleteSync(request->fence);
+            request->fence = NULL;
+        }
+        compiler->pending[i] = compiler->pending[--compiler->pending_count];
+
+        shader_compiler_finish(compiler, request);
+        shader_compiler_free_inputs(request);
+        if (request->released)
+        {
+            if (request->program)
+            {
+                gl_state_delete_program(request->program);
+            }
+            shader_compiler_recycle(compiler, handle);
+        }
+    }
+}
+
+inline const program_request_t *shader_compiler_request(const shader_compiler_t *compiler, uint32_t handle)
+{
+    assert(handle < compiler->request_count);
+    const program_request_t *request = compiler->requests[handle];
+    assert(request && !request->released);
+    return request;
+}
+
+inline program_status_t shader_compiler_status(const shader_compiler_t *compiler, uint32_t handle)
+{
+    return shader_compiler_request(compiler, handle)->status;
+}
+
+// The linked program once ready, the fallback before that or if it failed.
+inline uint32_t shader_compiler_program(const shader_compiler_t *compiler, uint32_t handle)
+{
+    const program_request_t *request = shader_compiler_request(compiler, handle);
+    return request->status == PROGRAM_READY ? request->program : request->fallback;
+}
+
+// Hands a ready program over to the caller, who deletes it from then on, and
+// frees the handle.
+uint32_t shader_compiler_take(shader_compiler_t *compiler, uint32_t handle)
+{
+    assert(shader_compiler_status(compiler, handle) == PROGRAM_READY);
+    uint32_t program = compiler->requests[handle]->program;
+    shader_compiler_recycle(compiler, handle);
+    return program;
+}
+
+// Gives up on a request and frees the handle: a ready program is deleted, a
+// failed request forgotten, and a pending one deleted by the poll that sees
+// it finish.
+void shader_compiler_release(shader_compiler_t *compiler, uint32_t handle)
+{
+    assert(shader_compiler_request(compiler, handle));
+    program_request_t *request = compiler->requests[handle];
+    if (request->status == PROGRAM_PENDING)
+    {
+        request->released = true;
+        return;
+    }
+    if (request->program)
+    {
+        gl_state_delete_program(request->program);
+    }
+    shader_compiler_recycle(compiler, handle);
+}
+
+inline uint32_t shader_compiler_pending(const shader_compiler_t *compiler)
+{
+    return compiler->pending_count;
+}
@@ -0,0 +1,715 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+#include "opengl.h"
+#include "gl_state.h"
+#include "shader_compiler.h"
+#include "shader_preprocessor.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Programs built from shader files in one directory, rebuilt while the demo
+// runs when a file they use changes. A watcher thread listens for writes to
+// the directory (inotify, ReadDirectoryChangesW on Windows) and flags the
+// files; shader_library_update() rereads flagged files between frames and
+// submits the programs that depend on them to the shader compiler.
+//
+// Draws always use shader_library_program(), which keeps returning the old
+// program until the new one has linked and is swapped in by a later update.
+// A program that fails to compile keeps the old one and logs the error, so
+// fixing the file is enough to recover.
+//
+// Sources go through the shader preprocessor, so a program also depends on
+// the files it includes. Variant sets describe the permutations of a program
+// over a list of features; a variant is only built when first asked for, and
+// variants whose preprocessed text is identical share one program.
+
+#define SHADER_LIBRARY_MAX_FILES 128
+#define SHADER_LIBRARY_MAX_DEPENDENCIES 16
+#define SHADER_LIBRARY_NO_REQUEST 0xffffffff
+#define SHADER_LIBRARY_NONE 0xffffffff
+
+struct shader_file_t
+{
+    char name[128];             // relative to the library directory
+    char *source;               // NULL while the file cannot be read
+    std::atomic<bool> changed;
+};
+
+struct shader_library_stage_t
+{
+    uint32_t type;              // GL_VERTEX_SHADER, ...
+    const char *file;
+};
+
+struct shader_library_program_t
+{
+    char *defines;
+    uint32_t stage_types[SHADER_COMPILER_MAX_STAGES];
+    uint32_t stage_files[SHADER_COMPILER_MAX_STAGES];
+    uint32_t stage_count;
+
+    uint32_t set;               // variant set and permutation key, or SHADER_LIBRARY_NONE
+    uint32_t key;
+
+    // Files whose change rebuilds the program: the stages and their includes.
+    uint32_t dependencies[SHADER_LIBRARY_MAX_DEPENDENCIES];
+    uint32_t dependency_count;
+
+    uint64_t hash;              // of the preprocessed stages, 0 before the first build
+    uint32_t shared;            // program with the same text to use instead, or SHADER_LIBRARY_NONE
+
+    // A program sharing another's text keeps drawing with current until that
+    // one has been built from the text, then draws with it.
+    uint32_t current;           // what draws use, 0 until the first build
+    uint32_t program;           // built from this program's own text
+    uint64_t built_hash;        // the text program was built from
+    uint32_t request;           // compiler handle in flight
+    bool dirty;                 // needs a build once request is done
+};
+
+struct shader_variant_t
+{
+    uint32_t key;
+    uint32_t program;           // library program handle
+};
+
+struct shader_variant_set_t
+{
+    shader_features_t features;
+    uint32_t stage_types[SHADER_COMPILER_MAX_STAGES];
+    uint32_t stage_files[SHADER_COMPILER_MAX_STAGES];
+    uint32_t stage_count;
+
+    shader_variant_t *variants; // the permutations asked for so far
+    uint32_t variant_count;
+    uint32_t variant_capacity;
+};
+
+struct shader_library_stats_t
+{
+    uint32_t file_reloads;
+    uint32_t rebuilds;
+    uint32_t failures;
+    uint32_t deduplicated;      // builds skipped for a program with the same text
+};
+
+struct shader_library_t
+{
+    char directory[256];
+    shader_compiler_t *compiler;
+
+    // Written by the render thread, names read by the watcher up to file_count.
+    shader_file_t files[SHADER_LIBRARY_MAX_FILES];
+    std::atomic<uint32_t> file_count;
+
+    shader_library_program_t *programs;
+    uint32_t program_count;
+    uint32_t program_capacity;
+
+    shader_variant_set_t *sets;
+    uint32_t set_count;
+    uint32_t set_capacity;
+
+    shader_preprocessed_t preprocessed[SHADER_COMPILER_MAX_STAGES];
+
+    std::thread watcher;
+    std::atomic<bool> stop;
+#ifdef _WIN32
+    HANDLE directory_handle;
+    HANDLE stop_event;
+#else
+    int inotify;
+#endif
+
+    shader_library_stats_t stats;
+};
+
+char *shader_library_read_file(const shader_library_t *library, const char *name)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", library->directory, name);
+
+    FILE *file = 0;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "rb") != 0)
+    {
+        file = 0;
+    }
+#else
+    file = fopen(path, "rb");
+#endif
+    if (!file)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *source = size >= 0 ? (char *)malloc((size_t)size + 1) : NULL;
+    if (source && fread(source, 1, (size_t)size, file) != (size_t)size)
+    {
+        free(source);
+        source = NULL;
+    }
+    fclose(file);
+    if (source)
+    {
+        source[size] = '\0';
+    }
+    return source;
+}
+
+// Watcher thread side: flags the file if a program uses it.
+void shader_library_file_written(shader_library_t *library, const char *name)
+{
+    uint32_t count = library->file_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (strcmp(library->files[i].name, name) == 0)
+        {
+            library->files[i].changed.store(true, std::memory_order_release);
+        }
+    }
+}
+
+#ifdef _WIN32
+
+void shader_library_watch(shader_library_t *library)
+{
+    DWORD buffer[4096];
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+    HANDLE events[] = { overlapped.hEvent, library->stop_event };
+
+    DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+    while (ReadDirectoryChangesW(library->directory_handle, buffer, sizeof(buffer), FALSE, filter, NULL, &overlapped, NULL))
+    {
+        DWORD bytes = 0;
+        if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+        {
+            // Stopped; the buffer has to outlive the cancelled read.
+            CancelIo(library->directory_handle);
+            GetOverlappedResult(library->directory_handle, &overlapped, &bytes, TRUE);
+            break;
+        }
+        if (!GetOverlappedResult(library->directory_handle, &overlapped, &bytes, FALSE))
+        {
+            break;
+        }
+
+        // Zero bytes means the buffer overflowed and every file may have changed.
+        const uint8_t *entry = (const uint8_t *)buffer;
+        while (bytes)
+        {
+            const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)entry;
+            char name[256];
+            int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)), name, sizeof(name) - 1, NULL, NULL);
+            name[length] = '\0';
+            shader_library_file_written(library, name);
+            if (!info->NextEntryOffset)
+            {
+                break;
+            }
+            entry += info->NextEntryOffset;
+        }
+        if (!bytes)
+        {
+            uint32_t count = library->file_count.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                library->files[i].changed.store(true, std::memory_order_release);
+            }
+        }
+    }
+    CloseHandle(overlapped.hEvent);
+}
+
+void shader_library_start_watcher(shader_library_t *library)
+{
+    library->directory_handle = CreateFileA(library->directory,
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        NULL);
+    if (library->directory_handle == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "shader_library: cannot watch %s\n", library->directory);
+        return;
+    }
+    library->stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    library->watcher = std::thread(shader_library_watch, library);
+}
+
+void shader_library_stop_watcher(shader_library_t *library)
+{
+    if (!library->watcher.joinable())
+    {
+        return;
+    }
+    SetEvent(library->stop_event);
+    library->watcher.join();
+    CloseHandle(library->stop_event);
+    CloseHandle(library->directory_handle);
+}
+
+#else
+
+// Editors either rewrite the file in place (IN_CLOSE_WRITE) or write a copy
+// and rename it over the original (IN_MOVED_TO).
+void shader_library_watch(shader_library_t *library)
+{
+    alignas(inotify_event) char buffer[4096];
+    pollfd descriptor = { library->inotify, POLLIN, 0 };
+    while (!library->stop.load(std::memory_order_relaxed))
+    {
+        if (poll(&descriptor, 1, 100) <= 0)
+        {
+            continue;
+        }
+        ssize_t size = read(library->inotify, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event *event = (const inotify_event *)(buffer + offset);
+            if (event->len)
+            {
+                shader_library_file_written(library, event->name);
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+void shader_library_start_watcher(shader_library_t *library)
+{
+    library->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (library->inotify < 0 || inotify_add_watch(library->inotify, library->directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        fprintf(stderr, "shader_library: cannot watch %s\n", library->directory);
+        return;
+    }
+    library->watcher = std::thread(shader_library_watch, library);
+}
+
+void shader_library_stop_watcher(shader_library_t *library)
+{
+    if (library->watcher.joinable())
+    {
+        library->stop.store(true, std::memory_order_relaxed);
+        library->watcher.join();
+    }
+    if (library->inotify >= 0)
+    {
+        close(library->inotify);
+    }
+}
+
+#endif
+
+
+// Programs are built by compiler, which has to outlive the library.
+shader_library_t *shader_library_create(const char *directory, shader_compiler_t *compiler)
+{
+    shader_library_t *library = new shader_library_t();
+    snprintf(library->directory, sizeof(library->directory), "%s", directory);
+    library->compiler = compiler;
+    shader_library_start_watcher(library);
+    return library;
+}
+
+// Deletes a GL program once no library program draws with it or owns it.
+void shader_library_release(shader_library_t *library, uint32_t gl_program)
+{
+    if (!gl_program)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < library->program_count; ++i)
+    {
+        if (library->programs[i].program == gl_program || library->programs[i].current == gl_program)
+        {
+            return;
+        }
+    }
+    gl_state_delete_program(gl_program);
+}
+
+void shader_library_destroy(shader_library_t *library)
+{
+    shader_library_stop_watcher(library);
+
+    for (uint32_t i = 0; i < library->program_count; ++i)
+    {
+        shader_library_program_t *program = &library->programs[i];
+        if (program->request != SHADER_LIBRARY_NO_REQUEST)
+        {
+            shader_compiler_release(library->compiler, program->request);
+        }
+        uint32_t own = program->program;
+        uint32_t current = program->current;
+        program->program = 0;
+        program->current = 0;
+        shader_library_release(library, own);
+        shader_library_release(library, current);
+        free(program->defines);
+    }
+    for (uint32_t i = 0; i < library->set_count; ++i)
+    {
+        free(library->sets[i].variants);
+    }
+    uint32_t file_count = library->file_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < file_count; ++i)
+    {
+        free(library->files[i].source);
+    }
+    for (uint32_t i = 0; i < SHADER_COMPILER_MAX_STAGES; ++i)
+    {
+        shader_preprocessed_free(&library->preprocessed[i]);
+    }
+    free(library->programs);
+    free(library->sets);
+    delete library;
+}
+
+// Index of the file, read now if it is new to the library.
+uint32_t shader_library_file(shader_library_t *library, const char *name)
+{
+    uint32_t count = library->file_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (strcmp(library->files[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+
+    assert(count < SHADER_LIBRARY_MAX_FILES);
+    shader_file_t *file = &library->files[count];
+    snprintf(file->name, sizeof(file->name), "%s", name);
+    file->source = shader_library_read_file(library, name);
+    if (!file->source)
+    {
+        fprintf(stderr, "shader_library: cannot read %s/%s\n", library->directory, name);
+    }
+    library->file_count.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+void shader_library_add_dependency(shader_library_program_t *program, uint32_t file)
+{
+    for (uint32_t i = 0; i < program->dependency_count; ++i)
+    {
+        if (program->dependencies[i] == file)
+        {
+            return;
+        }
+    }
+    assert(program->dependency_count < SHADER_LIBRARY_MAX_DEPENDENCIES);
+    program->dependencies[program->dependency_count++] = file;
+}
+
+struct shader_library_include_t
+{
+    shader_library_t *library;
+    shader_library_program_t *program;
+};
+
+// Missing includes are dependencies too, so creating the file rebuilds.
+const char *shader_library_load_include(void *user, const char *name, uint32_t *source_index)
+{
+    shader_library_include_t *include = (shader_library_include_t *)user;
+    *source_index = shader_library_file(include->library, name);
+    shader_library_add_dependency(include->program, *source_index);
+    return include->library->files[*source_index].source;
+}
+
+// Preprocesses the stages and submits them, unless the text is what the
+// program was last built from or another program already has it.
+void shader_library_build(shader_library_t *library, uint32_t index)
+{
+    shader_library_program_t *program = &library->programs[index];
+    const shader_features_t *features = program->set != SHADER_LIBRARY_NONE ? &library->sets[program->set].features : NULL;
+
+    program->dependency_count = 0;
+    for (uint32_t i = 0; i < program->stage_count; ++i)
+    {
+        shader_library_add_dependency(program, program->stage_files[i]);
+    }
+
+    shader_library_include_t include = { library, program };
+    program_stage_t stages[SHADER_COMPILER_MAX_STAGES];
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t i = 0; i < program->stage_count; ++i)
+    {
+        const char *source = library->files[program->stage_files[i]].source;
+        shader_preprocessed_t *preprocessed = &library->preprocessed[i];
+        // An unreadable stage was reported when the file was read.
+        if (!source || !shader_preprocess(preprocessed, source, program->stage_files[i], program->defines, features, program->key, shader_library_load_include, &include))
+        {
+            ++library->stats.failures;
+            return;
+        }
+        stages[i].type = program->stage_types[i];
+        stages[i].source = preprocessed->text.data;
+        hash = program_cache_hash(hash, &stages[i].type, sizeof(stages[i].type));
+        hash = program_cache_hash(hash, &preprocessed->hash, sizeof(preprocessed->hash));
+    }
+
+    // Comment or whitespace edits leave the program as it is.
+    if (hash == program->hash && program->shared == SHADER_LIBRARY_NONE)
+    {
+        ++library->stats.deduplicated;
+        return;
+    }
+
+    // A build still running is of text that is out of date now.
+    if (program->request != SHADER_LIBRARY_NO_REQUEST)
+    {
+        shader_compiler_release(library->compiler, program->request);
+        program->request = SHADER_LIBRARY_NO_REQUEST;
+    }
+
+    // Programs sharing this one no longer have the same text.
+    program->hash = hash;
+    for (uint32_t i = 0; i < library->program_count; ++i)
+    {
+        if (library->programs[i].shared == index)
+        {
+            library->programs[i].dirty = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < library->program_count; ++i)
+    {
+        const shader_library_program_t *other = &library->programs[i];
+        bool built = other->program || other->request != SHADER_LIBRARY_NO_REQUEST;
+        if (i != index && other->shared == SHADER_LIBRARY_NONE && other->hash == hash && built)
+        {
+            program->shared = i;
+            ++library->stats.deduplicated;
+            return;
+        }
+    }
+
+    program->shared = SHADER_LIBRARY_NONE;
+    program->request = shader_compiler_submit(library->compiler, NULL, stages, program->stage_count, program->current);
+    ++library->stats.rebuilds;
+}
+
+uint32_t shader_library_add(shader_library_t *library, const char *defines, const uint32_t *stage_types, const uint32_t *stage_files, uint32_t stage_count, uint32_t set, uint32_t key)
+{
+    assert(stage_count <= SHADER_COMPILER_MAX_STAGES);
+    if (library->program_count == library->program_capacity)
+    {
+        library->program_capacity = library->program_capacity ? library->program_capacity * 2 : 32;
+        library->programs = (shader_library_program_t *)realloc(library->programs, library->program_capacity * sizeof(shader_library_program_t));
+        assert(library->programs);
+    }
+
+    uint32_t handle = library->program_count++;
+    shader_library_program_t *program = &library->programs[handle];
+    memset(program, 0, sizeof(*program));
+    program->defines = defines ? shader_compiler_copy_string(defines) : NULL;
+    program->stage_count = stage_count;
+    memcpy(program->stage_types, stage_types, stage_count * sizeof(uint32_t));
+    memcpy(program->stage_files, stage_files, stage_count * sizeof(uint32_t));
+    program->set = set;
+    program->key = key;
+    program->shared = SHADER_LIBRARY_NONE;
+    program->request = SHADER_LIBRARY_NO_REQUEST;
+    shader_library_build(library, handle);
+    return handle;
+}
+
+// Returns the handle for shader_library_program(). The build starts right
+// away; the program is 0 until it has linked.
+uint32_t shader_library_add_program(shader_library_t *library, const char *defines, const shader_library_stage_t *stages, uint32_t stage_count)
+{
+    assert(stage_count <= SHADER_COMPILER_MAX_STAGES);
+    uint32_t stage_types[SHADER_COMPILER_MAX_STAGES];
+    uint32_t stage_files[SHADER_COMPILER_MAX_STAGES];
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        stage_types[i] = stages[i].type;
+        stage_files[i] = shader_library_file(library, stages[i].file);
+    }
+    return shader_library_add(library, defines, stage_types, stage_files, stage_count, SHADER_LIBRARY_NONE, 0);
+}
+
+// Returns a handle for shader_library_variant(). Nothing is compiled yet.
+uint32_t shader_library_add_variants(shader_library_t *library, const shader_features_t *features, const shader_library_stage_t *stages, uint32_t stage_count)
+{
+    assert(stage_count <= SHADER_COMPILER_MAX_STAGES);
+    if (library->set_count == library->set_capacity)
+    {
+        library->set_capacity = library->set_capacity ? library->set_capacity * 2 : 16;
+        library->sets = (shader_variant_set_t *)realloc(library->sets, library->set_capacity * sizeof(shader_variant_set_t));
+        assert(library->sets);
+    }
+
+    uint32_t handle = library->set_count++;
+    shader_variant_set_t *set = &library->sets[handle];
+    memset(set, 0, sizeof(*set));
+    set->features = *features;
+    set->stage_count = stage_count;
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        set->stage_types[i] = stages[i].type;
+        set->stage_files[i] = shader_library_file(library, stages[i].file);
+    }
+    return handle;
+}
+
+// The program handle for one permutation, which starts building the first
+// time it is asked for. Look it up once, not per draw.
+uint32_t shader_library_variant(shader_library_t *library, uint32_t set_handle, uint32_t key)
+{
+    assert(set_handle < library->set_count);
+    shader_variant_set_t *set = &library->sets[set_handle];
+    assert(key < shader_permutation_count(&set->features));
+    for (uint32_t i = 0; i < set->variant_count; ++i)
+    {
+        if (set->variants[i].key == key)
+        {
+            return set->variants[i].program;
+        }
+    }
+
+    uint32_t program = shader_library_add(library, NULL, set->stage_types, set->stage_files, set->stage_count, set_handle, key);
+    set = &library->sets[set_handle];
+    if (set->variant_count == set->variant_capacity)
+    {
+        set->variant_capacity = set->variant_capacity ? set->variant_capacity * 2 : 16;
+        set->variants = (shader_variant_t *)realloc(set->variants, set->variant_capacity * sizeof(shader_variant_t));
+        assert(set->variants);
+    }
+    set->variants[set->variant_count].key = key;
+    set->variants[set->variant_count].program = program;
+    ++set->variant_count;
+    return program;
+}
+
+// How many permutations the set has and how many of them have been used.
+void shader_library_variant_usage(const shader_library_t *library, uint32_t set_handle, uint32_t *permutations, uint32_t *used)
+{
+    assert(set_handle < library->set_count);
+    const shader_variant_set_t *set = &library->sets[set_handle];
+    *permutations = shader_permutation_count(&set->features);
+    *used = set->variant_count;
+}
+
+inline uint32_t shader_library_program(const shader_library_t *library, uint32_t handle)
+{
+    assert(handle < library->program_count);
+    return library->programs[handle].current;
+}
+
+// Rereads changed files, rebuilds the programs using them and swaps in the
+// programs that finished. Call between frames on the render thread.
+void shader_library_update(shader_library_t *library)
+{
+    shader_compiler_poll(library->compiler);
+
+    uint32_t file_count = library->file_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < file_count; ++i)
+    {
+        shader_file_t *file = &library->files[i];
+        if (!file->changed.exchange(false, std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        char *source = shader_library_read_file(library, file->name);
+        if (!source)
+        {
+            // Most likely still open in the editor; try again next frame.
+            file->changed.store(true, std::memory_order_relaxed);
+            continue;
+        }
+        if (file->source && strcmp(file->source, source) == 0)
+        {
+            free(source);
+            continue;
+        }
+        free(file->source);
+        file->source = source;
+        ++library->stats.file_reloads;
+
+        for (uint32_t p = 0; p < library->program_count; ++p)
+        {
+            shader_library_program_t *program = &library->programs[p];
+            for (uint32_t d = 0; d < program->dependency_count; ++d)
+            {
+                if (program->dependencies[d] == i)
+                {
+                    program->dirty = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < library->program_count; ++i)
+    {
+        shader_library_program_t *program = &library->programs[i];
+        if (program->request != SHADER_LIBRARY_NO_REQUEST)
+        {
+            program_status_t status = shader_compiler_status(library->compiler, program->request);
+            if (status == PROGRAM_PENDING)
+            {
+                continue;
+            }
+            if (status == PROGRAM_READY)
+            {
+                uint32_t previous = program->program;
+                uint32_t previous_current = program->current;
+                program->program = shader_compiler_take(library->compiler, program->request);
+                program->current = program->program;
+                program->built_hash = program->hash;
+                shader_library_release(library, previous);
+                shader_library_release(library, previous_current);
+            }
+            else
+            {
+                shader_compiler_release(library->compiler, program->request);
+                ++library->stats.failures;
+            }
+            program->request = SHADER_LIBRARY_NO_REQUEST;
+        }
+
+        // Changes that came in while a build was running start another.
+        if (program->dirty)
+        {
+            program->dirty = false;
+            shader_library_build(library, i);
+            program = &library->programs[i];
+        }
+
+        if (program->shared != SHADER_LIBRARY_NONE)
+        {
+            const shader_library_program_t *shared = &library->programs[program->shared];
+            if (shared->program && shared->built_hash == program->hash && program->current != shared->program)
+            {
+                uint32_t previous = program->program;
+                uint32_t previous_current = program->current;
+                program->program = 0;
+                program->current = shared->program;
+                shader_library_release(library, previous);
+                shader_library_release(library, previous_current);
+            }
+        }
+    }
+}
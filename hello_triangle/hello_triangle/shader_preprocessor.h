@@ -0,0 +1,388 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "program_cache.h"
+
+// Turns a shader file into the text handed to glShaderSource:
+//
+//   - #include "name" lines are replaced by the file, recursively, with #line
+//     directives so compile errors point into the right file. A file with
+//     #pragma once is only pulled in the first time.
+//   - defines and the features selected by a permutation key are inserted
+//     after #version. A feature is only defined when its name appears in the
+//     expanded source, so permutations that differ in features the shader
+//     never tests produce the same text.
+//   - the result is hashed with comments, #line directives and insignificant
+//     whitespace removed, so identical variants can share one program.
+//
+// Files are fetched through a loader, which also numbers them for #line.
+
+#define SHADER_MAX_FEATURES 16
+#define SHADER_PREPROCESSOR_MAX_INCLUDES 32
+#define SHADER_PREPROCESSOR_MAX_DEPTH 16
+
+// Named on/off switches; bit i of a permutation key turns on names[i]. The
+// strings are not copied.
+struct shader_features_t
+{
+    const char *names[SHADER_MAX_FEATURES];
+    uint32_t count;
+};
+
+inline uint32_t shader_permutation_count(const shader_features_t *features)
+{
+    return features ? 1u << features->count : 1;
+}
+
+// Returns the file's text or NULL, and its number for #line.
+typedef const char *(*shader_include_loader_t)(void *user, const char *name, uint32_t *source_index);
+
+struct shader_text_t
+{
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+};
+
+struct shader_preprocessed_t
+{
+    shader_text_t text;
+    uint32_t includes[SHADER_PREPROCESSOR_MAX_INCLUDES];   // source indices of included files
+    uint32_t include_count;
+    uint64_t hash;
+
+    // Scratch for the expansion, kept to reuse its memory.
+    shader_text_t body;
+};
+
+void shader_text_append(shader_text_t *text, const char *data, size_t size)
+{
+    if (text->size + size + 1 > text->capacity)
+    {
+        uint32_t capacity = text->capacity ? text->capacity : 4096;
+        while (text->size + size + 1 > capacity)
+        {
+            capacity *= 2;
+        }
+        text->data = (char *)realloc(text->data, capacity);
+        assert(text->data);
+        text->capacity = capacity;
+    }
+    memcpy(text->data + text->size, data, size);
+    text->size += (uint32_t)size;
+    text->data[text->size] = '\0';
+}
+
+inline void shader_text_append_string(shader_text_t *text, const char *string)
+{
+    shader_text_append(text, string, strlen(string));
+}
+
+void shader_text_append_line_directive(shader_text_t *text, uint32_t line, uint32_t source_index)
+{
+    char directive[48];
+    int length = snprintf(directive, sizeof(directive), "#line %u %u\n", line, source_index);
+    shader_text_append(text, directive, (size_t)length);
+}
+
+void shader_preprocessed_free(shader_preprocessed_t *preprocessed)
+{
+    free(preprocessed->text.data);
+    free(preprocessed->body.data);
+    memset(preprocessed, 0, sizeof(*preprocessed));
+}
+
+inline bool shader_is_identifier_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Whether name appears in text as a whole identifier.
+bool shader_mentions(const char *text, const char *name)
+{
+    size_t length = strlen(name);
+    for (const char *found = strstr(text, name); found; found = strstr(found + length, name))
+    {
+        bool starts = found == text || !shader_is_identifier_char(found[-1]);
+        bool ends = !shader_is_identifier_char(found[length]);
+        if (starts && ends)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The directive a line holds, e.g. "include" for "  #  include ...", with
+// *arguments after it; NULL for other lines.
+const char *shader_directive(const char *line, const char *end, const char *directive, const char **arguments)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+    {
+        ++line;
+    }
+    if (line == end || *line != '#')
+    {
+        return NULL;
+    }
+    ++line;
+    while (line < end && (*line == ' ' || *line == '\t'))
+    {
+        ++line;
+    }
+    size_t length = strlen(directive);
+    if ((size_t)(end - line) < length || strncmp(line, directive, length) != 0 || (line + length < end && shader_is_identifier_char(line[length])))
+    {
+        return NULL;
+    }
+    *arguments = line + length;
+    return line;
+}
+
+struct shader_expansion_t
+{
+    shader_preprocessed_t *out;
+    shader_include_loader_t load;
+    void *user;
+    uint32_t once[SHADER_PREPROCESSOR_MAX_INCLUDES];
+    uint32_t once_count;
+};
+
+bool shader_expand(shader_expansion_t *expansion, const char *source, uint32_t source_index, uint32_t first_line, uint32_t depth)
+{
+    if (depth > SHADER_PREPROCESSOR_MAX_DEPTH)
+    {
+        fprintf(stderr, "shader_preprocessor: includes nested too deep, or an include cycle\n");
+        return false;
+    }
+
+    shader_text_t *body = &expansion->out->body;
+    uint32_t line_number = first_line;
+    for (const char *line = source; *line; ++line_number)
+    {
+        const char *end = strchr(line, '\n');
+        const char *next = end ? end + 1 : line + strlen(line);
+        end = end ? end : next;
+
+        const char *arguments;
+        if (shader_directive(line, end, "pragma", &arguments))
+        {
+            const char *once = arguments;
+            while (once < end && (*once == ' ' || *once == '\t'))
+            {
+                ++once;
+            }
+            if (end - once >= 4 && strncmp(once, "once", 4) == 0)
+            {
+                for (uint32_t i = 0; i < expansion->once_count; ++i)
+                {
+                    if (expansion->once[i] == source_index)
+                    {
+                        return true;
+                    }
+                }
+                if (expansion->once_count < SHADER_PREPROCESSOR_MAX_INCLUDES)
+                {
+                    expansion->once[expansion->once_count++] = source_index;
+                }
+                line = next;
+                continue;
+            }
+        }
+
+        if (!shader_directive(line, end, "include", &arguments))
+        {
+            shader_text_append(body, line, (size_t)(next - line));
+            if (next == end)
+            {
+                shader_text_append(body, "\n", 1);
+            }
+            line = next;
+            continue;
+        }
+
+        const char *open = arguments;
+        while (open < end && *open != '"' && *open != '<')
+        {
+            ++open;
+        }
+        const char *close = open < end ? (const char *)memchr(open + 1, *open == '<' ? '>' : '"', (size_t)(end - open - 1)) : NULL;
+        char name[128];
+        if (!close || (size_t)(close - open - 1) >= sizeof(name))
+        {
+            fprintf(stderr, "shader_preprocessor: %u(%u): malformed #include\n", source_index, line_number);
+            return false;
+        }
+        memcpy(name, open + 1, (size_t)(close - open - 1));
+        name[close - open - 1] = '\0';
+
+        uint32_t include_index = 0;
+        const char *included = expansion->load(expansion->user, name, &include_index);
+        if (!included)
+        {
+            fprintf(stderr, "shader_preprocessor: %u(%u): cannot include %s\n", source_index, line_number, name);
+            return false;
+        }
+
+        shader_preprocessed_t *out = expansion->out;
+        bool known = false;
+        for (uint32_t i = 0; i < out->include_count; ++i)
+        {
+            known = known || out->includes[i] == include_index;
+        }
+        if (!known)
+        {
+            assert(out->include_count < SHADER_PREPROCESSOR_MAX_INCLUDES);
+            out->includes[out->include_count++] = include_index;
+        }
+
+        shader_text_append_line_directive(body, 1, include_index);
+        if (!shader_expand(expansion, included, include_index, 1, depth + 1))
+        {
+            return false;
+        }
+        shader_text_append_line_directive(body, line_number + 1, source_index);
+        line = next;
+    }
+    return true;
+}
+
+// Hash of text without comments, #line directives, blank lines and runs of
+// whitespace.
+uint64_t shader_normalized_hash(const char *text)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    bool line_start = true;
+    bool space = false;
+    for (const char *c = text; *c;)
+    {
+        if (c[0] == '/' && c[1] == '/')
+        {
+            while (*c && *c != '\n')
+            {
+                ++c;
+            }
+            continue;
+        }
+        if (c[0] == '/' && c[1] == '*')
+        {
+            const char *end = strstr(c + 2, "*/");
+            c = end ? end + 2 : c + strlen(c);
+            space = !line_start;
+            continue;
+        }
+        if (line_start)
+        {
+            const char *arguments;
+            const char *end = strchr(c, '\n');
+            end = end ? end : c + strlen(c);
+            if (shader_directive(c, end, "line", &arguments))
+            {
+                c = end;
+                continue;
+            }
+        }
+
+        char character = *c++;
+        if (character == ' ' || character == '\t' || character == '\r')
+        {
+            space = !line_start;
+            continue;
+        }
+        if (character == '\n')
+        {
+            if (!line_start)
+            {
+                hash = program_cache_hash(hash, "\n", 1);
+            }
+            line_start = true;
+            space = false;
+            continue;
+        }
+        if (space)
+        {
+            hash = program_cache_hash(hash, " ", 1);
+        }
+        hash = program_cache_hash(hash, &character, 1);
+        line_start = false;
+        space = false;
+    }
+    return hash;
+}
+
+// Expands source, numbered source_index, into out->text. defines and the
+// features of key go after #version. Returns false with the problem logged
+// when an include is missing or malformed.
+bool shader_preprocess(shader_preprocessed_t *out,
+    const char *source,
+    uint32_t source_index,
+    const char *defines,
+    const shader_features_t *features,
+    uint32_t key,
+    shader_include_loader_t load,
+    void *user)
+{
+    out->text.size = 0;
+    out->body.size = 0;
+    out->include_count = 0;
+    out->hash = 0;
+
+    // Only a line starting with the directive counts, not a mention of it in
+    // a comment further up.
+    const char *body = source;
+    uint32_t body_line = 1;
+    uint32_t line_number = 1;
+    for (const char *line = source; *line; ++line_number)
+    {
+        const char *end = strchr(line, '\n');
+        const char *next = end ? end + 1 : line + strlen(line);
+        const char *arguments;
+        if (shader_directive(line, end ? end : next, "version", &arguments))
+        {
+            body = next;
+            body_line = line_number + 1;
+            break;
+        }
+        line = next;
+    }
+
+    shader_expansion_t expansion = {};
+    expansion.out = out;
+    expansion.load = load;
+    expansion.user = user;
+    if (!shader_expand(&expansion, body, source_index, body_line, 0))
+    {
+        return false;
+    }
+
+    shader_text_append(&out->text, source, (size_t)(body - source));
+    if (body > source && body[-1] != '\n')
+    {
+        shader_text_append(&out->text, "\n", 1);
+    }
+    if (defines)
+    {
+        shader_text_append_string(&out->text, defines);
+    }
+    for (uint32_t i = 0; features && i < features->count; ++i)
+    {
+        if ((key >> i & 1) && shader_mentions(out->body.data ? out->body.data : "", features->names[i]))
+        {
+            shader_text_append_string(&out->text, "#define ");
+            shader_text_append_string(&out->text, features->names[i]);
+            shader_text_append_string(&out->text, " 1\n");
+        }
+    }
+    shader_text_append_line_directive(&out->text, body_line, source_index);
+    if (out->body.size)
+    {
+        shader_text_append(&out->text, out->body.data, out->body.size);
+    }
+
+    out->hash = shader_normalized_hash(out->text.data);
+    return true;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include "math.h"
+
+// 8-wide float/int lanes for the CPU renderer. Builds with /arch:AVX2 get one
+// 256-bit register per value, everything else falls back to a pair of SSE2
+// registers so the same code runs on any x64 CPU.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#else
+#include <emmintrin.h>
+#define SIMD_AVX2 0
+#endif
+
+#define SIMD_LANES 8
+
+#if SIMD_AVX2
+
+struct f32x8_t { __m256 v; };
+struct i32x8_t { __m256i v; };
+
+inline f32x8_t f32x8(real32_t a) { return { _mm256_set1_ps(a) }; }
+inline f32x8_t f32x8_load(const real32_t *p) { return { _mm256_loadu_ps(p) }; }
+inline void f32x8_store(real32_t *p, f32x8_t a) { _mm256_storeu_ps(p, a.v); }
+inline f32x8_t f32x8_ramp(real32_t base) { return { _mm256_add_ps(_mm256_set1_ps(base), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)) }; }
+
+inline f32x8_t operator+(f32x8_t a, f32x8_t b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline f32x8_t operator-(f32x8_t a, f32x8_t b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline f32x8_t operator*(f32x8_t a, f32x8_t b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline f32x8_t operator/(f32x8_t a, f32x8_t b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline f32x8_t simd_min(f32x8_t a, f32x8_t b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline f32x8_t simd_max(f32x8_t a, f32x8_t b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline f32x8_t floor(f32x8_t a) { return { _mm256_floor_ps(a.v) }; }
+inline f32x8_t sqrt(f32x8_t a) { return { _mm256_sqrt_ps(a.v) }; }
+inline f32x8_t abs(f32x8_t a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+
+inline i32x8_t cmp_lt(f32x8_t a, f32x8_t b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)) }; }
+inline i32x8_t cmp_le(f32x8_t a, f32x8_t b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)) }; }
+inline i32x8_t cmp_gt(f32x8_t a, f32x8_t b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)) }; }
+inline i32x8_t cmp_ge(f32x8_t a, f32x8_t b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)) }; }
+inline i32x8_t cmp_eq(f32x8_t a, f32x8_t b) { return { _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)) }; }
+inline f32x8_t select(i32x8_t mask, f32x8_t a, f32x8_t b) { return { _mm256_blendv_ps(b.v, a.v, _mm256_castsi256_ps(mask.v)) }; }
+
+inline i32x8_t i32x8(int32_t a) { return { _mm256_set1_epi32(a) }; }
+inline i32x8_t i32x8_load(const int32_t *p) { return { _mm256_loadu_si256((const __m256i *)p) }; }
+inline void i32x8_store(int32_t *p, i32x8_t a) { _mm256_storeu_si256((__m256i *)p, a.v); }
+inline i32x8_t i32x8_ramp(int32_t base) { return { _mm256_add_epi32(_mm256_set1_epi32(base), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)) }; }
+
+inline i32x8_t operator+(i32x8_t a, i32x8_t b) { return { _mm256_add_epi32(a.v, b.v) }; }
+inline i32x8_t operator-(i32x8_t a, i32x8_t b) { return { _mm256_sub_epi32(a.v, b.v) }; }
+inline i32x8_t operator*(i32x8_t a, i32x8_t b) { return { _mm256_mullo_epi32(a.v, b.v) }; }
+inline i32x8_t operator&(i32x8_t a, i32x8_t b) { return { _mm256_and_si256(a.v, b.v) }; }
+inline i32x8_t operator|(i32x8_t a, i32x8_t b) { return { _mm256_or_si256(a.v, b.v) }; }
+inline i32x8_t operator^(i32x8_t a, i32x8_t b) { return { _mm256_xor_si256(a.v, b.v) }; }
+inline i32x8_t operator<<(i32x8_t a, int32_t n) { return { _mm256_sll_epi32(a.v, _mm_cvtsi32_si128(n)) }; }
+inline i32x8_t operator>>(i32x8_t a, int32_t n) { return { _mm256_srl_epi32(a.v, _mm_cvtsi32_si128(n)) }; }
+inline i32x8_t shift_left(i32x8_t a, i32x8_t n) { return { _mm256_sllv_epi32(a.v, n.v) }; }
+inline i32x8_t shift_right(i32x8_t a, i32x8_t n) { return { _mm256_srlv_epi32(a.v, n.v) }; }
+inline i32x8_t andnot(i32x8_t mask, i32x8_t a) { return { _mm256_andnot_si256(mask.v, a.v) }; }
+inline i32x8_t simd_min(i32x8_t a, i32x8_t b) { return { _mm256_min_epi32(a.v, b.v) }; }
+inline i32x8_t simd_max(i32x8_t a, i32x8_t b) { return { _mm256_max_epi32(a.v, b.v) }; }
+inline i32x8_t cmp_eq(i32x8_t a, i32x8_t b) { return { _mm256_cmpeq_epi32(a.v, b.v) }; }
+inline i32x8_t cmp_gt(i32x8_t a, i32x8_t b) { return { _mm256_cmpgt_epi32(a.v, b.v) }; }
+inline i32x8_t select(i32x8_t mask, i32x8_t a, i32x8_t b) { return { _mm256_blendv_epi8(b.v, a.v, mask.v) }; }
+
+inline i32x8_t to_i32(f32x8_t a) { return { _mm256_cvttps_epi32(a.v) }; }
+inline f32x8_t to_f32(i32x8_t a) { return { _mm256_cvtepi32_ps(a.v) }; }
+inline f32x8_t as_f32(i32x8_t a) { return { _mm256_castsi256_ps(a.v) }; }
+inline i32x8_t as_i32(f32x8_t a) { return { _mm256_castps_si256(a.v) }; }
+
+inline uint32_t movemask(i32x8_t mask) { return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(mask.v)); }
+
+inline i32x8_t gather(const uint32_t *base, i32x8_t index) { return { _mm256_i32gather_epi32((const int *)base, index.v, 4) }; }
+
+// Lanes hold two 2x2 quads laid out (0,0) (1,0) (0,1) (1,1); these swap a lane
+// with its horizontal or vertical neighbour inside the quad.
+inline f32x8_t quad_swap_x(f32x8_t a) { return { _mm256_permute_ps(a.v, _MM_SHUFFLE(2, 3, 0, 1)) }; }
+inline f32x8_t quad_swap_y(f32x8_t a) { return { _mm256_permute_ps(a.v, _MM_SHUFFLE(1, 0, 3, 2)) }; }
+
+#else
+
+struct f32x8_t { __m128 lo, hi; };
+struct i32x8_t { __m128i lo, hi; };
+
+inline f32x8_t f32x8(real32_t a) { __m128 v = _mm_set1_ps(a); return { v, v }; }
+inline f32x8_t f32x8_load(const real32_t *p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+inline void f32x8_store(real32_t *p, f32x8_t a) { _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+inline f32x8_t f32x8_ramp(real32_t base) { __m128 b = _mm_set1_ps(base); return { _mm_add_ps(b, _mm_setr_ps(0, 1, 2, 3)), _mm_add_ps(b, _mm_setr_ps(4, 5, 6, 7)) }; }
+
+inline f32x8_t operator+(f32x8_t a, f32x8_t b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+inline f32x8_t operator-(f32x8_t a, f32x8_t b) { return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) }; }
+inline f32x8_t operator*(f32x8_t a, f32x8_t b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+inline f32x8_t operator/(f32x8_t a, f32x8_t b) { return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) }; }
+inline f32x8_t simd_min(f32x8_t a, f32x8_t b) { return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) }; }
+inline f32x8_t simd_max(f32x8_t a, f32x8_t b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+inline f32x8_t sqrt(f32x8_t a) { return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+inline f32x8_t abs(f32x8_t a) { __m128 s = _mm_set1_ps(-0.0f); return { _mm_andnot_ps(s, a.lo), _mm_andnot_ps(s, a.hi) }; }
+
+inline i32x8_t cmp_lt(f32x8_t a, f32x8_t b) { return { _mm_castps_si128(_mm_cmplt_ps(a.lo, b.lo)), _mm_castps_si128(_mm_cmplt_ps(a.hi, b.hi)) }; }
+inline i32x8_t cmp_le(f32x8_t a, f32x8_t b) { return { _mm_castps_si128(_mm_cmple_ps(a.lo, b.lo)), _mm_castps_si128(_mm_cmple_ps(a.hi, b.hi)) }; }
+inline i32x8_t cmp_gt(f32x8_t a, f32x8_t b) { return { _mm_castps_si128(_mm_cmpgt_ps(a.lo, b.lo)), _mm_castps_si128(_mm_cmpgt_ps(a.hi, b.hi)) }; }
+inline i32x8_t cmp_ge(f32x8_t a, f32x8_t b) { return { _mm_castps_si128(_mm_cmpge_ps(a.lo, b.lo)), _mm_castps_si128(_mm_cmpge_ps(a.hi, b.hi)) }; }
+inline i32x8_t cmp_eq(f32x8_t a, f32x8_t b) { return { _mm_castps_si128(_mm_cmpeq_ps(a.lo, b.lo)), _mm_castps_si128(_mm_cmpeq_ps(a.hi, b.hi)) }; }
+
+inline f32x8_t select(i32x8_t mask, f32x8_t a, f32x8_t b)
+{
+    __m128 m_lo = _mm_castsi128_ps(mask.lo);
+    __m128 m_hi = _mm_castsi128_ps(mask.hi);
+    return { _mm_or_ps(_mm_and_ps(m_lo, a.lo), _mm_andnot_ps(m_lo, b.lo)),
+        _mm_or_ps(_mm_and_ps(m_hi, a.hi), _mm_andnot_ps(m_hi, b.hi)) };
+}
+
+inline i32x8_t i32x8(int32_t a) { __m128i v = _mm_set1_epi32(a); return { v, v }; }
+inline i32x8_t i32x8_load(const int32_t *p) { return { _mm_loadu_si128((const __m128i *)p), _mm_loadu_si128((const __m128i *)(p + 4)) }; }
+inline void i32x8_store(int32_t *p, i32x8_t a) { _mm_storeu_si128((__m128i *)p, a.lo); _mm_storeu_si128((__m128i *)(p + 4), a.hi); }
+inline i32x8_t i32x8_ramp(int32_t base) { __m128i b = _mm_set1_epi32(base); return { _mm_add_epi32(b, _mm_setr_epi32(0, 1, 2, 3)), _mm_add_epi32(b, _mm_setr_epi32(4, 5, 6, 7)) }; }
+
+inline i32x8_t operator+(i32x8_t a, i32x8_t b) { return { _mm_add_epi32(a.lo, b.lo), _mm_add_epi32(a.hi, b.hi) }; }
+inline i32x8_t operator-(i32x8_t a, i32x8_t b) { return { _mm_sub_epi32(a.lo, b.lo), _mm_sub_epi32(a.hi, b.hi) }; }
+inline i32x8_t operator&(i32x8_t a, i32x8_t b) { return { _mm_and_si128(a.lo, b.lo), _mm_and_si128(a.hi, b.hi) }; }
+inline i32x8_t operator|(i32x8_t a, i32x8_t b) { return { _mm_or_si128(a.lo, b.lo), _mm_or_si128(a.hi, b.hi) }; }
+inline i32x8_t operator^(i32x8_t a, i32x8_t b) { return { _mm_xor_si128(a.lo, b.lo), _mm_xor_si128(a.hi, b.hi) }; }
+inline i32x8_t operator<<(i32x8_t a, int32_t n) { __m128i c = _mm_cvtsi32_si128(n); return { _mm_sll_epi32(a.lo, c), _mm_sll_epi32(a.hi, c) }; }
+inline i32x8_t operator>>(i32x8_t a, int32_t n) { __m128i c = _mm_cvtsi32_si128(n); return { _mm_srl_epi32(a.lo, c), _mm_srl_epi32(a.hi, c) }; }
+inline i32x8_t andnot(i32x8_t mask, i32x8_t a) { return { _mm_andnot_si128(mask.lo, a.lo), _mm_andnot_si128(mask.hi, a.hi) }; }
+inline i32x8_t cmp_eq(i32x8_t a, i32x8_t b) { return { _mm_cmpeq_epi32(a.lo, b.lo), _mm_cmpeq_epi32(a.hi, b.hi) }; }
+inline i32x8_t cmp_gt(i32x8_t a, i32x8_t b) { return { _mm_cmpgt_epi32(a.lo, b.lo), _mm_cmpgt_epi32(a.hi, b.hi) }; }
+inline i32x8_t select(i32x8_t mask, i32x8_t a, i32x8_t b) { return (mask & a) | andnot(mask, b); }
+inline i32x8_t simd_min(i32x8_t a, i32x8_t b) { return select(cmp_gt(a, b), b, a); }
+inline i32x8_t simd_max(i32x8_t a, i32x8_t b) { return select(cmp_gt(a, b), a, b); }
+
+// SSE2 has no 32-bit mullo, multiply even and odd lanes separately and re-interleave.
+inline __m128i simd_mullo_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline i32x8_t operator*(i32x8_t a, i32x8_t b) { return { simd_mullo_epi32(a.lo, b.lo), simd_mullo_epi32(a.hi, b.hi) }; }
+
+inline i32x8_t to_i32(f32x8_t a) { return { _mm_cvttps_epi32(a.lo), _mm_cvttps_epi32(a.hi) }; }
+inline f32x8_t to_f32(i32x8_t a) { return { _mm_cvtepi32_ps(a.lo), _mm_cvtepi32_ps(a.hi) }; }
+inline f32x8_t as_f32(i32x8_t a) { return { _mm_castsi128_ps(a.lo), _mm_castsi128_ps(a.hi) }; }
+inline i32x8_t as_i32(f32x8_t a) { return { _mm_castps_si128(a.lo), _mm_castps_si128(a.hi) }; }
+
+inline f32x8_t floor(f32x8_t a)
+{
+    // Truncate, then step down one where truncation rounded a negative value up.
+    f32x8_t t = to_f32(to_i32(a));
+    return t - select(cmp_gt(t, a), f32x8(1.0f), f32x8(0.0f));
+}
+
+inline uint32_t movemask(i32x8_t mask)
+{
+    return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(mask.lo)) | ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(mask.hi)) << 4);
+}
+
+inline i32x8_t gather(const uint32_t *base, i32x8_t index)
+{
+    int32_t i[8], r[8];
+    i32x8_store(i, index);
+    for (uint32_t lane = 0; lane < 8; ++lane)
+    {
+        r[lane] = (int32_t)base[i[lane]];
+    }
+    return i32x8_load(r);
+}
+
+inline i32x8_t shift_left(i32x8_t a, i32x8_t n)
+{
+    int32_t v[8], s[8];
+    i32x8_store(v, a);
+    i32x8_store(s, n);
+    for (uint32_t lane = 0; lane < 8; ++lane)
+    {
+        v[lane] = (int32_t)((uint32_t)v[lane] << s[lane]);
+    }
+    return i32x8_load(v);
+}
+
+inline i32x8_t shift_right(i32x8_t a, i32x8_t n)
+{
+    int32_t v[8], s[8];
+    i32x8_store(v, a);
+    i32x8_store(s, n);
+    for (uint32_t lane = 0; lane < 8; ++lane)
+    {
+        v[lane] = (int32_t)((uint32_t)v[lane] >> s[lane]);
+    }
+    return i32x8_load(v);
+}
+
+// Lanes hold two 2x2 quads laid out (0,0) (1,0) (0,1) (1,1); these swap a lane
+// with its horizontal or vertical neighbour inside the quad.
+inline f32x8_t quad_swap_x(f32x8_t a) { return { _mm_shuffle_ps(a.lo, a.lo, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(a.hi, a.hi, _MM_SHUFFLE(2, 3, 0, 1)) }; }
+inline f32x8_t quad_swap_y(f32x8_t a) { return { _mm_shuffle_ps(a.lo, a.lo, _MM_SHUFFLE(1, 0, 3, 2)), _mm_shuffle_ps(a.hi, a.hi, _MM_SHUFFLE(1, 0, 3, 2)) }; }
+
+#endif
+
+inline f32x8_t operator-(f32x8_t a) { return f32x8(0.0f) - a; }
+inline f32x8_t clamp(f32x8_t a, f32x8_t lo, f32x8_t hi) { return simd_min(simd_max(a, lo), hi); }
+inline f32x8_t lerp(f32x8_t a, f32x8_t b, f32x8_t t) { return a + (b - a) * t; }
+inline i32x8_t clamp(i32x8_t a, i32x8_t lo, i32x8_t hi) { return simd_min(simd_max(a, lo), hi); }
+
+// log2 from the float exponent plus a quadratic fit of the mantissa, good to
+// about 0.01 which is plenty for picking mip levels.
+inline f32x8_t log2_approx(f32x8_t a)
+{
+    i32x8_t bits = as_i32(a);
+    f32x8_t exponent = to_f32(((bits >> 23) & i32x8(0xff)) - i32x8(128));
+    f32x8_t mantissa = as_f32((bits & i32x8(0x007fffff)) | i32x8(0x3f800000));
+    f32x8_t fraction = (f32x8(-0.34484843f) * mantissa + f32x8(2.02466578f)) * mantissa - f32x8(0.67487759f);
+    return exponent + fraction;
+}
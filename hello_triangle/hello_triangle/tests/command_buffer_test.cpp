@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "command_buffer.h"
+#include "tests/test.h"
+
+#define ENTRY_COUNT 5000
+
+bool entry_less(const command_sort_entry_t &a, const command_sort_entry_t &b)
+{
+    return a.key < b.key;
+}
+
+// Sorts entries whose item is their gather position and compares with
+// std::stable_sort, so any reordering of equal keys shows up.
+bool sorts_stably(command_sort_entry_t *entries, uint32_t count)
+{
+    command_sort_entry_t *expected = (command_sort_entry_t *)malloc(count * sizeof(command_sort_entry_t));
+    command_sort_entry_t *scratch = (command_sort_entry_t *)malloc(count * sizeof(command_sort_entry_t));
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        entries[i].buffer = i % 3;
+        entries[i].item = i;
+    }
+    memcpy(expected, entries, count * sizeof(command_sort_entry_t));
+    std::stable_sort(expected, expected + count, entry_less);
+
+    command_radix_sort(entries, scratch, count);
+    bool stable = true;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        stable = stable && entries[i].key == expected[i].key && entries[i].buffer == expected[i].buffer && entries[i].item == expected[i].item;
+    }
+
+    free(scratch);
+    free(expected);
+    return stable;
+}
+
+// Keys from a handful of passes, programs and materials, with depth often
+// shared, so most keys repeat many times; some byte passes run and others are
+// skipped, leaving the result in either the entries or the scratch array.
+int main()
+{
+    command_sort_entry_t *entries = (command_sort_entry_t *)malloc(ENTRY_COUNT * sizeof(command_sort_entry_t));
+    uint32_t state = 1;
+    for (uint32_t i = 0; i < ENTRY_COUNT; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        uint32_t random = state >> 8;
+        real32_t depth = random % 4 == 0 ? (real32_t)(random % 7) / 7.0f : 0.5f;
+        entries[i].key = command_key(random % 3, (random >> 4) % 5, (random >> 8) % 4 * 1000, depth, (random >> 12) % 2 != 0);
+    }
+    TEST_CHECK(sorts_stably(entries, ENTRY_COUNT));
+
+    // Only the material differs: an odd number of passes runs.
+    for (uint32_t i = 0; i < ENTRY_COUNT; ++i)
+    {
+        entries[i].key = command_key(1, 2, (i * 7) % 3, 0.25f, false);
+    }
+    TEST_CHECK(sorts_stably(entries, ENTRY_COUNT));
+
+    // Only the depth differs, in its lowest and highest bytes.
+    for (uint32_t i = 0; i < ENTRY_COUNT; ++i)
+    {
+        entries[i].key = command_key(0, 0, 0, 0.0f, false) | (i % 5 == 0 ? 0x010001u : (i % 2) * 0x000001u);
+    }
+    TEST_CHECK(sorts_stably(entries, ENTRY_COUNT));
+
+    // Every key equal: every pass is skipped and nothing moves.
+    for (uint32_t i = 0; i < ENTRY_COUNT; ++i)
+    {
+        entries[i].key = command_key(3, 4, 5, 0.5f, false);
+    }
+    TEST_CHECK(sorts_stably(entries, ENTRY_COUNT));
+    TEST_CHECK(entries[0].item == 0 && entries[ENTRY_COUNT - 1].item == ENTRY_COUNT - 1);
+
+    TEST_CHECK(sorts_stably(entries, 1));
+
+    free(entries);
+    return test_result("command_buffer_test");
+}
@@ -0,0 +1,69 @@
+#include "cpu_shader.h"
+#include "tests/test.h"
+
+// Stores through a dynamic index land in the element each invocation picked,
+// including swizzled and compound stores and stores under divergent control
+// flow.
+const char *test_vertex_shader = R"(
+#version 400
+layout(location = 0) out vec4 array_result;
+layout(location = 1) out vec4 matrix_result;
+void main()
+{
+    float a[4] = float[4](1.0, 2.0, 3.0, 4.0);
+    a[gl_VertexID] = 10.0;
+    a[gl_VertexID] += 5.0;
+    if (gl_VertexID < 2)
+    {
+        a[3 - gl_VertexID] = 20.0;
+    }
+    array_result = vec4(a[0], a[1], a[2], a[3]);
+
+    mat2 m = mat2(0.0);
+    int column = gl_VertexID / 2;
+    m[column].y = 7.0;
+    matrix_result = vec4(m[0], m[1]);
+    gl_Position = vec4(0.0);
+}
+)";
+
+int main()
+{
+    cpu_shader_t *shader = (cpu_shader_t *)calloc(1, sizeof(cpu_shader_t));
+    char error[256];
+    bool compiled = cpu_shader_compile(shader, CPU_SHADER_VERTEX, test_vertex_shader, error, sizeof(error));
+    TEST_CHECK(compiled);
+    if (!compiled)
+    {
+        fprintf(stderr, "%s\n", error);
+        return test_result("cpu_shader_test");
+    }
+
+    real32_t array_result[4][4] = {};
+    real32_t matrix_result[4][4] = {};
+    cpu_shader_run_t run = {};
+    run.outputs[cpu_shader_output_location(shader, "array_result")] = { &array_result[0][0], 4 };
+    run.outputs[cpu_shader_output_location(shader, "matrix_result")] = { &matrix_result[0][0], 4 };
+    cpu_shader_context_t context = cpu_shader_create_context(shader, 8);
+    cpu_shader_execute(&context, &run, 4);
+    cpu_shader_destroy_context(&context);
+
+    const real32_t expected_array[4][4] = {
+        { 15.0f, 2.0f, 3.0f, 20.0f },
+        { 1.0f, 15.0f, 20.0f, 4.0f },
+        { 1.0f, 2.0f, 15.0f, 4.0f },
+        { 1.0f, 2.0f, 3.0f, 15.0f },
+    };
+    for (uint32_t vertex = 0; vertex < 4; ++vertex)
+    {
+        uint32_t column = vertex / 2;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            TEST_CHECK(array_result[vertex][i] == expected_array[vertex][i]);
+            TEST_CHECK(matrix_result[vertex][i] == (i == column * 2 + 1 ? 7.0f : 0.0f));
+        }
+    }
+
+    free(shader);
+    return test_result("cpu_shader_test");
+}
@@ -0,0 +1,94 @@
+#include "framebuffer.h"
+#include "tests/test.h"
+
+// 3x2 tiles, the last column and row partial.
+#define WIDTH 80
+#define HEIGHT 40
+
+#define GREY 0xff808080u
+#define BLACK 0xff000000u
+#define RED 0xff0000ffu
+#define GREEN 0xff00ff00u
+#define BLUE 0xffff0000u
+
+#define POISON 0x7f7f7f7fu
+
+raster_triangle_t make_triangle(real32_t x0, real32_t y0, real32_t x1, real32_t y1, real32_t x2, real32_t y2, real32_t z, uint32_t color)
+{
+    raster_triangle_t triangle;
+    raster_vertex_t v0 = { x0, y0, z };
+    raster_vertex_t v1 = { x1, y1, z };
+    raster_vertex_t v2 = { x2, y2, z };
+    bool visible = raster_setup_triangle(&triangle, v0, v1, v2, color, WIDTH, HEIGHT);
+    TEST_CHECK(visible);
+    return triangle;
+}
+
+uint32_t color_at(const cpu_framebuffer_t *framebuffer, uint32_t x, uint32_t y)
+{
+    uint32_t row[WIDTH];
+    cpu_framebuffer_read_color(framebuffer, y, 1, row, WIDTH);
+    return row[x];
+}
+
+real32_t depth_at(const cpu_framebuffer_t *framebuffer, uint32_t x, uint32_t y)
+{
+    real32_t row[WIDTH];
+    cpu_framebuffer_read_depth(framebuffer, y, 1, row, WIDTH);
+    return row[x];
+}
+
+// A clear touches no pixel memory and a draw inside one tile only that
+// tile's; readback fills in the rest. A triangle behind a tile's depth
+// bounds is rejected without touching the tile, cleared or drawn.
+int main()
+{
+    job_pool_t *pool = job_pool_create(2);
+    cpu_framebuffer_t framebuffer;
+    cpu_framebuffer_create(&framebuffer, WIDTH, HEIGHT);
+    uint32_t tile_count = framebuffer.tiles_x * framebuffer.tiles_y;
+    TEST_CHECK(framebuffer.tiles_x == 3 && framebuffer.tiles_y == 2);
+
+    memset(framebuffer.color, 0x7f, (size_t)tile_count * CPU_FRAMEBUFFER_TILE_PIXELS * sizeof(uint32_t));
+    cpu_framebuffer_clear(&framebuffer, GREY, 1.0f);
+    raster_triangle_t small = make_triangle(2.0f, 2.0f, 20.0f, 2.0f, 2.0f, 20.0f, 0.5f, RED);
+    cpu_framebuffer_draw(&framebuffer, pool, &small, 1);
+
+    TEST_CHECK(!framebuffer.tiles[0].cleared);
+    for (uint32_t t = 1; t < tile_count; ++t)
+    {
+        const uint32_t *color = framebuffer.color + (size_t)t * CPU_FRAMEBUFFER_TILE_PIXELS;
+        TEST_CHECK(framebuffer.tiles[t].cleared);
+        TEST_CHECK(color[0] == POISON && color[CPU_FRAMEBUFFER_TILE_PIXELS - 1] == POISON);
+    }
+    TEST_CHECK(color_at(&framebuffer, 3, 3) == RED && depth_at(&framebuffer, 3, 3) == 0.5f);
+    TEST_CHECK(color_at(&framebuffer, 25, 25) == GREY && depth_at(&framebuffer, 25, 25) == 1.0f);
+    TEST_CHECK(color_at(&framebuffer, 60, 30) == GREY);
+    TEST_CHECK(color_at(&framebuffer, WIDTH - 1, HEIGHT - 1) == GREY && depth_at(&framebuffer, WIDTH - 1, HEIGHT - 1) == 1.0f);
+    TEST_CHECK(framebuffer.tiles[0].min_depth == 0.5f && framebuffer.tiles[0].max_depth == 1.0f);
+
+    // Behind the clear depth: the tile is never written and stays cleared.
+    cpu_framebuffer_clear(&framebuffer, BLACK, 0.3f);
+    raster_triangle_t behind = make_triangle(40.0f, 2.0f, 60.0f, 2.0f, 40.0f, 20.0f, 0.6f, GREEN);
+    cpu_framebuffer_draw(&framebuffer, pool, &behind, 1);
+    TEST_CHECK(framebuffer.tiles[1].cleared);
+    TEST_CHECK(color_at(&framebuffer, 41, 3) == BLACK && depth_at(&framebuffer, 41, 3) == 0.3f);
+
+    // A triangle covering tile 0 bounds its depth, after which one behind it
+    // is rejected for the whole tile: even a pixel whose stored depth says it
+    // would pass keeps its colour.
+    cpu_framebuffer_clear(&framebuffer, GREY, 1.0f);
+    raster_triangle_t cover = make_triangle(-1.0f, -1.0f, 70.0f, -1.0f, -1.0f, 70.0f, 0.2f, BLUE);
+    cpu_framebuffer_draw(&framebuffer, pool, &cover, 1);
+    TEST_CHECK(framebuffer.tiles[0].max_depth == 0.2f);
+    TEST_CHECK(color_at(&framebuffer, 31, 31) == BLUE);
+    framebuffer.depth[5 * RASTER_TILE_SIZE + 5] = 1.0f;
+    raster_triangle_t hidden = make_triangle(2.0f, 2.0f, 20.0f, 2.0f, 2.0f, 20.0f, 0.5f, GREEN);
+    cpu_framebuffer_draw(&framebuffer, pool, &hidden, 1);
+    TEST_CHECK(color_at(&framebuffer, 5, 5) == BLUE);
+    TEST_CHECK(framebuffer.tiles[0].min_depth == 0.2f);
+
+    cpu_framebuffer_destroy(&framebuffer);
+    job_pool_destroy(pool);
+    return test_result("framebuffer_test");
+}
@@ -0,0 +1,150 @@
+#include "opengl.h"
+#include "gl_state.h"
+#include "geometry_pool.h"
+#include "tests/test.h"
+
+bool has_range(const geometry_free_list_t *list, uint32_t index, uint32_t offset, uint32_t size)
+{
+    return index < list->count && list->ranges[index].offset == offset && list->ranges[index].size == size;
+}
+
+void test_free_list()
+{
+    geometry_free_list_t list;
+    geometry_free_list_init(&list, 100);
+
+    uint32_t a = geometry_free_list_allocate(&list, 10);
+    uint32_t b = geometry_free_list_allocate(&list, 20);
+    uint32_t c = geometry_free_list_allocate(&list, 10);
+    uint32_t d = geometry_free_list_allocate(&list, 30);
+    TEST_CHECK(a == 0 && b == 10 && c == 30 && d == 40);
+    TEST_CHECK(list.used == 70 && has_range(&list, 0, 70, 30));
+
+    // Holes at 0 and 30 that touch nothing free.
+    geometry_free_list_release(&list, a, 10);
+    geometry_free_list_release(&list, c, 10);
+    TEST_CHECK(list.count == 3 && has_range(&list, 0, 0, 10) && has_range(&list, 1, 30, 10) && has_range(&list, 2, 70, 30));
+
+    // Best fit: 8 goes into the first 10-hole, split from its start, 25 skips
+    // both holes for the tail.
+    TEST_CHECK(geometry_free_list_allocate(&list, 8) == 0);
+    TEST_CHECK(has_range(&list, 0, 8, 2));
+    TEST_CHECK(geometry_free_list_allocate(&list, 25) == 70);
+    TEST_CHECK(has_range(&list, 2, 95, 5));
+    TEST_CHECK(geometry_free_list_allocate(&list, 10) == 30);
+    TEST_CHECK(list.count == 2 && has_range(&list, 0, 8, 2) && has_range(&list, 1, 95, 5));
+
+    // Releases merge with the previous range, the next one, and both.
+    geometry_free_list_release(&list, 0, 8);
+    TEST_CHECK(list.count == 2 && has_range(&list, 0, 0, 10));
+    geometry_free_list_release(&list, 70, 25);
+    TEST_CHECK(list.count == 2 && has_range(&list, 1, 70, 30));
+    geometry_free_list_release(&list, 30, 10);
+    geometry_free_list_release(&list, d, 30);
+    TEST_CHECK(list.count == 2 && has_range(&list, 0, 0, 10) && has_range(&list, 1, 30, 70));
+    geometry_free_list_release(&list, b, 20);
+    TEST_CHECK(list.count == 1 && has_range(&list, 0, 0, 100) && list.used == 0);
+
+    // Empty allocations neither need nor take space.
+    TEST_CHECK(geometry_free_list_allocate(&list, 100) == 0);
+    TEST_CHECK(list.count == 0);
+    TEST_CHECK(geometry_free_list_allocate(&list, 0) == 0);
+    TEST_CHECK(list.count == 0 && list.used == 100);
+    TEST_CHECK(geometry_free_list_allocate(&list, 1) == GEOMETRY_NO_SPACE);
+    geometry_free_list_release(&list, 0, 0);
+    TEST_CHECK(list.count == 0 && list.used == 100);
+
+    free(list.ranges);
+}
+
+void add_mesh(geometry_pool_t *pool, uint32_t *handle, uint32_t id, uint32_t vertex_count, uint32_t index_count)
+{
+    float vertices[16];
+    uint16_t indices[24];
+    for (uint32_t i = 0; i < vertex_count; ++i)
+    {
+        vertices[i] = (float)(id * 100 + i);
+    }
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        indices[i] = (uint16_t)(id * 100 + i);
+    }
+    *handle = geometry_pool_add(pool, vertices, vertex_count, indices, index_count);
+}
+
+// The mesh's data at its current offsets is still what add_mesh() wrote.
+bool mesh_intact(const geometry_pool_t *pool, uint32_t handle, uint32_t id)
+{
+    const geometry_mesh_t *mesh = geometry_pool_mesh(pool, handle);
+    bool intact = true;
+
+    gl_state_bind_buffer(GL_COPY_READ_BUFFER, pool->vertex_buffer);
+    const float *vertices = (const float *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, pool->vertices.capacity * sizeof(float), GL_MAP_READ_BIT);
+    for (uint32_t i = 0; i < mesh->vertex_count; ++i)
+    {
+        intact = intact && vertices[mesh->vertex_offset + i] == (float)(id * 100 + i);
+    }
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    gl_state_bind_buffer(GL_COPY_READ_BUFFER, pool->index_buffer);
+    const uint16_t *indices = (const uint16_t *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, pool->indices.capacity * sizeof(uint16_t), GL_MAP_READ_BIT);
+    for (uint32_t i = 0; i < mesh->index_count; ++i)
+    {
+        intact = intact && indices[mesh->index_offset + i] == (uint16_t)(id * 100 + i);
+    }
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    return intact;
+}
+
+void test_compact()
+{
+    geometry_layout_t layout = {};
+    layout.stride = sizeof(float);
+    layout.attribute_count = 1;
+    layout.attributes[0] = { 0, 1, GL_FLOAT, false, false, 0 };
+    geometry_pool_t *pool = geometry_pool_create(&layout, 16, 24, GL_UNSIGNED_SHORT);
+
+    uint32_t handles[5];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        add_mesh(pool, &handles[i], i, 4, 6);
+    }
+    geometry_pool_remove(pool, handles[0]);
+    geometry_pool_remove(pool, handles[2]);
+    TEST_CHECK(pool->stats.vertex_fragments == 2 && pool->stats.compactions == 0);
+
+    // 8 vertices fit only once the two holes of 4 are packed together.
+    add_mesh(pool, &handles[4], 4, 8, 12);
+    TEST_CHECK(handles[4] != GEOMETRY_NO_MESH);
+    TEST_CHECK(pool->stats.compactions == 1 && pool->stats.meshes == 3);
+    TEST_CHECK(geometry_pool_mesh(pool, handles[1])->vertex_offset == 0);
+    TEST_CHECK(geometry_pool_mesh(pool, handles[3])->vertex_offset == 4);
+    TEST_CHECK(geometry_pool_mesh(pool, handles[4])->vertex_offset == 8);
+    TEST_CHECK(mesh_intact(pool, handles[1], 1));
+    TEST_CHECK(mesh_intact(pool, handles[3], 3));
+    TEST_CHECK(mesh_intact(pool, handles[4], 4));
+
+    // The pool is full: an empty mesh still fits, anything else does not.
+    uint32_t empty;
+    add_mesh(pool, &empty, 5, 0, 0);
+    TEST_CHECK(empty != GEOMETRY_NO_MESH && pool->stats.compactions == 1);
+    uint32_t full;
+    add_mesh(pool, &full, 6, 1, 1);
+    TEST_CHECK(full == GEOMETRY_NO_MESH);
+    geometry_pool_remove(pool, empty);
+    TEST_CHECK(pool->vertices.used == 16 && pool->indices.used == 24);
+
+    geometry_pool_destroy(pool);
+}
+
+// Best fit, splitting, coalescing and empty allocations on the free list
+// alone, then a pool that has to compact to fit a mesh.
+int main()
+{
+    test_free_list();
+
+    render_context_t *context = create_render_context(8, 8);
+    test_compact();
+    destroy_render_context(context);
+    return test_result("geometry_pool_test");
+}
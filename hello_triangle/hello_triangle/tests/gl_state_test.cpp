@@ -0,0 +1,60 @@
+#include "opengl.h"
+#include "gl_state.h"
+#include "tests/test.h"
+
+// The first set of every value reaches GL, even one that matches what a
+// zeroed cache would hold, a repeated set is skipped, and switching contexts
+// starts the cache over.
+int main()
+{
+    render_context_t *context = create_render_context(8, 8);
+
+    gl_state_reset_stats();
+    gl_state_set_depth_write(false);
+    gl_state_set_color_mask(0);
+    gl_state_set_stencil_write_mask(0);
+    gl_state_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    TEST_CHECK(gl_state.stats.issued == 4 && gl_state.stats.skipped == 0);
+
+    GLboolean depth_write = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_write);
+    TEST_CHECK(depth_write == GL_FALSE);
+
+    GLboolean color_mask[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+    glGetBooleanv(GL_COLOR_WRITEMASK, color_mask);
+    TEST_CHECK(!color_mask[0] && !color_mask[1] && !color_mask[2] && !color_mask[3]);
+
+    GLint stencil_write_mask = -1;
+    glGetIntegerv(GL_STENCIL_WRITEMASK, &stencil_write_mask);
+    TEST_CHECK(stencil_write_mask == 0);
+
+    GLint framebuffer = -1;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    TEST_CHECK(framebuffer == 0);
+
+    gl_state_set_depth_write(false);
+    gl_state_set_color_mask(0);
+    gl_state_set_stencil_write_mask(0);
+    gl_state_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    TEST_CHECK(gl_state.stats.issued == 4 && gl_state.stats.skipped == 4);
+
+    // A second context starts with depth writes and all colors on; switching
+    // to it has to make the cache forget they are off in the first.
+    render_context_t *other = create_render_context(8, 8);
+    gl_state_set_depth_write(false);
+    depth_write = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_write);
+    TEST_CHECK(depth_write == GL_FALSE);
+
+    make_render_context_current(context);
+    gl_state_set_color_mask(0);
+    make_render_context_current(other);
+    gl_state_set_color_mask(0);
+    glGetBooleanv(GL_COLOR_WRITEMASK, color_mask);
+    TEST_CHECK(!color_mask[0] && !color_mask[1] && !color_mask[2] && !color_mask[3]);
+
+    destroy_render_context(other);
+    make_render_context_current(context);
+    destroy_render_context(context);
+    return test_result("gl_state_test");
+}
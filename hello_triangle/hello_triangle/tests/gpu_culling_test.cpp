@@ -0,0 +1,205 @@
+#include <string.h>
+#include "opengl.h"
+#include "gl_state.h"
+#include "gpu_culling.h"
+#include "tests/test.h"
+
+#define MESH_COUNT 4
+#define INSTANCE_COUNT 256
+
+// Width and height of the depth texture, floor-halved to 67, 33, 16, ...
+#define HIZ_SIZE 135
+
+void read_buffer(uint32_t buffer, uint32_t size, void *data)
+{
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    memcpy(data, glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, GL_MAP_READ_BIT), size);
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+}
+
+// Frustum test of the cull pass on the CPU. Returns -1 for spheres too close
+// to a plane for the GPU's rounding to agree.
+int32_t frustum_reference(const vector4_t planes[6], const vector4_t &sphere)
+{
+    int32_t visible = 1;
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        real32_t distance = planes[i].x * sphere.x + planes[i].y * sphere.y + planes[i].z * sphere.z + planes[i].w + sphere.w;
+        if (fabsf(distance) < 1e-3f)
+        {
+            return -1;
+        }
+        if (distance < 0.0f)
+        {
+            visible = 0;
+        }
+    }
+    return visible;
+}
+
+// Sphere covering the texels [x0, x1] of the depth texture in x under an
+// identity view-projection.
+vector4_t hiz_sphere(real32_t x0, real32_t x1, real32_t y, real32_t z)
+{
+    real32_t radius = (x1 - x0) / HIZ_SIZE;
+    return vector4_t((x0 + x1) / HIZ_SIZE - 1.0f, y, z, radius);
+}
+
+void set_instances(gpu_culling_t *culling, const vector4_t *spheres, const uint32_t *meshes, uint32_t count)
+{
+    static instance_t instances[INSTANCE_COUNT];
+    static gpu_cull_bounds_t bounds[INSTANCE_COUNT];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        instances[i] = {};
+        instances[i].transform = identity();
+        instances[i].color = vector4_t((real32_t)i, 0.0f, 0.0f, 1.0f);
+        bounds[i] = {};
+        bounds[i].sphere = spheres[i];
+        bounds[i].mesh = meshes[i];
+    }
+    gpu_culling_set_instances(culling, instances, bounds, count);
+}
+
+// Reset, cull and compact on scattered spheres against the frustum on the
+// CPU, then Hi-Z culling behind an occluder with an odd-sized pyramid, where
+// an object only visible through a one texel gap must survive on levels that
+// floor-halving shrank.
+int main()
+{
+    render_context_t *context = create_render_context(8, 8);
+    gpu_culling_t *culling = gpu_culling_create(MESH_COUNT, INSTANCE_COUNT);
+
+    gpu_cull_mesh_t meshes[MESH_COUNT];
+    for (uint32_t i = 0; i < MESH_COUNT; ++i)
+    {
+        meshes[i] = { 36, i * 36, 0, INSTANCE_COUNT / MESH_COUNT };
+    }
+    gpu_culling_set_meshes(culling, meshes, MESH_COUNT);
+
+    vector4_t spheres[INSTANCE_COUNT];
+    uint32_t mesh_of[INSTANCE_COUNT];
+    uint32_t seed = 12345;
+    uint32_t count = 0;
+    matrix4_t view_projection = perspective(1.0f, 1.5f, 0.5f, 50.0f) * look_at(vector3_t(0.0f, 2.0f, 10.0f), vector3_t(0.0f, 0.0f, 0.0f), vector3_t(0.0f, 1.0f, 0.0f));
+    vector4_t planes[6];
+    gpu_culling_frustum_planes(view_projection, planes);
+    int32_t expected[INSTANCE_COUNT];
+    uint32_t expected_count[MESH_COUNT] = {};
+    while (count < INSTANCE_COUNT)
+    {
+        real32_t coordinates[4];
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            coordinates[i] = (real32_t)(seed >> 8) / (real32_t)(1u << 24);
+        }
+        vector4_t sphere(coordinates[0] * 40.0f - 20.0f, coordinates[1] * 20.0f - 10.0f, coordinates[2] * 60.0f - 45.0f, coordinates[3] + 0.1f);
+        int32_t visible = frustum_reference(planes, sphere);
+        if (visible < 0)
+        {
+            continue;
+        }
+        spheres[count] = sphere;
+        mesh_of[count] = count % MESH_COUNT;
+        expected[count] = visible;
+        expected_count[mesh_of[count]] += (uint32_t)visible;
+        ++count;
+    }
+    set_instances(culling, spheres, mesh_of, count);
+    gpu_culling_run(culling, view_projection, false);
+
+    draw_elements_indirect_t commands[MESH_COUNT];
+    read_buffer(culling->command_buffer, sizeof(commands), commands);
+    uint32_t expected_draws = 0;
+    for (uint32_t i = 0; i < MESH_COUNT; ++i)
+    {
+        TEST_CHECK(commands[i].instance_count == expected_count[i]);
+        TEST_CHECK(commands[i].first_index == i * 36);
+        TEST_CHECK(commands[i].base_instance == i * (INSTANCE_COUNT / MESH_COUNT));
+        expected_draws += expected_count[i] ? 1 : 0;
+    }
+    TEST_CHECK(expected_draws > 0 && expected_draws <= MESH_COUNT);
+
+    uint32_t draw_count = 0;
+    read_buffer(culling->count_buffer, sizeof(draw_count), &draw_count);
+    TEST_CHECK(draw_count == expected_draws);
+    draw_elements_indirect_t compacted[MESH_COUNT];
+    read_buffer(culling->compacted_buffer, sizeof(compacted), compacted);
+    for (uint32_t i = 0; i < draw_count && i < MESH_COUNT; ++i)
+    {
+        uint32_t mesh = compacted[i].first_index / 36;
+        TEST_CHECK(mesh < MESH_COUNT && compacted[i].instance_count == expected_count[mesh]);
+    }
+
+    static instance_t visible[INSTANCE_COUNT];
+    read_buffer(culling->visible_buffer, sizeof(visible), visible);
+    uint32_t seen[INSTANCE_COUNT] = {};
+    for (uint32_t mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        for (uint32_t slot = 0; slot < expected_count[mesh]; ++slot)
+        {
+            uint32_t index = (uint32_t)visible[mesh * (INSTANCE_COUNT / MESH_COUNT) + slot].color.x;
+            TEST_CHECK(index < count && expected[index] && mesh_of[index] == mesh);
+            if (index < count)
+            {
+                ++seen[index];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        TEST_CHECK(seen[i] == (uint32_t)expected[i]);
+    }
+
+    // Occluder at depth 0.25 everywhere but texel column 68, which sees the
+    // far plane.
+    static real32_t depth[HIZ_SIZE * HIZ_SIZE];
+    for (uint32_t y = 0; y < HIZ_SIZE; ++y)
+    {
+        for (uint32_t x = 0; x < HIZ_SIZE; ++x)
+        {
+            depth[y * HIZ_SIZE + x] = x == 68 ? 1.0f : 0.25f;
+        }
+    }
+    GLuint depth_texture;
+    glGenTextures(1, &depth_texture);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, depth_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, HIZ_SIZE, HIZ_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
+    gpu_culling_build_hiz(culling, depth_texture, HIZ_SIZE, HIZ_SIZE);
+    TEST_CHECK(culling->hiz_levels == 8);
+
+    // One instance per mesh: behind the occluder, in front of it, and two
+    // behind it but over the gap, spanning 1.5 and 3 texels so they are
+    // tested on level 1 (67 wide) and level 2 (33 wide).
+    vector4_t hiz_spheres[MESH_COUNT] =
+    {
+        vector4_t(-0.5f, -0.5f, 0.0f, 0.1f),
+        vector4_t(-0.5f, 0.5f, -0.8f, 0.1f),
+        hiz_sphere(66.8f, 68.3f, 0.2f, 0.0f),
+        hiz_sphere(66.2f, 69.2f, -0.2f, 0.0f),
+    };
+    uint32_t hiz_meshes[MESH_COUNT] = { 0, 1, 2, 3 };
+    set_instances(culling, hiz_spheres, hiz_meshes, MESH_COUNT);
+    gpu_culling_run(culling, identity(), true);
+    read_buffer(culling->command_buffer, sizeof(commands), commands);
+    TEST_CHECK(commands[0].instance_count == 0);
+    TEST_CHECK(commands[1].instance_count == 1);
+    TEST_CHECK(commands[2].instance_count == 1);
+    TEST_CHECK(commands[3].instance_count == 1);
+    read_buffer(culling->count_buffer, sizeof(draw_count), &draw_count);
+    TEST_CHECK(draw_count == 3);
+
+    // Without the Hi-Z test everything inside the frustum stays.
+    gpu_culling_run(culling, identity(), false);
+    read_buffer(culling->command_buffer, sizeof(commands), commands);
+    TEST_CHECK(commands[0].instance_count == 1);
+
+    gl_state_delete_texture(depth_texture);
+    gpu_culling_destroy(culling);
+    destroy_render_context(context);
+    return test_result("gpu_culling_test");
+}
@@ -0,0 +1,469 @@
+#include "image_output.h"
+#include "tests/test.h"
+
+// Readers written from the format specs rather than from image_output.h, so
+// an encoder bug is not mirrored by the decoder. The PNG reader only inflates
+// stored and fixed-Huffman blocks, which is all the encoder writes.
+
+uint8_t *read_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(*size + 1);
+    *size = fread(data, 1, *size, file);
+    fclose(file);
+    return data;
+}
+
+inline uint32_t get_u32_be(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+inline uint32_t make_pixel(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+    return (a & 0xff) << 24 | (b & 0xff) << 16 | (g & 0xff) << 8 | (r & 0xff);
+}
+
+bool decode_ppm(const uint8_t *data, size_t size, uint32_t width, uint32_t height, uint32_t *pixels)
+{
+    char header[32];
+    int length = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+    if (size != length + (size_t)width * height * 3 || memcmp(data, header, length) != 0)
+    {
+        return false;
+    }
+    const uint8_t *p = data + length;
+    for (size_t i = 0; i < (size_t)width * height; ++i, p += 3)
+    {
+        pixels[i] = make_pixel(p[0], p[1], p[2], 0xff);
+    }
+    return true;
+}
+
+bool decode_qoi(const uint8_t *data, size_t size, uint32_t width, uint32_t height, uint32_t *pixels)
+{
+    static const uint8_t end_marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    if (size < 22 || memcmp(data, "qoif", 4) != 0 || get_u32_be(data + 4) != width || get_u32_be(data + 8) != height ||
+        memcmp(data + size - 8, end_marker, 8) != 0)
+    {
+        return false;
+    }
+
+    uint32_t index[64] = {};
+    uint32_t r = 0, g = 0, b = 0, a = 0xff;
+    const uint8_t *p = data + 14;
+    const uint8_t *end = data + size - 8;
+    size_t count = (size_t)width * height;
+    size_t i = 0;
+    while (i < count && p < end)
+    {
+        uint8_t op = *p++;
+        uint32_t run = 1;
+        if (op == 0xfe)
+        {
+            r = p[0]; g = p[1]; b = p[2];
+            p += 3;
+        }
+        else if (op == 0xff)
+        {
+            r = p[0]; g = p[1]; b = p[2]; a = p[3];
+            p += 4;
+        }
+        else if ((op & 0xc0) == 0x00)
+        {
+            uint32_t pixel = index[op];
+            r = pixel & 0xff; g = (pixel >> 8) & 0xff; b = (pixel >> 16) & 0xff; a = pixel >> 24;
+        }
+        else if ((op & 0xc0) == 0x40)
+        {
+            r += ((op >> 4) & 3) - 2;
+            g += ((op >> 2) & 3) - 2;
+            b += (op & 3) - 2;
+        }
+        else if ((op & 0xc0) == 0x80)
+        {
+            int32_t dg = (int32_t)(op & 0x3f) - 32;
+            r += dg + (int32_t)(*p >> 4) - 8;
+            g += dg;
+            b += dg + (int32_t)(*p & 0x0f) - 8;
+            ++p;
+        }
+        else
+        {
+            run = (op & 0x3f) + 1;
+        }
+
+        uint32_t pixel = make_pixel(r, g, b, a);
+        r &= 0xff; g &= 0xff; b &= 0xff;
+        index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = pixel;
+        for (; run && i < count; --run)
+        {
+            pixels[i++] = pixel;
+        }
+    }
+    return i == count && p == end;
+}
+
+struct bit_reader_t
+{
+    const uint8_t *data;
+    size_t size;
+    size_t bit;
+};
+
+uint32_t read_bits(bit_reader_t *reader, uint32_t count)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; ++i, ++reader->bit)
+    {
+        if (reader->bit / 8 < reader->size)
+        {
+            value |= (uint32_t)((reader->data[reader->bit / 8] >> (reader->bit % 8)) & 1) << i;
+        }
+    }
+    return value;
+}
+
+// Huffman codes are packed starting from their most significant bit.
+uint32_t read_code(bit_reader_t *reader, uint32_t code, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        code = code << 1 | read_bits(reader, 1);
+    }
+    return code;
+}
+
+uint32_t read_fixed_literal(bit_reader_t *reader)
+{
+    uint32_t code = read_code(reader, 0, 7);
+    if (code <= 0x17)
+    {
+        return 256 + code;
+    }
+    code = read_code(reader, code, 1);
+    if (code >= 0x30 && code <= 0xbf)
+    {
+        return code - 0x30;
+    }
+    if (code >= 0xc0 && code <= 0xc7)
+    {
+        return 280 + code - 0xc0;
+    }
+    return 144 + read_code(reader, code, 1) - 0x190;
+}
+
+bool inflate(const uint8_t *data, size_t size, uint8_t *out, size_t out_size, size_t *out_length)
+{
+    static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+    bit_reader_t reader = { data, size, 0 };
+    size_t n = 0;
+    bool final = false;
+    while (!final)
+    {
+        if (reader.bit > size * 8)
+        {
+            return false;
+        }
+        final = read_bits(&reader, 1) != 0;
+        uint32_t type = read_bits(&reader, 2);
+        if (type == 0)
+        {
+            reader.bit = (reader.bit + 7) & ~(size_t)7;
+            uint32_t length = read_bits(&reader, 16);
+            if ((read_bits(&reader, 16) ^ 0xffff) != length || reader.bit / 8 + length > size || n + length > out_size)
+            {
+                return false;
+            }
+            memcpy(out + n, data + reader.bit / 8, length);
+            reader.bit += length * 8;
+            n += length;
+        }
+        else if (type == 1)
+        {
+            for (;;)
+            {
+                uint32_t symbol = read_fixed_literal(&reader);
+                if (symbol < 256)
+                {
+                    if (n == out_size)
+                    {
+                        return false;
+                    }
+                    out[n++] = (uint8_t)symbol;
+                    continue;
+                }
+                if (symbol == 256)
+                {
+                    break;
+                }
+                if (symbol > 285)
+                {
+                    return false;
+                }
+                symbol -= 257;
+                uint32_t length = length_base[symbol];
+                if (symbol >= 8 && symbol < 28)
+                {
+                    length += read_bits(&reader, (symbol - 4) / 4);
+                }
+                uint32_t distance_symbol = read_code(&reader, 0, 5);
+                if (distance_symbol >= 30)
+                {
+                    return false;
+                }
+                uint32_t distance = distance_base[distance_symbol];
+                if (distance_symbol >= 4)
+                {
+                    distance += read_bits(&reader, (distance_symbol - 2) / 2);
+                }
+                if (distance > n || n + length > out_size)
+                {
+                    return false;
+                }
+                for (uint32_t i = 0; i < length; ++i, ++n)
+                {
+                    out[n] = out[n - distance];
+                }
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    *out_length = n;
+    return reader.bit <= size * 8;
+}
+
+uint32_t reference_crc32(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc ^= data[i];
+        for (uint32_t k = 0; k < 8; ++k)
+        {
+            crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return crc ^ 0xffffffffu;
+}
+
+uint32_t reference_adler32(const uint8_t *data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+uint8_t unfilter_paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int32_t p = (int32_t)a + b - c;
+    int32_t pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+
+bool decode_png(const uint8_t *data, size_t size, uint32_t width, uint32_t height, uint32_t *pixels)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (size < 8 || memcmp(data, signature, 8) != 0)
+    {
+        return false;
+    }
+
+    uint8_t *compressed = (uint8_t *)malloc(size);
+    size_t compressed_size = 0;
+    bool header = false, end = false;
+    size_t p = 8;
+    while (!end && p + 12 <= size)
+    {
+        uint32_t length = get_u32_be(data + p);
+        const uint8_t *type = data + p + 4;
+        const uint8_t *chunk = data + p + 8;
+        if (p + 12 + length > size || get_u32_be(chunk + length) != reference_crc32(type, length + 4))
+        {
+            break;
+        }
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            static const uint8_t format[5] = { 8, 6, 0, 0, 0 };
+            header = length == 13 && get_u32_be(chunk) == width && get_u32_be(chunk + 4) == height && memcmp(chunk + 8, format, 5) == 0;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            memcpy(compressed + compressed_size, chunk, length);
+            compressed_size += length;
+        }
+        end = memcmp(type, "IEND", 4) == 0;
+        p += 12 + length;
+    }
+
+    size_t row_bytes = (size_t)width * 4;
+    size_t filtered_size = height * (row_bytes + 1);
+    uint8_t *filtered = (uint8_t *)malloc(filtered_size);
+    size_t inflated = 0;
+    bool ok = header && end && p == size && compressed_size >= 6 &&
+        (compressed[0] & 0x0f) == 8 && (compressed[0] << 8 | compressed[1]) % 31 == 0 && !(compressed[1] & 0x20) &&
+        inflate(compressed + 2, compressed_size - 6, filtered, filtered_size, &inflated) && inflated == filtered_size &&
+        get_u32_be(compressed + compressed_size - 4) == reference_adler32(filtered, filtered_size);
+
+    uint8_t *image = (uint8_t *)pixels;
+    for (uint32_t y = 0; ok && y < height; ++y)
+    {
+        const uint8_t *in = filtered + y * (row_bytes + 1);
+        uint8_t *row = image + y * row_bytes;
+        const uint8_t *above = y > 0 ? row - row_bytes : 0;
+        ok = in[0] <= 4;
+        for (size_t i = 0; ok && i < row_bytes; ++i)
+        {
+            uint8_t left = i >= 4 ? row[i - 4] : 0;
+            uint8_t up = above ? above[i] : 0;
+            uint8_t up_left = above && i >= 4 ? above[i - 4] : 0;
+            uint8_t prediction = 0;
+            switch (in[0])
+            {
+            case 1: prediction = left; break;
+            case 2: prediction = up; break;
+            case 3: prediction = (uint8_t)((left + up) / 2); break;
+            case 4: prediction = unfilter_paeth(left, up, up_left); break;
+            }
+            row[i] = (uint8_t)(in[1 + i] + prediction);
+        }
+    }
+
+    free(filtered);
+    free(compressed);
+    return ok;
+}
+
+struct image_size_t
+{
+    uint32_t width;
+    uint32_t height;
+};
+
+// Mixes runs longer than one QOI run op, small and medium steps, a few
+// recurring colours and random colours with changing alpha, so every QOI op
+// and plenty of deflate matches show up.
+void fill_pixels(uint32_t *pixels, uint32_t width, uint32_t height, uint32_t seed)
+{
+    static const uint32_t palette[4] = { 0xff102030u, 0x80ffffffu, 0xff0000ffu, 0x00000000u };
+    uint32_t state = seed;
+    uint32_t previous = 0xff000000u;
+    for (uint32_t i = 0; i < width * height; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        uint32_t random = state >> 8;
+        uint32_t pixel;
+        switch ((state >> 28) % 8)
+        {
+        case 0:
+        case 1: pixel = previous; break;
+        case 2: pixel = (previous & 0xff000000u) | ((previous + 0x010101u) & 0xffffffu); break;
+        case 3: pixel = (previous & 0xff000000u) | ((previous + 0x0c100eu) & 0xffffffu); break;
+        case 4:
+        case 5: pixel = palette[random % 4]; break;
+        case 6: pixel = 0xff000000u | random; break;
+        default: pixel = random * 2654435761u; break;
+        }
+        if ((i / width) % 5 == 4 && (i % width) < 90)
+        {
+            pixel = 0xff405060u;
+        }
+        pixels[i] = pixel;
+        previous = pixel;
+    }
+}
+
+bool matches(const uint32_t *decoded, const uint32_t *expected, uint32_t width, uint32_t height, bool bottom_up, bool opaque)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint32_t *row = expected + (size_t)(bottom_up ? height - 1 - y : y) * width;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t pixel = opaque ? row[x] | 0xff000000u : row[x];
+            if (decoded[(size_t)y * width + x] != pixel)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Frames of odd sizes, bottom up or not, written in every format by several
+// encoding threads so the images are split into stripes, and decoded back.
+int main()
+{
+    const image_size_t sizes[] = { { 1, 1 }, { 7, 5 }, { 13, 3 }, { 101, 67 } };
+    const image_format_t formats[] = { IMAGE_FORMAT_PPM, IMAGE_FORMAT_QOI, IMAGE_FORMAT_PNG };
+    const char *paths[] = { "image_output_test.ppm", "image_output_test.qoi", "image_output_test.png" };
+
+    image_output_t *output = image_output_create(3);
+    uint32_t frames = 0;
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        uint32_t width = sizes[s].width;
+        uint32_t height = sizes[s].height;
+        uint32_t *expected = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+        uint32_t *decoded = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+        fill_pixels(expected, width, height, s + 1);
+
+        for (uint32_t f = 0; f < 3; ++f)
+        {
+            for (uint32_t bottom_up = 0; bottom_up < 2; ++bottom_up)
+            {
+                uint32_t *pixels = image_output_begin_frame(output, width, height, bottom_up != 0);
+                memcpy(pixels, expected, (size_t)width * height * sizeof(uint32_t));
+                image_output_end_frame(output, paths[f], formats[f]);
+                image_output_flush(output);
+                ++frames;
+
+                size_t size = 0;
+                uint8_t *data = read_file(paths[f], &size);
+                TEST_CHECK(data != 0);
+                if (!data)
+                {
+                    continue;
+                }
+                memset(decoded, 0, (size_t)width * height * sizeof(uint32_t));
+                bool decoded_ok =
+                    formats[f] == IMAGE_FORMAT_PPM ? decode_ppm(data, size, width, height, decoded) :
+                    formats[f] == IMAGE_FORMAT_QOI ? decode_qoi(data, size, width, height, decoded) :
+                    decode_png(data, size, width, height, decoded);
+                if (!decoded_ok || !matches(decoded, expected, width, height, bottom_up != 0, formats[f] == IMAGE_FORMAT_PPM))
+                {
+                    fprintf(stderr, "image_output_test: %s at %ux%u%s does not round-trip\n", paths[f], width, height, bottom_up ? ", bottom up" : "");
+                    ++test_failures;
+                }
+                free(data);
+            }
+        }
+
+        free(decoded);
+        free(expected);
+    }
+
+    TEST_CHECK(output->frames_written == frames && output->frames_failed == 0);
+    image_output_destroy(output);
+    for (uint32_t f = 0; f < 3; ++f)
+    {
+        remove(paths[f]);
+    }
+    return test_result("image_output_test");
+}
@@ -0,0 +1,78 @@
+#include "msaa.h"
+#include "tests/test.h"
+
+#define WIDTH 16
+#define HEIGHT 8
+
+#define GREEN 0xff00ff00u
+#define RED 0xff0000ffu
+#define BLUE 0xffff0000u
+#define YELLOW 0xff00ffffu
+
+// One triangle whose only edge inside the target is the vertical one at
+// edge_x; it covers the target right of it, or left of it with a negative
+// reach. Two triangles sharing a diagonal would split the pixels along it.
+void add_half(raster_triangle_t *triangles, uint32_t *count, real32_t edge_x, real32_t reach, real32_t z, uint32_t color)
+{
+    raster_vertex_t a = { edge_x, -40.0f, z };
+    raster_vertex_t b = { edge_x, 48.0f, z };
+    raster_vertex_t c = { edge_x + reach, 4.0f, z };
+    *count += raster_setup_triangle(&triangles[*count], a, b, c, color, WIDTH, HEIGHT);
+}
+
+bool column_is(const uint32_t *pixels, uint32_t x, uint32_t color)
+{
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        if (pixels[y * WIDTH + x] != color)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// An edge through the middle of column 4 covers half the samples of its
+// pixels at 4x and 8x, which resolve to the average of both colours; a
+// surface behind only fills the samples the front one left, and one in front
+// covering the pixels whole collapses them back to a single colour.
+int main()
+{
+    job_pool_t *pool = job_pool_create(2);
+    uint32_t pixels[WIDTH * HEIGHT];
+    raster_triangle_t triangles[3];
+
+    const uint32_t sample_counts[] = { 4, 8 };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        msaa_renderer_t *renderer = msaa_create_renderer(pool, sample_counts[i]);
+        msaa_stats_t stats;
+
+        uint32_t count = 0;
+        add_half(triangles, &count, 4.5f, 100.0f, 0.5f, RED);
+        msaa_render(renderer, triangles, count, GREEN, pixels, WIDTH, HEIGHT, &stats);
+        TEST_CHECK(column_is(pixels, 3, GREEN));
+        TEST_CHECK(column_is(pixels, 4, 0xff008080u));
+        TEST_CHECK(column_is(pixels, 5, RED));
+        TEST_CHECK(column_is(pixels, WIDTH - 1, RED));
+        TEST_CHECK(stats.pixels == WIDTH * HEIGHT && stats.split_pixels == HEIGHT);
+
+        add_half(triangles, &count, -1.0f, 100.0f, 0.8f, BLUE);
+        msaa_render(renderer, triangles, count, GREEN, pixels, WIDTH, HEIGHT, &stats);
+        TEST_CHECK(column_is(pixels, 3, BLUE));
+        TEST_CHECK(column_is(pixels, 4, 0xff800080u));
+        TEST_CHECK(column_is(pixels, 5, RED));
+        TEST_CHECK(stats.split_pixels == HEIGHT);
+
+        add_half(triangles, &count, 5.0f, -100.0f, 0.1f, YELLOW);
+        msaa_render(renderer, triangles, count, GREEN, pixels, WIDTH, HEIGHT, &stats);
+        TEST_CHECK(column_is(pixels, 4, YELLOW));
+        TEST_CHECK(column_is(pixels, 0, YELLOW) && column_is(pixels, 5, RED));
+        TEST_CHECK(stats.split_pixels == 0);
+
+        msaa_destroy_renderer(renderer);
+    }
+
+    job_pool_destroy(pool);
+    return test_result("msaa_test");
+}
@@ -0,0 +1,38 @@
+#include "opengl.h"
+#include "gl_state.h"
+#include "pipeline_state.h"
+#include "tests/test.h"
+
+bool depth_write_enabled()
+{
+    GLboolean depth_write = GL_FALSE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_write);
+    return depth_write == GL_TRUE;
+}
+
+// The first pipeline reaches GL in full, and gl_state_invalidate() makes the
+// next apply start over even for the pipeline that is already current.
+int main()
+{
+    render_context_t *context = create_render_context(8, 8);
+
+    pipeline_state_t desc = pipeline_state_defaults();
+    desc.depth_stencil.depth_write = 0;
+    uint32_t pipeline = pipeline_state_create(&desc);
+
+    pipeline_state_apply(pipeline);
+    TEST_CHECK(!depth_write_enabled());
+    TEST_CHECK(pipeline_state_cursor.stats.applied == 1);
+
+    glDepthMask(GL_TRUE);
+    gl_state_invalidate();
+    pipeline_state_apply(pipeline);
+    TEST_CHECK(!depth_write_enabled());
+    TEST_CHECK(pipeline_state_cursor.stats.applied == 2 && pipeline_state_cursor.stats.skipped == 0);
+
+    pipeline_state_apply(pipeline);
+    TEST_CHECK(pipeline_state_cursor.stats.skipped == 1);
+
+    destroy_render_context(context);
+    return test_result("pipeline_state_test");
+}
@@ -0,0 +1,40 @@
+#include "opengl.h"
+#include "tests/test.h"
+
+// Two render contexts on one thread: each clears its own framebuffer, and
+// switching between them keeps the results apart. Under GL_VALIDATION they
+// are debug contexts.
+int main()
+{
+    render_context_t *first = create_render_context(16, 8);
+    TEST_CHECK(first && current_render_context == first);
+    TEST_CHECK(first->viewport_width == 16 && first->viewport_height == 8);
+#ifdef GL_VALIDATION
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    TEST_CHECK(flags & GL_CONTEXT_FLAG_DEBUG_BIT);
+#endif
+    glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    render_context_t *second = create_render_context(8, 8);
+    TEST_CHECK(current_render_context == second);
+    glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    uint8_t pixel[4] = {};
+    glReadBuffer(second->color_read_buffer);
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    TEST_CHECK(pixel[0] == 0 && pixel[2] == 255);
+
+    TEST_CHECK(make_render_context_current(first));
+    glReadBuffer(first->color_read_buffer);
+    glReadPixels(15, 7, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    TEST_CHECK(pixel[0] == 255 && pixel[2] == 0);
+    TEST_CHECK(is_window_open(first));
+
+    destroy_render_context(second);
+    destroy_render_context(first);
+    TEST_CHECK(current_render_context == NULL);
+    return test_result("platform_test");
+}
@@ -0,0 +1,52 @@
+#include "opengl.h"
+#include "program_cache.h"
+#include "tests/test.h"
+
+#define TEST_PATH "program_cache_test.bin"
+
+// Writes a header claiming four entries followed by the given records, each
+// with size bytes of binary, padded to 8 unless it is the last.
+void write_cache(const program_cache_t *cache, const program_cache_record_t *records, uint32_t record_count)
+{
+    FILE *file = program_cache_open_file(TEST_PATH);
+    assert(file);
+    program_cache_header_t header = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, cache->driver_hash, 4, 0 };
+    fwrite(&header, sizeof(header), 1, file);
+    uint8_t binary[16] = {};
+    for (uint32_t i = 0; i < record_count; ++i)
+    {
+        fwrite(&records[i], sizeof(records[i]), 1, file);
+        uint32_t size = records[i].size < sizeof(binary) ? records[i].size : 0;
+        fwrite(binary, 1, i + 1 < record_count ? (size + 7) & ~7u : size, file);
+    }
+    fclose(file);
+}
+
+// Truncated and corrupt files index the entries that fit and stop there,
+// never reading past the mapping.
+int main()
+{
+    render_context_t *context = create_render_context(8, 8);
+    remove(TEST_PATH);
+    program_cache_t *cache = program_cache_create(TEST_PATH);
+
+    // The last binary is unpadded, so the padding steps past the end.
+    program_cache_record_t truncated[] = { { 1, 0, 3 }, { 2, 0, 1 } };
+    write_cache(cache, truncated, 2);
+    program_cache_load(cache);
+    TEST_CHECK(cache->entry_count == 2);
+    TEST_CHECK(program_cache_find(cache, 2) && program_cache_find(cache, 2)->size == 1);
+    program_cache_clear(cache);
+
+    // A size larger than the file.
+    program_cache_record_t corrupt[] = { { 1, 0, 8 }, { 2, 0, 0xfffffff9u } };
+    write_cache(cache, corrupt, 2);
+    program_cache_load(cache);
+    TEST_CHECK(cache->entry_count == 1);
+    TEST_CHECK(!program_cache_find(cache, 2));
+
+    program_cache_destroy(cache);
+    remove(TEST_PATH);
+    destroy_render_context(context);
+    return test_result("program_cache_test");
+}
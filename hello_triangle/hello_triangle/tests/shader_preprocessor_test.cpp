@@ -0,0 +1,112 @@
+#include "shader_preprocessor.h"
+#include "tests/test.h"
+
+// Include files by name; the source index is the position in the table plus 1,
+// the main file being 0.
+const char *test_files[][2] =
+{
+    { "common.glsl", "#pragma once\nfloat common_value() { return 1.0; }\n" },
+    { "light.glsl", "#include \"common.glsl\"\nfloat light() { return common_value(); }\n" },
+};
+
+const char *test_load(void *user, const char *name, uint32_t *source_index)
+{
+    uint32_t *loads = (uint32_t *)user;
+    for (uint32_t i = 0; i < sizeof(test_files) / sizeof(test_files[0]); ++i)
+    {
+        if (strcmp(test_files[i][0], name) == 0)
+        {
+            ++*loads;
+            *source_index = i + 1;
+            return test_files[i][1];
+        }
+    }
+    return NULL;
+}
+
+uint32_t count_occurrences(const char *text, const char *needle)
+{
+    uint32_t count = 0;
+    for (const char *found = strstr(text, needle); found; found = strstr(found + 1, needle))
+    {
+        ++count;
+    }
+    return count;
+}
+
+const char *test_source =
+    "// needs #version 400 for the light model\n"
+    "#version 330 core\n"
+    "#include \"common.glsl\"\n"
+    "#include \"light.glsl\"\n"
+    "void main() { float f = light(); if (USE_FOG) f = 0.0; }\n";
+
+// Same shader with comments and whitespace changed.
+const char *test_source_reformatted =
+    "// needs #version 400 for the light model\n"
+    "#version 330 core\n"
+    "\n"
+    "#include \"common.glsl\"\n"
+    "   #  include \"light.glsl\"\n"
+    "void main()\t{ float f = light();   /* fog */ if (USE_FOG) f = 0.0; }  \n";
+
+// #version found on its own line below a comment mentioning it, includes
+// expanded once with #line directives back into the including file, features
+// defined only when the shader names them, and a hash that ignores layout.
+int main()
+{
+    shader_features_t features = {};
+    features.names[0] = "USE_FOG";
+    features.names[1] = "USE_SHADOW";
+    features.count = 2;
+
+    shader_preprocessed_t out = {};
+    uint32_t loads = 0;
+    bool preprocessed = shader_preprocess(&out, test_source, 0, "#define QUALITY 2\n", &features, 3, test_load, &loads);
+    TEST_CHECK(preprocessed);
+    const char *text = out.text.data;
+
+    const char *expected_head =
+        "// needs #version 400 for the light model\n"
+        "#version 330 core\n"
+        "#define QUALITY 2\n"
+        "#define USE_FOG 1\n"
+        "#line 3 0\n";
+    TEST_CHECK(strncmp(text, expected_head, strlen(expected_head)) == 0);
+    TEST_CHECK(count_occurrences(text, "#define USE_SHADOW") == 0);
+
+    // common.glsl is pulled in directly and again through light.glsl, but
+    // expanded only the first time.
+    TEST_CHECK(count_occurrences(text, "float common_value()") == 1);
+    TEST_CHECK(count_occurrences(text, "#pragma once") == 0);
+    TEST_CHECK(strstr(text, "#line 1 1\nfloat common_value()") != NULL);
+    TEST_CHECK(strstr(text, "#line 1 2\n#line 1 1\n#line 2 2\nfloat light()") != NULL);
+    TEST_CHECK(strstr(text, "#line 4 0\n#line 1 2\n") != NULL);
+    TEST_CHECK(strstr(text, "#line 5 0\nvoid main()") != NULL);
+    TEST_CHECK(loads == 3);
+    TEST_CHECK(out.include_count == 2 && out.includes[0] == 1 && out.includes[1] == 2);
+
+    // USE_SHADOW is never mentioned, so turning it on changes nothing.
+    uint64_t hash = out.hash;
+    shader_preprocessed_t fog_only = {};
+    TEST_CHECK(shader_preprocess(&fog_only, test_source, 0, "#define QUALITY 2\n", &features, 1, test_load, &loads));
+    TEST_CHECK(strcmp(fog_only.text.data, text) == 0 && fog_only.hash == hash);
+    shader_preprocessed_t no_fog = {};
+    TEST_CHECK(shader_preprocess(&no_fog, test_source, 0, "#define QUALITY 2\n", &features, 2, test_load, &loads));
+    TEST_CHECK(no_fog.hash != hash);
+
+    shader_preprocessed_t reformatted = {};
+    TEST_CHECK(shader_preprocess(&reformatted, test_source_reformatted, 0, "#define QUALITY 2\n", &features, 3, test_load, &loads));
+    TEST_CHECK(strcmp(reformatted.text.data, text) != 0);
+    TEST_CHECK(reformatted.hash == hash);
+
+    shader_preprocessed_t missing = {};
+    TEST_CHECK(!shader_preprocess(&missing, "#version 330\n#include \"missing.glsl\"\n", 0, NULL, NULL, 0, test_load, &loads));
+
+    shader_preprocessed_free(&out);
+    shader_preprocessed_free(&fog_only);
+    shader_preprocessed_free(&no_fog);
+    shader_preprocessed_free(&reformatted);
+    shader_preprocessed_free(&missing);
+    return test_result("shader_preprocessor_test");
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdio.h>
+
+// Checks for the tests, which are plain programs returning nonzero when a
+// check failed.
+
+int test_failures;
+
+#define TEST_CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++test_failures; \
+        } \
+    } while (0)
+
+inline int test_result(const char *name)
+{
+    printf("%s: %s\n", name, test_failures ? "failed" : "passed");
+    return test_failures ? 1 : 0;
+}
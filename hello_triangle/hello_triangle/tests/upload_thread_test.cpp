@@ -0,0 +1,67 @@
+#include <chrono>
+#include "opengl.h"
+#include "gl_state.h"
+#include "upload_thread.h"
+#include "tests/test.h"
+
+// Polls until nothing is pending, or gives up after a few seconds.
+bool wait_for_uploads(upload_thread_t *thread)
+{
+    for (uint32_t i = 0; i < 5000 && upload_thread_pending(thread); ++i)
+    {
+        upload_thread_poll(thread);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return !upload_thread_pending(thread);
+}
+
+// Taken and released handles are reused, so a steady stream of uploads keeps
+// the request array small, and failed or unwanted results can be let go.
+int main()
+{
+    render_context_t *context = create_render_context(8, 8);
+    upload_thread_t *thread = upload_thread_create();
+
+    uint32_t data[16] = {};
+    uint32_t first = upload_thread_submit_buffer(thread, data, sizeof(data), GL_STATIC_DRAW);
+    TEST_CHECK(wait_for_uploads(thread));
+    TEST_CHECK(upload_thread_status(thread, first) == UPLOAD_READY);
+    uint32_t buffer = upload_thread_take(thread, first);
+    TEST_CHECK(buffer != 0);
+    gl_state_delete_buffer(buffer);
+
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        uint32_t handle = upload_thread_submit_buffer(thread, data, sizeof(data), GL_STATIC_DRAW);
+        TEST_CHECK(wait_for_uploads(thread));
+        if (i & 1)
+        {
+            gl_state_delete_buffer(upload_thread_take(thread, handle));
+        }
+        else
+        {
+            upload_thread_release(thread, handle);
+        }
+    }
+    TEST_CHECK(thread->request_count == 1);
+
+    // Released while still pending, then deleted by the poll.
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        upload_thread_release(thread, upload_thread_submit_buffer(thread, data, sizeof(data), GL_STATIC_DRAW));
+    }
+    TEST_CHECK(wait_for_uploads(thread));
+    TEST_CHECK(thread->free_count == thread->request_count);
+
+    program_stage_t stage = { GL_VERTEX_SHADER, "not glsl" };
+    uint32_t failed = upload_thread_submit_program(thread, &stage, 1);
+    TEST_CHECK(wait_for_uploads(thread));
+    TEST_CHECK(upload_thread_status(thread, failed) == UPLOAD_FAILED);
+    TEST_CHECK(upload_thread_object(thread, failed) == 0);
+    upload_thread_release(thread, failed);
+    TEST_CHECK(thread->free_count == thread->request_count);
+
+    upload_thread_destroy(thread);
+    destroy_render_context(context);
+    return test_result("upload_thread_test");
+}
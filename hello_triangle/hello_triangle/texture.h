@@ -0,0 +1,370 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "simd.h"
+
+// CPU texture with its whole mip chain in one allocation. Texels are RGBA8
+// (R in the low byte, same as GL_RGBA/GL_UNSIGNED_BYTE) stored either in 4x4
+// tiles or along a Morton curve, so a 2x2 bilinear footprint almost always sits
+// in one cache line no matter how the surface is rotated on screen.
+
+#define TEXTURE_MAX_MIPS 16
+
+enum texture_layout_t
+{
+    TEXTURE_LAYOUT_TILED,
+    TEXTURE_LAYOUT_MORTON,
+};
+
+enum texture_filter_t
+{
+    TEXTURE_FILTER_POINT,
+    TEXTURE_FILTER_BILINEAR,
+    TEXTURE_FILTER_TRILINEAR,
+};
+
+struct texture_t
+{
+    texture_layout_t layout;
+    uint32_t mip_count;
+
+    // Per-mip parameters kept as separate arrays so the sampler can gather
+    // them per lane when neighbouring fragments land on different mips.
+    uint32_t mip_width[TEXTURE_MAX_MIPS];
+    uint32_t mip_height[TEXTURE_MAX_MIPS];
+    uint32_t mip_offset[TEXTURE_MAX_MIPS];
+    uint32_t mip_tiles_x[TEXTURE_MAX_MIPS];
+    uint32_t mip_morton_bits[TEXTURE_MAX_MIPS];
+
+    uint32_t *texels;
+    void *memory;
+};
+
+// Four channels for eight fragments, each in [0, 1].
+struct texture_sample_t
+{
+    f32x8_t r, g, b, a;
+};
+
+inline uint32_t texture_log2_ceil(uint32_t value)
+{
+    uint32_t bits = 0;
+    while ((1u << bits) < value)
+    {
+        ++bits;
+    }
+    return bits;
+}
+
+// Spreads the low 16 bits of value so there is a zero bit between each of them.
+inline uint32_t texture_part1by1(uint32_t value)
+{
+    value &= 0x0000ffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+inline i32x8_t texture_part1by1(i32x8_t value)
+{
+    value = value & i32x8(0x0000ffff);
+    value = (value | (value << 8)) & i32x8(0x00ff00ff);
+    value = (value | (value << 4)) & i32x8(0x0f0f0f0f);
+    value = (value | (value << 2)) & i32x8(0x33333333);
+    value = (value | (value << 1)) & i32x8(0x55555555);
+    return value;
+}
+
+uint32_t texture_texel_index(const texture_t *texture, uint32_t mip, uint32_t x, uint32_t y)
+{
+    uint32_t index;
+    if (texture->layout == TEXTURE_LAYOUT_TILED)
+    {
+        uint32_t tile = (y >> 2) * texture->mip_tiles_x[mip] + (x >> 2);
+        index = (tile << 4) | ((y & 3) << 2) | (x & 3);
+    }
+    else
+    {
+        // Interleave the bits both axes have in common, the leftover high bits
+        // of the longer axis go on top.
+        uint32_t bits = texture->mip_morton_bits[mip];
+        uint32_t low_mask = (1u << bits) - 1;
+        index = texture_part1by1(x & low_mask) | (texture_part1by1(y & low_mask) << 1);
+        index |= ((x >> bits) | (y >> bits)) << (2 * bits);
+    }
+    return texture->mip_offset[mip] + index;
+}
+
+i32x8_t texture_texel_index(const texture_t *texture, i32x8_t mip, i32x8_t x, i32x8_t y)
+{
+    i32x8_t index;
+    if (texture->layout == TEXTURE_LAYOUT_TILED)
+    {
+        i32x8_t tiles_x = gather(texture->mip_tiles_x, mip);
+        i32x8_t tile = (y >> 2) * tiles_x + (x >> 2);
+        index = (tile << 4) | ((y & i32x8(3)) << 2) | (x & i32x8(3));
+    }
+    else
+    {
+        i32x8_t bits = gather(texture->mip_morton_bits, mip);
+        i32x8_t low_mask = shift_left(i32x8(1), bits) - i32x8(1);
+        index = texture_part1by1(x & low_mask) | (texture_part1by1(y & low_mask) << 1);
+        index = index | shift_left(shift_right(x, bits) | shift_right(y, bits), bits + bits);
+    }
+    return gather(texture->mip_offset, mip) + index;
+}
+
+uint32_t texture_read_texel(const texture_t *texture, uint32_t mip, uint32_t x, uint32_t y)
+{
+    assert(mip < texture->mip_count);
+    assert(x < texture->mip_width[mip] && y < texture->mip_height[mip]);
+    return texture->texels[texture_texel_index(texture, mip, x, y)];
+}
+
+// 2x2 box filter to the floor-halved size. When the source is odd the last
+// row and column of the destination also take in the trailing source texels,
+// averaging up to 3x3, so none are dropped.
+void texture_downsample(const uint32_t *source, uint32_t source_width, uint32_t source_height, uint32_t *destination)
+{
+    uint32_t width = source_width > 1 ? source_width / 2 : 1;
+    uint32_t height = source_height > 1 ? source_height / 2 : 1;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint32_t y0 = y * 2;
+        uint32_t y1 = y + 1 == height ? source_height - 1 : y0 + 1;
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t x0 = x * 2;
+            uint32_t x1 = x + 1 == width ? source_width - 1 : x0 + 1;
+
+            uint32_t sums[4] = {};
+            for (uint32_t sy = y0; sy <= y1; ++sy)
+            {
+                for (uint32_t sx = x0; sx <= x1; ++sx)
+                {
+                    uint32_t texel = source[sy * source_width + sx];
+                    for (uint32_t channel = 0; channel < 4; ++channel)
+                    {
+                        sums[channel] += (texel >> (channel * 8)) & 0xff;
+                    }
+                }
+            }
+
+            uint32_t count = (x1 - x0 + 1) * (y1 - y0 + 1);
+            uint32_t result = 0;
+            for (uint32_t channel = 0; channel < 4; ++channel)
+            {
+                result |= ((sums[channel] + count / 2) / count) << (channel * 8);
+            }
+            destination[y * width + x] = result;
+        }
+    }
+}
+
+// Builds a texture from row-major RGBA8 pixels. With generate_mips the full
+// chain down to 1x1 is box filtered, otherwise only level 0 exists.
+texture_t texture_create(const uint32_t *pixels, uint32_t width, uint32_t height, texture_layout_t layout, bool generate_mips)
+{
+    assert(pixels && width && height);
+    assert(width <= 0xffff && height <= 0xffff);
+
+    texture_t texture = {};
+    texture.layout = layout;
+
+    uint32_t total_texels = 0;
+    uint32_t mip_width = width;
+    uint32_t mip_height = height;
+    for (;;)
+    {
+        uint32_t mip = texture.mip_count++;
+        texture.mip_width[mip] = mip_width;
+        texture.mip_height[mip] = mip_height;
+        texture.mip_offset[mip] = total_texels;
+
+        if (layout == TEXTURE_LAYOUT_TILED)
+        {
+            uint32_t tiles_x = (mip_width + 3) / 4;
+            uint32_t tiles_y = (mip_height + 3) / 4;
+            texture.mip_tiles_x[mip] = tiles_x;
+            total_texels += tiles_x * tiles_y * 16;
+        }
+        else
+        {
+            uint32_t width_bits = texture_log2_ceil(mip_width);
+            uint32_t height_bits = texture_log2_ceil(mip_height);
+            texture.mip_morton_bits[mip] = width_bits < height_bits ? width_bits : height_bits;
+            total_texels += 1u << (width_bits + height_bits);
+        }
+
+        if (!generate_mips || (mip_width == 1 && mip_height == 1))
+        {
+            break;
+        }
+        mip_width = mip_width > 1 ? mip_width / 2 : 1;
+        mip_height = mip_height > 1 ? mip_height / 2 : 1;
+    }
+
+    // One allocation aligned to a cache line, so every 4x4 tile is exactly one line.
+    texture.memory = malloc(total_texels * sizeof(uint32_t) + 63);
+    assert(texture.memory);
+    texture.texels = (uint32_t *)(((uintptr_t)texture.memory + 63) & ~(uintptr_t)63);
+    memset(texture.texels, 0, total_texels * sizeof(uint32_t));
+
+    uint32_t *scratch = (uint32_t *)malloc(width * height * sizeof(uint32_t) * 2);
+    assert(scratch);
+    uint32_t *level = scratch;
+    uint32_t *next_level = scratch + width * height;
+    memcpy(level, pixels, width * height * sizeof(uint32_t));
+
+    for (uint32_t mip = 0; mip < texture.mip_count; ++mip)
+    {
+        uint32_t w = texture.mip_width[mip];
+        uint32_t h = texture.mip_height[mip];
+        for (uint32_t y = 0; y < h; ++y)
+        {
+            for (uint32_t x = 0; x < w; ++x)
+            {
+                texture.texels[texture_texel_index(&texture, mip, x, y)] = level[y * w + x];
+            }
+        }
+
+        if (mip + 1 < texture.mip_count)
+        {
+            texture_downsample(level, w, h, next_level);
+            uint32_t *swap = level;
+            level = next_level;
+            next_level = swap;
+        }
+    }
+
+    free(scratch);
+
+    return texture;
+}
+
+void texture_destroy(texture_t *texture)
+{
+    free(texture->memory);
+    *texture = {};
+}
+
+inline texture_sample_t texture_unpack(i32x8_t texels)
+{
+    f32x8_t scale = f32x8(1.0f / 255.0f);
+    texture_sample_t sample;
+    sample.r = to_f32(texels & i32x8(0xff)) * scale;
+    sample.g = to_f32((texels >> 8) & i32x8(0xff)) * scale;
+    sample.b = to_f32((texels >> 16) & i32x8(0xff)) * scale;
+    sample.a = to_f32(texels >> 24) * scale;
+    return sample;
+}
+
+inline texture_sample_t texture_lerp(const texture_sample_t &a, const texture_sample_t &b, f32x8_t t)
+{
+    return { lerp(a.r, b.r, t), lerp(a.g, b.g, t), lerp(a.b, b.b, t), lerp(a.a, b.a, t) };
+}
+
+// Wraps integer texel coordinates (held as floats) into [0, size) for GL_REPEAT.
+inline f32x8_t texture_wrap(f32x8_t coordinate, f32x8_t size)
+{
+    return coordinate - floor(coordinate / size) * size;
+}
+
+texture_sample_t texture_sample_point(const texture_t *texture, f32x8_t u, f32x8_t v, i32x8_t mip)
+{
+    f32x8_t width = to_f32(gather(texture->mip_width, mip));
+    f32x8_t height = to_f32(gather(texture->mip_height, mip));
+
+    i32x8_t x = to_i32(texture_wrap(floor(u * width), width));
+    i32x8_t y = to_i32(texture_wrap(floor(v * height), height));
+
+    return texture_unpack(gather(texture->texels, texture_texel_index(texture, mip, x, y)));
+}
+
+texture_sample_t texture_sample_bilinear(const texture_t *texture, f32x8_t u, f32x8_t v, i32x8_t mip)
+{
+    f32x8_t width = to_f32(gather(texture->mip_width, mip));
+    f32x8_t height = to_f32(gather(texture->mip_height, mip));
+
+    f32x8_t fx = u * width - f32x8(0.5f);
+    f32x8_t fy = v * height - f32x8(0.5f);
+    f32x8_t x0 = floor(fx);
+    f32x8_t y0 = floor(fy);
+    f32x8_t tx = fx - x0;
+    f32x8_t ty = fy - y0;
+
+    x0 = texture_wrap(x0, width);
+    y0 = texture_wrap(y0, height);
+    f32x8_t x1 = x0 + f32x8(1.0f);
+    f32x8_t y1 = y0 + f32x8(1.0f);
+    x1 = select(cmp_ge(x1, width), f32x8(0.0f), x1);
+    y1 = select(cmp_ge(y1, height), f32x8(0.0f), y1);
+
+    i32x8_t ix0 = to_i32(x0), iy0 = to_i32(y0);
+    i32x8_t ix1 = to_i32(x1), iy1 = to_i32(y1);
+
+    texture_sample_t s00 = texture_unpack(gather(texture->texels, texture_texel_index(texture, mip, ix0, iy0)));
+    texture_sample_t s10 = texture_unpack(gather(texture->texels, texture_texel_index(texture, mip, ix1, iy0)));
+    texture_sample_t s01 = texture_unpack(gather(texture->texels, texture_texel_index(texture, mip, ix0, iy1)));
+    texture_sample_t s11 = texture_unpack(gather(texture->texels, texture_texel_index(texture, mip, ix1, iy1)));
+
+    return texture_lerp(texture_lerp(s00, s10, tx), texture_lerp(s01, s11, tx), ty);
+}
+
+// Level of detail from screen-space derivatives. The eight lanes must hold two
+// 2x2 quads as (x, y) (x+1, y) (x, y+1) (x+1, y+1), so differences with the
+// quad neighbours give d/dx and d/dy without any extra inputs.
+f32x8_t texture_compute_lod(const texture_t *texture, f32x8_t u, f32x8_t v)
+{
+    f32x8_t width = f32x8((real32_t)texture->mip_width[0]);
+    f32x8_t height = f32x8((real32_t)texture->mip_height[0]);
+
+    f32x8_t dudx = (u - quad_swap_x(u)) * width;
+    f32x8_t dvdx = (v - quad_swap_x(v)) * height;
+    f32x8_t dudy = (u - quad_swap_y(u)) * width;
+    f32x8_t dvdy = (v - quad_swap_y(v)) * height;
+
+    f32x8_t rho2 = simd_max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+    rho2 = simd_max(rho2, f32x8(1e-8f));
+
+    f32x8_t lod = log2_approx(rho2) * f32x8(0.5f);
+    return clamp(lod, f32x8(0.0f), f32x8((real32_t)(texture->mip_count - 1)));
+}
+
+texture_sample_t texture_sample_trilinear(const texture_t *texture, f32x8_t u, f32x8_t v)
+{
+    f32x8_t lod = texture_compute_lod(texture, u, v);
+    f32x8_t lod_floor = floor(lod);
+
+    i32x8_t mip0 = to_i32(lod_floor);
+    i32x8_t mip1 = simd_min(mip0 + i32x8(1), i32x8((int32_t)texture->mip_count - 1));
+
+    texture_sample_t s0 = texture_sample_bilinear(texture, u, v, mip0);
+
+    // Skip the second level when no lane actually blends between two mips.
+    f32x8_t t = lod - lod_floor;
+    if (movemask(cmp_gt(t, f32x8(1.0f / 256.0f)) & cmp_gt(mip1, mip0)) == 0)
+    {
+        return s0;
+    }
+
+    texture_sample_t s1 = texture_sample_bilinear(texture, u, v, mip1);
+    return texture_lerp(s0, s1, t);
+}
+
+texture_sample_t texture_sample(const texture_t *texture, texture_filter_t filter, f32x8_t u, f32x8_t v)
+{
+    switch (filter)
+    {
+    case TEXTURE_FILTER_BILINEAR: return texture_sample_bilinear(texture, u, v, i32x8(0));
+    case TEXTURE_FILTER_TRILINEAR: return texture_sample_trilinear(texture, u, v);
+    default: return texture_sample_point(texture, u, v, i32x8(0));
+    }
+}
@@ -0,0 +1,593 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "opengl.h"
+#include "gl_state.h"
+#include "texture.h"
+
+// Loads textures without stalling the render thread. Worker threads read and
+// decode image files, build the mip chain and write it into a slot of one
+// pixel unpack buffer that stays mapped (GL_ARB_buffer_storage). The render
+// thread calls texture_stream_update() once a frame, which uploads mips from
+// the buffer with glTexSubImage2D, coarsest first, and moves the texture's
+// base level down as finer mips land, so a blurry texture is usable at once.
+// A slot goes back to the workers when the fence after its last upload has
+// signalled.
+//
+// Without buffer storage the slots are plain memory and the uploads read from
+// it directly; decoding still happens off the render thread.
+//
+// texture_stream_load() returns a handle whose GL texture exists right away
+// and can be bound before any data arrived. Everything except the workers runs
+// on the thread that owns the context.
+
+#define TEXTURE_STREAM_MAX_TEXTURES 1024
+#define TEXTURE_STREAM_MAX_SLOTS 16
+#define TEXTURE_STREAM_MAX_THREADS 8
+#define TEXTURE_STREAM_NO_SLOT 0xffffffffu
+
+// Mips this many texels wide or high and smaller are uploaded as soon as a
+// texture is decoded, whatever the budget.
+#define TEXTURE_STREAM_FIRST_MIP_SIZE 64
+
+enum texture_stream_status_t
+{
+    TEXTURE_STREAM_PENDING,     // being read and decoded
+    TEXTURE_STREAM_PARTIAL,     // some mips are resident, coarsest first
+    TEXTURE_STREAM_READY,
+    TEXTURE_STREAM_FAILED,
+};
+
+// Returns row-major RGBA8 pixels allocated with malloc, NULL on failure.
+// Called on worker threads.
+typedef uint32_t *texture_stream_decode_t(const char *path, uint32_t *width, uint32_t *height);
+
+struct texture_stream_texture_t
+{
+    char path[256];
+    uint32_t texture;
+    texture_stream_status_t status;
+
+    // Written by the worker before the texture is queued as decoded.
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint32_t mip_offset[TEXTURE_MAX_MIPS];     // bytes into the slot
+    uint32_t slot;
+
+    // Mips from here to mip_count - 1 are resident.
+    uint32_t resident_mip;
+};
+
+struct texture_stream_stats_t
+{
+    uint32_t decoded;
+    uint32_t failures;
+    uint32_t mips_uploaded;
+    uint64_t bytes_uploaded;
+    uint32_t slot_waits;        // decoded textures that found every slot in use
+};
+
+struct texture_stream_t
+{
+    texture_stream_decode_t *decode;
+    bool persistent;
+    bool immutable;
+    uint32_t buffer;
+    uint8_t *memory;
+    uint32_t slot_size;
+    uint32_t slot_count;
+    GLsync fences[TEXTURE_STREAM_MAX_SLOTS];
+
+    texture_stream_texture_t textures[TEXTURE_STREAM_MAX_TEXTURES];
+    uint32_t texture_count;
+
+    // Textures handed to or returned by the workers, in order, under mutex.
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable slot_freed;
+    uint32_t requests[TEXTURE_STREAM_MAX_TEXTURES];
+    uint32_t request_begin;
+    uint32_t request_end;
+    uint32_t decoded[TEXTURE_STREAM_MAX_TEXTURES];
+    uint32_t decoded_begin;
+    uint32_t decoded_end;
+    uint32_t free_slots[TEXTURE_STREAM_MAX_SLOTS];
+    uint32_t free_slot_count;
+    bool stop;
+
+    // Decoded textures still uploading, render thread only.
+    uint32_t streaming[TEXTURE_STREAM_MAX_TEXTURES];
+    uint32_t streaming_count;
+
+    std::thread threads[TEXTURE_STREAM_MAX_THREADS];
+    uint32_t thread_count;
+
+    texture_stream_stats_t stats;
+};
+
+//
+// Decoding
+//
+
+FILE *texture_stream_open(const char *path)
+{
+    FILE *file = 0;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "rb") != 0)
+    {
+        file = 0;
+    }
+#else
+    file = fopen(path, "rb");
+#endif
+    return file;
+}
+
+// Next number of a PPM header, skipping whitespace and comments.
+bool texture_stream_read_ppm_number(FILE *file, uint32_t *value)
+{
+    int c = fgetc(file);
+    for (;;)
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+            {
+                c = fgetc(file);
+            }
+        }
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        {
+            c = fgetc(file);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (c < '0' || c > '9')
+    {
+        return false;
+    }
+    uint32_t number = 0;
+    while (c >= '0' && c <= '9' && number < 0x10000)
+    {
+        number = number * 10 + (uint32_t)(c - '0');
+        c = fgetc(file);
+    }
+    *value = number;
+    return true;
+}
+
+// Binary PPM (P6) with 8-bit channels, the format image_output writes.
+uint32_t *texture_stream_decode_ppm(const char *path, uint32_t *width, uint32_t *height)
+{
+    FILE *file = texture_stream_open(path);
+    if (!file)
+    {
+        return NULL;
+    }
+
+    uint32_t max_value = 0;
+    bool valid = fgetc(file) == 'P' && fgetc(file) == '6' &&
+        texture_stream_read_ppm_number(file, width) &&
+        texture_stream_read_ppm_number(file, height) &&
+        texture_stream_read_ppm_number(file, &max_value) &&
+        *width && *height && *width <= 0xffff && *height <= 0xffff && max_value == 255;
+
+    uint32_t *pixels = NULL;
+    if (valid)
+    {
+        size_t count = (size_t)*width * *height;
+        pixels = (uint32_t *)malloc(count * sizeof(uint32_t));
+        assert(pixels);
+
+        // Expand in place from the back, RGB triplets sit in the first three
+        // quarters of the allocation.
+        uint8_t *rgb = (uint8_t *)pixels;
+        if (fread(rgb, 3, count, file) == count)
+        {
+            for (size_t i = count; i-- > 0;)
+            {
+                pixels[i] = rgb[i * 3] | (uint32_t)rgb[i * 3 + 1] << 8 | (uint32_t)rgb[i * 3 + 2] << 16 | 0xff000000u;
+            }
+        }
+        else
+        {
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    fclose(file);
+    return pixels;
+}
+
+//
+// Workers
+//
+
+uint32_t texture_stream_chain_size(texture_stream_texture_t *texture)
+{
+    uint32_t size = 0;
+    uint32_t width = texture->width;
+    uint32_t height = texture->height;
+    texture->mip_count = 0;
+    for (;;)
+    {
+        texture->mip_offset[texture->mip_count++] = size;
+        size += width * height * sizeof(uint32_t);
+        if (width == 1 && height == 1)
+        {
+            break;
+        }
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+// Downsamples in cached memory and copies every level into the slot, which
+// may be write-combined and slow to read back.
+void texture_stream_write_chain(texture_stream_t *stream, texture_stream_texture_t *texture, uint32_t *pixels)
+{
+    uint8_t *slot = stream->memory + (size_t)texture->slot * stream->slot_size;
+    uint32_t *scratch = (uint32_t *)malloc((size_t)(texture->width / 2 + 1) * (texture->height / 2 + 1) * sizeof(uint32_t));
+    assert(scratch);
+
+    uint32_t *level = pixels;
+    uint32_t *next_level = scratch;
+    uint32_t width = texture->width;
+    uint32_t height = texture->height;
+    for (uint32_t mip = 0; mip < texture->mip_count; ++mip)
+    {
+        memcpy(slot + texture->mip_offset[mip], level, (size_t)width * height * sizeof(uint32_t));
+        if (mip + 1 < texture->mip_count)
+        {
+            texture_downsample(level, width, height, next_level);
+            uint32_t *swap = level;
+            level = next_level;
+            next_level = swap;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+    }
+    free(scratch);
+}
+
+void texture_stream_thread(texture_stream_t *stream)
+{
+    for (;;)
+    {
+        uint32_t handle;
+        {
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            stream->work.wait(lock, [&] { return stream->stop || stream->request_begin != stream->request_end; });
+            if (stream->stop)
+            {
+                return;
+            }
+            handle = stream->requests[stream->request_begin++ % TEXTURE_STREAM_MAX_TEXTURES];
+        }
+
+        texture_stream_texture_t *texture = &stream->textures[handle];
+        texture->slot = TEXTURE_STREAM_NO_SLOT;
+        uint32_t *pixels = stream->decode(texture->path, &texture->width, &texture->height);
+        if (!pixels)
+        {
+            fprintf(stderr, "texture_stream: cannot decode %s\n", texture->path);
+        }
+        else if (texture_stream_chain_size(texture) > stream->slot_size)
+        {
+            fprintf(stderr, "texture_stream: %s is %ux%u, too large for a slot\n", texture->path, texture->width, texture->height);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            if (stream->free_slot_count == 0)
+            {
+                ++stream->stats.slot_waits;
+            }
+            stream->slot_freed.wait(lock, [&] { return stream->stop || stream->free_slot_count > 0; });
+            if (stream->stop)
+            {
+                free(pixels);
+                return;
+            }
+            texture->slot = stream->free_slots[--stream->free_slot_count];
+        }
+
+        if (texture->slot != TEXTURE_STREAM_NO_SLOT)
+        {
+            texture_stream_write_chain(stream, texture, pixels);
+        }
+        free(pixels);
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->decoded[stream->decoded_end++ % TEXTURE_STREAM_MAX_TEXTURES] = handle;
+    }
+}
+
+//
+// Render thread
+//
+
+// slot_size bounds the largest mip chain, a 1024x1024 texture needs about
+// 5.3 MB. thread_count of 0 picks one worker per hardware thread besides the
+// render thread. decode NULL reads PPM files.
+texture_stream_t *texture_stream_create(uint32_t slot_size, uint32_t slot_count, uint32_t thread_count, texture_stream_decode_t *decode)
+{
+    assert(slot_count > 0 && slot_count <= TEXTURE_STREAM_MAX_SLOTS);
+    if (thread_count == 0)
+    {
+        uint32_t hardware = std::thread::hardware_concurrency();
+        thread_count = hardware > 1 ? hardware - 1 : 1;
+    }
+    if (thread_count > TEXTURE_STREAM_MAX_THREADS)
+    {
+        thread_count = TEXTURE_STREAM_MAX_THREADS;
+    }
+
+    texture_stream_t *stream = new texture_stream_t();
+    stream->decode = decode ? decode : texture_stream_decode_ppm;
+    stream->slot_size = (slot_size + 255) & ~255u;
+    stream->slot_count = slot_count;
+    stream->immutable = gl_dispatch_available(GL_DISPATCH_glTexStorage2D) && gl_supports(4, 2, "GL_ARB_texture_storage");
+    stream->persistent = gl_dispatch_available(GL_DISPATCH_glBufferStorage) && gl_supports(4, 4, "GL_ARB_buffer_storage");
+
+    GLsizeiptr size = (GLsizeiptr)stream->slot_size * slot_count;
+    if (stream->persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &stream->buffer);
+        gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+        stream->memory = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        stream->memory = (uint8_t *)malloc((size_t)size);
+    }
+    assert(stream->memory);
+
+    for (uint32_t i = 0; i < slot_count; ++i)
+    {
+        stream->free_slots[stream->free_slot_count++] = slot_count - 1 - i;
+    }
+
+    stream->thread_count = thread_count;
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        stream->threads[i] = std::thread(texture_stream_thread, stream);
+    }
+    return stream;
+}
+
+void texture_stream_destroy(texture_stream_t *stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->stop = true;
+    }
+    stream->work.notify_all();
+    stream->slot_freed.notify_all();
+    for (uint32_t i = 0; i < stream->thread_count; ++i)
+    {
+        stream->threads[i].join();
+    }
+
+    for (uint32_t i = 0; i < stream->slot_count; ++i)
+    {
+        if (stream->fences[i])
+        {
+            glDeleteSync(stream->fences[i]);
+        }
+    }
+    for (uint32_t i = 0; i < stream->texture_count; ++i)
+    {
+        gl_state_delete_texture(stream->textures[i].texture);
+    }
+    if (stream->persistent)
+    {
+        gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        gl_state_delete_buffer(stream->buffer);
+    }
+    else
+    {
+        free(stream->memory);
+    }
+    delete stream;
+}
+
+// Queues path for loading and returns its handle.
+uint32_t texture_stream_load(texture_stream_t *stream, const char *path)
+{
+    assert(stream->texture_count < TEXTURE_STREAM_MAX_TEXTURES);
+    uint32_t handle = stream->texture_count++;
+    texture_stream_texture_t *texture = &stream->textures[handle];
+    snprintf(texture->path, sizeof(texture->path), "%s", path);
+    texture->status = TEXTURE_STREAM_PENDING;
+    glGenTextures(1, &texture->texture);
+
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->requests[stream->request_end++ % TEXTURE_STREAM_MAX_TEXTURES] = handle;
+    }
+    stream->work.notify_one();
+    return handle;
+}
+
+inline uint32_t texture_stream_texture(const texture_stream_t *stream, uint32_t handle)
+{
+    assert(handle < stream->texture_count);
+    return stream->textures[handle].texture;
+}
+
+inline texture_stream_status_t texture_stream_status(const texture_stream_t *stream, uint32_t handle)
+{
+    assert(handle < stream->texture_count);
+    return stream->textures[handle].status;
+}
+
+void texture_stream_release_slot(texture_stream_t *stream, uint32_t slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->free_slots[stream->free_slot_count++] = slot;
+    }
+    stream->slot_freed.notify_one();
+}
+
+// Gives the texture storage for every mip, none of which is visible until
+// texture_stream_upload_mip() lowers the base level.
+void texture_stream_allocate(texture_stream_t *stream, texture_stream_texture_t *texture)
+{
+    gl_state_bind_texture(0, GL_TEXTURE_2D, texture->texture);
+    if (stream->immutable)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, (GLsizei)texture->mip_count, GL_RGBA8, (GLsizei)texture->width, (GLsizei)texture->height);
+    }
+    else
+    {
+        uint32_t width = texture->width;
+        uint32_t height = texture->height;
+        for (uint32_t mip = 0; mip < texture->mip_count; ++mip)
+        {
+            glTexImage2D(GL_TEXTURE_2D, (GLint)mip, GL_RGBA8, (GLsizei)width, (GLsizei)height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture->mip_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    texture->resident_mip = texture->mip_count;
+}
+
+// Uploads the next finer mip and returns its size in bytes.
+uint32_t texture_stream_upload_mip(texture_stream_t *stream, texture_stream_texture_t *texture)
+{
+    assert(texture->resident_mip > 0);
+    uint32_t mip = texture->resident_mip - 1;
+    uint32_t width = texture->width >> mip ? texture->width >> mip : 1;
+    uint32_t height = texture->height >> mip ? texture->height >> mip : 1;
+    size_t offset = (size_t)texture->slot * stream->slot_size + texture->mip_offset[mip];
+    const void *pixels = stream->persistent ? (const void *)offset : (const void *)(stream->memory + offset);
+
+    gl_state_bind_texture(0, GL_TEXTURE_2D, texture->texture);
+    glTexSubImage2D(GL_TEXTURE_2D, (GLint)mip, 0, 0, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)mip);
+    texture->resident_mip = mip;
+
+    uint32_t size = width * height * sizeof(uint32_t);
+    ++stream->stats.mips_uploaded;
+    stream->stats.bytes_uploaded += size;
+    return size;
+}
+
+void texture_stream_finish(texture_stream_t *stream, texture_stream_texture_t *texture)
+{
+    texture->status = TEXTURE_STREAM_READY;
+    if (stream->persistent)
+    {
+        stream->fences[texture->slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else
+    {
+        texture_stream_release_slot(stream, texture->slot);
+    }
+}
+
+// Call once a frame. Recycles slots whose uploads have finished, gives every
+// newly decoded texture its small mips and then uploads finer mips until
+// byte_budget is spent, at least one per call.
+void texture_stream_update(texture_stream_t *stream, uint32_t byte_budget)
+{
+    for (uint32_t i = 0; i < stream->slot_count; ++i)
+    {
+        GLsync fence = stream->fences[i];
+        if (fence && glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            glDeleteSync(fence);
+            stream->fences[i] = NULL;
+            texture_stream_release_slot(stream, i);
+        }
+    }
+
+    uint32_t decoded[TEXTURE_STREAM_MAX_TEXTURES];
+    uint32_t decoded_count = 0;
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        while (stream->decoded_begin != stream->decoded_end)
+        {
+            decoded[decoded_count++] = stream->decoded[stream->decoded_begin++ % TEXTURE_STREAM_MAX_TEXTURES];
+        }
+    }
+
+    // Without a buffer the uploads read client memory, which needs the unpack
+    // binding cleared.
+    gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->buffer);
+    for (uint32_t i = 0; i < decoded_count; ++i)
+    {
+        texture_stream_texture_t *texture = &stream->textures[decoded[i]];
+        if (texture->slot == TEXTURE_STREAM_NO_SLOT)
+        {
+            texture->status = TEXTURE_STREAM_FAILED;
+            ++stream->stats.failures;
+            continue;
+        }
+
+        ++stream->stats.decoded;
+        texture_stream_allocate(stream, texture);
+        texture->status = TEXTURE_STREAM_PARTIAL;
+        do
+        {
+            texture_stream_upload_mip(stream, texture);
+        } while (texture->resident_mip > 0 &&
+            (texture->width >> (texture->resident_mip - 1)) <= TEXTURE_STREAM_FIRST_MIP_SIZE &&
+            (texture->height >> (texture->resident_mip - 1)) <= TEXTURE_STREAM_FIRST_MIP_SIZE);
+
+        if (texture->resident_mip == 0)
+        {
+            texture_stream_finish(stream, texture);
+        }
+        else
+        {
+            stream->streaming[stream->streaming_count++] = decoded[i];
+        }
+    }
+
+    uint32_t spent = 0;
+    bool uploaded = false;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < stream->streaming_count; ++i)
+    {
+        texture_stream_texture_t *texture = &stream->textures[stream->streaming[i]];
+        while (texture->resident_mip > 0 && (!uploaded || spent < byte_budget))
+        {
+            spent += texture_stream_upload_mip(stream, texture);
+            uploaded = true;
+        }
+
+        if (texture->resident_mip == 0)
+        {
+            texture_stream_finish(stream, texture);
+        }
+        else
+        {
+            stream->streaming[kept++] = stream->streaming[i];
+        }
+    }
+    stream->streaming_count = kept;
+    gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
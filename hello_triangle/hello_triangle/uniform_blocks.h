@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "opengl.h"
+#include "gl_state.h"
+#include "upload_ring.h"
+
+// Uniform blocks mirrored by C++ structs. A block is declared once as a list
+// of fields:
+//
+//     #define MY_BLOCK(FIELD, ARRAY) FIELD(matrix4_t, transform) ARRAY(vector4_t, lights, 4)
+//     STD140_BLOCK(my_block, MY_BLOCK)
+//
+// which gives the struct my_block_t, the GLSL declaration my_block_glsl to
+// paste into shaders, and my_block_desc for uniform_block_bind(). Every
+// member's offset is checked against the std140 rules at compile time; pad
+// by hand where the check fires. Arrays have to be of 16-byte types so the
+// C++ and std140 strides agree.
+//
+// The shaders are GLSL 4.00, which has no binding layout qualifier, so block
+// bindings are assigned after linking with uniform_block_bind().
+
+template <typename T> struct std140_type;
+template <> struct std140_type<real32_t> { enum { alignment = 4 }; };
+template <> struct std140_type<int32_t> { enum { alignment = 4 }; };
+template <> struct std140_type<uint32_t> { enum { alignment = 4 }; };
+template <> struct std140_type<vector3_t> { enum { alignment = 16 }; };
+template <> struct std140_type<vector4_t> { enum { alignment = 16 }; };
+template <> struct std140_type<matrix4_t> { enum { alignment = 16 }; };
+
+#define STD140_GLSL_real32_t "float"
+#define STD140_GLSL_int32_t "int"
+#define STD140_GLSL_uint32_t "uint"
+#define STD140_GLSL_vector3_t "vec3"
+#define STD140_GLSL_vector4_t "vec4"
+#define STD140_GLSL_matrix4_t "mat4"
+
+#define STD140_DECLARE_FIELD(type, member) type member;
+#define STD140_DECLARE_ARRAY(type, member, count) type member[count];
+
+#define STD140_CHECK_FIELD(type, member) \
+    static_assert(offsetof(block_t, member) % std140_type<type>::alignment == 0, "std140: " #member " is misaligned, add padding before it");
+#define STD140_CHECK_ARRAY(type, member, count) \
+    static_assert(sizeof(type) % 16 == 0, "std140: elements of " #member " need a 16-byte stride"); \
+    static_assert(offsetof(block_t, member) % 16 == 0, "std140: " #member " is misaligned, add padding before it");
+
+#define STD140_GLSL_FIELD(type, member) "    " STD140_GLSL_##type " " #member ";\n"
+#define STD140_GLSL_ARRAY(type, member, count) "    " STD140_GLSL_##type " " #member "[" #count "];\n"
+
+struct uniform_block_desc_t
+{
+    const char *name;
+    uint32_t size;
+};
+
+#define STD140_BLOCK(name, fields)                                                               \
+    struct name##_t                                                                              \
+    {                                                                                            \
+        fields(STD140_DECLARE_FIELD, STD140_DECLARE_ARRAY)                                       \
+    };                                                                                           \
+    struct name##_std140_check_t                                                                 \
+    {                                                                                            \
+        typedef name##_t block_t;                                                                \
+        fields(STD140_CHECK_FIELD, STD140_CHECK_ARRAY)                                           \
+        static_assert(sizeof(block_t) % 16 == 0, "std140: " #name " has to end on 16 bytes");    \
+    };                                                                                           \
+    const char *name##_glsl = "layout(std140) uniform " #name "\n{\n" fields(STD140_GLSL_FIELD, STD140_GLSL_ARRAY) "};\n"; \
+    const uniform_block_desc_t name##_desc = { #name, sizeof(name##_t) }
+
+//
+// Blocks shared by all shaders
+//
+
+enum uniform_binding_t
+{
+    UNIFORM_BINDING_FRAME,
+    UNIFORM_BINDING_PASS,
+    UNIFORM_BINDING_OBJECT,
+};
+
+#define FRAME_UNIFORMS(FIELD, ARRAY)        \
+    FIELD(matrix4_t, view)                  \
+    FIELD(matrix4_t, projection)            \
+    FIELD(matrix4_t, view_projection)       \
+    FIELD(vector3_t, camera_position)       \
+    FIELD(real32_t, time)
+
+#define PASS_UNIFORMS(FIELD, ARRAY)         \
+    FIELD(vector4_t, viewport)              \
+    FIELD(vector4_t, clear_color)
+
+#define OBJECT_UNIFORMS(FIELD, ARRAY)       \
+    FIELD(matrix4_t, transform)             \
+    FIELD(vector4_t, color)
+
+STD140_BLOCK(frame_uniforms, FRAME_UNIFORMS);
+STD140_BLOCK(pass_uniforms, PASS_UNIFORMS);
+STD140_BLOCK(object_uniforms, OBJECT_UNIFORMS);
+
+// Points the program's block at binding. Programs that do not use the block
+// are left alone; a size mismatch means the shader and the struct disagree.
+void uniform_block_bind(uint32_t program, const uniform_block_desc_t *block, uint32_t binding)
+{
+    GLuint index = glGetUniformBlockIndex(program, block->name);
+    if (index == GL_INVALID_INDEX)
+    {
+        return;
+    }
+
+    GLint size = 0;
+    glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    assert((uint32_t)size == block->size && "uniform block does not match its C++ struct");
+    glUniformBlockBinding(program, index, binding);
+}
+
+// The shared blocks at their fixed bindings; call once after linking.
+void uniform_blocks_bind_program(uint32_t program)
+{
+    uniform_block_bind(program, &frame_uniforms_desc, UNIFORM_BINDING_FRAME);
+    uniform_block_bind(program, &pass_uniforms_desc, UNIFORM_BINDING_PASS);
+    uniform_block_bind(program, &object_uniforms_desc, UNIFORM_BINDING_OBJECT);
+}
+
+// Copies a frame or pass block into the ring and binds it; once per frame or
+// pass, every draw after that reads the same range.
+void uniform_block_update(upload_ring_t *ring, uint32_t binding, const void *block, uint32_t size)
+{
+    upload_allocation_t allocation = upload_ring_allocate_uniforms(ring, size);
+    memcpy(allocation.memory, block, size);
+    gl_state_bind_buffer_range(GL_UNIFORM_BUFFER, binding, allocation.buffer, allocation.offset, size);
+}
+
+//
+// Per-object blocks
+//
+
+// Objects packed into one ring allocation at the uniform offset alignment, so
+// a draw only rebinds the range.
+struct uniform_objects_t
+{
+    upload_allocation_t allocation;
+    uint32_t binding;
+    uint32_t object_size;
+    uint32_t stride;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+void uniform_objects_begin(uniform_objects_t *objects, upload_ring_t *ring, uint32_t binding, uint32_t object_size, uint32_t capacity)
+{
+    objects->binding = binding;
+    objects->object_size = object_size;
+    objects->stride = (object_size + ring->uniform_alignment - 1) / ring->uniform_alignment * ring->uniform_alignment;
+    objects->count = 0;
+    objects->capacity = capacity;
+    objects->allocation = upload_ring_allocate_uniforms(ring, objects->stride * capacity);
+}
+
+// Returns the index to pass to uniform_objects_bind().
+uint32_t uniform_objects_push(uniform_objects_t *objects, const void *object)
+{
+    assert(objects->count < objects->capacity);
+    uint32_t index = objects->count++;
+    memcpy((uint8_t *)objects->allocation.memory + index * objects->stride, object, objects->object_size);
+    return index;
+}
+
+inline uint32_t uniform_objects_offset(const uniform_objects_t *objects, uint32_t index)
+{
+    return objects->allocation.offset + index * objects->stride;
+}
+
+void uniform_objects_bind(const uniform_objects_t *objects, uint32_t index)
+{
+    assert(index < objects->count);
+    gl_state_bind_buffer_range(GL_UNIFORM_BUFFER, objects->binding, objects->allocation.buffer, uniform_objects_offset(objects, index), objects->object_size);
+}
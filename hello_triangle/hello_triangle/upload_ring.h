@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include "opengl.h"
+#include "gl_state.h"
+
+// Per-frame dynamic data (vertices, indices, uniform blocks) goes into one GL
+// buffer split into UPLOAD_RING_FRAMES regions. The region of the frame being
+// recorded is written by the CPU while the GPU reads the older ones; a fence
+// per region keeps the CPU from overwriting data a frame still in flight uses.
+//
+// With GL_ARB_buffer_storage (GL 4.4) the buffer is mapped persistent and
+// coherent once, and allocations hand out pointers straight into it. Without
+// it allocations land in a CPU copy and upload_ring_flush() sends everything
+// new with a single glBufferSubData into the fenced region, which the driver
+// can do without waiting for the GPU.
+//
+// upload_ring_allocate() can be called from any thread, the rest only from
+// the thread that owns the context. Define UPLOAD_RING_FORCE_FALLBACK to test
+// the glBufferSubData path on drivers that have buffer storage.
+
+#define UPLOAD_RING_FRAMES 3
+
+struct upload_allocation_t
+{
+    void *memory;
+    uint32_t buffer;
+    uint32_t offset;    // in bytes from the start of buffer
+};
+
+struct upload_ring_stats_t
+{
+    uint64_t allocated;
+    uint32_t fence_waits;   // frames that found their region still in use
+    uint32_t flushes;
+};
+
+struct upload_ring_t
+{
+    uint32_t buffer;
+    uint32_t frame_size;
+    uint32_t uniform_alignment;
+    bool persistent;
+    bool multi_draw_indirect;   // for the indirect_batch_t drawn from this ring
+    uint8_t *memory;
+
+    uint32_t frame;
+    uint32_t frame_begin;
+    uint32_t flushed;
+    std::atomic<uint32_t> offset;
+    GLsync fences[UPLOAD_RING_FRAMES];
+
+    upload_ring_stats_t stats;
+};
+
+// frame_size is the budget for one frame, allocations past it assert.
+upload_ring_t *upload_ring_create(uint32_t frame_size)
+{
+    upload_ring_t *ring = new upload_ring_t();
+
+    GLint uniform_alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    ring->uniform_alignment = (uint32_t)uniform_alignment;
+    ring->frame_size = (frame_size + ring->uniform_alignment - 1) / ring->uniform_alignment * ring->uniform_alignment;
+
+    GLsizeiptr size = (GLsizeiptr)ring->frame_size * UPLOAD_RING_FRAMES;
+#ifdef UPLOAD_RING_FORCE_FALLBACK
+    ring->persistent = false;
+#else
+    ring->persistent = gl_dispatch_available(GL_DISPATCH_glBufferStorage) && gl_supports(4, 4, "GL_ARB_buffer_storage");
+#endif
+    ring->multi_draw_indirect = gl_dispatch_available(GL_DISPATCH_glMultiDrawElementsIndirect) && gl_supports(4, 3, "GL_ARB_multi_draw_indirect");
+
+    glGenBuffers(1, &ring->buffer);
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+    if (ring->persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        ring->memory = (uint8_t *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        assert(ring->memory);
+    }
+    else
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        ring->memory = (uint8_t *)malloc((size_t)size);
+        assert(ring->memory);
+    }
+
+    ring->frame = UPLOAD_RING_FRAMES - 1;
+    return ring;
+}
+
+void upload_ring_destroy(upload_ring_t *ring)
+{
+    for (uint32_t i = 0; i < UPLOAD_RING_FRAMES; ++i)
+    {
+        if (ring->fences[i])
+        {
+            glDeleteSync(ring->fences[i]);
+        }
+    }
+    if (ring->persistent)
+    {
+        gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    else
+    {
+        free(ring->memory);
+    }
+    gl_state_delete_buffer(ring->buffer);
+    delete ring;
+}
+
+// Moves to the next region, waiting for the GPU to finish the frame that
+// used it UPLOAD_RING_FRAMES frames ago.
+void upload_ring_begin_frame(upload_ring_t *ring)
+{
+    ring->frame = (ring->frame + 1) % UPLOAD_RING_FRAMES;
+    GLsync fence = ring->fences[ring->frame];
+    if (fence)
+    {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            ++ring->stats.fence_waits;
+            do
+            {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        assert(result != GL_WAIT_FAILED);
+        glDeleteSync(fence);
+        ring->fences[ring->frame] = NULL;
+    }
+
+    ring->frame_begin = ring->frame * ring->frame_size;
+    ring->flushed = ring->frame_begin;
+    ring->offset.store(ring->frame_begin, std::memory_order_relaxed);
+}
+
+// alignment has to be a power of two; uniform blocks need at least
+// ring->uniform_alignment, which upload_ring_allocate_uniforms() takes care of.
+upload_allocation_t upload_ring_allocate(upload_ring_t *ring, uint32_t size, uint32_t alignment)
+{
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+
+    uint32_t offset = ring->offset.load(std::memory_order_relaxed);
+    uint32_t begin;
+    do
+    {
+        begin = (offset + alignment - 1) & ~(alignment - 1);
+    } while (!ring->offset.compare_exchange_weak(offset, begin + size, std::memory_order_relaxed));
+    assert(begin + size <= ring->frame_begin + ring->frame_size && "upload ring frame budget exceeded");
+
+    upload_allocation_t allocation;
+    allocation.memory = ring->memory + begin;
+    allocation.buffer = ring->buffer;
+    allocation.offset = begin;
+    return allocation;
+}
+
+inline upload_allocation_t upload_ring_allocate_uniforms(upload_ring_t *ring, uint32_t size)
+{
+    return upload_ring_allocate(ring, size, ring->uniform_alignment);
+}
+
+// Makes everything allocated so far visible to GL. Call after the writes and
+// before the draws that read them; a no-op for persistent mappings.
+void upload_ring_flush(upload_ring_t *ring)
+{
+    uint32_t end = ring->offset.load(std::memory_order_relaxed);
+    if (ring->persistent || end == ring->flushed)
+    {
+        return;
+    }
+
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, ring->flushed, end - ring->flushed, ring->memory + ring->flushed);
+    ring->flushed = end;
+    ++ring->stats.flushes;
+}
+
+// Fences the region after the frame's last draw.
+void upload_ring_end_frame(upload_ring_t *ring)
+{
+    upload_ring_flush(ring);
+    assert(!ring->fences[ring->frame]);
+    ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    uint32_t used = ring->offset.load(std::memory_order_relaxed) - ring->frame_begin;
+    ring->stats.allocated += used;
+}
@@ -0,0 +1,514 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "opengl.h"
+#include "gl_state.h"
+#include "program_cache.h"
+
+// Buffers, textures and programs created on a dedicated thread with its own
+// context sharing objects with the render one. Submitting copies the inputs
+// and queues them; the upload thread makes the GL calls, fences them and
+// flushes. upload_thread_poll(), once a frame on the render thread, picks up
+// the requests whose fence has signalled without waiting for the rest, and
+// only then does upload_thread_object() return the new object. Until then
+// the render thread draws without it and never waits on an upload.
+//
+// A handle stays valid until upload_thread_take() hands its object over or
+// upload_thread_release() gives it up, failed requests included; then it is
+// reused by a later submit.
+//
+// The upload thread uses its own context's bindings and leaves gl_state
+// alone; objects are first bound on the render thread after their fence, as
+// sharing requires.
+
+#define UPLOAD_THREAD_MAX_STAGES 4
+
+enum upload_kind_t
+{
+    UPLOAD_BUFFER,
+    UPLOAD_TEXTURE,
+    UPLOAD_PROGRAM,
+};
+
+enum upload_status_t
+{
+    UPLOAD_PENDING,
+    UPLOAD_READY,
+    UPLOAD_FAILED,
+};
+
+struct upload_texture_desc_t
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t internal_format;   // GL_RGBA8, ...
+    uint32_t format;            // of the pixels, GL_RGBA, ...
+    uint32_t type;              // GL_UNSIGNED_BYTE, ...
+    bool mipmaps;               // a full chain, generated from the pixels
+};
+
+struct upload_request_t
+{
+    upload_kind_t kind;
+
+    // Inputs, freed by the upload thread once GL has copied them.
+    void *data;
+    uint32_t size;
+    uint32_t usage;                 // buffers
+    upload_texture_desc_t texture;  // textures
+    program_stage_t stages[UPLOAD_THREAD_MAX_STAGES];
+    uint32_t stage_count;
+
+    uint32_t object;
+    upload_status_t status;
+
+    // Set by the upload thread after its calls, with fence marking their end.
+    bool failed;
+    std::atomic<bool> uploaded;
+    GLsync fence;
+
+    bool released;              // unwanted, deleted once its upload finishes
+    upload_request_t *next;     // in the upload thread's queue
+};
+
+struct upload_thread_stats_t
+{
+    uint32_t submitted;
+    uint32_t uploaded;
+    uint32_t failed;
+    uint64_t bytes;         // buffer and pixel data submitted
+};
+
+struct upload_thread_t
+{
+    bool immutable_textures;
+    shared_context_t *context;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // Render thread only. requests is indexed by handle and NULL for the
+    // handles on the free list; pending holds the handles poll still checks.
+    upload_request_t **requests;
+    uint32_t request_count;
+    uint32_t request_capacity;
+    uint32_t *free_handles;
+    uint32_t free_count;
+    uint32_t *pending;
+    uint32_t pending_count;
+
+    // Submitted requests the upload thread has not started, under mutex.
+    upload_request_t *queue_head;
+    upload_request_t *queue_tail;
+    bool stop;
+
+    upload_thread_stats_t stats;
+};
+
+void upload_thread_create_buffer(upload_request_t *request)
+{
+    glGenBuffers(1, &request->object);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, request->object);
+    glBufferData(GL_COPY_WRITE_BUFFER, request->size, request->data, request->usage);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void upload_thread_create_texture(upload_thread_t *thread, upload_request_t *request)
+{
+    const upload_texture_desc_t *desc = &request->texture;
+    GLsizei levels = 1;
+    if (desc->mipmaps)
+    {
+        for (uint32_t size = desc->width > desc->height ? desc->width : desc->height; size > 1; size >>= 1)
+        {
+            ++levels;
+        }
+    }
+
+    glGenTextures(1, &request->object);
+    glBindTexture(GL_TEXTURE_2D, request->object);
+    if (thread->immutable_textures)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, levels, desc->internal_format, desc->width, desc->height);
+    }
+    else
+    {
+        for (GLsizei level = 0; level < levels; ++level)
+        {
+            GLsizei width = desc->width >> level ? desc->width >> level : 1;
+            GLsizei height = desc->height >> level ? desc->height >> level : 1;
+            glTexImage2D(GL_TEXTURE_2D, level, desc->internal_format, width, height, 0, desc->format, desc->type, NULL);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    if (request->data)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, desc->width, desc->height, desc->format, desc->type, request->data);
+        if (levels > 1)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Linking blocks, which is what the upload thread is for. A failed program is
+// deleted here and reported.
+void upload_thread_create_program(upload_request_t *request)
+{
+    GLuint shaders[UPLOAD_THREAD_MAX_STAGES];
+    request->object = glCreateProgram();
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        shaders[i] = glCreateShader(request->stages[i].type);
+        glShaderSource(shaders[i], 1, &request->stages[i].source, NULL);
+        glCompileShader(shaders[i]);
+        glAttachShader(request->object, shaders[i]);
+    }
+    glLinkProgram(request->object);
+
+    GLint status = 0;
+    glGetProgramiv(request->object, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        char log[2048];
+        glGetProgramInfoLog(request->object, sizeof(log), NULL, log);
+        for (uint32_t i = 0; i < request->stage_count; ++i)
+        {
+            GLint compiled = 0;
+            glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (!compiled)
+            {
+                glGetShaderInfoLog(shaders[i], sizeof(log), NULL, log);
+                break;
+            }
+        }
+        fprintf(stderr, "upload_thread: %s\n", log);
+    }
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        glDetachShader(request->object, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
+    if (!status)
+    {
+        glDeleteProgram(request->object);
+        request->object = 0;
+        request->failed = true;
+    }
+}
+
+void upload_thread_free_inputs(upload_request_t *request)
+{
+    free(request->data);
+    request->data = NULL;
+    for (uint32_t i = 0; i < request->stage_count; ++i)
+    {
+        free((void *)request->stages[i].source);
+        request->stages[i].source = NULL;
+    }
+}
+
+void upload_thread_worker(upload_thread_t *thread)
+{
+    bool current = make_shared_context_current(thread->context);
+    assert(current);
+    gl_validation_initialize(false);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (;;)
+    {
+        upload_request_t *request = NULL;
+        {
+            std::unique_lock<std::mutex> lock(thread->mutex);
+            thread->wake.wait(lock, [thread] { return thread->stop || thread->queue_head; });
+            if (thread->stop)
+            {
+                break;
+            }
+            request = thread->queue_head;
+            thread->queue_head = request->next;
+            if (!thread->queue_head)
+            {
+                thread->queue_tail = NULL;
+            }
+        }
+
+        switch (request->kind)
+        {
+        case UPLOAD_BUFFER: upload_thread_create_buffer(request); break;
+        case UPLOAD_TEXTURE: upload_thread_create_texture(thread, request); break;
+        case UPLOAD_PROGRAM: upload_thread_create_program(request); break;
+        }
+        upload_thread_free_inputs(request);
+
+        request->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        request->uploaded.store(true, std::memory_order_release);
+    }
+
+    make_shared_context_current(NULL);
+}
+
+upload_thread_t *upload_thread_create()
+{
+    upload_thread_t *thread = new upload_thread_t();
+    thread->immutable_textures = gl_dispatch_available(GL_DISPATCH_glTexStorage2D) && gl_supports(4, 2, "GL_ARB_texture_storage");
+    thread->context = create_shared_context();
+    thread->worker = std::thread(upload_thread_worker, thread);
+    return thread;
+}
+
+void upload_thread_delete_object(upload_request_t *request)
+{
+    if (request->object)
+    {
+        switch (request->kind)
+        {
+        case UPLOAD_BUFFER: gl_state_delete_buffer(request->object); break;
+        case UPLOAD_TEXTURE: gl_state_delete_texture(request->object); break;
+        case UPLOAD_PROGRAM: gl_state_delete_program(request->object); break;
+        }
+        request->object = 0;
+    }
+}
+
+// Deletes every object the thread made that was not taken, finished or not.
+void upload_thread_destroy(upload_thread_t *thread)
+{
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->stop = true;
+    }
+    thread->wake.notify_one();
+    thread->worker.join();
+    destroy_shared_context(thread->context);
+
+    for (uint32_t i = 0; i < thread->request_count; ++i)
+    {
+        upload_request_t *request = thread->requests[i];
+        if (!request)
+        {
+            continue;
+        }
+        if (request->fence)
+        {
+            glDeleteSync(request->fence);
+        }
+        upload_thread_delete_object(request);
+        upload_thread_free_inputs(request);
+        delete request;
+    }
+    free(thread->requests);
+    free(thread->free_handles);
+    free(thread->pending);
+    delete thread;
+}
+
+inline void *upload_thread_copy(const void *data, uint32_t size)
+{
+    if (!data)
+    {
+        return NULL;
+    }
+    void *copy = malloc(size);
+    assert(copy);
+    memcpy(copy, data, size);
+    return copy;
+}
+
+uint32_t upload_thread_submit(upload_thread_t *thread, upload_request_t *request)
+{
+    request->status = UPLOAD_PENDING;
+    ++thread->stats.submitted;
+
+    // The free and pending lists never hold more handles than there are, so
+    // they grow with the request array.
+    uint32_t handle;
+    if (thread->free_count)
+    {
+        handle = thread->free_handles[--thread->free_count];
+    }
+    else
+    {
+        if (thread->request_count == thread->request_capacity)
+        {
+            thread->request_capacity = thread->request_capacity ? thread->request_capacity * 2 : 64;
+            thread->requests = (upload_request_t **)realloc(thread->requests, thread->request_capacity * sizeof(upload_request_t *));
+            thread->free_handles = (uint32_t *)realloc(thread->free_handles, thread->request_capacity * sizeof(uint32_t));
+            thread->pending = (uint32_t *)realloc(thread->pending, thread->request_capacity * sizeof(uint32_t));
+            assert(thread->requests && thread->free_handles && thread->pending);
+        }
+        handle = thread->request_count++;
+    }
+    thread->requests[handle] = request;
+    thread->pending[thread->pending_count++] = handle;
+
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        if (thread->queue_tail)
+        {
+            thread->queue_tail->next = request;
+        }
+        else
+        {
+            thread->queue_head = request;
+        }
+        thread->queue_tail = request;
+    }
+    thread->wake.notify_one();
+    return handle;
+}
+
+// Frees the request, whose upload has finished, and puts its handle up for reuse.
+void upload_thread_recycle(upload_thread_t *thread, uint32_t handle)
+{
+    delete thread->requests[handle];
+    thread->requests[handle] = NULL;
+    thread->free_handles[thread->free_count++] = handle;
+}
+
+// Queues a buffer of size bytes, filled from data unless it is NULL, and
+// returns its handle. The data is copied.
+uint32_t upload_thread_submit_buffer(upload_thread_t *thread, const void *data, uint32_t size, uint32_t usage)
+{
+    upload_request_t *request = new upload_request_t();
+    request->kind = UPLOAD_BUFFER;
+    request->data = upload_thread_copy(data, size);
+    request->size = size;
+    request->usage = usage;
+    thread->stats.bytes += data ? size : 0;
+    return upload_thread_submit(thread, request);
+}
+
+// Queues a 2D texture with pixels of size bytes for level 0, or none when
+// pixels is NULL. The pixels are copied and read with an alignment of 1.
+uint32_t upload_thread_submit_texture(upload_thread_t *thread, const upload_texture_desc_t *desc, const void *pixels, uint32_t size)
+{
+    upload_request_t *request = new upload_request_t();
+    request->kind = UPLOAD_TEXTURE;
+    request->texture = *desc;
+    request->data = upload_thread_copy(pixels, size);
+    request->size = size;
+    thread->stats.bytes += pixels ? size : 0;
+    return upload_thread_submit(thread, request);
+}
+
+// Queues a program linked from stages. The sources are copied.
+uint32_t upload_thread_submit_program(upload_thread_t *thread, const program_stage_t *stages, uint32_t stage_count)
+{
+    assert(stage_count <= UPLOAD_THREAD_MAX_STAGES);
+    upload_request_t *request = new upload_request_t();
+    request->kind = UPLOAD_PROGRAM;
+    request->stage_count = stage_count;
+    for (uint32_t i = 0; i < stage_count; ++i)
+    {
+        size_t length = strlen(stages[i].source) + 1;
+        request->stages[i].type = stages[i].type;
+        request->stages[i].source = (const char *)upload_thread_copy(stages[i].source, (uint32_t)length);
+    }
+    return upload_thread_submit(thread, request);
+}
+
+// Picks up finished uploads without waiting for the rest; once a frame. Only
+// the requests still pending are looked at.
+void upload_thread_poll(upload_thread_t *thread)
+{
+    for (uint32_t i = 0; i < thread->pending_count;)
+    {
+        uint32_t handle = thread->pending[i];
+        upload_request_t *request = thread->requests[handle];
+        if (!request->uploaded.load(std::memory_order_acquire))
+        {
+            ++i;
+            continue;
+        }
+        GLenum result = glClientWaitSync(request->fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            ++i;
+            continue;
+        }
+        assert(result != GL_WAIT_FAILED);
+        glDeleteSync(request->fence);
+        request->fence = NULL;
+        thread->pending[i] = thread->pending[--thread->pending_count];
+
+        if (request->failed)
+        {
+            request->status = UPLOAD_FAILED;
+            ++thread->stats.failed;
+        }
+        else
+        {
+            request->status = UPLOAD_READY;
+            ++thread->stats.uploaded;
+        }
+        if (request->released)
+        {
+            upload_thread_delete_object(request);
+            upload_thread_recycle(thread, handle);
+        }
+    }
+}
+
+inline const upload_request_t *upload_thread_request(const upload_thread_t *thread, uint32_t handle)
+{
+    assert(handle < thread->request_count);
+    const upload_request_t *request = thread->requests[handle];
+    assert(request && !request->released);
+    return request;
+}
+
+inline upload_status_t upload_thread_status(const upload_thread_t *thread, uint32_t handle)
+{
+    return upload_thread_request(thread, handle)->status;
+}
+
+// The object once its upload has finished, 0 before that or if it failed.
+inline uint32_t upload_thread_object(const upload_thread_t *thread, uint32_t handle)
+{
+    const upload_request_t *request = upload_thread_request(thread, handle);
+    return request->status == UPLOAD_READY ? request->object : 0;
+}
+
+// Hands a ready object over to the caller, who deletes it from then on, and
+// frees the handle.
+uint32_t upload_thread_take(upload_thread_t *thread, uint32_t handle)
+{
+    assert(upload_thread_status(thread, handle) == UPLOAD_READY);
+    uint32_t object = thread->requests[handle]->object;
+    upload_thread_recycle(thread, handle);
+    return object;
+}
+
+// Gives up on a request and frees the handle: a ready object is deleted, a
+// failed request forgotten, and a pending one deleted by the poll that sees
+// it finish.
+void upload_thread_release(upload_thread_t *thread, uint32_t handle)
+{
+    assert(upload_thread_request(thread, handle));
+    upload_request_t *request = thread->requests[handle];
+    if (request->status == UPLOAD_PENDING)
+    {
+        request->released = true;
+        return;
+    }
+    upload_thread_delete_object(request);
+    upload_thread_recycle(thread, handle);
+}
+
+inline uint32_t upload_thread_pending(const upload_thread_t *thread)
+{
+    return thread->pending_count;
+}
@@ -0,0 +1,418 @@
+#pragma once
+
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "opengl.h"
+#include "gl_state.h"
+
+// Meshes of any vertex layout drawn through one empty vertex array. Vertices
+// and indices of every mesh are packed into two shared buffers; a format
+// table says where each attribute sits in a vertex and how it is encoded, and
+// a mesh table says which format, vertices and indices a mesh uses. The
+// vertex shader fetches and decodes its attributes by gl_VertexID, the way
+// load_vertex_shader_code() indexes its constant array:
+//
+//     void main()
+//     {
+//         uint vertex = pull_vertex_index();
+//         gl_Position = transform * pull_attribute(vertex, 0u);
+//         color = pull_attribute(vertex, 1u);
+//     }
+//
+// Switching meshes, even between layouts, is one uniform instead of a vertex
+// array and attribute format change. Needs GL 4.3; the data is read from
+// shader storage buffers, or from buffer textures where the vertex stage has
+// no storage blocks. Define VERTEX_PULLING_FORCE_TEXTURES to test that path.
+
+#define VERTEX_PULLING_MAX_ATTRIBUTES 8
+
+// First of four storage buffer bindings or texture units, above the ones
+// gpu_culling uses.
+#define VERTEX_PULLING_BINDING 8
+
+// Uniform location of the mesh index, high so shaders can number theirs from 0.
+#define VERTEX_PULLING_MESH_LOCATION 63
+
+// Attribute encodings; attributes start on 4-byte boundaries. Components a
+// type lacks read as 0, and w as 1.
+enum vertex_attribute_type_t
+{
+    VERTEX_ATTRIBUTE_NONE = 0,
+    VERTEX_ATTRIBUTE_FLOAT1 = 1,
+    VERTEX_ATTRIBUTE_FLOAT2 = 2,
+    VERTEX_ATTRIBUTE_FLOAT3 = 3,
+    VERTEX_ATTRIBUTE_FLOAT4 = 4,
+    VERTEX_ATTRIBUTE_HALF2 = 5,
+    VERTEX_ATTRIBUTE_HALF4 = 6,
+    VERTEX_ATTRIBUTE_UNORM8X4 = 7,
+    VERTEX_ATTRIBUTE_SNORM8X4 = 8,
+    VERTEX_ATTRIBUTE_UNORM16X2 = 9,
+    VERTEX_ATTRIBUTE_SNORM16X2 = 10,
+    VERTEX_ATTRIBUTE_UNORM16X4 = 11,
+    VERTEX_ATTRIBUTE_SNORM16X4 = 12,
+};
+
+struct vertex_attribute_t
+{
+    vertex_attribute_type_t type;
+    uint32_t offset;            // in bytes from the start of the vertex
+};
+
+// attributes[i] is what pull_attribute(vertex, i) returns.
+struct vertex_format_t
+{
+    uint32_t stride;
+    vertex_attribute_t attributes[VERTEX_PULLING_MAX_ATTRIBUTES];
+};
+
+struct vertex_pulling_mesh_t
+{
+    uint32_t format;
+    uint32_t vertex_offset;     // bytes into the vertex buffer
+    uint32_t vertex_count;
+    uint32_t index_offset;      // bytes into the index buffer
+    uint32_t index_count;
+    uint32_t index_size;        // 2 or 4, 0 without indices
+};
+
+struct vertex_pulling_t
+{
+    bool storage_buffers;
+    uint32_t vertex_array;
+
+    // Vertices, indices, formats and meshes, in binding order.
+    uint32_t buffers[4];
+    uint32_t textures[4];
+
+    uint32_t vertex_capacity;
+    uint32_t vertex_size;
+    uint32_t index_capacity;
+    uint32_t index_size;
+
+    vertex_format_t *formats;
+    uint32_t format_count;
+    uint32_t max_formats;
+
+    vertex_pulling_mesh_t *meshes;
+    uint32_t mesh_count;
+    uint32_t max_meshes;
+};
+
+// The format table holds a header (stride) and one entry (type, offset) per
+// attribute for each format, the mesh table one entry (format, vertex offset,
+// index offset, index size) per mesh, all as uvec4.
+const char *vertex_pulling_source = R"(
+
+#define PULL_FORMAT_ENTRIES (1 + PULL_MAX_ATTRIBUTES)
+
+#if PULL_STORAGE_BUFFERS
+layout(std430, binding = PULL_BINDING_VERTICES) readonly buffer pull_vertex_block { uint pull_vertices[]; };
+layout(std430, binding = PULL_BINDING_INDICES) readonly buffer pull_index_block { uint pull_indices[]; };
+layout(std430, binding = PULL_BINDING_FORMATS) readonly buffer pull_format_block { uvec4 pull_formats[]; };
+layout(std430, binding = PULL_BINDING_MESHES) readonly buffer pull_mesh_block { uvec4 pull_meshes[]; };
+#define pull_vertex_word(i) pull_vertices[i]
+#define pull_index_word(i) pull_indices[i]
+#define pull_format_entry(i) pull_formats[i]
+#define pull_mesh_entry(i) pull_meshes[i]
+#else
+layout(binding = PULL_BINDING_VERTICES) uniform usamplerBuffer pull_vertices;
+layout(binding = PULL_BINDING_INDICES) uniform usamplerBuffer pull_indices;
+layout(binding = PULL_BINDING_FORMATS) uniform usamplerBuffer pull_formats;
+layout(binding = PULL_BINDING_MESHES) uniform usamplerBuffer pull_meshes;
+#define pull_vertex_word(i) texelFetch(pull_vertices, int(i)).x
+#define pull_index_word(i) texelFetch(pull_indices, int(i)).x
+#define pull_format_entry(i) texelFetch(pull_formats, int(i))
+#define pull_mesh_entry(i) texelFetch(pull_meshes, int(i))
+#endif
+
+layout(location = PULL_MESH_LOCATION) uniform uint pull_mesh;
+
+uint pull_vertex_index()
+{
+    uvec4 mesh = pull_mesh_entry(pull_mesh);
+    uint vertex = uint(gl_VertexID);
+    if (mesh.w == 2u)
+    {
+        uint byte = mesh.z + vertex * 2u;
+        return (pull_index_word(byte >> 2) >> ((byte & 2u) * 8u)) & 0xffffu;
+    }
+    if (mesh.w == 4u)
+    {
+        return pull_index_word((mesh.z >> 2) + vertex);
+    }
+    return vertex;
+}
+
+vec4 pull_attribute(uint vertex, uint slot)
+{
+    uvec4 mesh = pull_mesh_entry(pull_mesh);
+    uint format = mesh.x * uint(PULL_FORMAT_ENTRIES);
+    uint stride = pull_format_entry(format).x;
+    uvec4 layout_entry = pull_format_entry(format + 1u + slot);
+    uint word = (mesh.y + vertex * stride + layout_entry.y) >> 2;
+
+    switch (layout_entry.x)
+    {
+    case 1u: return vec4(uintBitsToFloat(pull_vertex_word(word)), 0.0, 0.0, 1.0);
+    case 2u: return vec4(uintBitsToFloat(pull_vertex_word(word)), uintBitsToFloat(pull_vertex_word(word + 1u)), 0.0, 1.0);
+    case 3u: return vec4(uintBitsToFloat(pull_vertex_word(word)), uintBitsToFloat(pull_vertex_word(word + 1u)), uintBitsToFloat(pull_vertex_word(word + 2u)), 1.0);
+    case 4u: return vec4(uintBitsToFloat(pull_vertex_word(word)), uintBitsToFloat(pull_vertex_word(word + 1u)), uintBitsToFloat(pull_vertex_word(word + 2u)), uintBitsToFloat(pull_vertex_word(word + 3u)));
+    case 5u: return vec4(unpackHalf2x16(pull_vertex_word(word)), 0.0, 1.0);
+    case 6u: return vec4(unpackHalf2x16(pull_vertex_word(word)), unpackHalf2x16(pull_vertex_word(word + 1u)));
+    case 7u: return unpackUnorm4x8(pull_vertex_word(word));
+    case 8u: return unpackSnorm4x8(pull_vertex_word(word));
+    case 9u: return vec4(unpackUnorm2x16(pull_vertex_word(word)), 0.0, 1.0);
+    case 10u: return vec4(unpackSnorm2x16(pull_vertex_word(word)), 0.0, 1.0);
+    case 11u: return vec4(unpackUnorm2x16(pull_vertex_word(word)), unpackUnorm2x16(pull_vertex_word(word + 1u)));
+    case 12u: return vec4(unpackSnorm2x16(pull_vertex_word(word)), unpackSnorm2x16(pull_vertex_word(word + 1u)));
+    }
+    return vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+)";
+
+uint32_t vertex_pulling_create_buffer(uint32_t size)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+    return buffer;
+}
+
+// Capacities are in bytes for vertices and indices.
+vertex_pulling_t *vertex_pulling_create(uint32_t vertex_capacity, uint32_t index_capacity, uint32_t max_formats, uint32_t max_meshes)
+{
+    assert(gl_supports(4, 3, NULL));
+
+    vertex_pulling_t *pulling = (vertex_pulling_t *)calloc(1, sizeof(vertex_pulling_t));
+    assert(pulling);
+    GLint vertex_storage_blocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertex_storage_blocks);
+#ifdef VERTEX_PULLING_FORCE_TEXTURES
+    vertex_storage_blocks = 0;
+#endif
+    pulling->storage_buffers = vertex_storage_blocks >= 4;
+
+    pulling->vertex_capacity = (vertex_capacity + 15) & ~15u;
+    pulling->index_capacity = (index_capacity + 15) & ~15u;
+    pulling->max_formats = max_formats;
+    pulling->max_meshes = max_meshes;
+    pulling->formats = (vertex_format_t *)calloc(max_formats, sizeof(vertex_format_t));
+    pulling->meshes = (vertex_pulling_mesh_t *)calloc(max_meshes, sizeof(vertex_pulling_mesh_t));
+    assert(pulling->formats && pulling->meshes);
+
+    uint32_t sizes[4] = {
+        pulling->vertex_capacity,
+        pulling->index_capacity,
+        max_formats * (1 + VERTEX_PULLING_MAX_ATTRIBUTES) * 16,
+        max_meshes * 16,
+    };
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        pulling->buffers[i] = vertex_pulling_create_buffer(sizes[i]);
+    }
+
+    if (!pulling->storage_buffers)
+    {
+        uint32_t formats[4] = { GL_R32UI, GL_R32UI, GL_RGBA32UI, GL_RGBA32UI };
+        glGenTextures(4, pulling->textures);
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            gl_state_bind_texture(VERTEX_PULLING_BINDING + i, GL_TEXTURE_BUFFER, pulling->textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], pulling->buffers[i]);
+        }
+    }
+
+    glGenVertexArrays(1, &pulling->vertex_array);
+    return pulling;
+}
+
+void vertex_pulling_destroy(vertex_pulling_t *pulling)
+{
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (pulling->textures[i])
+        {
+            gl_state_delete_texture(pulling->textures[i]);
+        }
+        gl_state_delete_buffer(pulling->buffers[i]);
+    }
+    if (gl_state.vertex_array == pulling->vertex_array)
+    {
+        gl_state_bind_vertex_array(0);
+    }
+    glDeleteVertexArrays(1, &pulling->vertex_array);
+    free(pulling->formats);
+    free(pulling->meshes);
+    free(pulling);
+}
+
+// Returns the format's index; equal formats share one.
+uint32_t vertex_pulling_add_format(vertex_pulling_t *pulling, const vertex_format_t *format)
+{
+    vertex_format_t normalized = {};
+    normalized.stride = format->stride;
+    assert(format->stride % 4 == 0);
+    for (uint32_t i = 0; i < VERTEX_PULLING_MAX_ATTRIBUTES; ++i)
+    {
+        if (format->attributes[i].type != VERTEX_ATTRIBUTE_NONE)
+        {
+            assert(format->attributes[i].offset % 4 == 0 && format->attributes[i].offset < format->stride);
+            normalized.attributes[i] = format->attributes[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < pulling->format_count; ++i)
+    {
+        if (memcmp(&pulling->formats[i], &normalized, sizeof(normalized)) == 0)
+        {
+            return i;
+        }
+    }
+
+    assert(pulling->format_count < pulling->max_formats);
+    uint32_t index = pulling->format_count++;
+    pulling->formats[index] = normalized;
+
+    uint32_t entries[(1 + VERTEX_PULLING_MAX_ATTRIBUTES) * 4] = {};
+    entries[0] = normalized.stride;
+    for (uint32_t i = 0; i < VERTEX_PULLING_MAX_ATTRIBUTES; ++i)
+    {
+        entries[(1 + i) * 4] = (uint32_t)normalized.attributes[i].type;
+        entries[(1 + i) * 4 + 1] = normalized.attributes[i].offset;
+    }
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pulling->buffers[2]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index * sizeof(entries), sizeof(entries), entries);
+    return index;
+}
+
+// Appends a mesh and returns its index. index_type is GL_UNSIGNED_SHORT or
+// GL_UNSIGNED_INT; pass NULL indices to draw the vertices in order.
+uint32_t vertex_pulling_add_mesh(vertex_pulling_t *pulling,
+    uint32_t format,
+    const void *vertices,
+    uint32_t vertex_count,
+    const void *indices,
+    uint32_t index_count,
+    uint32_t index_type)
+{
+    assert(format < pulling->format_count);
+    assert(pulling->mesh_count < pulling->max_meshes);
+
+    vertex_pulling_mesh_t mesh = {};
+    mesh.format = format;
+    mesh.vertex_count = vertex_count;
+    mesh.vertex_offset = pulling->vertex_size;
+    uint32_t vertex_bytes = vertex_count * pulling->formats[format].stride;
+    assert(pulling->vertex_size + vertex_bytes <= pulling->vertex_capacity);
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pulling->buffers[0]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.vertex_offset, vertex_bytes, vertices);
+    pulling->vertex_size += vertex_bytes;
+
+    if (indices)
+    {
+        assert(index_type == GL_UNSIGNED_SHORT || index_type == GL_UNSIGNED_INT);
+        mesh.index_size = index_type == GL_UNSIGNED_INT ? 4 : 2;
+        mesh.index_count = index_count;
+        mesh.index_offset = pulling->index_size;
+        uint32_t index_bytes = index_count * mesh.index_size;
+        assert(pulling->index_size + index_bytes <= pulling->index_capacity);
+        gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pulling->buffers[1]);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.index_offset, index_bytes, indices);
+        pulling->index_size += (index_bytes + 3) & ~3u;
+    }
+
+    uint32_t index = pulling->mesh_count++;
+    pulling->meshes[index] = mesh;
+
+    uint32_t entry[4] = { mesh.format, mesh.vertex_offset, mesh.index_offset, mesh.index_size };
+    gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, pulling->buffers[3]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index * sizeof(entry), sizeof(entry), entry);
+    return index;
+}
+
+uint32_t vertex_pulling_compile_shader(uint32_t type, uint32_t count, const char **sources)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, (GLsizei)count, sources, NULL);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status)
+    {
+        char log[2048];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "vertex_pulling: %s\n", log);
+    }
+    assert(status);
+    return shader;
+}
+
+// Links vertex_body, which sees pull_vertex_index() and pull_attribute(), with
+// a complete fragment shader.
+uint32_t vertex_pulling_compile(const vertex_pulling_t *pulling, const char *vertex_body, const char *fragment_source)
+{
+    // GLSL 4.30 wants literal binding numbers.
+    char prefix[320];
+    snprintf(prefix, sizeof(prefix),
+        "#version 430\n#define PULL_STORAGE_BUFFERS %d\n"
+        "#define PULL_BINDING_VERTICES %d\n#define PULL_BINDING_INDICES %d\n#define PULL_BINDING_FORMATS %d\n#define PULL_BINDING_MESHES %d\n"
+        "#define PULL_MAX_ATTRIBUTES %d\n#define PULL_MESH_LOCATION %d\n",
+        pulling->storage_buffers ? 1 : 0,
+        VERTEX_PULLING_BINDING,
+        VERTEX_PULLING_BINDING + 1,
+        VERTEX_PULLING_BINDING + 2,
+        VERTEX_PULLING_BINDING + 3,
+        VERTEX_PULLING_MAX_ATTRIBUTES,
+        VERTEX_PULLING_MESH_LOCATION);
+
+    const char *vertex_sources[] = { prefix, vertex_pulling_source, vertex_body };
+    GLuint vertex_shader = vertex_pulling_compile_shader(GL_VERTEX_SHADER, 3, vertex_sources);
+    GLuint fragment_shader = vertex_pulling_compile_shader(GL_FRAGMENT_SHADER, 1, &fragment_source);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glDetachShader(program, vertex_shader);
+    glDetachShader(program, fragment_shader);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    assert(status);
+    return program;
+}
+
+// Binds the shared vertex array and the four tables. Call once before a run of
+// vertex_pulling_draw() calls, with the program in use.
+void vertex_pulling_bind(const vertex_pulling_t *pulling)
+{
+    gl_state_bind_vertex_array(pulling->vertex_array);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (pulling->storage_buffers)
+        {
+            gl_state_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, VERTEX_PULLING_BINDING + i, pulling->buffers[i], 0, -1);
+        }
+        else
+        {
+            gl_state_bind_texture(VERTEX_PULLING_BINDING + i, GL_TEXTURE_BUFFER, pulling->textures[i]);
+        }
+    }
+}
+
+void vertex_pulling_draw(const vertex_pulling_t *pulling, uint32_t mode, uint32_t mesh, int32_t instance_count)
+{
+    assert(mesh < pulling->mesh_count);
+    const vertex_pulling_mesh_t *entry = &pulling->meshes[mesh];
+    gl_state_uniform_1ui(VERTEX_PULLING_MESH_LOCATION, mesh);
+    GLsizei count = (GLsizei)(entry->index_size ? entry->index_count : entry->vertex_count);
+    glDrawArraysInstanced(mode, 0, count, instance_count);
+}